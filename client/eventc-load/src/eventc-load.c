@@ -0,0 +1,452 @@
+/*
+ * eventc-load - Load generator for eventd
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include "nkutils-git-version.h"
+
+#include "libeventd-event.h"
+
+#include "libeventc-light.h"
+
+#define EVENTC_LOAD_TICK 5
+#define EVENTC_LOAD_BATCH 64
+#define EVENTC_LOAD_CLOSE_TIMEOUT 1000
+
+typedef struct {
+    EventcLightConnection *connection;
+    guint watch;
+} EventcLoadConnection;
+
+static struct {
+    GMainLoop *loop;
+    const gchar *category;
+    const gchar *name;
+    gchar *payload;
+    EventcLoadConnection *senders;
+    EventcLoadConnection *receivers;
+    guint n_senders;
+    guint n_receivers;
+    guint64 rate;
+    guint64 count;
+    guint64 sent;
+    guint64 received;
+    gint64 start;
+    gint64 stop;
+    gint64 last_received;
+    gint64 deadline;
+    GArray *latencies;
+    guint source;
+    gint error;
+} load;
+
+static void
+_eventc_load_done(void)
+{
+    if ( ( load.sent < load.count ) || ( load.received < load.sent * load.n_receivers ) )
+        return;
+
+    g_main_loop_quit(load.loop);
+}
+
+static void
+_eventc_load_received_event_callback(EventcLightConnection *connection, EventdEvent *event, gpointer user_data)
+{
+    GVariant *time;
+
+    if ( ( g_strcmp0(eventd_event_get_category(event), load.category) != 0 ) || ( g_strcmp0(eventd_event_get_name(event), load.name) != 0 ) )
+        return;
+
+    time = eventd_event_get_data(event, "load-time");
+    if ( ( time == NULL ) || ( ! g_variant_is_of_type(time, G_VARIANT_TYPE_INT64) ) )
+        return;
+
+    load.last_received = g_get_monotonic_time();
+    gint64 latency = load.last_received - g_variant_get_int64(time);
+    g_array_append_val(load.latencies, latency);
+    ++load.received;
+
+    _eventc_load_done();
+}
+
+static void
+_eventc_load_disconnected_callback(EventcLightConnection *connection, gpointer user_data)
+{
+    EventcLoadConnection *self = user_data;
+
+    if ( self->watch == 0 )
+        return;
+
+    g_warning("Connection %p closed by the server", connection);
+    g_source_remove(self->watch);
+    self->watch = 0;
+    load.error = -ECONNRESET;
+    g_main_loop_quit(load.loop);
+}
+
+static gboolean
+_eventc_load_connection_read(gint fd, GIOCondition condition, gpointer user_data)
+{
+    EventcLoadConnection *self = user_data;
+    gint error;
+
+    error = eventc_light_connection_read(self->connection);
+    if ( self->watch == 0 )
+        /* The disconnected callback already handled it */
+        return G_SOURCE_REMOVE;
+    if ( error == 0 )
+        return G_SOURCE_CONTINUE;
+
+    if ( error < 0 )
+    {
+        g_warning("Couldn't read from eventd: %s", g_strerror(-error));
+        load.error = error;
+    }
+    self->watch = 0;
+    g_main_loop_quit(load.loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_eventc_load_connection_open(EventcLoadConnection *self, const gchar *socket, gboolean subscribe)
+{
+    gint error;
+
+    self->connection = eventc_light_connection_new(socket);
+    eventc_light_connection_set_disconnected_callback(self->connection, _eventc_load_disconnected_callback, self, NULL);
+    if ( subscribe )
+    {
+        eventc_light_connection_set_subscribe(self->connection, TRUE);
+        eventc_light_connection_add_subscription(self->connection, g_strdup(load.category));
+        eventc_light_connection_set_received_event_callback(self->connection, _eventc_load_received_event_callback, self, NULL);
+    }
+
+    error = eventc_light_connection_connect(self->connection);
+    if ( error != 0 )
+    {
+        g_warning("Couldn't connect to eventd: %s", g_strerror(-error));
+        return FALSE;
+    }
+
+    self->watch = g_unix_fd_add(eventc_light_connection_get_socket(self->connection), G_IO_IN, _eventc_load_connection_read, self);
+    return TRUE;
+}
+
+static void
+_eventc_load_connection_close(EventcLoadConnection *self)
+{
+    if ( self->connection == NULL )
+        return;
+
+    if ( self->watch > 0 )
+    {
+        guint watch = self->watch;
+        self->watch = 0;
+        g_source_remove(watch);
+
+        GPollFD fd = {
+            .fd = eventc_light_connection_get_socket(self->connection),
+            .events = G_IO_OUT,
+        };
+        while ( eventc_light_connection_close(self->connection) == -EAGAIN )
+        {
+            if ( g_poll(&fd, 1, EVENTC_LOAD_CLOSE_TIMEOUT) < 1 )
+            {
+                g_warning("Couldn't send the pending events before closing");
+                break;
+            }
+        }
+    }
+    eventc_light_connection_unref(self->connection);
+}
+
+static gboolean
+_eventc_load_linger(gpointer user_data)
+{
+    load.source = 0;
+    g_main_loop_quit(load.loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_eventc_load_send(gpointer user_data)
+{
+    gint64 now = g_get_monotonic_time();
+    guint64 target;
+
+    if ( load.rate == 0 )
+        target = MIN(load.count, load.sent + EVENTC_LOAD_BATCH);
+    else
+        target = MIN(load.count, ( now - load.start ) * load.rate / G_USEC_PER_SEC);
+
+    if ( ( load.deadline > 0 ) && ( now >= load.deadline ) )
+        load.count = target = load.sent;
+
+    for ( ; load.sent < target ; ++load.sent )
+    {
+        EventcLoadConnection *sender = &load.senders[load.sent % load.n_senders];
+        EventdEvent *event;
+        gint error;
+
+        event = eventd_event_new(load.category, load.name);
+        eventd_event_add_data(event, g_strdup("load-id"), g_variant_new_uint64(load.sent));
+        if ( load.payload != NULL )
+            eventd_event_add_data_string(event, g_strdup("load-payload"), g_strdup(load.payload));
+        /* Stamped last so the time spent building the event is not accounted */
+        eventd_event_add_data(event, g_strdup("load-time"), g_variant_new_int64(g_get_monotonic_time()));
+        error = eventc_light_connection_send_event(sender->connection, event);
+        eventd_event_unref(event);
+
+        if ( error == -EAGAIN )
+            /* The server is not keeping up, we try again on the next tick */
+            break;
+        if ( error != 0 )
+        {
+            g_warning("Couldn't send event: %s", g_strerror(-error));
+            load.error = error;
+            load.source = 0;
+            g_main_loop_quit(load.loop);
+            return G_SOURCE_REMOVE;
+        }
+    }
+
+    if ( load.sent < load.count )
+        return G_SOURCE_CONTINUE;
+
+    load.stop = g_get_monotonic_time();
+    load.source = g_timeout_add_seconds(GPOINTER_TO_UINT(user_data), _eventc_load_linger, NULL);
+    _eventc_load_done();
+
+    return G_SOURCE_REMOVE;
+}
+
+static gint
+_eventc_load_latency_compare(gconstpointer a_, gconstpointer b_)
+{
+    const gint64 *a = a_, *b = b_;
+
+    return ( *a > *b ) - ( *a < *b );
+}
+
+static gdouble
+_eventc_load_latency_quantile(guint per_mille)
+{
+    guint i = ( load.latencies->len - 1 ) * per_mille / 1000;
+
+    return g_array_index(load.latencies, gint64, i) / 1000.;
+}
+
+static void
+_eventc_load_report(void)
+{
+    gdouble sending = ( load.stop - load.start ) / (gdouble) G_USEC_PER_SEC;
+    gdouble receiving = ( load.last_received - load.start ) / (gdouble) G_USEC_PER_SEC;
+
+    g_print("Sent %" G_GUINT64_FORMAT " events over %u connections in %.3f s: %.0f events/s\n", load.sent, load.n_senders, sending, ( sending > 0 ) ? ( load.sent / sending ) : 0.);
+
+    if ( load.n_receivers == 0 )
+        return;
+
+    g_print("Received %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT " events on %u subscribers in %.3f s: %.0f events/s\n", load.received, load.sent * load.n_receivers, load.n_receivers, receiving, ( receiving > 0 ) ? ( load.received / receiving ) : 0.);
+
+    if ( load.latencies->len == 0 )
+        return;
+
+    gdouble sum = 0;
+    guint i;
+
+    g_array_sort(load.latencies, _eventc_load_latency_compare);
+    for ( i = 0 ; i < load.latencies->len ; ++i )
+        sum += g_array_index(load.latencies, gint64, i);
+
+    g_print("Latency (ms): min %.3f, mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+        g_array_index(load.latencies, gint64, 0) / 1000.,
+        sum / load.latencies->len / 1000.,
+        _eventc_load_latency_quantile(500),
+        _eventc_load_latency_quantile(900),
+        _eventc_load_latency_quantile(990),
+        _eventc_load_latency_quantile(999),
+        g_array_index(load.latencies, gint64, load.latencies->len - 1) / 1000.);
+}
+
+static void
+_eventc_load_raise_fd_limit(guint needed)
+{
+    struct rlimit limit;
+
+    if ( getrlimit(RLIMIT_NOFILE, &limit) < 0 )
+        return;
+    if ( limit.rlim_cur >= needed )
+        return;
+
+    limit.rlim_cur = MIN(limit.rlim_max, MAX(needed, limit.rlim_cur));
+    if ( setrlimit(RLIMIT_NOFILE, &limit) < 0 )
+        g_warning("Couldn't raise the file descriptor limit: %s", g_strerror(errno));
+}
+
+int
+main(int argc, char *argv[])
+{
+    int retval = 0;
+    gchar *socket = NULL;
+    gint connections = 1;
+    gint subscribers = 1;
+    gint64 rate = 0;
+    gint64 count = 10000;
+    gint duration = 0;
+    gint size = 0;
+    gint linger = 5;
+    gboolean print_version = FALSE;
+    guint i;
+
+    setlocale(LC_ALL, "");
+
+    GOptionEntry entries[] =
+    {
+        { "socket",      's', 0, G_OPTION_ARG_FILENAME, &socket,        "Socket to connect to (defaults to $EVENTC_HOST if defined)", "<path>" },
+        { "connections", 'c', 0, G_OPTION_ARG_INT,      &connections,   "Number of sending connections",                               "<number>" },
+        { "subscribers", 'S', 0, G_OPTION_ARG_INT,      &subscribers,   "Number of subscribed connections measuring latency",         "<number>" },
+        { "rate",        'r', 0, G_OPTION_ARG_INT64,    &rate,          "Events per second to send (0 for as fast as possible)",      "<events/s>" },
+        { "count",       'n', 0, G_OPTION_ARG_INT64,    &count,         "Number of events to send",                                   "<events>" },
+        { "duration",    't', 0, G_OPTION_ARG_INT,      &duration,      "Stop sending after this time (0 for no limit)",              "<seconds>" },
+        { "size",        'z', 0, G_OPTION_ARG_INT,      &size,          "Size of the payload to add to each event",                   "<bytes>" },
+        { "linger",      'l', 0, G_OPTION_ARG_INT,      &linger,        "Time to wait for pending events after the last one is sent", "<seconds>" },
+        { "version",     'V', 0, G_OPTION_ARG_NONE,     &print_version, "Print version",                                              NULL },
+        { .long_name = NULL }
+    };
+    GOptionContext *opt_context = g_option_context_new("[<event category> [<event name>]] - Load generator for eventd");
+
+    g_option_context_set_summary(opt_context, ""
+        "eventc-load will open <connections> connections to <socket> and send events of the given category and name (defaults to test load) at the given rate."
+        "\n  Each event carries its sending time, and <subscribers> extra connections subscribe to the category to measure the end-to-end latency."
+        "\n  eventd only dispatches events it has a configuration for, so make sure the category is configured."
+        "");
+
+    g_option_context_add_main_entries(opt_context, entries, GETTEXT_PACKAGE);
+
+    GError *error = NULL;
+    if ( ! g_option_context_parse(opt_context, &argc, &argv, &error) )
+    {
+        g_warning("Couldn't parse the arguments: %s", error->message);
+        g_option_context_free(opt_context);
+        return 1;
+    }
+    g_option_context_free(opt_context);
+
+    if ( print_version )
+    {
+        g_print("eventc-load %s (using libeventc-light %s)\n",
+            NK_PACKAGE_VERSION,
+            eventc_light_get_version());
+        goto end;
+    }
+
+    if ( ( connections < 1 ) || ( subscribers < 0 ) || ( rate < 0 ) || ( count < 1 ) || ( duration < 0 ) || ( size < 0 ) || ( linger < 0 ) )
+    {
+        g_print("Invalid arguments, see --help\n");
+        retval = 1;
+        goto end;
+    }
+
+    load.category = ( argc > 1 ) ? argv[1] : "test";
+    load.name = ( argc > 2 ) ? argv[2] : "load";
+    load.rate = rate;
+    load.count = count;
+    load.n_senders = connections;
+    load.n_receivers = subscribers;
+    if ( size > 0 )
+    {
+        load.payload = g_malloc(size + 1);
+        memset(load.payload, 'x', size);
+        load.payload[size] = '\0';
+    }
+    load.latencies = g_array_sized_new(FALSE, FALSE, sizeof(gint64), MIN(count * subscribers, 1 << 20));
+    load.loop = g_main_loop_new(NULL, FALSE);
+
+    _eventc_load_raise_fd_limit(connections + subscribers + 16);
+
+    load.receivers = g_new0(EventcLoadConnection, load.n_receivers);
+    for ( i = 0 ; i < load.n_receivers ; ++i )
+    {
+        if ( ! _eventc_load_connection_open(&load.receivers[i], socket, TRUE) )
+            goto close;
+    }
+
+    load.senders = g_new0(EventcLoadConnection, load.n_senders);
+    for ( i = 0 ; i < load.n_senders ; ++i )
+    {
+        if ( ! _eventc_load_connection_open(&load.senders[i], socket, FALSE) )
+            goto close;
+    }
+
+    load.start = g_get_monotonic_time();
+    if ( duration > 0 )
+        load.deadline = load.start + duration * G_USEC_PER_SEC;
+    if ( load.rate == 0 )
+        load.source = g_idle_add(_eventc_load_send, GUINT_TO_POINTER(linger));
+    else
+        load.source = g_timeout_add(EVENTC_LOAD_TICK, _eventc_load_send, GUINT_TO_POINTER(linger));
+
+    g_main_loop_run(load.loop);
+
+    if ( load.stop == 0 )
+        load.stop = g_get_monotonic_time();
+    if ( load.source > 0 )
+        g_source_remove(load.source);
+
+    _eventc_load_report();
+
+close:
+    if ( load.senders != NULL )
+    {
+        for ( i = 0 ; i < load.n_senders ; ++i )
+            _eventc_load_connection_close(&load.senders[i]);
+    }
+    for ( i = 0 ; i < load.n_receivers ; ++i )
+        _eventc_load_connection_close(&load.receivers[i]);
+
+    if ( ( load.error != 0 ) || ( load.sent < load.count ) )
+        retval = 1;
+    else if ( load.received < load.sent * load.n_receivers )
+        retval = 2;
+
+    g_free(load.senders);
+    g_free(load.receivers);
+    g_array_unref(load.latencies);
+    g_main_loop_unref(load.loop);
+    g_free(load.payload);
+
+end:
+    g_free(socket);
+
+    return retval;
+}
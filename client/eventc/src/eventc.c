@@ -92,12 +92,19 @@ _eventc_send_event(void)
     g_idle_add(_eventc_disconnect, NULL);
 }
 
-static gboolean
-_eventc_disconnect(gpointer user_data)
+static void
+_eventc_disconnect_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
 {
     GError *error = NULL;
-    if ( ! eventc_connection_close(client, &error) )
+    if ( ! eventc_connection_close_finish(EVENTC_CONNECTION(obj), res, &error) )
         g_warning("Couldn't disconnect from event: %s", error->message);
+    g_clear_error(&error);
+}
+
+static gboolean
+_eventc_disconnect(gpointer user_data)
+{
+    eventc_connection_close_async(client, NULL, _eventc_disconnect_callback, NULL);
 
     return G_SOURCE_REMOVE;
 }
@@ -122,6 +129,10 @@ main(int argc, char *argv[])
     gchar **file_strv = NULL;
     GHashTable *data = NULL;
     gboolean subscribe = FALSE;
+    gchar **if_data_strv = NULL;
+    gchar **if_data_matches_strv = NULL;
+    gchar **if_data_regex_strv = NULL;
+    gchar **only_data_strv = NULL;
     gint ping_interval = 0;
     gboolean system_mode = FALSE;
 
@@ -146,6 +157,10 @@ main(int argc, char *argv[])
         { "certificate",   'c', 0, G_OPTION_ARG_FILENAME,       &certificate_file, "TLS certicate file to use",                                "<certificate>" },
         { "key",           'k', 0, G_OPTION_ARG_FILENAME,       &key_file,         "TLS key file to use",                                      "<key>" },
         { "subscribe",     's', 0, G_OPTION_ARG_NONE,           &subscribe,        "Subscribe mode",                                           NULL },
+        { "if-data",         0, 0, G_OPTION_ARG_STRING_ARRAY,   &if_data_strv,     "Subscribe mode: only receive events with this data",       "<name>" },
+        { "if-data-matches", 0, 0, G_OPTION_ARG_STRING_ARRAY,   &if_data_matches_strv, "Subscribe mode: only receive events with matching data", "<name>,<operator>,<value>" },
+        { "if-data-regex",   0, 0, G_OPTION_ARG_STRING_ARRAY,   &if_data_regex_strv, "Subscribe mode: only receive events with matching data", "<name>,<regex>" },
+        { "only-data",       0, 0, G_OPTION_ARG_STRING_ARRAY,   &only_data_strv,   "Subscribe mode: only receive this data",                   "<name>" },
         { "ping-interval", 'p', 0, G_OPTION_ARG_INT,            &ping_interval,    "Ping interval",                                            "<seconds>" },
 #ifdef G_OS_UNIX
         { "system",        'S', 0, G_OPTION_ARG_NONE,           &system_mode,      "Talk to system eventd",                                    NULL },
@@ -165,6 +180,7 @@ main(int argc, char *argv[])
         "\n\n"
         "Subscribe mode: eventc --subscribe [<event category>...]"
         "\n  eventc will connect to <URI> and wait for an event of the specified categories. If no category is specified, it will wait for any event."
+        "\n  Filters are evaluated by the server, with the same syntax as the IfData, IfDataMatches and IfDataRegex event keys."
         "");
 
     g_option_context_add_main_entries(opt_context, entries, GETTEXT_PACKAGE);
@@ -374,6 +390,28 @@ post_event_args:
         for ( i = 1 ; i < argc ; ++i )
             eventc_connection_add_subscription(client, g_strdup(argv[i]));
 
+        gchar **f;
+        if ( if_data_strv != NULL )
+        {
+            for ( f = if_data_strv ; *f != NULL ; ++f )
+                eventc_connection_add_subscription_filter(client, EVENTC_SUBSCRIPTION_FILTER_IF_DATA, g_strdup(*f));
+        }
+        if ( if_data_matches_strv != NULL )
+        {
+            for ( f = if_data_matches_strv ; *f != NULL ; ++f )
+                eventc_connection_add_subscription_filter(client, EVENTC_SUBSCRIPTION_FILTER_IF_DATA_MATCHES, g_strdup(*f));
+        }
+        if ( if_data_regex_strv != NULL )
+        {
+            for ( f = if_data_regex_strv ; *f != NULL ; ++f )
+                eventc_connection_add_subscription_filter(client, EVENTC_SUBSCRIPTION_FILTER_IF_DATA_REGEX, g_strdup(*f));
+        }
+        if ( only_data_strv != NULL )
+        {
+            for ( f = only_data_strv ; *f != NULL ; ++f )
+                eventc_connection_add_subscription_filter(client, EVENTC_SUBSCRIPTION_FILTER_ONLY_DATA, g_strdup(*f));
+        }
+
         g_signal_connect(client, "received-event", G_CALLBACK(_eventc_received_event_callback), NULL);
         goto post_event;
     }
@@ -409,6 +447,10 @@ post_event:
 
 end:
     g_hash_table_unref(data);
+    g_strfreev(only_data_strv);
+    g_strfreev(if_data_regex_strv);
+    g_strfreev(if_data_matches_strv);
+    g_strfreev(if_data_strv);
     g_strfreev(file_strv);
     g_strfreev(data_string_strv);
     g_strfreev(data_strv);
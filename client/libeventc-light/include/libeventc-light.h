@@ -53,6 +53,7 @@ gint eventc_light_connection_read(EventcLightConnection *connection);
 
 gint eventc_light_connection_connect(EventcLightConnection *connection);
 gint eventc_light_connection_send_event(EventcLightConnection *connection, EventdEvent *event);
+gint eventc_light_connection_flush(EventcLightConnection *connection);
 gint eventc_light_connection_close(EventcLightConnection *connection);
 
 gboolean eventc_light_connection_is_connected(EventcLightConnection *connection, gint *error);
@@ -67,6 +67,8 @@ struct _EventcLightConnection {
     EventdProtocol *protocol;
     EventcLightSocket socket;
     GString *buffer;
+    GString *pending;
+    gboolean closing;
 };
 
 static void _eventc_light_connection_close_internal(EventcLightConnection *self);
@@ -85,24 +87,59 @@ eventc_light_get_version(void)
     return NK_PACKAGE_VERSION;
 }
 
+static gint
+_eventc_light_connection_send_data(EventcLightConnection *self, const gchar *data, gsize length, gsize *sent)
+{
+    *sent = 0;
+    while ( *sent < length )
+    {
+        gssize r;
+        r = send(self->socket, data + *sent, length - *sent, 0);
+        if ( r >= 0 )
+            *sent += r;
+        else if ( errno == EINTR )
+            continue;
+        else if ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+            return -EAGAIN;
+        else
+            return -errno;
+    }
+    return 0;
+}
+
+static gint
+_eventc_light_connection_flush(EventcLightConnection *self)
+{
+    gint error;
+    gsize sent;
+
+    error = _eventc_light_connection_send_data(self, self->pending->str, self->pending->len, &sent);
+    g_string_erase(self->pending, 0, sent);
+
+    return error;
+}
+
 static gint
 _eventc_light_connection_send_message(EventcLightConnection *self, gchar *message)
 {
     eventd_debug("Sending message:\n%s", message);
 
-    gint error = 0;
+    gint error;
+    gsize sent;
 
-    gsize o = 0;
-    gsize length;
-    length = strlen(message);
-    while ( ( error == 0 ) && ( o < length ) )
+    /* Finish the message we left half-sent first */
+    error = _eventc_light_connection_flush(self);
+    if ( error == 0 )
     {
-        gssize r;
-        r = send(self->socket, message+o, length-o, 0);
-        if ( r < 0 )
-            error = -errno;
-        else
-            o += r;
+        gsize length;
+        length = strlen(message);
+        error = _eventc_light_connection_send_data(self, message, length, &sent);
+        if ( ( error == -EAGAIN ) && ( sent > 0 ) )
+        {
+            /* Never leave half a message on the wire, we send the rest on the next call */
+            g_string_append_len(self->pending, message + sent, length - sent);
+            error = 0;
+        }
     }
 
     g_free(message);
@@ -158,6 +195,7 @@ eventc_light_connection_new(const gchar *name)
 
     self->protocol = eventd_protocol_new(&_eventc_light_connection_protocol_callbacks, self, NULL);
     self->buffer = g_string_sized_new(512);
+    self->pending = g_string_new(NULL);
 
     return self;
 }
@@ -174,6 +212,7 @@ _eventc_light_connection_free(EventcLightConnection *self)
     if ( self->subscriptions != NULL )
         g_hash_table_unref(self->subscriptions);
 
+    g_string_free(self->pending, TRUE);
     g_string_free(self->buffer, TRUE);
     eventd_protocol_unref(self->protocol);
 
@@ -535,7 +574,14 @@ eventc_light_connection_read(EventcLightConnection *self)
  *
  * Sends an event across the connection.
  *
- * Returns: 0 if the event was sent successfully, a negative %errno value otherwise
+ * The socket is non-blocking: if it cannot take the event at all, it is
+ * not sent and -%EAGAIN is returned. Wait for the socket to be writable
+ * (see eventc_light_connection_get_socket()) before trying again.
+ * If only part of the event fit, it is accepted and the rest is kept
+ * pending: it is sent first by the next call, or by
+ * eventc_light_connection_flush().
+ *
+ * Returns: 0 if the event was sent or queued successfully, a negative %errno value otherwise
  */
 EVENTD_EXPORT
 gint
@@ -547,17 +593,47 @@ eventc_light_connection_send_event(EventcLightConnection *self, EventdEvent *eve
     gint error = 0;
     if ( ! _eventc_light_connection_expect_connected(self, &error) )
         return error;
+    if ( self->closing )
+        return -EPIPE;
 
     return _eventc_light_connection_send_message(self, eventd_protocol_generate_event(self->protocol, event));
 }
 
+/**
+ * eventc_light_connection_flush:
+ * @connection: an #EventcLightConnection
+ *
+ * Sends the pending part of a previously accepted event.
+ *
+ * Returns: 0 if nothing is pending anymore, -%EAGAIN if the socket
+ * cannot take it all yet, a negative %errno value otherwise
+ */
+EVENTD_EXPORT
+gint
+eventc_light_connection_flush(EventcLightConnection *self)
+{
+    g_return_val_if_fail(self != NULL, -EFAULT);
+
+    gint error = 0;
+    if ( ! _eventc_light_connection_expect_connected(self, &error) )
+        return error;
+
+    return _eventc_light_connection_flush(self);
+}
+
 /**
  * eventc_light_connection_close:
  * @connection: an #EventcLightConnection
  *
  * Closes the connection.
  *
- * Returns: 0 if the connection was successfully closed, a negative %errno value otherwise
+ * Pending data is sent before the connection is closed. If the socket
+ * cannot take it all, -%EAGAIN is returned and the connection stays open,
+ * only accepting eventc_light_connection_flush() and
+ * eventc_light_connection_close() calls: wait for the socket to be
+ * writable and call eventc_light_connection_close() again.
+ *
+ * Returns: 0 if the connection was successfully closed, -%EAGAIN if data is still pending, a negative %errno value otherwise
  */
 EVENTD_EXPORT
 gint
@@ -566,16 +642,25 @@ eventc_light_connection_close(EventcLightConnection *self)
     g_return_val_if_fail(self != NULL, -EFAULT);
 
     gint error = 0;
-    if ( eventc_light_connection_is_connected(self, &error) )
-        _eventc_light_connection_send_message(self, eventd_protocol_generate_bye(self->protocol, NULL));
-    else if ( error != 0 )
+    if ( ! eventc_light_connection_is_connected(self, &error) )
+        return error;
+
+    if ( ! self->closing )
+    {
+        gchar *bye = eventd_protocol_generate_bye(self->protocol, NULL);
+        eventd_debug("Sending message:\n%s", bye);
+        g_string_append(self->pending, bye);
+        g_free(bye);
+        self->closing = TRUE;
+    }
+
+    error = _eventc_light_connection_flush(self);
+    if ( error == -EAGAIN )
         return error;
-    else
-        return 0;
 
     _eventc_light_connection_close_internal(self);
 
-    return 0;
+    return error;
 }
 
 static void
@@ -583,6 +668,9 @@ _eventc_light_connection_close_internal(EventcLightConnection *self)
 {
     close(self->socket);
     self->socket = 0;
+    g_string_truncate(self->pending, 0);
+    self->closing = FALSE;
+    eventd_protocol_reset(self->protocol);
 
     if ( self->disconnected_callback.callback != NULL )
         self->disconnected_callback.callback(self, self->disconnected_callback.user_data);
@@ -40,9 +40,17 @@ typedef enum  {
 	EVENTC_ERROR_RECEIVE,
 	EVENTC_ERROR_EVENT,
 	EVENTC_ERROR_END,
-	EVENTC_ERROR_BYE
+	EVENTC_ERROR_BYE,
+	EVENTC_ERROR_BUSY
 } EventcError;
 
+typedef enum  {
+	EVENTC_SUBSCRIPTION_FILTER_IF_DATA,
+	EVENTC_SUBSCRIPTION_FILTER_IF_DATA_MATCHES,
+	EVENTC_SUBSCRIPTION_FILTER_IF_DATA_REGEX,
+	EVENTC_SUBSCRIPTION_FILTER_ONLY_DATA
+} EventcSubscriptionFilter;
+
 
 GType eventc_connection_get_type(void) G_GNUC_CONST;
 GQuark eventc_error_quark(void);
@@ -84,6 +92,8 @@ gboolean eventc_connection_connect_finish(EventcConnection *connection, GAsyncRe
 gboolean eventc_connection_connect_sync(EventcConnection *connection, GError **error);
 gboolean eventc_connection_send_event(EventcConnection *connection, EventdEvent *event, GError **error);
 gboolean eventc_connection_close(EventcConnection *connection, GError **error);
+void eventc_connection_close_async(EventcConnection *connection, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean eventc_connection_close_finish(EventcConnection *connection, GAsyncResult *result, GError **error);
 
 
 gboolean eventc_connection_set_uri(EventcConnection *connection, const gchar *uri, GError **error);
@@ -93,10 +103,13 @@ void eventc_connection_set_server_identity(EventcConnection *connection, GSocket
 void eventc_connection_set_accept_unknown_ca(EventcConnection *connection, gboolean accept_unknown_ca);
 void eventc_connection_set_certificate(EventcConnection *connection, GTlsCertificate *certificate);
 void eventc_connection_set_subscribe(EventcConnection *connection, gboolean subscribe);
+void eventc_connection_set_binary(EventcConnection *connection, gboolean binary);
 void eventc_connection_add_subscription(EventcConnection *connection, gchar *category);
+void eventc_connection_add_subscription_filter(EventcConnection *connection, EventcSubscriptionFilter filter, gchar *value);
 
 gboolean eventc_connection_is_connected(EventcConnection *connection, GError **error);
 gboolean eventc_connection_get_subscribe(EventcConnection *connection);
+gboolean eventc_connection_get_binary(EventcConnection *connection);
 
 G_END_DECLS
 
@@ -45,6 +45,11 @@
 #include "libeventc.h"
 
 #define EVENTC_CONNECTION_DEFAULT_PING_INTERVAL 300
+#define EVENTC_CONNECTION_READ_BUFFER_SIZE 4096
+#define EVENTC_CONNECTION_FLUSH_DELAY 2
+#define EVENTC_CONNECTION_FLUSH_SIZE (64 * 1024)
+#define EVENTC_CONNECTION_HIGH_WATER (4 * 1024 * 1024)
+#define EVENTC_CONNECTION_CLOSE_TIMEOUT 5
 
 #define EVENTC_CONNECTION_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), EVENTC_TYPE_CONNECTION, EventcConnectionPrivate))
 
@@ -68,6 +73,8 @@ struct _EventcConnectionPrivate {
     GTlsCertificate *certificate;
     gboolean subscribe;
     GHashTable *subscriptions;
+    EventdProtocolSubscribeFilter *subscription_filter;
+    gboolean binary;
     GError *error;
     EventdProtocol* protocol;
     GCancellable *cancellable;
@@ -75,8 +82,19 @@ struct _EventcConnectionPrivate {
     guint ping;
     GSocketConnection *connection;
     EventdWsConnection *ws;
-    GDataInputStream *in;
+    GInputStream *in;
+    gchar *buffer;
     GDataOutputStream *out;
+    struct {
+        GQueue messages;
+        gsize size;
+        GBytes **messages_writing;
+        GOutputVector *vectors;
+        gsize n_writing;
+        guint flush;
+        GTask *close;
+        gulong close_cancelled;
+    } write;
 };
 
 typedef struct {
@@ -211,8 +229,153 @@ eventc_error_quark(void)
     return g_quark_from_static_string("eventc_error-quark");
 }
 
+static void
+_eventc_connection_write_prepare(EventcConnection *self)
+{
+    gsize i;
+
+    if ( self->priv->write.flush > 0 )
+        g_source_remove(self->priv->write.flush);
+    self->priv->write.flush = 0;
+
+    self->priv->write.n_writing = g_queue_get_length(&self->priv->write.messages);
+    self->priv->write.messages_writing = g_new(GBytes *, self->priv->write.n_writing);
+    self->priv->write.vectors = g_new(GOutputVector, self->priv->write.n_writing);
+    for ( i = 0 ; i < self->priv->write.n_writing ; ++i )
+    {
+        GBytes *message = g_queue_pop_head(&self->priv->write.messages);
+        self->priv->write.messages_writing[i] = message;
+        self->priv->write.vectors[i].buffer = g_bytes_get_data(message, &self->priv->write.vectors[i].size);
+    }
+
+    eventd_debug("Flushing %" G_GSIZE_FORMAT " messages (%" G_GSIZE_FORMAT " bytes)", self->priv->write.n_writing, self->priv->write.size);
+    self->priv->write.size = 0;
+}
+
+static void
+_eventc_connection_write_release(EventcConnection *self)
+{
+    gsize i;
+
+    for ( i = 0 ; i < self->priv->write.n_writing ; ++i )
+        g_bytes_unref(self->priv->write.messages_writing[i]);
+    g_free(self->priv->write.messages_writing);
+    g_free(self->priv->write.vectors);
+    self->priv->write.messages_writing = NULL;
+    self->priv->write.vectors = NULL;
+    self->priv->write.n_writing = 0;
+}
+
+static void _eventc_connection_flush(EventcConnection *self);
+
+static void
+_eventc_connection_close_return(EventcConnection *self, const GError *error)
+{
+    GTask *task = self->priv->write.close;
+
+    if ( task == NULL )
+        return;
+    self->priv->write.close = NULL;
+
+    if ( self->priv->write.close_cancelled > 0 )
+        g_cancellable_disconnect(g_task_get_cancellable(task), self->priv->write.close_cancelled);
+    self->priv->write.close_cancelled = 0;
+
+    if ( error != NULL )
+        g_task_return_error(task, g_error_copy(error));
+    else
+        g_task_return_boolean(task, TRUE);
+    g_object_unref(task);
+}
+
+static void
+_eventc_connection_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    EventcConnection *self = user_data;
+    GError *error = NULL;
+
+    _eventc_connection_write_release(self);
+
+    if ( ! g_output_stream_writev_all_finish(G_OUTPUT_STREAM(obj), res, NULL, &error) )
+    {
+        /* Only a cancelled asynchronous close leaves us connected on cancellation */
+        if ( self->priv->out != NULL )
+        {
+            if ( self->priv->write.close != NULL )
+                _eventc_connection_close_return(self, error);
+            else
+                g_warning("Failed to send messages: %s", error->message);
+            g_cancellable_cancel(self->priv->cancellable);
+            _eventc_connection_close_internal(self);
+        }
+        g_clear_error(&error);
+    }
+    else if ( self->priv->out != NULL )
+    {
+        _eventc_connection_flush(self);
+        if ( ( self->priv->write.close != NULL ) && ( self->priv->write.n_writing == 0 ) )
+        {
+            g_cancellable_cancel(self->priv->cancellable);
+            _eventc_connection_close_internal(self);
+        }
+    }
+
+    g_object_unref(self);
+}
+
+static void
+_eventc_connection_flush(EventcConnection *self)
+{
+    if ( ( self->priv->write.n_writing > 0 ) || g_queue_is_empty(&self->priv->write.messages) )
+        return;
+
+    _eventc_connection_write_prepare(self);
+    g_output_stream_writev_all_async(G_OUTPUT_STREAM(self->priv->out), self->priv->write.vectors, self->priv->write.n_writing, G_PRIORITY_DEFAULT, self->priv->cancellable, _eventc_connection_write_callback, g_object_ref(self));
+}
+
+static gboolean
+_eventc_connection_flush_callback(gpointer user_data)
+{
+    EventcConnection *self = user_data;
+
+    self->priv->write.flush = 0;
+    _eventc_connection_flush(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventc_connection_flush_sync(EventcConnection *self)
+{
+    GError *error = NULL;
+
+    /*
+     * We cannot write behind the back of a running write,
+     * and waiting for it would mean iterating our caller's context
+     */
+    if ( self->priv->write.n_writing > 0 )
+    {
+        g_warning("Closing while sending messages, %u queued messages are lost: use eventc_connection_close_async() to wait for them", g_queue_get_length(&self->priv->write.messages));
+        return;
+    }
+
+    if ( ( self->priv->out == NULL ) || g_queue_is_empty(&self->priv->write.messages) )
+        return;
+
+    /* We do not want to block forever on a peer that does not read */
+    g_socket_set_timeout(g_socket_connection_get_socket(self->priv->connection), EVENTC_CONNECTION_CLOSE_TIMEOUT);
+
+    _eventc_connection_write_prepare(self);
+    if ( ! g_output_stream_writev_all(G_OUTPUT_STREAM(self->priv->out), self->priv->write.vectors, self->priv->write.n_writing, NULL, NULL, &error) )
+    {
+        g_warning("Failed to send messages: %s", error->message);
+        g_clear_error(&error);
+    }
+    _eventc_connection_write_release(self);
+}
+
 static gboolean
-_eventc_connection_send_message(EventcConnection *self, gchar *message, GError **error)
+_eventc_connection_send_message(EventcConnection *self, GBytes *message, GError **error)
 {
     gboolean r = FALSE;
     if ( self->priv->error != NULL )
@@ -222,38 +385,54 @@ _eventc_connection_send_message(EventcConnection *self, gchar *message, GError *
         goto end;
     }
 
-    GError *_inner_error_ = NULL;
+    gconstpointer data;
+    gsize size;
 
-    eventd_debug("Sending message:\n%s", message);
+    data = g_bytes_get_data(message, &size);
+    eventd_debug("Sending message (%" G_GSIZE_FORMAT " bytes)", size);
 
     if ( self->priv->ws != NULL )
     {
-        eventd_ws_connection_send_message(_eventc_connection_ws_module, self->priv->ws, message);
+        /* WebSocket connections always use text messages */
+        gchar *text = g_strndup(data, size);
+        eventd_ws_connection_send_message(_eventc_connection_ws_module, self->priv->ws, text);
+        g_free(text);
         r = TRUE;
         goto end;
     }
 
-    if ( g_data_output_stream_put_string(self->priv->out, message, NULL, &_inner_error_) )
-        r = TRUE;
-    else
+    if ( ( self->priv->write.size + size ) > EVENTC_CONNECTION_HIGH_WATER )
     {
-        g_set_error(error, EVENTC_ERROR, EVENTC_ERROR_CONNECTION, "Failed to send message: %s", _inner_error_->message);
-        g_error_free(_inner_error_);
-        g_cancellable_cancel(self->priv->cancellable);
-        _eventc_connection_close_internal(self);
+        g_set_error(error, EVENTC_ERROR, EVENTC_ERROR_BUSY, "Output queue is full (%" G_GSIZE_FORMAT " bytes pending)", self->priv->write.size);
+        goto end;
     }
 
+    g_queue_push_tail(&self->priv->write.messages, g_bytes_ref(message));
+    self->priv->write.size += size;
+    r = TRUE;
+
+    if ( self->priv->write.size >= EVENTC_CONNECTION_FLUSH_SIZE )
+        _eventc_connection_flush(self);
+    else if ( ( self->priv->write.flush == 0 ) && ( self->priv->write.n_writing == 0 ) )
+        self->priv->write.flush = g_timeout_add(EVENTC_CONNECTION_FLUSH_DELAY, _eventc_connection_flush_callback, self);
+
 end:
-    g_free(message);
+    g_bytes_unref(message);
     return r;
 }
 
+static gboolean
+_eventc_connection_send_text_message(EventcConnection *self, gchar *message, GError **error)
+{
+    return _eventc_connection_send_message(self, g_bytes_new_take(message, strlen(message)), error);
+}
+
 static gboolean
 _eventc_connection_ping(gpointer user_data)
 {
     EventcConnection *self = user_data;
 
-    if ( _eventc_connection_send_message(self, eventd_protocol_generate_ping(self->priv->protocol), NULL) )
+    if ( _eventc_connection_send_message(self, eventd_protocol_generate_ping_bytes(self->priv->protocol), NULL) )
         return G_SOURCE_CONTINUE;
 
     self->priv->ping = 0;
@@ -302,26 +481,24 @@ _eventc_connection_read_callback(GObject *obj, GAsyncResult *res, gpointer user_
 {
     EventcConnection *self = user_data;
     GError *error = NULL;
-    gchar *line;
-    gsize length;
+    gssize length;
 
-    line = g_data_input_stream_read_line_finish(G_DATA_INPUT_STREAM(obj), res, &length, &error);
-    if ( line == NULL )
+    length = g_input_stream_read_finish(G_INPUT_STREAM(obj), res, &error);
+    if ( length <= 0 )
     {
         if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
         {
             if ( error != NULL )
-                g_set_error(&self->priv->error, EVENTC_ERROR, EVENTC_ERROR_CONNECTION, "Could not read line: %s", error->message);
+                g_set_error(&self->priv->error, EVENTC_ERROR, EVENTC_ERROR_CONNECTION, "Could not read message: %s", error->message);
             _eventc_connection_close_internal(self);
         }
         g_clear_error(&error);
     }
-    else if ( eventd_protocol_parse(self->priv->protocol, line, length, &self->priv->error) )
+    else if ( eventd_protocol_parse_chunk(self->priv->protocol, self->priv->buffer, length, &self->priv->error) )
     {
         if ( self->priv->in != NULL )
-            g_data_input_stream_read_line_async(self->priv->in, G_PRIORITY_DEFAULT, self->priv->cancellable, _eventc_connection_read_callback, self);
+            g_input_stream_read_async(self->priv->in, self->priv->buffer, EVENTC_CONNECTION_READ_BUFFER_SIZE, G_PRIORITY_DEFAULT, self->priv->cancellable, _eventc_connection_read_callback, self);
     }
-    g_free(line);
 }
 
 static void _eventc_connection_finalize(GObject *object);
@@ -377,6 +554,7 @@ eventc_connection_init(EventcConnection *self)
     self->priv->protocol = eventd_protocol_new(&_eventc_connection_protocol_callbacks, self, NULL);
     self->priv->cancellable = g_cancellable_new();
     self->priv->ping_interval = EVENTC_CONNECTION_DEFAULT_PING_INTERVAL;
+    g_queue_init(&self->priv->write.messages);
 }
 
 static void
@@ -390,6 +568,15 @@ _eventc_connection_finalize(GObject *object)
     if ( self->priv->subscriptions != NULL )
         g_hash_table_unref(self->priv->subscriptions);
 
+    if ( self->priv->subscription_filter != NULL )
+    {
+        g_strfreev(self->priv->subscription_filter->if_data);
+        g_strfreev(self->priv->subscription_filter->if_data_matches);
+        g_strfreev(self->priv->subscription_filter->if_data_regexes);
+        g_strfreev(self->priv->subscription_filter->only_data);
+        g_free(self->priv->subscription_filter);
+    }
+
     if ( self->priv->certificate != NULL )
         g_object_unref(self->priv->certificate);
 
@@ -402,6 +589,8 @@ _eventc_connection_finalize(GObject *object)
     if ( self->priv->address != NULL )
         g_object_unref(self->priv->address);
 
+    g_free(self->priv->buffer);
+
     g_object_unref(self->priv->cancellable);
     eventd_protocol_unref(self->priv->protocol);
 
@@ -677,9 +866,11 @@ _eventc_connection_connect_check(EventcConnection *self, GError *_inner_error_,
         if ( self->priv->ws == NULL )
         {
             self->priv->out = g_data_output_stream_new(g_io_stream_get_output_stream(G_IO_STREAM(self->priv->connection)));
-            self->priv->in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(self->priv->connection)));
+            self->priv->in = g_object_ref(g_io_stream_get_input_stream(G_IO_STREAM(self->priv->connection)));
+            if ( self->priv->buffer == NULL )
+                self->priv->buffer = g_new(gchar, EVENTC_CONNECTION_READ_BUFFER_SIZE);
 
-            g_data_input_stream_read_line_async(self->priv->in, G_PRIORITY_DEFAULT, self->priv->cancellable, _eventc_connection_read_callback, self);
+            g_input_stream_read_async(self->priv->in, self->priv->buffer, EVENTC_CONNECTION_READ_BUFFER_SIZE, G_PRIORITY_DEFAULT, self->priv->cancellable, _eventc_connection_read_callback, self);
         }
         return TRUE;
     }
@@ -703,7 +894,10 @@ _eventc_connection_connect_check(EventcConnection *self, GError *_inner_error_,
 static gboolean
 _eventc_connection_connect_after(EventcConnection *self, GError **error)
 {
-    if ( self->priv->subscribe && ( ! _eventc_connection_send_message(self, eventd_protocol_generate_subscribe(self->priv->protocol, self->priv->subscriptions), error) ) )
+    if ( self->priv->binary && ( self->priv->ws == NULL ) && ( ! _eventc_connection_send_text_message(self, eventd_protocol_generate_binary(self->priv->protocol), error) ) )
+        return FALSE;
+
+    if ( self->priv->subscribe && ( ! _eventc_connection_send_message(self, eventd_protocol_generate_subscribe_filter_bytes(self->priv->protocol, self->priv->subscriptions, self->priv->subscription_filter), error) ) )
         return FALSE;
 
     if ( _eventc_connection_should_ping(self) )
@@ -846,8 +1040,11 @@ eventc_connection_connect_sync(EventcConnection *self, GError **error)
  * @error: (out) (optional): return location for error or %NULL to ignore
  *
  * Sends an event across the connection.
+ * Events are queued and written in batches shortly after, or immediately if
+ * enough of them are pending. If too much data is waiting to be written,
+ * the event is refused with %EVENTC_ERROR_BUSY.
  *
- * Returns: %TRUE if the event was sent successfully
+ * Returns: %TRUE if the event was queued successfully
  */
 EVENTD_EXPORT
 gboolean
@@ -860,7 +1057,7 @@ eventc_connection_send_event(EventcConnection *self, EventdEvent *event, GError
     if ( ! _eventc_connection_expect_connected(self, error) )
         return FALSE;
 
-    return _eventc_connection_send_message(self, eventd_protocol_generate_event(self->priv->protocol, event), error);
+    return _eventc_connection_send_message(self, eventd_protocol_generate_event_bytes(self->priv->protocol, event), error);
 }
 
 /**
@@ -871,6 +1068,10 @@ eventc_connection_send_event(EventcConnection *self, EventdEvent *event, GError
  * Closes the connection. You must wait for the #EventcConnection::disconnected
  * signal before trying to connect again.
  *
+ * Queued messages are sent synchronously first, waiting at most a few seconds.
+ * If a write is already running, they are dropped: use
+ * eventc_connection_close_async() to make sure they are sent.
+ *
  * Returns: %TRUE if the connection was successfully closed
  */
 EVENTD_EXPORT
@@ -881,7 +1082,7 @@ eventc_connection_close(EventcConnection *self, GError **error)
 
     GError *_inner_error_ = NULL;
     if ( eventc_connection_is_connected(self, &_inner_error_) )
-        _eventc_connection_send_message(self, eventd_protocol_generate_bye(self->priv->protocol, NULL), NULL);
+        _eventc_connection_send_message(self, eventd_protocol_generate_bye_bytes(self->priv->protocol, NULL), NULL);
     else if ( _inner_error_ != NULL )
     {
         g_set_error(error, EVENTC_ERROR, EVENTC_ERROR_BYE, "Couldn't send bye message: %s", _inner_error_->message);
@@ -895,6 +1096,7 @@ eventc_connection_close(EventcConnection *self, GError **error)
         eventd_ws_connection_close(_eventc_connection_ws_module, self->priv->ws);
     else
     {
+        _eventc_connection_flush_sync(self);
         g_cancellable_cancel(self->priv->cancellable);
         _eventc_connection_close_internal(self);
     }
@@ -902,15 +1104,122 @@ eventc_connection_close(EventcConnection *self, GError **error)
     return TRUE;
 }
 
+static void
+_eventc_connection_close_cancelled(GCancellable *cancellable, gpointer user_data)
+{
+    EventcConnection *self = user_data;
+
+    /* Our running write will fail and finish the close */
+    g_cancellable_cancel(self->priv->cancellable);
+}
+
+/**
+ * eventc_connection_close_async:
+ * @connection: an #EventcConnection
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: (scope async) (closure user_data): a #GAsyncReadyCallback to call when the request is satisfied
+ *
+ * Closes the connection once all the queued messages are sent.
+ * Cancelling @cancellable closes the connection right away, dropping them.
+ */
+EVENTD_EXPORT
+void
+eventc_connection_close_async(EventcConnection *self, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    g_return_if_fail(EVENTC_IS_CONNECTION(self));
+
+    GTask *task;
+    GError *error = NULL;
+
+    task = g_task_new(self, cancellable, callback, user_data);
+
+    if ( ! eventc_connection_is_connected(self, &error) )
+    {
+        if ( error != NULL )
+        {
+            g_task_return_new_error(task, EVENTC_ERROR, EVENTC_ERROR_BYE, "Couldn't send bye message: %s", error->message);
+            g_error_free(error);
+        }
+        else
+            g_task_return_boolean(task, TRUE);
+        g_object_unref(task);
+        return;
+    }
+
+    if ( self->priv->write.close != NULL )
+    {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_PENDING, "Connection is already closing");
+        g_object_unref(task);
+        return;
+    }
+
+    _eventc_connection_send_message(self, eventd_protocol_generate_bye_bytes(self->priv->protocol, NULL), NULL);
+
+    if ( self->priv->ws != NULL )
+    {
+        eventd_ws_connection_close(_eventc_connection_ws_module, self->priv->ws);
+        g_task_return_boolean(task, TRUE);
+        g_object_unref(task);
+        return;
+    }
+
+    self->priv->write.close = task;
+    if ( cancellable != NULL )
+        self->priv->write.close_cancelled = g_cancellable_connect(cancellable, G_CALLBACK(_eventc_connection_close_cancelled), self, NULL);
+
+    if ( self->priv->write.flush > 0 )
+        g_source_remove(self->priv->write.flush);
+    self->priv->write.flush = 0;
+    _eventc_connection_flush(self);
+
+    if ( self->priv->write.n_writing == 0 )
+    {
+        g_cancellable_cancel(self->priv->cancellable);
+        _eventc_connection_close_internal(self);
+    }
+}
+
+/**
+ * eventc_connection_close_finish:
+ * @connection: an #EventcConnection
+ * @result: a #GAsyncResult
+ * @error: (out) (optional): return location for error or %NULL to ignore
+ *
+ * Finish an asynchronous operation started with eventc_connection_close_async().
+ *
+ * Returns: %TRUE if the queued messages were sent and the connection closed
+ */
+EVENTD_EXPORT
+gboolean
+eventc_connection_close_finish(EventcConnection *self, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(EVENTC_IS_CONNECTION(self), FALSE);
+    g_return_val_if_fail(g_task_is_valid(result, self), FALSE);
+    g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 static void
 _eventc_connection_close_internal(EventcConnection *self)
 {
     gboolean emit_disconnect = FALSE;
 
+    /* Whatever closed us, we are closed */
+    _eventc_connection_close_return(self, NULL);
+
     if ( self->priv->ping > 0 )
         g_source_remove(self->priv->ping);
     self->priv->ping = 0;
 
+    if ( self->priv->write.flush > 0 )
+        g_source_remove(self->priv->write.flush);
+    self->priv->write.flush = 0;
+    g_queue_clear_full(&self->priv->write.messages, (GDestroyNotify) g_bytes_unref);
+    self->priv->write.size = 0;
+
+    eventd_protocol_reset(self->priv->protocol);
+
     if ( self->priv->error != NULL )
         g_error_free(self->priv->error);
     self->priv->error = NULL;
@@ -1115,6 +1424,26 @@ eventc_connection_set_subscribe(EventcConnection *self, gboolean subscribe)
     self->priv->subscribe = subscribe;
 }
 
+/**
+ * eventc_connection_set_binary:
+ * @connection: an #EventcConnection
+ * @binary: the binary setting
+ *
+ * Sets whether the connection will offer to switch to binary frames
+ * when connecting.
+ * The connection keeps using text messages if the server does not support them.
+ *
+ * WebSocket connections always use text messages.
+ */
+EVENTD_EXPORT
+void
+eventc_connection_set_binary(EventcConnection *self, gboolean binary)
+{
+    g_return_if_fail(EVENTC_IS_CONNECTION(self));
+
+    self->priv->binary = binary;
+}
+
 /**
  * eventc_connection_add_subscription:
  * @connection: an #EventcConnection
@@ -1134,6 +1463,56 @@ eventc_connection_add_subscription(EventcConnection *self, gchar *category)
     g_hash_table_add(self->priv->subscriptions, category);
 }
 
+/**
+ * eventc_connection_add_subscription_filter:
+ * @connection: an #EventcConnection
+ * @filter: the kind of filter to add
+ * @value: (transfer full): the filter value
+ *
+ * Adds a server-side filter to the subscription.
+ *
+ * %EVENTC_SUBSCRIPTION_FILTER_IF_DATA, %EVENTC_SUBSCRIPTION_FILTER_IF_DATA_MATCHES
+ * and %EVENTC_SUBSCRIPTION_FILTER_IF_DATA_REGEX use the same syntax as the
+ * `IfData`, `IfDataMatches` and `IfDataRegex` keys of event configuration files,
+ * and only matching events are sent.
+ *
+ * %EVENTC_SUBSCRIPTION_FILTER_ONLY_DATA names a data to keep in the
+ * received events, all others are stripped by the server.
+ */
+EVENTD_EXPORT
+void
+eventc_connection_add_subscription_filter(EventcConnection *self, EventcSubscriptionFilter filter, gchar *value)
+{
+    g_return_if_fail(EVENTC_IS_CONNECTION(self));
+    g_return_if_fail(value != NULL);
+
+    if ( self->priv->subscription_filter == NULL )
+        self->priv->subscription_filter = g_new0(EventdProtocolSubscribeFilter, 1);
+
+    gchar ***list = NULL;
+    switch ( filter )
+    {
+    case EVENTC_SUBSCRIPTION_FILTER_IF_DATA:
+        list = &self->priv->subscription_filter->if_data;
+    break;
+    case EVENTC_SUBSCRIPTION_FILTER_IF_DATA_MATCHES:
+        list = &self->priv->subscription_filter->if_data_matches;
+    break;
+    case EVENTC_SUBSCRIPTION_FILTER_IF_DATA_REGEX:
+        list = &self->priv->subscription_filter->if_data_regexes;
+    break;
+    case EVENTC_SUBSCRIPTION_FILTER_ONLY_DATA:
+        list = &self->priv->subscription_filter->only_data;
+    break;
+    }
+    g_return_if_fail(list != NULL);
+
+    gsize length = ( *list == NULL ) ? 0 : g_strv_length(*list);
+    *list = g_renew(gchar *, *list, length + 2);
+    (*list)[length] = value;
+    (*list)[length + 1] = NULL;
+}
+
 /**
  * eventc_connection_get_subscribe:
  * @connection: an #EventcConnection
@@ -1150,3 +1529,20 @@ eventc_connection_get_subscribe(EventcConnection *self)
 
     return self->priv->subscribe;
 }
+
+/**
+ * eventc_connection_get_binary:
+ * @connection: an #EventcConnection
+ *
+ * Retrieves whether the connection will offer to switch to binary frames.
+ *
+ * Returns: %TRUE if the connection will offer binary frames
+ */
+EVENTD_EXPORT
+gboolean
+eventc_connection_get_binary(EventcConnection *self)
+{
+    g_return_val_if_fail(EVENTC_IS_CONNECTION(self), FALSE);
+
+    return self->priv->binary;
+}
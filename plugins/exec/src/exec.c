@@ -22,41 +22,506 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
+#include <gio/gio.h>
 
 #include "eventd-plugin.h"
 #include "libeventd-helpers-config.h"
 
+typedef enum {
+    EVENTD_EXEC_MODE_ONESHOT,
+    EVENTD_EXEC_MODE_PERSISTENT,
+} EventdExecMode;
+
+static const gchar * const _eventd_exec_modes[] = {
+    [EVENTD_EXEC_MODE_ONESHOT]    = "oneshot",
+    [EVENTD_EXEC_MODE_PERSISTENT] = "persistent",
+};
+
+typedef enum {
+    EVENTD_EXEC_FRAMING_NEWLINE,
+    EVENTD_EXEC_FRAMING_LENGTH,
+} EventdExecFraming;
+
+static const gchar * const _eventd_exec_framings[] = {
+    [EVENTD_EXEC_FRAMING_NEWLINE] = "newline",
+    [EVENTD_EXEC_FRAMING_LENGTH]  = "length",
+};
+
+typedef enum {
+    EVENTD_EXEC_RESTART_ON_FAILURE,
+    EVENTD_EXEC_RESTART_ALWAYS,
+    EVENTD_EXEC_RESTART_NEVER,
+} EventdExecRestart;
+
+static const gchar * const _eventd_exec_restarts[] = {
+    [EVENTD_EXEC_RESTART_ON_FAILURE] = "on-failure",
+    [EVENTD_EXEC_RESTART_ALWAYS]     = "always",
+    [EVENTD_EXEC_RESTART_NEVER]      = "never",
+};
+
+/*
+ * Running one-shot commands hold a reference
+ * so that they can exit after we are uninitialized
+ */
 struct _EventdPluginContext {
+    gatomicrefcount refcount;
+    gint64 max_children;
+    gint64 queue_size;
+    gint64 children;
+    GQueue queue;
     GSList *actions;
 };
 
+/*
+ * Pools are only used from the main thread,
+ * but jobs may reference them from action workers
+ * Every asynchronous operation holds a reference
+ */
+typedef struct {
+    gatomicrefcount refcount;
+    EventdPluginContext *context;
+    gchar *command;
+    gchar **argv;
+    EventdExecFraming framing;
+    EventdExecRestart restart;
+    gint64 restart_delay;
+    gboolean stopping;
+    gsize size;
+    struct _EventdExecWorker *workers;
+} EventdExecPool;
+
+typedef struct _EventdExecWorker {
+    EventdExecPool *pool;
+    GSubprocess *process;
+    GOutputStream *stdin_pipe;
+    GQueue pending;
+    GBytes *writing;
+    guint restart_timeout;
+    gboolean dead;
+} EventdExecWorker;
+
 struct _EventdPluginAction {
     FormatString *command;
     FormatString *stdin_template;
+    EventdExecPool *pool;
 };
 
+typedef struct {
+    EventdPluginContext *context;
+    EventdExecPool *pool;
+    gchar *command;
+    gchar **argv;
+    GBytes *data;
+    GOutputStream *stdin_pipe;
+} EventdExecJob;
+
+static EventdExecPool *
+_eventd_exec_pool_ref(EventdExecPool *self)
+{
+    g_atomic_ref_count_inc(&self->refcount);
+    return self;
+}
+
+static void
+_eventd_exec_pool_unref(EventdExecPool *self)
+{
+    if ( ! g_atomic_ref_count_dec(&self->refcount) )
+        return;
+
+    gsize i;
+    for ( i = 0 ; i < self->size ; ++i )
+        g_queue_clear_full(&self->workers[i].pending, (GDestroyNotify) g_bytes_unref);
+    g_free(self->workers);
+
+    g_strfreev(self->argv);
+    g_free(self->command);
+
+    g_slice_free(EventdExecPool, self);
+}
+
+static void
+_eventd_exec_worker_close(EventdExecWorker *self)
+{
+    GError *error = NULL;
+
+    /* Closing a pipe does not block, and tells the command to stop */
+    if ( ! g_output_stream_close(self->stdin_pipe, NULL, &error) )
+    {
+        g_warning("Could not properly shutdown stdin of '%s': %s", self->pool->command, error->message);
+        g_clear_error(&error);
+    }
+    g_clear_object(&self->stdin_pipe);
+}
+
+static void
+_eventd_exec_pool_stop(EventdExecPool *self)
+{
+    gsize i;
+
+    self->stopping = TRUE;
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        EventdExecWorker *worker = &self->workers[i];
+
+        g_queue_clear_full(&worker->pending, (GDestroyNotify) g_bytes_unref);
+
+        if ( worker->restart_timeout > 0 )
+        {
+            g_source_remove(worker->restart_timeout);
+            worker->restart_timeout = 0;
+            _eventd_exec_pool_unref(self);
+        }
+
+        if ( ( worker->stdin_pipe != NULL ) && ( worker->writing == NULL ) )
+            _eventd_exec_worker_close(worker);
+    }
+
+    _eventd_exec_pool_unref(self);
+}
+
 static void
 _eventd_exec_action_free(gpointer data)
 {
     EventdPluginAction *action = data;
 
+    if ( action->pool != NULL )
+        _eventd_exec_pool_stop(action->pool);
     evhelpers_format_string_unref(action->stdin_template);
     evhelpers_format_string_unref(action->command);
 
     g_slice_free(EventdPluginAction, action);
 }
 
+static void
+_eventd_exec_job_free(EventdExecJob *job)
+{
+    if ( job->stdin_pipe != NULL )
+        g_object_unref(job->stdin_pipe);
+    if ( job->data != NULL )
+        g_bytes_unref(job->data);
+    g_strfreev(job->argv);
+    g_free(job->command);
+
+    g_slice_free(EventdExecJob, job);
+}
+
+/*
+ * Persistent workers
+ */
+
+static void _eventd_exec_worker_start(EventdExecWorker *self);
+static void _eventd_exec_worker_write(EventdExecWorker *self);
+
+static gboolean
+_eventd_exec_worker_restart_callback(gpointer user_data)
+{
+    EventdExecWorker *self = user_data;
+    EventdExecPool *pool = self->pool;
+
+    self->restart_timeout = 0;
+    _eventd_exec_worker_start(self);
+    _eventd_exec_pool_unref(pool);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_exec_worker_stopped(EventdExecWorker *self, gboolean success)
+{
+    EventdExecPool *pool = self->pool;
+
+    if ( pool->stopping )
+        return;
+
+    if ( ( pool->restart == EVENTD_EXEC_RESTART_ALWAYS ) || ( ( pool->restart == EVENTD_EXEC_RESTART_ON_FAILURE ) && ( ! success ) ) )
+    {
+        _eventd_exec_pool_ref(pool);
+        self->restart_timeout = g_timeout_add(pool->restart_delay, _eventd_exec_worker_restart_callback, self);
+    }
+    else if ( ( ! success ) || ( pool->restart == EVENTD_EXEC_RESTART_NEVER ) )
+    {
+        g_warning("Command '%s' will not be restarted", pool->command);
+        self->dead = TRUE;
+        g_queue_clear_full(&self->pending, (GDestroyNotify) g_bytes_unref);
+    }
+    else if ( ! g_queue_is_empty(&self->pending) )
+        /* We start it again right away for pending data */
+        _eventd_exec_worker_start(self);
+}
+
+static void
+_eventd_exec_worker_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    EventdExecWorker *self = user_data;
+    EventdExecPool *pool = self->pool;
+    GError *error = NULL;
+
+    if ( ! g_output_stream_write_all_finish(G_OUTPUT_STREAM(obj), res, NULL, &error) )
+    {
+        g_warning("Could not write to command stdin '%s': %s", pool->command, error->message);
+        g_clear_error(&error);
+    }
+
+    g_bytes_unref(self->writing);
+    self->writing = NULL;
+
+    if ( ( self->stdin_pipe != NULL ) && pool->stopping )
+        _eventd_exec_worker_close(self);
+    else
+        _eventd_exec_worker_write(self);
+
+    _eventd_exec_pool_unref(pool);
+}
+
+static void
+_eventd_exec_worker_write(EventdExecWorker *self)
+{
+    gsize size;
+
+    if ( ( self->writing != NULL ) || ( self->stdin_pipe == NULL ) || g_queue_is_empty(&self->pending) )
+        return;
+
+    self->writing = g_queue_pop_head(&self->pending);
+    _eventd_exec_pool_ref(self->pool);
+    g_output_stream_write_all_async(self->stdin_pipe, g_bytes_get_data(self->writing, &size), size, G_PRIORITY_DEFAULT, NULL, _eventd_exec_worker_write_callback, self);
+}
+
+static void
+_eventd_exec_worker_wait_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    EventdExecWorker *self = user_data;
+    EventdExecPool *pool = self->pool;
+    GError *error = NULL;
+    gboolean success = FALSE;
+
+    if ( ! g_subprocess_wait_finish(G_SUBPROCESS(obj), res, &error) )
+    {
+        g_warning("Could not wait for '%s': %s", pool->command, error->message);
+        g_clear_error(&error);
+    }
+    else
+        success = g_subprocess_get_successful(G_SUBPROCESS(obj));
+
+    if ( ( ! success ) && ( ! pool->stopping ) )
+        g_warning("Command '%s' exited unexpectedly", pool->command);
+
+    g_clear_object(&self->stdin_pipe);
+    g_clear_object(&self->process);
+
+    _eventd_exec_worker_stopped(self, success);
+    _eventd_exec_pool_unref(pool);
+}
+
+static void
+_eventd_exec_worker_start(EventdExecWorker *self)
+{
+    EventdExecPool *pool = self->pool;
+    GError *error = NULL;
+
+    self->process = g_subprocess_newv((const gchar * const *) pool->argv, G_SUBPROCESS_FLAGS_STDIN_PIPE, &error);
+    if ( self->process == NULL )
+    {
+        g_warning("Couldn't spawn '%s': %s", pool->command, error->message);
+        g_clear_error(&error);
+        _eventd_exec_worker_stopped(self, FALSE);
+        return;
+    }
+
+    self->stdin_pipe = g_object_ref(g_subprocess_get_stdin_pipe(self->process));
+    _eventd_exec_pool_ref(pool);
+    g_subprocess_wait_async(self->process, NULL, _eventd_exec_worker_wait_callback, self);
+
+    _eventd_exec_worker_write(self);
+}
+
+static void
+_eventd_exec_pool_push(EventdExecPool *self, GBytes *data)
+{
+    EventdExecWorker *worker = NULL;
+    gsize i;
+
+    if ( self->stopping )
+        goto drop;
+
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        if ( self->workers[i].dead )
+            continue;
+        if ( ( worker == NULL ) || ( g_queue_get_length(&self->workers[i].pending) < g_queue_get_length(&worker->pending) ) )
+            worker = &self->workers[i];
+    }
+
+    if ( worker == NULL )
+    {
+        g_warning("No worker left for '%s', dropping event", self->command);
+        goto drop;
+    }
+
+    if ( g_queue_get_length(&worker->pending) >= (guint) self->context->queue_size )
+    {
+        g_warning("Queue full for '%s', dropping event", self->command);
+        goto drop;
+    }
+
+    g_queue_push_tail(&worker->pending, data);
+    if ( ( worker->process == NULL ) && ( worker->restart_timeout == 0 ) )
+        _eventd_exec_worker_start(worker);
+    else
+        _eventd_exec_worker_write(worker);
+    return;
+
+drop:
+    g_bytes_unref(data);
+}
+
+
+/*
+ * One-shot commands
+ */
+
+static void _eventd_exec_job_spawn(EventdExecJob *job);
+
+static void
+_eventd_exec_job_write_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    EventdExecJob *job = user_data;
+    GError *error = NULL;
+
+    if ( ! g_output_stream_write_all_finish(G_OUTPUT_STREAM(obj), res, NULL, &error) )
+    {
+        g_warning("Could not write to command stdin '%s': %s", job->command, error->message);
+        g_clear_error(&error);
+    }
+
+    if ( ! g_output_stream_close(job->stdin_pipe, NULL, &error) )
+    {
+        g_warning("Could not properly shutdown stdin of '%s': %s", job->command, error->message);
+        g_clear_error(&error);
+    }
+
+    _eventd_exec_job_free(job);
+}
+
+static EventdPluginContext *
+_eventd_exec_context_ref(EventdPluginContext *context)
+{
+    g_atomic_ref_count_inc(&context->refcount);
+    return context;
+}
+
+static void
+_eventd_exec_context_unref(EventdPluginContext *context)
+{
+    if ( ! g_atomic_ref_count_dec(&context->refcount) )
+        return;
+
+    g_free(context);
+}
+
+static void
+_eventd_exec_job_wait_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
+{
+    EventdPluginContext *context = user_data;
+    EventdExecJob *job;
+
+    g_subprocess_wait_finish(G_SUBPROCESS(obj), res, NULL);
+
+    /* The queue is empty once we are uninitialized */
+    --context->children;
+    job = g_queue_pop_head(&context->queue);
+    if ( job != NULL )
+        _eventd_exec_job_spawn(job);
+
+    _eventd_exec_context_unref(context);
+}
+
+static void
+_eventd_exec_job_spawn(EventdExecJob *job)
+{
+    EventdPluginContext *context = job->context;
+    GSubprocess *process;
+    GError *error = NULL;
+
+    process = g_subprocess_newv((const gchar * const *) job->argv, ( job->data != NULL ) ? G_SUBPROCESS_FLAGS_STDIN_PIPE : G_SUBPROCESS_FLAGS_NONE, &error);
+    if ( process == NULL )
+    {
+        g_warning("Couldn't spawn '%s': %s", job->command, error->message);
+        g_clear_error(&error);
+        _eventd_exec_job_free(job);
+        return;
+    }
+
+    ++context->children;
+    g_subprocess_wait_async(process, NULL, _eventd_exec_job_wait_callback, _eventd_exec_context_ref(context));
+
+    if ( job->data != NULL )
+    {
+        gsize size;
+
+        job->stdin_pipe = g_object_ref(g_subprocess_get_stdin_pipe(process));
+        g_output_stream_write_all_async(job->stdin_pipe, g_bytes_get_data(job->data, &size), size, G_PRIORITY_DEFAULT, NULL, _eventd_exec_job_write_callback, job);
+    }
+    else
+        _eventd_exec_job_free(job);
+
+    g_object_unref(process);
+}
+
+/*
+ * Actions may run in any thread, so we do everything from the main thread
+ */
+static gboolean
+_eventd_exec_job_dispatch(gpointer user_data)
+{
+    EventdExecJob *job = user_data;
+    EventdPluginContext *context = job->context;
+
+    if ( job->pool != NULL )
+    {
+        _eventd_exec_pool_push(job->pool, job->data);
+        job->data = NULL;
+        _eventd_exec_pool_unref(job->pool);
+        _eventd_exec_job_free(job);
+    }
+    else if ( ( context->max_children > 0 ) && ( context->children >= context->max_children ) )
+    {
+        if ( g_queue_get_length(&context->queue) >= (guint) context->queue_size )
+        {
+            g_warning("Too many commands waiting, dropping '%s'", job->command);
+            _eventd_exec_job_free(job);
+        }
+        else
+            g_queue_push_tail(&context->queue, job);
+    }
+    else
+        _eventd_exec_job_spawn(job);
+
+    return G_SOURCE_REMOVE;
+}
+
 /*
  * Initialization interface
  */
 
+static void
+_eventd_exec_global_reset(EventdPluginContext *context)
+{
+    context->max_children = 0;
+    context->queue_size = 1000;
+}
+
 static EventdPluginContext *
 _eventd_exec_init(EventdPluginCoreContext *core)
 {
     EventdPluginContext *context;
 
     context = g_new0(EventdPluginContext, 1);
+    g_atomic_ref_count_init(&context->refcount);
+    g_queue_init(&context->queue);
+    _eventd_exec_global_reset(context);
 
     return context;
 }
@@ -64,7 +529,9 @@ _eventd_exec_init(EventdPluginCoreContext *core)
 static void
 _eventd_exec_uninit(EventdPluginContext *context)
 {
-    g_free(context);
+    g_queue_clear_full(&context->queue, (GDestroyNotify) _eventd_exec_job_free);
+
+    _eventd_exec_context_unref(context);
 }
 
 
@@ -72,12 +539,87 @@ _eventd_exec_uninit(EventdPluginContext *context)
  * Configuration interface
  */
 
+static void
+_eventd_exec_global_parse(EventdPluginContext *context, GKeyFile *config_file)
+{
+    Int integer;
+
+    if ( ! g_key_file_has_group(config_file, "Exec") )
+        return;
+
+    if ( evhelpers_config_key_file_get_int(config_file, "Exec", "MaxChildren", &integer) == 0 )
+        context->max_children = MAX(integer.value, 0);
+
+    if ( evhelpers_config_key_file_get_int(config_file, "Exec", "QueueSize", &integer) == 0 )
+        context->queue_size = MAX(integer.value, 0);
+}
+
+static EventdExecPool *
+_eventd_exec_pool_parse(EventdPluginContext *context, GKeyFile *config_file)
+{
+    gchar *command = NULL;
+    gchar **argv = NULL;
+    guint64 framing, restart;
+    gint64 workers, restart_delay;
+    GError *error = NULL;
+
+    if ( evhelpers_config_key_file_get_string(config_file, "Exec", "Command", &command) != 0 )
+        goto fail;
+
+    if ( ! g_shell_parse_argv(command, NULL, &argv, &error) )
+    {
+        g_warning("Couldn't parse command line '%s': %s", command, error->message);
+        g_clear_error(&error);
+        goto fail;
+    }
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "Exec", "Workers", 1, &workers) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_enum_with_default(config_file, "Exec", "Framing", _eventd_exec_framings, G_N_ELEMENTS(_eventd_exec_framings), EVENTD_EXEC_FRAMING_NEWLINE, &framing) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_enum_with_default(config_file, "Exec", "Restart", _eventd_exec_restarts, G_N_ELEMENTS(_eventd_exec_restarts), EVENTD_EXEC_RESTART_ON_FAILURE, &restart) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "Exec", "RestartDelay", 1000, &restart_delay) < 0 )
+        goto fail;
+
+    EventdExecPool *self;
+    gsize i;
+
+    self = g_slice_new0(EventdExecPool);
+    g_atomic_ref_count_init(&self->refcount);
+    self->context = context;
+    self->command = command;
+    self->argv = argv;
+    self->framing = framing;
+    self->restart = restart;
+    self->restart_delay = MAX(restart_delay, 0);
+    self->size = CLAMP(workers, 1, 64);
+    self->workers = g_new0(EventdExecWorker, self->size);
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        self->workers[i].pool = self;
+        g_queue_init(&self->workers[i].pending);
+    }
+
+    return self;
+
+fail:
+    g_strfreev(argv);
+    g_free(command);
+    return NULL;
+}
+
 static EventdPluginAction *
 _eventd_exec_action_parse(EventdPluginContext *context, GKeyFile *config_file)
 {
     gboolean disable = FALSE;
+    guint64 mode;
     FormatString *command = NULL;
     FormatString *stdin_template = NULL;
+    EventdExecPool *pool = NULL;
 
     if ( ! g_key_file_has_group(config_file, "Exec") )
         return NULL;
@@ -88,16 +630,33 @@ _eventd_exec_action_parse(EventdPluginContext *context, GKeyFile *config_file)
     if ( disable )
         return NULL;
 
-    if ( evhelpers_config_key_file_get_format_string(config_file, "Exec", "Command", &command) < 0 )
+    if ( evhelpers_config_key_file_get_enum_with_default(config_file, "Exec", "Mode", _eventd_exec_modes, G_N_ELEMENTS(_eventd_exec_modes), EVENTD_EXEC_MODE_ONESHOT, &mode) < 0 )
         return NULL;
 
     if ( evhelpers_config_key_file_get_template(config_file, "Exec", "StdInTemplate", &stdin_template) < 0 )
         goto fail;
 
+    if ( mode == EVENTD_EXEC_MODE_PERSISTENT )
+    {
+        if ( stdin_template == NULL )
+        {
+            g_warning("Persistent commands need a StdInTemplate=");
+            goto fail;
+        }
+
+        /* The command is only run once, so it cannot reference event data */
+        pool = _eventd_exec_pool_parse(context, config_file);
+        if ( pool == NULL )
+            goto fail;
+    }
+    else if ( evhelpers_config_key_file_get_format_string(config_file, "Exec", "Command", &command) < 0 )
+        goto fail;
+
     EventdPluginAction *action;
     action = g_slice_new(EventdPluginAction);
     action->command = command;
     action->stdin_template = stdin_template;
+    action->pool = pool;
 
     context->actions = g_slist_prepend(context->actions, action);
 
@@ -114,6 +673,8 @@ _eventd_exec_config_reset(EventdPluginContext *context)
 {
     g_slist_free_full(context->actions, _eventd_exec_action_free);
     context->actions = NULL;
+
+    _eventd_exec_global_reset(context);
 }
 
 
@@ -121,58 +682,68 @@ _eventd_exec_config_reset(EventdPluginContext *context)
  * Event action interface
  */
 
-static void
-_eventd_exec_event_action(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event)
+static GBytes *
+_eventd_exec_frame(EventdExecFraming framing, gchar *data)
 {
-    gchar *cmd;
-    gchar **argv;
-
-    gint in_, *in = ( action->stdin_template != NULL ) ? &in_ : NULL;
-    GError *error = NULL;
+    gsize length = strlen(data);
 
-    cmd = evhelpers_format_string_get_string(action->command, event, NULL, NULL);
-    if ( ! g_shell_parse_argv(cmd, NULL, &argv, &error) )
+    switch ( framing )
     {
-        g_warning("Couldn't parse command line '%s': %s", cmd, error->message);
-        g_clear_error(&error);
-    }
-    else if ( ! g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, in, NULL, NULL, &error) )
+    case EVENTD_EXEC_FRAMING_NEWLINE:
+        if ( ( length > 0 ) && ( data[length - 1] == '\n' ) )
+            break;
+        data = g_realloc(data, length + 2);
+        data[length++] = '\n';
+        data[length] = '\0';
+    break;
+    case EVENTD_EXEC_FRAMING_LENGTH:
     {
-        g_warning("Couldn't spawn '%s': %s", cmd, error->message);
-        g_clear_error(&error);
+        gchar *framed;
+        framed = g_strdup_printf("%" G_GSIZE_FORMAT "\n%s", length, data);
+        g_free(data);
+        data = framed;
+        length = strlen(data);
     }
-    else if ( in != NULL )
-    {
-        GIOChannel *io;
-        gchar *data;
+    break;
+    }
+
+    return g_bytes_new_take(data, length);
+}
 
-#ifdef G_OS_UNIX
-        io = g_io_channel_unix_new(*in);
-#else /* ! G_OS_UNIX */
-        io = g_io_channel_win32_new_fd(*in);
-#endif /* ! G_OS_UNIX */
+static void
+_eventd_exec_event_action(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event)
+{
+    EventdExecJob *job;
+    gchar *data = NULL;
+    GError *error = NULL;
+
+    if ( action->stdin_template != NULL )
         data = evhelpers_format_string_get_string(action->stdin_template, event, NULL, NULL);
 
-        GIOStatus status;
-        gsize bytes_written;
-        status = g_io_channel_write_chars(io, data, -1, &bytes_written, &error);
-        if ( status != G_IO_STATUS_NORMAL )
-        {
-            g_warning("Could not write to command stdin '%s': %s", cmd, error->message);
-            g_clear_error(&error);
-        }
-        status = g_io_channel_shutdown(io, TRUE, &error);
-        if ( status != G_IO_STATUS_NORMAL )
+    job = g_slice_new0(EventdExecJob);
+    job->context = context;
+
+    if ( action->pool != NULL )
+    {
+        job->pool = _eventd_exec_pool_ref(action->pool);
+        job->data = _eventd_exec_frame(action->pool->framing, data);
+    }
+    else
+    {
+        job->command = evhelpers_format_string_get_string(action->command, event, NULL, NULL);
+        if ( ! g_shell_parse_argv(job->command, NULL, &job->argv, &error) )
         {
-            g_warning("Could not properly shutdown stdin of '%s': %s", cmd, error->message);
+            g_warning("Couldn't parse command line '%s': %s", job->command, error->message);
             g_clear_error(&error);
+            g_free(data);
+            _eventd_exec_job_free(job);
+            return;
         }
-        g_io_channel_unref(io);
-
-        g_free(data);
+        if ( data != NULL )
+            job->data = g_bytes_new_take(data, strlen(data));
     }
 
-    g_free(cmd);
+    g_main_context_invoke(NULL, _eventd_exec_job_dispatch, job);
 }
 
 
@@ -189,8 +760,10 @@ eventd_plugin_get_interface(EventdPluginInterface *interface)
     eventd_plugin_interface_add_init_callback(interface, _eventd_exec_init);
     eventd_plugin_interface_add_uninit_callback(interface, _eventd_exec_uninit);
 
+    eventd_plugin_interface_add_global_parse_callback(interface, _eventd_exec_global_parse);
     eventd_plugin_interface_add_action_parse_callback(interface, _eventd_exec_action_parse);
     eventd_plugin_interface_add_config_reset_callback(interface, _eventd_exec_config_reset);
 
     eventd_plugin_interface_add_event_action_callback(interface, _eventd_exec_event_action);
+    eventd_plugin_interface_set_event_action_thread_safe(interface, TRUE);
 }
@@ -32,6 +32,14 @@
 
 struct _EventdPluginContext {
     gchar *runtime_dir;
+    gint64 max_open_files;
+    gint64 buffer_size;
+    gint64 flush_interval;
+    GHashTable *writers;
+    GQueue lru;
+    GThreadPool *pool;
+    GSource *source;
+    struct _EventdFileWriter *done;
     GSList *actions;
 };
 
@@ -39,6 +47,37 @@ struct _EventdPluginAction {
     FormatString *file;
     FormatString *string;
     gboolean truncate;
+    gint64 rotate_size;
+    gint64 rotate_interval;
+    gint64 rotate_count;
+};
+
+/*
+ * We keep one writer per file, so that writes to a file are ordered
+ * Only one operation is running at a time, in our I/O thread,
+ * while new data is buffered
+ */
+typedef struct _EventdFileWriter EventdFileWriter;
+
+struct _EventdFileWriter {
+    EventdPluginContext *context;
+    gchar *uri;
+    GFile *file;
+    GList lru_link;
+    gboolean truncate;
+    gint64 rotate_size;
+    gint64 rotate_interval;
+    gint64 rotate_count;
+
+    GFileOutputStream *stream;
+    gint64 size;
+    gint64 opened;
+    GString *buffer;
+    GString *writing;
+    gboolean busy;
+    gboolean closing;
+    guint flush_timeout;
+    EventdFileWriter *next;
 };
 
 static void
@@ -52,10 +91,314 @@ _eventd_file_action_free(gpointer data)
     g_slice_free(EventdPluginAction, action);
 }
 
+static void _eventd_file_writer_flush(EventdFileWriter *self);
+
+static EventdFileWriter *
+_eventd_file_writer_new(EventdPluginContext *context, GFile *file, gchar *uri, EventdPluginAction *action)
+{
+    EventdFileWriter *self;
+
+    self = g_slice_new0(EventdFileWriter);
+    self->context = context;
+    self->uri = uri;
+    self->file = file;
+    self->lru_link.data = self;
+    self->truncate = action->truncate;
+    self->rotate_size = action->rotate_size;
+    self->rotate_interval = action->rotate_interval;
+    self->rotate_count = action->rotate_count;
+    self->buffer = g_string_new(NULL);
+
+    g_hash_table_insert(context->writers, self->uri, self);
+    g_queue_push_head_link(&context->lru, &self->lru_link);
+
+    return self;
+}
+
+static void
+_eventd_file_writer_free(EventdFileWriter *self)
+{
+    EventdPluginContext *context = self->context;
+
+    g_hash_table_remove(context->writers, self->uri);
+    if ( ! self->closing )
+        g_queue_unlink(&context->lru, &self->lru_link);
+
+    if ( self->flush_timeout > 0 )
+        g_source_remove(self->flush_timeout);
+
+    if ( self->stream != NULL )
+    {
+        GError *error = NULL;
+        if ( ! g_output_stream_close(G_OUTPUT_STREAM(self->stream), NULL, &error) )
+            g_warning("Could not close file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        g_object_unref(self->stream);
+    }
+
+    g_string_free(self->buffer, TRUE);
+    g_object_unref(self->file);
+    g_free(self->uri);
+
+    g_slice_free(EventdFileWriter, self);
+}
+
+static void
+_eventd_file_writer_check_close(EventdFileWriter *self)
+{
+    if ( self->closing && ( ! self->busy ) && ( self->buffer->len == 0 ) )
+        _eventd_file_writer_free(self);
+}
+
+static void
+_eventd_file_writers_trim(EventdPluginContext *context)
+{
+    /* Evicted writers leave the LRU and close once their buffer is written */
+    while ( g_queue_get_length(&context->lru) > context->max_open_files )
+    {
+        EventdFileWriter *self = context->lru.tail->data;
+
+        g_queue_unlink(&context->lru, &self->lru_link);
+        self->closing = TRUE;
+        _eventd_file_writer_flush(self);
+        _eventd_file_writer_check_close(self);
+    }
+}
+
+/*
+ * Everything from here to _eventd_file_writer_write() runs in the I/O thread,
+ * which owns the stream while the writer is busy
+ */
+static GFile *
+_eventd_file_writer_get_rotated(EventdFileWriter *self, gint64 n)
+{
+    GFile *parent, *file;
+    gchar *basename, *name;
+
+    if ( n == 0 )
+        return g_object_ref(self->file);
+
+    parent = g_file_get_parent(self->file);
+    basename = g_file_get_basename(self->file);
+    name = g_strdup_printf("%s.%" G_GINT64_FORMAT, basename, n);
+    file = g_file_get_child(parent, name);
+    g_free(name);
+    g_free(basename);
+    g_object_unref(parent);
+
+    return file;
+}
+
+static void
+_eventd_file_writer_rotate(EventdFileWriter *self)
+{
+    GError *error = NULL;
+    gint64 n;
+
+    eventd_debug("Rotating file '%s'", self->uri);
+
+    if ( ! g_output_stream_close(G_OUTPUT_STREAM(self->stream), NULL, &error) )
+    {
+        g_warning("Could not close file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+    }
+    g_clear_object(&self->stream);
+
+    if ( self->rotate_count == 0 )
+    {
+        if ( ! g_file_delete(self->file, NULL, &error) )
+            g_warning("Could not delete file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        return;
+    }
+
+    for ( n = self->rotate_count ; n > 0 ; --n )
+    {
+        GFile *from, *to;
+
+        from = _eventd_file_writer_get_rotated(self, n - 1);
+        to = _eventd_file_writer_get_rotated(self, n);
+        if ( ( ! g_file_move(from, to, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error) ) && ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ) )
+            g_warning("Could not rotate file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        g_object_unref(to);
+        g_object_unref(from);
+    }
+}
+
+static gboolean
+_eventd_file_writer_need_rotate(EventdFileWriter *self)
+{
+    if ( ( self->rotate_size > 0 ) && ( self->size > 0 ) && ( self->size + (gint64) self->writing->len > self->rotate_size ) )
+        return TRUE;
+
+    if ( ( self->rotate_interval > 0 ) && ( g_get_monotonic_time() - self->opened >= self->rotate_interval * G_USEC_PER_SEC ) )
+        return TRUE;
+
+    return FALSE;
+}
+
+static gboolean
+_eventd_file_writer_open(EventdFileWriter *self)
+{
+    GError *error = NULL;
+    GFileInfo *info;
+
+    self->stream = g_file_append_to(self->file, G_FILE_CREATE_NONE, NULL, &error);
+    if ( self->stream == NULL )
+    {
+        g_warning("Could not open file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    self->size = 0;
+    self->opened = g_get_monotonic_time();
+    info = g_file_output_stream_query_info(self->stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, NULL);
+    if ( info != NULL )
+    {
+        self->size = g_file_info_get_size(info);
+        g_object_unref(info);
+    }
+
+    return TRUE;
+}
+
+static void
+_eventd_file_writer_write(gpointer data, gpointer user_data)
+{
+    EventdFileWriter *self = data;
+    EventdPluginContext *context = user_data;
+    GError *error = NULL;
+    gsize written = 0;
+
+    if ( self->truncate )
+    {
+        if ( ! g_file_replace_contents(self->file, self->writing->str, self->writing->len, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error) )
+            g_warning("Could not write to file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        goto done;
+    }
+
+    if ( ( self->stream != NULL ) && _eventd_file_writer_need_rotate(self) )
+        _eventd_file_writer_rotate(self);
+
+    /* If we cannot open it, the data is lost and we will try again next time */
+    if ( ( self->stream == NULL ) && ( ! _eventd_file_writer_open(self) ) )
+        goto done;
+
+    if ( ! g_output_stream_write_all(G_OUTPUT_STREAM(self->stream), self->writing->str, self->writing->len, &written, NULL, &error) )
+    {
+        g_warning("Could not write to file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+        /* We will try to open it again next time */
+        g_clear_object(&self->stream);
+    }
+    self->size += written;
+
+done:
+    do
+        self->next = g_atomic_pointer_get(&context->done);
+    while ( ! g_atomic_pointer_compare_and_exchange(&context->done, self->next, self) );
+    g_source_set_ready_time(context->source, 0);
+}
+
+static void
+_eventd_file_writer_flush(EventdFileWriter *self)
+{
+    if ( self->flush_timeout > 0 )
+    {
+        g_source_remove(self->flush_timeout);
+        self->flush_timeout = 0;
+    }
+
+    if ( self->busy || ( self->buffer->len == 0 ) )
+        return;
+
+    self->busy = TRUE;
+    self->writing = self->buffer;
+    self->buffer = g_string_new(NULL);
+    g_thread_pool_push(self->context->pool, self, NULL);
+}
+
+static void
+_eventd_file_writers_process(EventdPluginContext *context, gboolean flush)
+{
+    EventdFileWriter *done, *self;
+
+    do
+        done = g_atomic_pointer_get(&context->done);
+    while ( ! g_atomic_pointer_compare_and_exchange(&context->done, done, NULL) );
+
+    for ( self = done ; self != NULL ; self = done )
+    {
+        done = self->next;
+        self->next = NULL;
+
+        g_string_free(self->writing, TRUE);
+        self->writing = NULL;
+        self->busy = FALSE;
+
+        /* What came in meanwhile is written right away */
+        if ( flush )
+            _eventd_file_writer_flush(self);
+        _eventd_file_writer_check_close(self);
+    }
+}
+
+static gboolean
+_eventd_file_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    EventdPluginContext *context = user_data;
+
+    /* Reset before processing, so a write finishing meanwhile wakes us up again */
+    g_source_set_ready_time(source, -1);
+    _eventd_file_writers_process(context, TRUE);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs _eventd_file_source_funcs = {
+    .dispatch = _eventd_file_source_dispatch,
+};
+
+static gboolean
+_eventd_file_writer_flush_callback(gpointer user_data)
+{
+    EventdFileWriter *self = user_data;
+
+    self->flush_timeout = 0;
+    _eventd_file_writer_flush(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_file_writer_append(EventdFileWriter *self, const gchar *string)
+{
+    /* We only keep the last string, the file is replaced anyway */
+    if ( self->truncate )
+        g_string_truncate(self->buffer, 0);
+    g_string_append(self->buffer, string);
+
+    if ( self->buffer->len >= (gsize) self->context->buffer_size )
+        _eventd_file_writer_flush(self);
+    else if ( self->flush_timeout == 0 )
+        self->flush_timeout = g_timeout_add(self->context->flush_interval, _eventd_file_writer_flush_callback, self);
+}
+
 /*
  * Initialization interface
  */
 
+static void
+_eventd_file_global_reset(EventdPluginContext *context)
+{
+    context->max_open_files = 16;
+    context->buffer_size = 64 * 1024;
+    context->flush_interval = 1000;
+}
+
 static EventdPluginContext *
 _eventd_file_init(EventdPluginCoreContext *core)
 {
@@ -64,6 +407,9 @@ _eventd_file_init(EventdPluginCoreContext *core)
     context = g_new0(EventdPluginContext, 1);
 
     context->runtime_dir = g_build_filename(g_get_user_runtime_dir(), PACKAGE_NAME, NULL);
+    context->writers = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&context->lru);
+    _eventd_file_global_reset(context);
 
     return context;
 }
@@ -71,16 +417,115 @@ _eventd_file_init(EventdPluginCoreContext *core)
 static void
 _eventd_file_uninit(EventdPluginContext *context)
 {
+    g_hash_table_unref(context->writers);
     g_free(context->runtime_dir);
 
     g_free(context);
 }
 
 
+/*
+ * Start/Stop interface
+ */
+
+static void
+_eventd_file_start(EventdPluginContext *context)
+{
+    /* One thread keeps things simple and is enough for our small writes */
+    context->pool = g_thread_pool_new(_eventd_file_writer_write, context, 1, FALSE, NULL);
+
+    context->source = g_source_new(&_eventd_file_source_funcs, sizeof(GSource));
+    g_source_set_callback(context->source, NULL, context, NULL);
+    g_source_attach(context->source, NULL);
+}
+
+static void
+_eventd_file_stop(EventdPluginContext *context)
+{
+    GList *writers, *writer;
+
+    /*
+     * The main loop will not run again after that,
+     * so we wait for running writes and then write what is left synchronously
+     */
+    g_thread_pool_free(context->pool, FALSE, TRUE);
+    context->pool = NULL;
+    _eventd_file_writers_process(context, FALSE);
+
+    g_source_destroy(context->source);
+    g_source_unref(context->source);
+    context->source = NULL;
+
+    writers = g_hash_table_get_values(context->writers);
+    for ( writer = writers ; writer != NULL ; writer = g_list_next(writer) )
+    {
+        EventdFileWriter *self = writer->data;
+        GError *error = NULL;
+
+        if ( self->buffer->len == 0 )
+            goto close;
+
+        if ( self->truncate )
+        {
+            if ( ! g_file_replace_contents(self->file, self->buffer->str, self->buffer->len, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error) )
+                goto fail;
+            goto close;
+        }
+
+        if ( self->stream == NULL )
+            self->stream = g_file_append_to(self->file, G_FILE_CREATE_NONE, NULL, &error);
+        if ( ( self->stream == NULL ) || ( ! g_output_stream_write_all(G_OUTPUT_STREAM(self->stream), self->buffer->str, self->buffer->len, NULL, NULL, &error) ) )
+            goto fail;
+        goto close;
+
+    fail:
+        g_warning("Could not write to file '%s': %s", self->uri, error->message);
+        g_clear_error(&error);
+    close:
+        g_string_truncate(self->buffer, 0);
+        _eventd_file_writer_free(self);
+    }
+    g_list_free(writers);
+}
+
+static void
+_eventd_file_reload(EventdPluginContext *context)
+{
+    GHashTableIter iter;
+    EventdFileWriter *self;
+
+    /* We keep our writers, only making sure nothing waits in their buffer */
+    g_hash_table_iter_init(&iter, context->writers);
+    while ( g_hash_table_iter_next(&iter, NULL, (gpointer *) &self) )
+        _eventd_file_writer_flush(self);
+
+    /* MaxOpenFiles may have changed */
+    _eventd_file_writers_trim(context);
+}
+
+
 /*
  * Configuration interface
  */
 
+static void
+_eventd_file_global_parse(EventdPluginContext *context, GKeyFile *config_file)
+{
+    Int integer;
+
+    if ( ! g_key_file_has_group(config_file, "FileWrite") )
+        return;
+
+    if ( evhelpers_config_key_file_get_int(config_file, "FileWrite", "MaxOpenFiles", &integer) == 0 )
+        context->max_open_files = MAX(integer.value, 1);
+
+    if ( evhelpers_config_key_file_get_int(config_file, "FileWrite", "BufferSize", &integer) == 0 )
+        context->buffer_size = MAX(integer.value, 0);
+
+    if ( evhelpers_config_key_file_get_int(config_file, "FileWrite", "FlushInterval", &integer) == 0 )
+        context->flush_interval = MAX(integer.value, 0);
+}
+
 static EventdPluginAction *
 _eventd_file_action_parse(EventdPluginContext *context, GKeyFile *config_file)
 {
@@ -89,6 +534,7 @@ _eventd_file_action_parse(EventdPluginContext *context, GKeyFile *config_file)
     FormatString *file = NULL;
     FormatString *string = NULL;
     gboolean truncate = FALSE;
+    gint64 rotate_size, rotate_interval, rotate_count;
 
     if ( ! g_key_file_has_group(config_file, "FileWrite") )
         return NULL;
@@ -112,11 +558,23 @@ _eventd_file_action_parse(EventdPluginContext *context, GKeyFile *config_file)
     if ( evhelpers_config_key_file_get_boolean(config_file, "FileWrite", "Truncate", &truncate) < 0 )
         goto fail;
 
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "FileWrite", "RotateSize", 0, &rotate_size) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "FileWrite", "RotateInterval", 0, &rotate_interval) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "FileWrite", "RotateCount", 5, &rotate_count) < 0 )
+        goto fail;
+
     EventdPluginAction *action;
     action = g_slice_new(EventdPluginAction);
     action->file = file;
     action->string = string;
     action->truncate = truncate;
+    action->rotate_size = MAX(rotate_size, 0);
+    action->rotate_interval = MAX(rotate_interval, 0);
+    action->rotate_count = MAX(rotate_count, 0);
 
     context->actions = g_slist_prepend(context->actions, action);
 
@@ -133,6 +591,8 @@ _eventd_file_config_reset(EventdPluginContext *context)
 {
     g_slist_free_full(context->actions, _eventd_file_action_free);
     context->actions = NULL;
+
+    _eventd_file_global_reset(context);
 }
 
 
@@ -140,66 +600,10 @@ _eventd_file_config_reset(EventdPluginContext *context)
  * Event action interface
  */
 
-static void
-_eventd_file_replace_fallback_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
-{
-    g_file_replace_contents_finish(G_FILE(obj), res, NULL, NULL);
-    g_object_unref(obj);
-    g_free(user_data);
-}
-
-static void
-_eventd_file_write(GFile *file, gchar *string, GAsyncResult *res, gboolean truncate)
-{
-    GError *error = NULL;
-    gchar *path;
-    GFileOutputStream *stream;
-
-    path = g_file_get_path(file);
-    stream = g_file_append_to_finish(file, res, &error);
-
-    if ( stream == NULL )
-    {
-        g_warning("Could not write to file '%s': %s", path, error->message);
-        g_free(string);
-        goto out;
-    }
-
-    if ( truncate )
-    {
-        if ( ( ! g_seekable_can_truncate(G_SEEKABLE(stream)) ) || ( ! g_seekable_truncate(G_SEEKABLE(stream), 0, NULL, &error) ) )
-        {
-            g_warning("Could not truncate file '%s'%s%s", path, ( error != NULL ) ? ": " : "", ( error != NULL ) ? error->message : "");
-            g_file_replace_contents_async(g_object_ref(file), string, strlen(string), NULL, FALSE, G_FILE_CREATE_NONE, NULL, _eventd_file_replace_fallback_callback, string);
-            goto out;
-        }
-    }
-
-    if ( ! g_output_stream_write_all(G_OUTPUT_STREAM(stream), string, strlen(string), NULL, NULL, &error) )
-        g_warning("Could not write to file '%s': %s", path, error->message);
-
-out:
-    g_clear_error(&error);
-    g_object_unref(stream);
-    g_object_unref(file);
-    g_free(path);
-}
-
-static void
-_eventd_file_truncate_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
-{
-    _eventd_file_write(G_FILE(obj), user_data, res, TRUE);
-}
-
-static void
-_eventd_file_append_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
-{
-    _eventd_file_write(G_FILE(obj), user_data, res, FALSE);
-}
-
 static void
 _eventd_file_event_action(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event)
 {
+    EventdFileWriter *writer;
     gchar *uri = NULL;
     GFile *file;
     gchar *string = NULL;
@@ -208,9 +612,26 @@ _eventd_file_event_action(EventdPluginContext *context, EventdPluginAction *acti
     file = g_file_new_for_commandline_arg_and_cwd(uri, context->runtime_dir);
     g_free(uri);
 
+    uri = g_file_get_uri(file);
+    writer = g_hash_table_lookup(context->writers, uri);
+    if ( writer == NULL )
+        writer = _eventd_file_writer_new(context, file, uri, action);
+    else
+    {
+        g_object_unref(file);
+        g_free(uri);
+        if ( writer->closing )
+            writer->closing = FALSE;
+        else
+            g_queue_unlink(&context->lru, &writer->lru_link);
+        g_queue_push_head_link(&context->lru, &writer->lru_link);
+    }
+
     string = evhelpers_format_string_get_string(action->string, event, NULL, NULL);
+    _eventd_file_writer_append(writer, string);
+    g_free(string);
 
-    g_file_append_to_async(file, G_FILE_CREATE_NONE, G_PRIORITY_DEFAULT, NULL, action->truncate ? _eventd_file_truncate_callback : _eventd_file_append_callback, string);
+    _eventd_file_writers_trim(context);
 }
 
 
@@ -227,6 +648,11 @@ eventd_plugin_get_interface(EventdPluginInterface *interface)
     eventd_plugin_interface_add_init_callback(interface, _eventd_file_init);
     eventd_plugin_interface_add_uninit_callback(interface, _eventd_file_uninit);
 
+    eventd_plugin_interface_add_start_callback(interface, _eventd_file_start);
+    eventd_plugin_interface_add_stop_callback(interface, _eventd_file_stop);
+    eventd_plugin_interface_add_reload_callback(interface, _eventd_file_reload);
+
+    eventd_plugin_interface_add_global_parse_callback(interface, _eventd_file_global_parse);
     eventd_plugin_interface_add_action_parse_callback(interface, _eventd_file_action_parse);
     eventd_plugin_interface_add_config_reset_callback(interface, _eventd_file_config_reset);
 
@@ -0,0 +1,292 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "eventd-plugin.h"
+#include "eventd-plugin-private.h"
+
+void eventd_plugin_get_interface(EventdPluginInterface *interface);
+
+typedef struct {
+    gchar *dir;
+    EventdPluginInterface interface;
+    EventdPluginContext *context;
+    EventdPluginAction *action;
+} EventdFileTestFixture;
+
+static void
+_init_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    const gchar *extra = user_data;
+    GKeyFile *config_file;
+    gchar *config;
+
+    fixture->dir = g_dir_make_tmp("eventd-file-XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+
+    config = g_strdup_printf(
+        "[FileWrite]\n"
+        "File=%s/${file}\n"
+        "String=${index}\\n\n"
+        "%s",
+        fixture->dir, extra);
+    config_file = g_key_file_new();
+    g_assert_true(g_key_file_load_from_data(config_file, config, -1, G_KEY_FILE_NONE, NULL));
+    g_free(config);
+
+    eventd_plugin_get_interface(&fixture->interface);
+    fixture->context = fixture->interface.init(NULL);
+    fixture->interface.global_parse(fixture->context, config_file);
+    fixture->action = fixture->interface.action_parse(fixture->context, config_file);
+    g_assert_nonnull(fixture->action);
+    fixture->interface.start(fixture->context);
+
+    g_key_file_unref(config_file);
+}
+
+static void
+_clean_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    const gchar *name;
+    GDir *dir;
+
+    fixture->interface.stop(fixture->context);
+    fixture->interface.config_reset(fixture->context);
+    fixture->interface.uninit(fixture->context);
+
+    dir = g_dir_open(fixture->dir, 0, NULL);
+    g_assert_nonnull(dir);
+    while ( ( name = g_dir_read_name(dir) ) != NULL )
+    {
+        gchar *path;
+
+        path = g_build_filename(fixture->dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    g_rmdir(fixture->dir);
+    g_free(fixture->dir);
+}
+
+static void
+_eventd_file_tests_push(EventdFileTestFixture *fixture, const gchar *file, guint64 index)
+{
+    EventdEvent *event;
+
+    event = eventd_event_new("test", "file");
+    eventd_event_add_data_string(event, g_strdup("file"), g_strdup(file));
+    eventd_event_add_data(event, g_strdup("index"), g_variant_new_uint64(index));
+    fixture->interface.event_action(fixture->context, fixture->action, event);
+    eventd_event_unref(event);
+}
+
+static gchar *
+_eventd_file_tests_get_contents(EventdFileTestFixture *fixture, const gchar *file)
+{
+    gchar *path, *contents = NULL;
+
+    path = g_build_filename(fixture->dir, file, NULL);
+    g_file_get_contents(path, &contents, NULL, NULL);
+    g_free(path);
+
+    return contents;
+}
+
+static gboolean
+_eventd_file_tests_timeout(gpointer user_data)
+{
+    gboolean *timed_out = user_data;
+
+    *timed_out = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_file_tests_iterate(guint ms)
+{
+    gboolean timed_out = FALSE;
+
+    g_timeout_add(ms, _eventd_file_tests_timeout, &timed_out);
+    while ( ! timed_out )
+        g_main_context_iteration(NULL, TRUE);
+}
+
+/* Iterate until the file has the expected contents */
+static void
+_eventd_file_tests_wait(EventdFileTestFixture *fixture, const gchar *file, const gchar *expected)
+{
+    gboolean timed_out = FALSE;
+    gchar *contents = NULL;
+    guint timeout;
+
+    timeout = g_timeout_add_seconds(2, _eventd_file_tests_timeout, &timed_out);
+    while ( ! timed_out )
+    {
+        g_free(contents);
+        contents = _eventd_file_tests_get_contents(fixture, file);
+        if ( g_strcmp0(contents, expected) == 0 )
+            break;
+        g_main_context_iteration(NULL, TRUE);
+    }
+    if ( ! timed_out )
+        g_source_remove(timeout);
+
+    g_assert_cmpstr(contents, ==, expected);
+    g_free(contents);
+}
+
+static void
+_eventd_file_tests_ordered(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    GString *expected;
+    guint64 i;
+
+    expected = g_string_new(NULL);
+    for ( i = 0 ; i < 100 ; ++i )
+    {
+        _eventd_file_tests_push(fixture, "test", i);
+        g_string_append_printf(expected, "%" G_GUINT64_FORMAT "\n", i);
+        if ( i % 10 == 0 )
+            g_main_context_iteration(NULL, FALSE);
+    }
+
+    _eventd_file_tests_wait(fixture, "test", expected->str);
+    g_string_free(expected, TRUE);
+}
+
+static void
+_eventd_file_tests_flush_buffer(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    gchar *contents;
+
+    _eventd_file_tests_push(fixture, "test", 1);
+    _eventd_file_tests_iterate(50);
+    contents = _eventd_file_tests_get_contents(fixture, "test");
+    g_assert_null(contents);
+
+    /* BufferSize reached */
+    _eventd_file_tests_push(fixture, "test", 2);
+    _eventd_file_tests_wait(fixture, "test", "1\n2\n");
+}
+
+static void
+_eventd_file_tests_flush_interval(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    gchar *contents;
+
+    _eventd_file_tests_push(fixture, "test", 1);
+    contents = _eventd_file_tests_get_contents(fixture, "test");
+    g_assert_null(contents);
+
+    _eventd_file_tests_wait(fixture, "test", "1\n");
+}
+
+static void
+_eventd_file_tests_rotate(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+
+    _eventd_file_tests_push(fixture, "test", 1);
+    _eventd_file_tests_wait(fixture, "test", "1\n");
+    _eventd_file_tests_push(fixture, "test", 2);
+    _eventd_file_tests_wait(fixture, "test", "1\n2\n");
+
+    /* RotateSize exceeded */
+    _eventd_file_tests_push(fixture, "test", 3);
+    _eventd_file_tests_wait(fixture, "test", "3\n");
+    _eventd_file_tests_wait(fixture, "test.1", "1\n2\n");
+}
+
+static void
+_eventd_file_tests_lru(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+
+    _eventd_file_tests_push(fixture, "a", 1);
+    /* Evicts "a", which closes once written */
+    _eventd_file_tests_push(fixture, "b", 2);
+    _eventd_file_tests_wait(fixture, "a", "1\n");
+    _eventd_file_tests_wait(fixture, "b", "2\n");
+
+    /* Evicts "b" and opens "a" again */
+    _eventd_file_tests_push(fixture, "a", 3);
+    _eventd_file_tests_wait(fixture, "a", "1\n3\n");
+    _eventd_file_tests_wait(fixture, "b", "2\n");
+}
+
+static void
+_eventd_file_tests_reload(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+
+    _eventd_file_tests_push(fixture, "test", 1);
+    fixture->interface.reload(fixture->context);
+    _eventd_file_tests_wait(fixture, "test", "1\n");
+
+    /* The writer is still there */
+    _eventd_file_tests_push(fixture, "test", 2);
+    fixture->interface.reload(fixture->context);
+    _eventd_file_tests_wait(fixture, "test", "1\n2\n");
+}
+
+static void
+_eventd_file_tests_stop(gpointer fixture_, gconstpointer user_data)
+{
+    EventdFileTestFixture *fixture = fixture_;
+    gchar *contents;
+
+    _eventd_file_tests_push(fixture, "test", 1);
+    _eventd_file_tests_push(fixture, "test", 2);
+
+    /* Stop writes everything without the main loop */
+    fixture->interface.stop(fixture->context);
+    contents = _eventd_file_tests_get_contents(fixture, "test");
+    g_assert_cmpstr(contents, ==, "1\n2\n");
+    g_free(contents);
+
+    fixture->interface.start(fixture->context);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/file/ordered", EventdFileTestFixture, "BufferSize=0\n", _init_data, _eventd_file_tests_ordered, _clean_data);
+    g_test_add("/file/flush/buffer", EventdFileTestFixture, "BufferSize=4\nFlushInterval=10000\n", _init_data, _eventd_file_tests_flush_buffer, _clean_data);
+    g_test_add("/file/flush/interval", EventdFileTestFixture, "FlushInterval=50\n", _init_data, _eventd_file_tests_flush_interval, _clean_data);
+    g_test_add("/file/rotate", EventdFileTestFixture, "RotateSize=4\nRotateCount=1\nBufferSize=0\n", _init_data, _eventd_file_tests_rotate, _clean_data);
+    g_test_add("/file/lru", EventdFileTestFixture, "MaxOpenFiles=1\nBufferSize=0\n", _init_data, _eventd_file_tests_lru, _clean_data);
+    g_test_add("/file/reload", EventdFileTestFixture, "FlushInterval=10000\n", _init_data, _eventd_file_tests_reload, _clean_data);
+    g_test_add("/file/stop", EventdFileTestFixture, "FlushInterval=10000\n", _init_data, _eventd_file_tests_stop, _clean_data);
+
+    return g_test_run();
+}
@@ -39,6 +39,7 @@
 #include "style.h"
 #include "pixbuf.h"
 #include "blur.h"
+#include "premultiply.h"
 
 #include "draw.h"
 
@@ -253,39 +254,10 @@ eventd_nd_draw_text_process(EventdNdStyle *style, EventdEvent *event, gint max_w
 }
 
 /*
- * _eventd_nd_draw_get_icon_surface and alpha_mult
- * are inspired by gdk_cairo_set_source_pixbuf
+ * _eventd_nd_draw_get_icon_surface is inspired by gdk_cairo_set_source_pixbuf
  * GDK is:
  *     Copyright (C) 2011-2024 Red Hat, Inc.
  */
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-#define RED_BYTE 2
-#define GREEN_BYTE 1
-#define BLUE_BYTE 0
-#define ALPHA_BYTE 3
-#else
-#define RED_BYTE 1
-#define GREEN_BYTE 2
-#define BLUE_BYTE 3
-#define ALPHA_BYTE 0
-#endif
-
-static inline guchar
-alpha_mult(guchar c, guchar a)
-{
-    guint16 t;
-    switch ( a )
-    {
-    case 0xff:
-        return c;
-    case 0x00:
-        return 0x00;
-    default:
-        t = c * a + 0x7f;
-        return ((t >> 8) + t) >> 8;
-    }
-}
-
 static cairo_surface_t *
 _eventd_nd_draw_get_surface_from_pixbuf(GdkPixbuf *pixbuf)
 {
@@ -306,58 +278,46 @@ _eventd_nd_draw_get_surface_from_pixbuf(GdkPixbuf *pixbuf)
     cairo_surface_t *surface = NULL;
 
     gint cstride;
-    guint lo, o;
-    guchar a = 0xff;
-    const guchar *pixels_end, *line, *line_end;
-    guchar *cpixels, *cline;
-
-    pixels_end = pixels + height * stride;
-    o = alpha ? 4 : 3;
-    lo = o * width;
+    guchar *cpixels;
+    gint y;
 
     surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
     cpixels = cairo_image_surface_get_data(surface);
     cstride = cairo_image_surface_get_stride(surface);
 
     cairo_surface_flush(surface);
-    while ( pixels < pixels_end )
-    {
-        line = pixels;
-        line_end = line + lo;
-        cline = cpixels;
-
-        while ( line < line_end )
-        {
-            if ( alpha )
-                a = line[3];
-            cline[RED_BYTE] = alpha_mult(line[0], a);
-            cline[GREEN_BYTE] = alpha_mult(line[1], a);
-            cline[BLUE_BYTE] = alpha_mult(line[2], a);
-            cline[ALPHA_BYTE] = a;
-
-            line += o;
-            cline += 4;
-        }
-
-        pixels += stride;
-        cpixels += cstride;
-    }
+    for ( y = 0 ; y < height ; ++y )
+        eventd_nd_draw_premultiply((guint32 *) ( cpixels + y * cstride ), pixels + y * stride, width, alpha);
     cairo_surface_mark_dirty(surface);
     cairo_surface_flush(surface);
 
     return surface;
 }
 
+static gpointer
+_eventd_nd_draw_image_cache_convert(GdkPixbuf *pixbuf, gsize *size)
+{
+    cairo_surface_t *surface;
+
+    surface = _eventd_nd_draw_get_surface_from_pixbuf(pixbuf);
+    *size = cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface);
+
+    return surface;
+}
+
+EventdNdPixbufCache *
+eventd_nd_draw_image_cache_new(gsize max_size)
+{
+    return eventd_nd_pixbuf_cache_new(max_size, _eventd_nd_draw_image_cache_convert, (GBoxedCopyFunc) cairo_surface_reference, (GDestroyNotify) cairo_surface_destroy);
+}
+
 static cairo_surface_t *
-_eventd_nd_draw_limit_size(GdkPixbuf *pixbuf, EventdNdStyle *style, gboolean image, gint max_draw_width)
+_eventd_nd_draw_limit_size(cairo_surface_t *source, EventdNdStyle *style, gboolean image, gint max_draw_width)
 {
-    cairo_surface_t *source;
     gint width, height;
     gint max_width, max_height;
     gboolean fixed_size;
 
-    source = _eventd_nd_draw_get_surface_from_pixbuf(pixbuf);
-
     width = cairo_image_surface_get_width(source);
     height = cairo_image_surface_get_height(source);
 
@@ -373,7 +333,7 @@ _eventd_nd_draw_limit_size(GdkPixbuf *pixbuf, EventdNdStyle *style, gboolean ima
     }
 
     if ( ( ( max_width < 0 ) || ( width <= max_width ) ) && ( ( max_height < 0 ) || ( height <= max_height ) ) && ( ! fixed_size ) )
-        return source;
+        return cairo_surface_reference(source);
 
     /*
      * We checked before that fixed_size cannot happen with max_width/height being -1,
@@ -408,18 +368,17 @@ _eventd_nd_draw_limit_size(GdkPixbuf *pixbuf, EventdNdStyle *style, gboolean ima
 
     cairo_pattern_destroy(pattern);
     cairo_destroy(cr);
-    cairo_surface_destroy(source);
 
     cairo_surface_flush(surface);
     return surface;
 }
 
 static cairo_surface_t *
-_eventd_nd_draw_image_process(GdkPixbuf *pixbuf, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
+_eventd_nd_draw_image_process(cairo_surface_t *source, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
 {
     cairo_surface_t *image;
 
-    image = _eventd_nd_draw_limit_size(pixbuf, style, TRUE, max_draw_width);
+    image = _eventd_nd_draw_limit_size(source, style, TRUE, max_draw_width);
 
     *width = cairo_image_surface_get_width(image) + eventd_nd_style_get_image_margin(style);
     *height = cairo_image_surface_get_height(image);
@@ -428,12 +387,12 @@ _eventd_nd_draw_image_process(GdkPixbuf *pixbuf, EventdNdStyle *style, gint max_
 }
 
 static cairo_surface_t *
-_eventd_nd_draw_icon_process_overlay(GdkPixbuf *pixbuf, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
+_eventd_nd_draw_icon_process_overlay(cairo_surface_t *source, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
 {
     cairo_surface_t *icon;
     gint w, h;
 
-    icon = _eventd_nd_draw_limit_size(pixbuf, style, FALSE, max_draw_width);
+    icon = _eventd_nd_draw_limit_size(source, style, FALSE, max_draw_width);
 
     w = cairo_image_surface_get_width(icon);
     h = cairo_image_surface_get_height(icon);
@@ -445,11 +404,11 @@ _eventd_nd_draw_icon_process_overlay(GdkPixbuf *pixbuf, EventdNdStyle *style, gi
 }
 
 static cairo_surface_t *
-_eventd_nd_draw_icon_process_foreground(GdkPixbuf *pixbuf, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
+_eventd_nd_draw_icon_process_foreground(cairo_surface_t *source, EventdNdStyle *style, gint max_draw_width, gint *width, gint *height)
 {
     cairo_surface_t *icon;
 
-    icon = _eventd_nd_draw_limit_size(pixbuf, style, FALSE, max_draw_width);
+    icon = _eventd_nd_draw_limit_size(source, style, FALSE, max_draw_width);
 
     gint h;
 
@@ -461,11 +420,11 @@ _eventd_nd_draw_icon_process_foreground(GdkPixbuf *pixbuf, EventdNdStyle *style,
 }
 
 static cairo_surface_t *
-_eventd_nd_draw_icon_process_background(GdkPixbuf *pixbuf, EventdNdStyle *style, gint max_width, gint *width, gint *height)
+_eventd_nd_draw_icon_process_background(cairo_surface_t *source, EventdNdStyle *style, gint max_width, gint *width, gint *height)
 {
     cairo_surface_t *icon;
 
-    icon = _eventd_nd_draw_icon_process_foreground(pixbuf, style, max_width, width, height);
+    icon = _eventd_nd_draw_icon_process_foreground(source, style, max_width, width, height);
 
     *width -= cairo_image_surface_get_width(icon) * eventd_nd_style_get_icon_fade_width(style) / 4;
 
@@ -473,11 +432,12 @@ _eventd_nd_draw_icon_process_background(GdkPixbuf *pixbuf, EventdNdStyle *style,
 }
 
 void
-eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNdStyle *style, EventdEvent *event, gint max_width, gint scale, cairo_surface_t **image, cairo_surface_t **icon, gint *text_x, gint *width, gint *height)
+eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNdPixbufCache *image_cache, EventdNdStyle *style, EventdEvent *event, gint max_width, gint scale, cairo_surface_t **image, cairo_surface_t **icon, gint *text_x, gint *width, gint *height)
 {
     gint load_width, load_height;
-    GdkPixbuf *image_pixbuf = NULL;
-    GdkPixbuf *icon_pixbuf = NULL;
+    cairo_surface_t *image_surface = NULL;
+    cairo_surface_t *icon_surface = NULL;
+    GdkPixbuf *pixbuf;
     const Filename *image_filename = eventd_nd_style_get_template_image(style);
     const gchar *image_theme = eventd_nd_style_get_image_theme(style);
     const Filename *icon_filename = eventd_nd_style_get_template_icon(style);
@@ -489,13 +449,16 @@ eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNd
     switch ( evhelpers_filename_process(image_filename, event, "images", &uri, &data) )
     {
     case FILENAME_PROCESS_RESULT_URI:
-        image_pixbuf = eventd_nd_pixbuf_from_uri(uri, load_width, load_height, scale);
+        image_surface = eventd_nd_pixbuf_cache_from_uri(image_cache, uri, load_width, load_height, scale);
     break;
     case FILENAME_PROCESS_RESULT_DATA:
-        image_pixbuf = eventd_nd_pixbuf_from_data(data, load_width, load_height, scale);
+        pixbuf = eventd_nd_pixbuf_from_data(data, load_width, load_height, scale);
+        image_surface = _eventd_nd_draw_get_surface_from_pixbuf(pixbuf);
+        if ( pixbuf != NULL )
+            g_object_unref(pixbuf);
     break;
     case FILENAME_PROCESS_RESULT_THEME:
-        image_pixbuf = eventd_nd_pixbuf_from_theme(theme_context, image_theme, uri, MIN(load_width, load_height), scale);
+        image_surface = eventd_nd_pixbuf_cache_from_theme(image_cache, theme_context, image_theme, uri, MIN(load_width, load_height), scale);
     break;
     case FILENAME_PROCESS_RESULT_NONE:
     break;
@@ -505,13 +468,16 @@ eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNd
     switch ( evhelpers_filename_process(icon_filename, event, "icons", &uri, &data) )
     {
     case FILENAME_PROCESS_RESULT_URI:
-        icon_pixbuf = eventd_nd_pixbuf_from_uri(uri, load_width, load_height, scale);
+        icon_surface = eventd_nd_pixbuf_cache_from_uri(image_cache, uri, load_width, load_height, scale);
     break;
     case FILENAME_PROCESS_RESULT_DATA:
-        icon_pixbuf = eventd_nd_pixbuf_from_data(data, load_width, load_height, scale);
+        pixbuf = eventd_nd_pixbuf_from_data(data, load_width, load_height, scale);
+        icon_surface = _eventd_nd_draw_get_surface_from_pixbuf(pixbuf);
+        if ( pixbuf != NULL )
+            g_object_unref(pixbuf);
     break;
     case FILENAME_PROCESS_RESULT_THEME:
-        icon_pixbuf = eventd_nd_pixbuf_from_theme(theme_context, icon_theme, uri, MIN(load_width, load_height), scale);
+        icon_surface = eventd_nd_pixbuf_cache_from_theme(image_cache, theme_context, icon_theme, uri, MIN(load_width, load_height), scale);
     break;
     case FILENAME_PROCESS_RESULT_NONE:
     break;
@@ -523,45 +489,45 @@ eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNd
     switch ( eventd_nd_style_get_icon_placement(style) )
     {
     case EVENTD_ND_STYLE_ICON_PLACEMENT_BACKGROUND:
-        if ( image_pixbuf != NULL )
+        if ( image_surface != NULL )
         {
-            *image = _eventd_nd_draw_image_process(image_pixbuf, style, max_width, width, height);
+            *image = _eventd_nd_draw_image_process(image_surface, style, max_width, width, height);
             *text_x = *width;
             max_width -= *width;
         }
-        if ( ( icon_pixbuf != NULL ) && ( max_width > 0 ) )
-            *icon = _eventd_nd_draw_icon_process_background(icon_pixbuf, style, max_width, width, height);
+        if ( ( icon_surface != NULL ) && ( max_width > 0 ) )
+            *icon = _eventd_nd_draw_icon_process_background(icon_surface, style, max_width, width, height);
     break;
     case EVENTD_ND_STYLE_ICON_PLACEMENT_OVERLAY:
-        if ( ( image_pixbuf == NULL ) && ( icon_pixbuf != NULL ) )
+        if ( ( image_surface == NULL ) && ( icon_surface != NULL ) )
         {
-            image_pixbuf = icon_pixbuf;
-            icon_pixbuf = NULL;
+            image_surface = icon_surface;
+            icon_surface = NULL;
         }
-        if ( image_pixbuf != NULL )
+        if ( image_surface != NULL )
         {
-            *image = _eventd_nd_draw_image_process(image_pixbuf, style, max_width, width, height);
+            *image = _eventd_nd_draw_image_process(image_surface, style, max_width, width, height);
             max_width -= *width;
-            if ( ( icon_pixbuf != NULL ) && ( max_width > 0 ) )
-                *icon = _eventd_nd_draw_icon_process_overlay(icon_pixbuf, style, max_width, width, height);
+            if ( ( icon_surface != NULL ) && ( max_width > 0 ) )
+                *icon = _eventd_nd_draw_icon_process_overlay(icon_surface, style, max_width, width, height);
             *text_x = *width;
         }
     break;
     case EVENTD_ND_STYLE_ICON_PLACEMENT_FOREGROUND:
-        if ( image_pixbuf != NULL )
+        if ( image_surface != NULL )
         {
-            *image = _eventd_nd_draw_image_process(image_pixbuf, style, max_width, width, height);
+            *image = _eventd_nd_draw_image_process(image_surface, style, max_width, width, height);
             *text_x = *width;
             max_width -= *width;
         }
-        if ( ( icon_pixbuf != NULL ) && ( max_width > 0 ) )
-            *icon = _eventd_nd_draw_icon_process_foreground(icon_pixbuf, style, max_width, width, height);
+        if ( ( icon_surface != NULL ) && ( max_width > 0 ) )
+            *icon = _eventd_nd_draw_icon_process_foreground(icon_surface, style, max_width, width, height);
     break;
     }
-    if ( image_pixbuf != NULL )
-        g_object_unref(image_pixbuf);
-    if ( icon_pixbuf != NULL )
-        g_object_unref(icon_pixbuf);
+    if ( image_surface != NULL )
+        cairo_surface_destroy(image_surface);
+    if ( icon_surface != NULL )
+        cairo_surface_destroy(icon_surface);
 }
 
 
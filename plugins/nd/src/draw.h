@@ -25,8 +25,10 @@
 
 #include <nkutils-xdg-theme.h>
 
+EventdNdPixbufCache *eventd_nd_draw_image_cache_new(gsize max_size);
+
 PangoLayout *eventd_nd_draw_text_process(EventdNdStyle *style, EventdEvent *event, gint max_width, guint more_size, gint *text_width);
-void eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNdStyle *style, EventdEvent *event, gint max_width, gint scale, cairo_surface_t **image, cairo_surface_t **icon, gint *text_x, gint *width, gint *height);
+void eventd_nd_draw_image_and_icon_process(NkXdgThemeContext *theme_context, EventdNdPixbufCache *image_cache, EventdNdStyle *style, EventdEvent *event, gint max_width, gint scale, cairo_surface_t **image, cairo_surface_t **icon, gint *text_x, gint *width, gint *height);
 
 void eventd_nd_draw_bubble_shape(cairo_t *cr, EventdNdStyle *style, gint width, gint height);
 void eventd_nd_draw_bubble_draw(cairo_t *cr, EventdNdStyle *style, gint width, gint height, EventdNdShaping shaping, gdouble value);
@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include <gdk-pixbuf/gdk-pixbuf.h>
 #include <pango/pango.h>
 #include <cairo.h>
 
@@ -35,11 +36,14 @@
 #include "libeventd-helpers-config.h"
 
 #include <nkutils-enum.h>
+#include <nkutils-xdg-theme.h>
 
 #include "backend.h"
 #include "backends.h"
 #include "style.h"
 #include "cairo.h"
+#include "pixbuf.h"
+#include "draw.h"
 #include "notification.h"
 
 #include "nd.h"
@@ -242,6 +246,7 @@ _eventd_nd_init(EventdPluginCoreContext *core)
     }
 
     context->style = eventd_nd_style_new(NULL);
+    context->image_cache = eventd_nd_draw_image_cache_new(EVENTD_ND_IMAGE_CACHE_DEFAULT_SIZE);
 
     context->queues = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _eventd_nd_queue_free);
 
@@ -259,6 +264,7 @@ _eventd_nd_uninit(EventdPluginContext *context)
 
     g_hash_table_unref(context->queues);
 
+    eventd_nd_pixbuf_cache_free(context->image_cache);
     eventd_nd_style_free(context->style);
 
     g_free(context->last_target);
@@ -410,22 +416,23 @@ _eventd_nd_control_command(EventdPluginContext *context, guint64 argc, const gch
     }
     else if ( g_strcmp0(argv[0], "status") == 0 )
     {
+        GString *full_status;
         if ( context->backend == NULL )
         {
-            *status = g_strdup("No backend attached");
+            full_status = g_string_new("No backend attached");
             r = EVENTD_PLUGIN_COMMAND_STATUS_OK;
         }
         else
         {
-            GString *full_status;
             full_status = g_string_new("Backend attached: ");
             g_string_append(full_status, context->backend->name);
             if ( context->backend->status == NULL )
                 r = EVENTD_PLUGIN_COMMAND_STATUS_OK;
             else
                 r = context->backend->status(context->backend->context, full_status);
-            *status = g_string_free(full_status, FALSE);
         }
+        eventd_nd_pixbuf_cache_status(context->image_cache, full_status);
+        *status = g_string_free(full_status, FALSE);
 
     }
     else
@@ -481,6 +488,14 @@ _eventd_nd_global_parse(EventdPluginContext *context, GKeyFile *config_file)
         }
     }
 
+    if ( g_key_file_has_group(config_file, "NotificationImageCache") )
+    {
+        Int size;
+
+        if ( evhelpers_config_key_file_get_int(config_file, "NotificationImageCache", "MaxSize", &size) == 0 )
+            eventd_nd_pixbuf_cache_set_max_size(context->image_cache, MAX(size.value, 0) * 1024);
+    }
+
     gchar **groups, **group;
     groups = g_key_file_get_groups(config_file, NULL);
     if ( groups == NULL )
@@ -580,6 +595,9 @@ _eventd_nd_config_reset(EventdPluginContext *context)
 
     eventd_nd_style_free(context->style);
     context->style = eventd_nd_style_new(NULL);
+
+    eventd_nd_pixbuf_cache_clear(context->image_cache);
+    eventd_nd_pixbuf_cache_set_max_size(context->image_cache, EVENTD_ND_IMAGE_CACHE_DEFAULT_SIZE);
 }
 
 
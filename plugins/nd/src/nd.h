@@ -26,6 +26,8 @@
 #include "types.h"
 #include <nkutils-xdg-theme.h>
 
+#define EVENTD_ND_IMAGE_CACHE_DEFAULT_SIZE (16 * 1024 * 1024)
+
 struct _EventdNdQueue {
     EventdNdAnchor anchor;
     guint64 limit;
@@ -50,6 +52,7 @@ struct _EventdPluginContext {
     EventdNdStyle *style;
     EventdNdBackends last_backend;
     NkXdgThemeContext *theme_context;
+    EventdNdPixbufCache *image_cache;
     gchar *last_target;
     struct {
         gint x;
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include <nkutils-xdg-theme.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include <cairo.h>
@@ -37,6 +38,7 @@
 
 #include "backend.h"
 #include "style.h"
+#include "pixbuf.h"
 #include "draw.h"
 #include "nd.h"
 
@@ -190,7 +192,7 @@ _eventd_nd_notification_process(EventdNdNotification *self, EventdEvent *event)
     if ( self->content_size.width < max_width )
     {
         if ( self->event != NULL )
-            eventd_nd_draw_image_and_icon_process(self->context->theme_context, self->style, self->event, max_width - self->content_size.width, self->context->geometry.s, &self->image, &self->icon, &self->text.x, &image_width, &image_height);
+            eventd_nd_draw_image_and_icon_process(self->context->theme_context, self->context->image_cache, self->style, self->event, max_width - self->content_size.width, self->context->geometry.s, &self->image, &self->icon, &self->text.x, &image_width, &image_height);
         self->content_size.width += image_width;
     }
 
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
 
 #include <nkutils-xdg-theme.h>
@@ -32,6 +33,32 @@
 
 #include "libeventd-event.h"
 
+#include "pixbuf.h"
+
+struct _EventdNdPixbufCache {
+    gsize max_size;
+    gsize size;
+    EventdNdPixbufCacheConvertFunc convert;
+    GBoxedCopyFunc ref;
+    GDestroyNotify unref;
+    GHashTable *entries;
+    GQueue lru;
+    guint64 hits;
+    guint64 misses;
+    guint64 invalidations;
+    guint64 evictions;
+};
+
+typedef struct {
+    GList link;
+    gchar *key;
+    gchar *path;
+    gint64 mtime;
+    goffset file_size;
+    gpointer value;
+    gsize size;
+} EventdNdPixbufCacheEntry;
+
 
 static GdkPixbuf *
 _eventd_nd_pixbuf_from_file(const gchar *path, gint width, gint height)
@@ -55,17 +82,6 @@ _eventd_nd_pixbuf_from_file(const gchar *path, gint width, gint height)
     return pixbuf;
 }
 
-GdkPixbuf *
-eventd_nd_pixbuf_from_uri(gchar *uri, gint width, gint height, gint scale)
-{
-    GdkPixbuf *pixbuf = NULL;
-    if ( g_str_has_prefix(uri, "file://") )
-        pixbuf = _eventd_nd_pixbuf_from_file(uri + strlen("file://"), width * scale, height * scale);
-    g_free(uri);
-
-    return pixbuf;
-}
-
 static void
 _eventd_nd_pixbuf_data_free(guchar *pixels, gpointer data)
 {
@@ -179,20 +195,24 @@ end:
     return pixbuf;
 }
 
-GdkPixbuf *
-eventd_nd_pixbuf_from_theme(NkXdgThemeContext *context, const gchar *theme, gchar *uri, gint size, gint scale)
+/*
+ * uri is "theme:[theme/]name", the explicit theme taking precedence
+ * Returns the icon file path, %NULL if not found
+ */
+static gchar *
+_eventd_nd_pixbuf_theme_lookup(NkXdgThemeContext *context, const gchar *theme, const gchar *uri, gint size, gint scale)
 {
-    GdkPixbuf *pixbuf = NULL;
     gsize i = 0;
     const gchar *themes[] = { NULL, NULL, NULL };
     const gchar *name = uri + strlen("theme:");
+    gchar *uri_theme = NULL;
     gchar *file;
 
-    gchar *c;
+    const gchar *c;
     if ( ( c = g_utf8_strchr(name, -1, '/') ) != NULL )
     {
-        *c = '\0';
-        themes[i++] = name;
+        uri_theme = g_strndup(name, c - name);
+        themes[i++] = uri_theme;
         name = ++c;
     }
 
@@ -200,10 +220,184 @@ eventd_nd_pixbuf_from_theme(NkXdgThemeContext *context, const gchar *theme, gcha
         themes[i++] = theme;
 
     file = nk_xdg_theme_get_icon(context, themes, NULL, name, size, scale, TRUE);
+    g_free(uri_theme);
+
+    return file;
+}
+
+static void
+_eventd_nd_pixbuf_cache_entry_free(gpointer data)
+{
+    EventdNdPixbufCacheEntry *entry = data;
+
+    g_free(entry->path);
+    g_free(entry->key);
+
+    g_slice_free(EventdNdPixbufCacheEntry, entry);
+}
+
+EventdNdPixbufCache *
+eventd_nd_pixbuf_cache_new(gsize max_size, EventdNdPixbufCacheConvertFunc convert, GBoxedCopyFunc ref, GDestroyNotify unref)
+{
+    EventdNdPixbufCache *self;
+
+    self = g_slice_new0(EventdNdPixbufCache);
+    self->max_size = max_size;
+    self->convert = convert;
+    self->ref = ref;
+    self->unref = unref;
+
+    self->entries = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return self;
+}
+
+static void
+_eventd_nd_pixbuf_cache_remove(EventdNdPixbufCache *self, EventdNdPixbufCacheEntry *entry)
+{
+    g_hash_table_remove(self->entries, entry->key);
+    g_queue_unlink(&self->lru, &entry->link);
+    self->size -= entry->size;
+
+    self->unref(entry->value);
+    _eventd_nd_pixbuf_cache_entry_free(entry);
+}
+
+static void
+_eventd_nd_pixbuf_cache_trim(EventdNdPixbufCache *self)
+{
+    while ( self->size > self->max_size )
+    {
+        _eventd_nd_pixbuf_cache_remove(self, g_queue_peek_tail(&self->lru));
+        ++self->evictions;
+    }
+}
+
+void
+eventd_nd_pixbuf_cache_clear(EventdNdPixbufCache *self)
+{
+    while ( ! g_queue_is_empty(&self->lru) )
+        _eventd_nd_pixbuf_cache_remove(self, g_queue_peek_head(&self->lru));
+}
+
+void
+eventd_nd_pixbuf_cache_free(EventdNdPixbufCache *self)
+{
+    if ( self == NULL )
+        return;
+
+    eventd_nd_pixbuf_cache_clear(self);
+    g_hash_table_unref(self->entries);
+
+    g_slice_free(EventdNdPixbufCache, self);
+}
+
+void
+eventd_nd_pixbuf_cache_set_max_size(EventdNdPixbufCache *self, gsize max_size)
+{
+    self->max_size = max_size;
+    _eventd_nd_pixbuf_cache_trim(self);
+}
+
+static gpointer
+_eventd_nd_pixbuf_cache_get(EventdNdPixbufCache *self, gchar *key, const gchar *path, gint width, gint height)
+{
+    EventdNdPixbufCacheEntry *entry;
+    GStatBuf st;
+    gboolean has_stat;
+
+    has_stat = ( g_stat(path, &st) == 0 );
+
+    entry = g_hash_table_lookup(self->entries, key);
+    if ( entry != NULL )
+    {
+        if ( has_stat && ( g_strcmp0(entry->path, path) == 0 ) && ( entry->mtime == st.st_mtime ) && ( entry->file_size == st.st_size ) )
+        {
+            ++self->hits;
+            g_free(key);
+            g_queue_unlink(&self->lru, &entry->link);
+            g_queue_push_head_link(&self->lru, &entry->link);
+            return self->ref(entry->value);
+        }
+
+        /* The file changed (or vanished) under us */
+        ++self->invalidations;
+        _eventd_nd_pixbuf_cache_remove(self, entry);
+    }
+    ++self->misses;
+
+    GdkPixbuf *pixbuf;
+    gpointer value;
+    gsize size;
+
+    pixbuf = _eventd_nd_pixbuf_from_file(path, width, height);
+    if ( pixbuf == NULL )
+    {
+        g_free(key);
+        return NULL;
+    }
+
+    value = self->convert(pixbuf, &size);
+    g_object_unref(pixbuf);
+
+    if ( ( ! has_stat ) || ( size > self->max_size ) )
+    {
+        g_free(key);
+        return value;
+    }
+
+    entry = g_slice_new0(EventdNdPixbufCacheEntry);
+    entry->link.data = entry;
+    entry->key = key;
+    entry->path = g_strdup(path);
+    entry->mtime = st.st_mtime;
+    entry->file_size = st.st_size;
+    entry->value = self->ref(value);
+    entry->size = size;
+
+    g_hash_table_insert(self->entries, entry->key, entry);
+    g_queue_push_head_link(&self->lru, &entry->link);
+    self->size += size;
+    _eventd_nd_pixbuf_cache_trim(self);
+
+    return value;
+}
+
+gpointer
+eventd_nd_pixbuf_cache_from_uri(EventdNdPixbufCache *self, gchar *uri, gint width, gint height, gint scale)
+{
+    gpointer value = NULL;
+    if ( g_str_has_prefix(uri, "file://") )
+    {
+        const gchar *path = uri + strlen("file://");
+        value = _eventd_nd_pixbuf_cache_get(self, g_strdup_printf("%d %d %d %s", width, height, scale, path), path, width * scale, height * scale);
+    }
+    g_free(uri);
+
+    return value;
+}
+
+gpointer
+eventd_nd_pixbuf_cache_from_theme(EventdNdPixbufCache *self, NkXdgThemeContext *context, const gchar *theme, gchar *uri, gint size, gint scale)
+{
+    gpointer value = NULL;
+    gchar *file;
+
+    file = _eventd_nd_pixbuf_theme_lookup(context, theme, uri, size, scale);
     if ( file != NULL )
-        pixbuf = _eventd_nd_pixbuf_from_file(file, size * scale, size * scale);
+        value = _eventd_nd_pixbuf_cache_get(self, g_strdup_printf("%d %d %s %s", size, scale, ( theme != NULL ) ? theme : "", uri + strlen("theme:")), file, size * scale, size * scale);
     g_free(file);
     g_free(uri);
 
-    return pixbuf;
+    return value;
+}
+
+void
+eventd_nd_pixbuf_cache_status(EventdNdPixbufCache *self, GString *status)
+{
+    guint64 lookups = self->hits + self->misses;
+
+    g_string_append_printf(status, "\nImage cache: %u entries, %" G_GSIZE_FORMAT "/%" G_GSIZE_FORMAT " bytes", g_hash_table_size(self->entries), self->size, self->max_size);
+    g_string_append_printf(status, "\n    hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT " (hit rate: %.1f%%)", self->hits, self->misses, ( lookups > 0 ) ? ( 100. * (gdouble) self->hits / (gdouble) lookups ) : 0.);
+    g_string_append_printf(status, "\n    invalidations: %" G_GUINT64_FORMAT ", evictions: %" G_GUINT64_FORMAT, self->invalidations, self->evictions);
 }
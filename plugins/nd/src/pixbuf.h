@@ -27,8 +27,17 @@
 static inline const guchar *gdk_pixbuf_read_pixels(GdkPixbuf *pixbuf) { return gdk_pixbuf_get_pixels(pixbuf); }
 #endif /* gdk-pixbux < 2.32 */
 
-GdkPixbuf *eventd_nd_pixbuf_from_uri(gchar *uri, gint width, gint height, gint scale);
 GdkPixbuf *eventd_nd_pixbuf_from_data(GVariant *data, gint width, gint height, gint scale);
-GdkPixbuf *eventd_nd_pixbuf_from_theme(NkXdgThemeContext *context, const gchar *theme, gchar *uri, gint size, gint scale);
+
+typedef struct _EventdNdPixbufCache EventdNdPixbufCache;
+typedef gpointer (*EventdNdPixbufCacheConvertFunc)(GdkPixbuf *pixbuf, gsize *size);
+
+EventdNdPixbufCache *eventd_nd_pixbuf_cache_new(gsize max_size, EventdNdPixbufCacheConvertFunc convert, GBoxedCopyFunc ref, GDestroyNotify unref);
+void eventd_nd_pixbuf_cache_free(EventdNdPixbufCache *cache);
+void eventd_nd_pixbuf_cache_set_max_size(EventdNdPixbufCache *cache, gsize max_size);
+void eventd_nd_pixbuf_cache_clear(EventdNdPixbufCache *cache);
+gpointer eventd_nd_pixbuf_cache_from_uri(EventdNdPixbufCache *cache, gchar *uri, gint width, gint height, gint scale);
+gpointer eventd_nd_pixbuf_cache_from_theme(EventdNdPixbufCache *cache, NkXdgThemeContext *context, const gchar *theme, gchar *uri, gint size, gint scale);
+void eventd_nd_pixbuf_cache_status(EventdNdPixbufCache *cache, GString *status);
 
 #endif /* __EVENTD_ND_PIXBUF_H__ */
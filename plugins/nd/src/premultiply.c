@@ -0,0 +1,289 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define EVENTD_ND_DRAW_PREMULTIPLY_X86 1
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 */
+
+#include "premultiply.h"
+
+/*
+ * All implementations convert one row of RGB or RGBA pixels
+ * to native-endian premultiplied ARGB32, as cairo wants it.
+ * They must stay bit-exact with the scalar one.
+ */
+
+typedef void (*EventdNdDrawPremultiplyFunc)(guint32 *dest, const guchar *src, gsize width);
+
+const gchar * const eventd_nd_draw_premultiply_impl_names[_EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE] = {
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SCALAR] = "scalar",
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SSE2] = "sse2",
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_AVX2] = "avx2",
+};
+
+/*
+ * alpha_mult is inspired by gdk_cairo_set_source_pixbuf
+ * GDK is:
+ *     Copyright (C) 2011-2024 Red Hat, Inc.
+ */
+static inline guchar
+alpha_mult(guchar c, guchar a)
+{
+    guint16 t;
+    switch ( a )
+    {
+    case 0xff:
+        return c;
+    case 0x00:
+        return 0x00;
+    default:
+        t = c * a + 0x7f;
+        return ((t >> 8) + t) >> 8;
+    }
+}
+
+static void
+_eventd_nd_draw_premultiply_rgb_scalar(guint32 *dest, const guchar *src, gsize width)
+{
+    const guchar *end = src + width * 3;
+
+    for ( ; src < end ; src += 3 )
+        *dest++ = 0xff000000 | ( src[0] << 16 ) | ( src[1] << 8 ) | src[2];
+}
+
+static void
+_eventd_nd_draw_premultiply_rgba_scalar(guint32 *dest, const guchar *src, gsize width)
+{
+    const guchar *end = src + width * 4;
+    guchar a;
+
+    for ( ; src < end ; src += 4 )
+    {
+        a = src[3];
+        *dest++ = ( (guint32) a << 24 ) | ( alpha_mult(src[0], a) << 16 ) | ( alpha_mult(src[1], a) << 8 ) | alpha_mult(src[2], a);
+    }
+}
+
+#ifdef EVENTD_ND_DRAW_PREMULTIPLY_X86
+
+/*
+ * The SIMD versions use the same rounded division by 255 as alpha_mult,
+ * without the special cases which it gives the same result for.
+ * Every channel is widened to 16 bits: c * a + 0x7f fits.
+ *
+ * Vector loops only read bytes that belong to the row,
+ * the scalar versions take care of the remaining pixels.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i
+_eventd_nd_draw_premultiply_sse2_mult(__m128i v, __m128i round, __m128i alpha_mask)
+{
+    __m128i a, t;
+
+    /* RGBA to BGRA, which is ARGB32 in little-endian */
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+
+    a = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+
+    t = _mm_add_epi16(_mm_mullo_epi16(v, a), round);
+    t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+    return _mm_or_si128(_mm_andnot_si128(alpha_mask, t), _mm_and_si128(alpha_mask, v));
+}
+
+__attribute__((target("sse2")))
+static void
+_eventd_nd_draw_premultiply_rgba_sse2(guint32 *dest, const guchar *src, gsize width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(0x7f);
+    const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    gsize i;
+
+    for ( i = 0 ; i + 4 <= width ; i += 4, src += 16 )
+    {
+        __m128i px, lo, hi;
+
+        px = _mm_loadu_si128((const __m128i *) src);
+        lo = _eventd_nd_draw_premultiply_sse2_mult(_mm_unpacklo_epi8(px, zero), round, alpha_mask);
+        hi = _eventd_nd_draw_premultiply_sse2_mult(_mm_unpackhi_epi8(px, zero), round, alpha_mask);
+        _mm_storeu_si128((__m128i *) ( dest + i ), _mm_packus_epi16(lo, hi));
+    }
+
+    _eventd_nd_draw_premultiply_rgba_scalar(dest + i, src, width - i);
+}
+
+__attribute__((target("sse2")))
+static void
+_eventd_nd_draw_premultiply_rgb_sse2(guint32 *dest, const guchar *src, gsize width)
+{
+    const __m128i alpha = _mm_set1_epi32((gint32) 0xff000000);
+    const __m128i low_mask = _mm_set1_epi32(0xff);
+    const __m128i green_mask = _mm_set1_epi32(0xff00);
+    gsize i;
+
+    /* We load 16 bytes for 4 pixels, so keep 6 pixels ahead */
+    for ( i = 0 ; i + 6 <= width ; i += 4, src += 12 )
+    {
+        __m128i px, v;
+
+        px = _mm_loadu_si128((const __m128i *) src);
+        v = _mm_unpacklo_epi64(
+            _mm_unpacklo_epi32(px, _mm_srli_si128(px, 3)),
+            _mm_unpacklo_epi32(_mm_srli_si128(px, 6), _mm_srli_si128(px, 9))
+        );
+
+        v = _mm_or_si128(
+            _mm_or_si128(alpha, _mm_slli_epi32(_mm_and_si128(v, low_mask), 16)),
+            _mm_or_si128(_mm_and_si128(v, green_mask), _mm_and_si128(_mm_srli_epi32(v, 16), low_mask))
+        );
+        _mm_storeu_si128((__m128i *) ( dest + i ), v);
+    }
+
+    _eventd_nd_draw_premultiply_rgb_scalar(dest + i, src, width - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+_eventd_nd_draw_premultiply_avx2_mult(__m256i v, __m256i round, __m256i alpha_mask)
+{
+    __m256i a, t;
+
+    v = _mm256_shufflelo_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+    v = _mm256_shufflehi_epi16(v, _MM_SHUFFLE(3, 0, 1, 2));
+
+    a = _mm256_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+
+    t = _mm256_add_epi16(_mm256_mullo_epi16(v, a), round);
+    t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+
+    return _mm256_blendv_epi8(t, v, alpha_mask);
+}
+
+__attribute__((target("avx2")))
+static void
+_eventd_nd_draw_premultiply_rgba_avx2(guint32 *dest, const guchar *src, gsize width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi16(0x7f);
+    const __m256i alpha_mask = _mm256_set1_epi64x((gint64) 0xffff000000000000);
+    gsize i;
+
+    /* Unpacking and packing both work per 128-bit lane, so pixels stay in order */
+    for ( i = 0 ; i + 8 <= width ; i += 8, src += 32 )
+    {
+        __m256i px, lo, hi;
+
+        px = _mm256_loadu_si256((const __m256i *) src);
+        lo = _eventd_nd_draw_premultiply_avx2_mult(_mm256_unpacklo_epi8(px, zero), round, alpha_mask);
+        hi = _eventd_nd_draw_premultiply_avx2_mult(_mm256_unpackhi_epi8(px, zero), round, alpha_mask);
+        _mm256_storeu_si256((__m256i *) ( dest + i ), _mm256_packus_epi16(lo, hi));
+    }
+
+    _eventd_nd_draw_premultiply_rgba_sse2(dest + i, src, width - i);
+}
+
+__attribute__((target("avx2")))
+static void
+_eventd_nd_draw_premultiply_rgb_avx2(guint32 *dest, const guchar *src, gsize width)
+{
+    const __m256i alpha = _mm256_set1_epi32((gint32) 0xff000000);
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+    );
+    gsize i;
+
+    /* We load 28 bytes for 8 pixels, so keep 10 pixels ahead */
+    for ( i = 0 ; i + 10 <= width ; i += 8, src += 24 )
+    {
+        __m256i px;
+
+        px = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) src)), _mm_loadu_si128((const __m128i *) ( src + 12 )), 1);
+        _mm256_storeu_si256((__m256i *) ( dest + i ), _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), alpha));
+    }
+
+    _eventd_nd_draw_premultiply_rgb_sse2(dest + i, src, width - i);
+}
+
+#endif /* EVENTD_ND_DRAW_PREMULTIPLY_X86 */
+
+static const EventdNdDrawPremultiplyFunc _eventd_nd_draw_premultiply_funcs[_EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE][2] = {
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SCALAR] = { _eventd_nd_draw_premultiply_rgb_scalar, _eventd_nd_draw_premultiply_rgba_scalar },
+#ifdef EVENTD_ND_DRAW_PREMULTIPLY_X86
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SSE2] = { _eventd_nd_draw_premultiply_rgb_sse2, _eventd_nd_draw_premultiply_rgba_sse2 },
+    [EVENTD_ND_DRAW_PREMULTIPLY_IMPL_AVX2] = { _eventd_nd_draw_premultiply_rgb_avx2, _eventd_nd_draw_premultiply_rgba_avx2 },
+#endif /* EVENTD_ND_DRAW_PREMULTIPLY_X86 */
+};
+
+gboolean
+eventd_nd_draw_premultiply_impl_supported(EventdNdDrawPremultiplyImpl impl)
+{
+    switch ( impl )
+    {
+    case EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SCALAR:
+        return TRUE;
+#ifdef EVENTD_ND_DRAW_PREMULTIPLY_X86
+    case EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case EVENTD_ND_DRAW_PREMULTIPLY_IMPL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif /* EVENTD_ND_DRAW_PREMULTIPLY_X86 */
+    default:
+        return FALSE;
+    }
+}
+
+void
+eventd_nd_draw_premultiply_impl(EventdNdDrawPremultiplyImpl impl, guint32 *dest, const guchar *src, gsize width, gboolean alpha)
+{
+    g_return_if_fail(eventd_nd_draw_premultiply_impl_supported(impl));
+
+    _eventd_nd_draw_premultiply_funcs[impl][alpha ? 1 : 0](dest, src, width);
+}
+
+void
+eventd_nd_draw_premultiply(guint32 *dest, const guchar *src, gsize width, gboolean alpha)
+{
+    static gsize best = 0;
+
+    if ( g_once_init_enter(&best) )
+    {
+        EventdNdDrawPremultiplyImpl impl = _EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE;
+        while ( ! eventd_nd_draw_premultiply_impl_supported(--impl) );
+        /* Stored shifted so that 0 still means "not initialized" */
+        g_once_init_leave(&best, impl + 1);
+    }
+
+    _eventd_nd_draw_premultiply_funcs[best - 1][alpha ? 1 : 0](dest, src, width);
+}
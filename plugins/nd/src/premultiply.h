@@ -0,0 +1,39 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_ND_DRAW_PREMULTIPLY_H__
+#define __EVENTD_ND_DRAW_PREMULTIPLY_H__
+
+typedef enum {
+    EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SCALAR,
+    EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SSE2,
+    EVENTD_ND_DRAW_PREMULTIPLY_IMPL_AVX2,
+    _EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE
+} EventdNdDrawPremultiplyImpl;
+
+extern const gchar * const eventd_nd_draw_premultiply_impl_names[_EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE];
+
+gboolean eventd_nd_draw_premultiply_impl_supported(EventdNdDrawPremultiplyImpl impl);
+void eventd_nd_draw_premultiply_impl(EventdNdDrawPremultiplyImpl impl, guint32 *dest, const guchar *src, gsize width, gboolean alpha);
+void eventd_nd_draw_premultiply(guint32 *dest, const guchar *src, gsize width, gboolean alpha);
+
+#endif /* __EVENTD_ND_DRAW_PREMULTIPLY_H__ */
@@ -0,0 +1,107 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "premultiply.h"
+
+#define WIDTH 1024
+#define HEIGHT 1024
+#define ROUNDS 20
+
+typedef struct {
+    EventdNdDrawPremultiplyImpl impl;
+    gboolean alpha;
+} EventdNdDrawPremultiplyBenchmarkData;
+
+static void
+_eventd_nd_draw_premultiply_benchmark_func(gconstpointer user_data)
+{
+    const EventdNdDrawPremultiplyBenchmarkData *data = user_data;
+    gsize stride = WIDTH * ( data->alpha ? 4 : 3 );
+    guchar *pixels;
+    guint32 *surface;
+    GRand *rand;
+    gdouble elapsed;
+    guint r, y;
+    gsize i;
+
+    if ( ! eventd_nd_draw_premultiply_impl_supported(data->impl) )
+    {
+        g_test_skip("Not supported on this CPU");
+        return;
+    }
+
+    pixels = g_new(guchar, stride * HEIGHT);
+    surface = g_new(guint32, WIDTH * HEIGHT);
+
+    rand = g_rand_new_with_seed(WIDTH);
+    for ( i = 0 ; i < stride * HEIGHT ; ++i )
+        pixels[i] = g_rand_int_range(rand, 0, 256);
+    g_rand_free(rand);
+
+    g_test_timer_start();
+    for ( r = 0 ; r < ROUNDS ; ++r )
+    {
+        for ( y = 0 ; y < HEIGHT ; ++y )
+            eventd_nd_draw_premultiply_impl(data->impl, surface + y * WIDTH, pixels + y * stride, WIDTH, data->alpha);
+    }
+    elapsed = g_test_timer_elapsed();
+
+    g_test_message("%s %s: %.3f ms/image, %.1f Mpixels/s", eventd_nd_draw_premultiply_impl_names[data->impl], data->alpha ? "RGBA" : "RGB", elapsed * 1e3 / ROUNDS, ( (gdouble) WIDTH * HEIGHT * ROUNDS ) / ( elapsed * 1e6 ));
+    g_test_maximized_result(( (gdouble) WIDTH * HEIGHT * ROUNDS ) / ( elapsed * 1e6 ), "%s %s: %.1f Mpixels/s", eventd_nd_draw_premultiply_impl_names[data->impl], data->alpha ? "RGBA" : "RGB", ( (gdouble) WIDTH * HEIGHT * ROUNDS ) / ( elapsed * 1e6 ));
+
+    g_free(surface);
+    g_free(pixels);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static EventdNdDrawPremultiplyBenchmarkData data[_EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE * 2];
+
+    setlocale(LC_ALL, "C");
+
+    g_test_init(&argc, &argv, NULL);
+
+    EventdNdDrawPremultiplyImpl impl;
+    for ( impl = 0 ; impl < _EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE ; ++impl )
+    {
+        gchar *path;
+
+        data[impl * 2] = (EventdNdDrawPremultiplyBenchmarkData) { .impl = impl, .alpha = FALSE };
+        path = g_strdup_printf("/nd/premultiply/benchmark/%s/rgb", eventd_nd_draw_premultiply_impl_names[impl]);
+        g_test_add_data_func(path, &data[impl * 2], _eventd_nd_draw_premultiply_benchmark_func);
+        g_free(path);
+
+        data[impl * 2 + 1] = (EventdNdDrawPremultiplyBenchmarkData) { .impl = impl, .alpha = TRUE };
+        path = g_strdup_printf("/nd/premultiply/benchmark/%s/rgba", eventd_nd_draw_premultiply_impl_names[impl]);
+        g_test_add_data_func(path, &data[impl * 2 + 1], _eventd_nd_draw_premultiply_benchmark_func);
+        g_free(path);
+    }
+
+    return g_test_run();
+}
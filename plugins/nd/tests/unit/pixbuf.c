@@ -0,0 +1,268 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib-object.h>
+
+#include <nkutils-xdg-theme.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "pixbuf.h"
+
+/* A 8x8 image is 256 bytes once converted */
+#define IMAGE_SIZE 8
+#define IMAGE_BYTES ( IMAGE_SIZE * IMAGE_SIZE * 4 )
+
+typedef struct {
+    gchar *dir;
+    EventdNdPixbufCache *cache;
+} EventdNdPixbufCacheTestFixture;
+
+static gpointer
+_eventd_nd_pixbuf_tests_convert(GdkPixbuf *pixbuf, gsize *size)
+{
+    *size = gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+    return g_object_ref(pixbuf);
+}
+
+static void
+_eventd_nd_pixbuf_tests_write(EventdNdPixbufCacheTestFixture *fixture, const gchar *name, gint size)
+{
+    GdkPixbuf *pixbuf;
+    gchar *path;
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+    gdk_pixbuf_fill(pixbuf, 0xff0000ff);
+
+    path = g_build_filename(fixture->dir, name, NULL);
+    g_assert_true(gdk_pixbuf_save(pixbuf, path, "png", NULL, NULL));
+    g_free(path);
+
+    g_object_unref(pixbuf);
+}
+
+static gpointer
+_eventd_nd_pixbuf_tests_get(EventdNdPixbufCacheTestFixture *fixture, const gchar *name)
+{
+    gchar *uri;
+
+    uri = g_strdup_printf("file://%s/%s", fixture->dir, name);
+    return eventd_nd_pixbuf_cache_from_uri(fixture->cache, uri, IMAGE_SIZE, IMAGE_SIZE, 1);
+}
+
+static void
+_eventd_nd_pixbuf_tests_assert_status(EventdNdPixbufCacheTestFixture *fixture, const gchar *expected)
+{
+    GString *status;
+
+    status = g_string_new(NULL);
+    eventd_nd_pixbuf_cache_status(fixture->cache, status);
+    if ( strstr(status->str, expected) == NULL )
+        g_error("Status '%s' does not contain '%s'", status->str, expected);
+    g_string_free(status, TRUE);
+}
+
+static void
+_init_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+    gsize max_size = GPOINTER_TO_SIZE(user_data);
+
+    fixture->dir = g_dir_make_tmp("eventd-nd-pixbuf-XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+
+    _eventd_nd_pixbuf_tests_write(fixture, "a.png", IMAGE_SIZE);
+    _eventd_nd_pixbuf_tests_write(fixture, "b.png", IMAGE_SIZE);
+    _eventd_nd_pixbuf_tests_write(fixture, "c.png", IMAGE_SIZE);
+
+    fixture->cache = eventd_nd_pixbuf_cache_new(max_size, _eventd_nd_pixbuf_tests_convert, g_object_ref, g_object_unref);
+}
+
+static void
+_clean_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+    const gchar *name;
+    GDir *dir;
+
+    eventd_nd_pixbuf_cache_free(fixture->cache);
+
+    dir = g_dir_open(fixture->dir, 0, NULL);
+    g_assert_nonnull(dir);
+    while ( ( name = g_dir_read_name(dir) ) != NULL )
+    {
+        gchar *path;
+
+        path = g_build_filename(fixture->dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    g_rmdir(fixture->dir);
+    g_free(fixture->dir);
+}
+
+static void
+_eventd_nd_pixbuf_tests_hit(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+    GdkPixbuf *first, *second;
+
+    first = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(first);
+    second = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_true(first == second);
+
+    g_object_unref(second);
+    g_object_unref(first);
+
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 1 entries, 256/1024 bytes");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 1, misses: 1 (hit rate: 50.0%)");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "invalidations: 0, evictions: 0");
+}
+
+static void
+_eventd_nd_pixbuf_tests_invalidation(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+    GdkPixbuf *first, *second;
+    GStatBuf st;
+    GUtimbuf times;
+    goffset size;
+    gchar *path;
+
+    path = g_build_filename(fixture->dir, "a.png", NULL);
+    g_assert_cmpint(g_stat(path, &st), ==, 0);
+    size = st.st_size;
+
+    first = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(first);
+
+    /* A different image gives a different file size */
+    _eventd_nd_pixbuf_tests_write(fixture, "a.png", IMAGE_SIZE / 2);
+    g_assert_cmpint(g_stat(path, &st), ==, 0);
+    g_assert_cmpint(st.st_size, !=, size);
+    second = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(second);
+    g_assert_true(first != second);
+    g_object_unref(second);
+
+    /* Same size, different mtime */
+    times.actime = st.st_atime;
+    times.modtime = st.st_mtime - 10;
+    g_assert_cmpint(g_utime(path, &times), ==, 0);
+    g_free(path);
+
+    second = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(second);
+    g_object_unref(second);
+
+    g_object_unref(first);
+
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 1 entries");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 0, misses: 3");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "invalidations: 2, evictions: 0");
+}
+
+static void
+_eventd_nd_pixbuf_tests_eviction(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "a.png"));
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "b.png"));
+    /* Touch "a" so "b" is the least recently used */
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "a.png"));
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "c.png"));
+
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 2 entries, 512/512 bytes");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 1, misses: 3");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "evictions: 1");
+
+    /* "a" survived, "b" did not */
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "a.png"));
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 2, misses: 3");
+    g_object_unref(_eventd_nd_pixbuf_tests_get(fixture, "b.png"));
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 2, misses: 4");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "evictions: 2");
+
+    /* Shrinking evicts too */
+    eventd_nd_pixbuf_cache_set_max_size(fixture->cache, IMAGE_BYTES);
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 1 entries, 256/256 bytes");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "evictions: 3");
+}
+
+static void
+_eventd_nd_pixbuf_tests_disabled(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+    GdkPixbuf *first, *second;
+
+    first = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(first);
+    second = _eventd_nd_pixbuf_tests_get(fixture, "a.png");
+    g_assert_nonnull(second);
+    g_assert_true(first != second);
+
+    g_object_unref(second);
+    g_object_unref(first);
+
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 0 entries, 0/0 bytes");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 0, misses: 2 (hit rate: 0.0%)");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "invalidations: 0, evictions: 0");
+}
+
+static void
+_eventd_nd_pixbuf_tests_missing(gpointer fixture_, gconstpointer user_data)
+{
+    EventdNdPixbufCacheTestFixture *fixture = fixture_;
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Couldn't load file*");
+    g_assert_null(_eventd_nd_pixbuf_tests_get(fixture, "missing.png"));
+    g_test_assert_expected_messages();
+
+    g_assert_null(eventd_nd_pixbuf_cache_from_uri(fixture->cache, g_strdup("http://example.com/a.png"), IMAGE_SIZE, IMAGE_SIZE, 1));
+
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "Image cache: 0 entries, 0/1024 bytes");
+    _eventd_nd_pixbuf_tests_assert_status(fixture, "hits: 0, misses: 1");
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/nd/pixbuf/cache/hit", EventdNdPixbufCacheTestFixture, GSIZE_TO_POINTER(4 * IMAGE_BYTES), _init_data, _eventd_nd_pixbuf_tests_hit, _clean_data);
+    g_test_add("/nd/pixbuf/cache/invalidation", EventdNdPixbufCacheTestFixture, GSIZE_TO_POINTER(4 * IMAGE_BYTES), _init_data, _eventd_nd_pixbuf_tests_invalidation, _clean_data);
+    g_test_add("/nd/pixbuf/cache/eviction", EventdNdPixbufCacheTestFixture, GSIZE_TO_POINTER(2 * IMAGE_BYTES), _init_data, _eventd_nd_pixbuf_tests_eviction, _clean_data);
+    g_test_add("/nd/pixbuf/cache/disabled", EventdNdPixbufCacheTestFixture, GSIZE_TO_POINTER(0), _init_data, _eventd_nd_pixbuf_tests_disabled, _clean_data);
+    g_test_add("/nd/pixbuf/cache/missing", EventdNdPixbufCacheTestFixture, GSIZE_TO_POINTER(4 * IMAGE_BYTES), _init_data, _eventd_nd_pixbuf_tests_missing, _clean_data);
+
+    return g_test_run();
+}
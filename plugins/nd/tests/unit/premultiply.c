@@ -0,0 +1,215 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "premultiply.h"
+
+/*
+ * The original byte-per-byte conversion, which all implementations must match
+ */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define RED_BYTE 2
+#define GREEN_BYTE 1
+#define BLUE_BYTE 0
+#define ALPHA_BYTE 3
+#else
+#define RED_BYTE 1
+#define GREEN_BYTE 2
+#define BLUE_BYTE 3
+#define ALPHA_BYTE 0
+#endif
+
+static inline guchar
+alpha_mult(guchar c, guchar a)
+{
+    guint16 t;
+    switch ( a )
+    {
+    case 0xff:
+        return c;
+    case 0x00:
+        return 0x00;
+    default:
+        t = c * a + 0x7f;
+        return ((t >> 8) + t) >> 8;
+    }
+}
+
+static void
+_eventd_nd_draw_premultiply_tests_reference(guint32 *dest, const guchar *src, gsize width, gboolean alpha)
+{
+    guchar *cline = (guchar *) dest;
+    guint o = alpha ? 4 : 3;
+    guchar a = 0xff;
+    gsize i;
+
+    for ( i = 0 ; i < width ; ++i )
+    {
+        if ( alpha )
+            a = src[3];
+        cline[RED_BYTE] = alpha_mult(src[0], a);
+        cline[GREEN_BYTE] = alpha_mult(src[1], a);
+        cline[BLUE_BYTE] = alpha_mult(src[2], a);
+        cline[ALPHA_BYTE] = a;
+
+        src += o;
+        cline += 4;
+    }
+}
+
+static void
+_eventd_nd_draw_premultiply_tests_check(EventdNdDrawPremultiplyImpl impl, const guchar *pixels, gsize width, gboolean alpha)
+{
+    gsize size = width * ( alpha ? 4 : 3 );
+    guchar *src;
+    guint32 *expected, *result;
+    gsize offset;
+
+    expected = g_new0(guint32, width + 1);
+    result = g_new0(guint32, width + 1);
+
+    /* Check every source alignment, with no readable byte past the row */
+    for ( offset = 0 ; offset < 4 ; ++offset )
+    {
+        src = g_malloc(size + offset);
+        memcpy(src + offset, pixels, size);
+
+        /* Canary to catch writes past the row */
+        expected[width] = result[width] = 0xdeadbeef;
+
+        _eventd_nd_draw_premultiply_tests_reference(expected, src + offset, width, alpha);
+        eventd_nd_draw_premultiply_impl(impl, result, src + offset, width, alpha);
+        g_assert_cmpmem(result, ( width + 1 ) * sizeof(guint32), expected, ( width + 1 ) * sizeof(guint32));
+
+        g_free(src);
+    }
+
+    g_free(result);
+    g_free(expected);
+}
+
+static void
+_eventd_nd_draw_premultiply_tests_exhaustive(gconstpointer user_data)
+{
+    EventdNdDrawPremultiplyImpl impl = GPOINTER_TO_UINT(user_data);
+    gsize width = 256 * 256;
+    guchar *pixels, *p;
+    guint c, a;
+
+    if ( ! eventd_nd_draw_premultiply_impl_supported(impl) )
+    {
+        g_test_skip("Not supported on this CPU");
+        return;
+    }
+
+    /* Every (channel, alpha) couple, with different values per channel */
+    p = pixels = g_new(guchar, width * 4);
+    for ( c = 0 ; c < 256 ; ++c )
+    {
+        for ( a = 0 ; a < 256 ; ++a )
+        {
+            *p++ = c;
+            *p++ = 255 - c;
+            *p++ = c ^ 0x5a;
+            *p++ = a;
+        }
+    }
+
+    _eventd_nd_draw_premultiply_tests_check(impl, pixels, width, TRUE);
+    _eventd_nd_draw_premultiply_tests_check(impl, pixels, width * 4 / 3, FALSE);
+
+    g_free(pixels);
+}
+
+static void
+_eventd_nd_draw_premultiply_tests_widths(gconstpointer user_data)
+{
+    EventdNdDrawPremultiplyImpl impl = GPOINTER_TO_UINT(user_data);
+    GRand *rand;
+    guchar pixels[64 * 4];
+    gsize width;
+    guint i;
+
+    if ( ! eventd_nd_draw_premultiply_impl_supported(impl) )
+    {
+        g_test_skip("Not supported on this CPU");
+        return;
+    }
+
+    rand = g_rand_new_with_seed(impl);
+    for ( i = 0 ; i < G_N_ELEMENTS(pixels) ; ++i )
+        pixels[i] = g_rand_int_range(rand, 0, 256);
+    g_rand_free(rand);
+
+    /* Short rows and every tail length */
+    for ( width = 0 ; width <= 64 ; ++width )
+    {
+        _eventd_nd_draw_premultiply_tests_check(impl, pixels, width, TRUE);
+        _eventd_nd_draw_premultiply_tests_check(impl, pixels, width, FALSE);
+    }
+}
+
+static void
+_eventd_nd_draw_premultiply_tests_dispatch(void)
+{
+    guchar pixels[] = { 0x10, 0x80, 0xff, 0x80, 0x10, 0x80, 0xff, 0x00, 0x10, 0x80, 0xff, 0xff };
+    guint32 expected[3], result[3];
+
+    _eventd_nd_draw_premultiply_tests_reference(expected, pixels, 3, TRUE);
+    eventd_nd_draw_premultiply(result, pixels, 3, TRUE);
+    g_assert_cmpmem(result, sizeof(result), expected, sizeof(expected));
+
+    _eventd_nd_draw_premultiply_tests_reference(expected, pixels, 3, FALSE);
+    eventd_nd_draw_premultiply(result, pixels, 3, FALSE);
+    g_assert_cmpmem(result, sizeof(result), expected, sizeof(expected));
+}
+
+int
+main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "C");
+
+    g_test_init(&argc, &argv, NULL);
+
+    EventdNdDrawPremultiplyImpl impl;
+    for ( impl = 0 ; impl < _EVENTD_ND_DRAW_PREMULTIPLY_IMPL_SIZE ; ++impl )
+    {
+        gchar *path;
+
+        path = g_strdup_printf("/nd/premultiply/%s/exhaustive", eventd_nd_draw_premultiply_impl_names[impl]);
+        g_test_add_data_func(path, GUINT_TO_POINTER(impl), _eventd_nd_draw_premultiply_tests_exhaustive);
+        g_free(path);
+
+        path = g_strdup_printf("/nd/premultiply/%s/widths", eventd_nd_draw_premultiply_impl_names[impl]);
+        g_test_add_data_func(path, GUINT_TO_POINTER(impl), _eventd_nd_draw_premultiply_tests_widths);
+        g_free(path);
+    }
+    g_test_add_func("/nd/premultiply/dispatch", _eventd_nd_draw_premultiply_tests_dispatch);
+
+    return g_test_run();
+}
@@ -41,6 +41,8 @@
  * D-Bus interface information
  */
 
+#define EVENTD_LIBNOTIFY_IMAGE_CACHE_SIZE (4 * 1024 * 1024)
+
 #define NOTIFICATION_BUS_NAME      "org.freedesktop.Notifications"
 #define NOTIFICATION_BUS_PATH      "/org/freedesktop/Notifications"
 
@@ -102,6 +104,7 @@ struct _EventdPluginContext
         gboolean svg_support;
     } capabilities;
     NkXdgThemeContext *theme_context;
+    EventdNdPixbufCache *image_cache;
 };
 
 struct _EventdPluginAction {
@@ -132,6 +135,13 @@ static const gchar * const  _eventd_libnotify_icon_fallback_themes[] = {
     NULL
 };
 
+static gpointer
+_eventd_libnotify_image_cache_convert(GdkPixbuf *pixbuf, gsize *size)
+{
+    *size = gdk_pixbuf_get_byte_length(pixbuf);
+    return g_object_ref(pixbuf);
+}
+
 static GdkPixbuf *
 _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event, gchar **icon_uri, gchar **image_uri)
 {
@@ -149,7 +159,7 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
                 && ( context->capabilities.svg_support || ( ! g_str_has_suffix(*image_uri, ".svg") ) )
             )
             break;
-        image = eventd_nd_pixbuf_from_uri(*image_uri, 0, 0, 1);
+        image = eventd_nd_pixbuf_cache_from_uri(context->image_cache, *image_uri, 0, 0, 1);
         *image_uri = NULL;
     break;
     case FILENAME_PROCESS_RESULT_DATA:
@@ -157,7 +167,7 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
     break;
     case FILENAME_PROCESS_RESULT_THEME:
         /* Theme icon as image is not supported by the spec */
-        image = eventd_nd_pixbuf_from_theme(context->theme_context, NULL, *image_uri, 48, 1);
+        image = eventd_nd_pixbuf_cache_from_theme(context->image_cache, context->theme_context, NULL, *image_uri, 48, 1);
         *image_uri = NULL;
     break;
     case FILENAME_PROCESS_RESULT_NONE:
@@ -172,7 +182,7 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
                 && ( context->capabilities.svg_support || ( ! g_str_has_suffix(*icon_uri, ".svg") ) )
             )
             break;
-        icon = eventd_nd_pixbuf_from_uri(*icon_uri, 0, 0, 1);
+        icon = eventd_nd_pixbuf_cache_from_uri(context->image_cache, *icon_uri, 0, 0, 1);
         *icon_uri = NULL;
     break;
     case FILENAME_PROCESS_RESULT_DATA:
@@ -208,7 +218,7 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
      */
     if ( ( image == NULL ) && ( *image_uri != NULL ) )
     {
-        image = eventd_nd_pixbuf_from_uri(*image_uri, 0, 0, 1);
+        image = eventd_nd_pixbuf_cache_from_uri(context->image_cache, *image_uri, 0, 0, 1);
         *image_uri = NULL;
     }
 
@@ -223,7 +233,7 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
      */
     if ( ( icon == NULL ) && ( *icon_uri != NULL ) )
     {
-        icon = eventd_nd_pixbuf_from_uri(*icon_uri, 0, 0, 1);
+        icon = eventd_nd_pixbuf_cache_from_uri(context->image_cache, *icon_uri, 0, 0, 1);
         *icon_uri = NULL;
     }
 
@@ -242,6 +252,11 @@ _eventd_libnotify_get_image(EventdPluginContext *context, EventdPluginAction *ac
     gint icon_width, icon_height;
     gint x, y;
     gdouble scale;
+    GdkPixbuf *cached = image;
+
+    /* The image may be shared with the cache, so we composite on a copy */
+    image = gdk_pixbuf_copy(cached);
+    g_object_unref(cached);
 
     image_width = gdk_pixbuf_get_width(image);
     image_height = gdk_pixbuf_get_height(image);
@@ -335,6 +350,7 @@ _eventd_libnotify_init(EventdPluginCoreContext *core)
     context = g_new0(EventdPluginContext, 1);
 
     context->introspection_data = introspection_data;
+    context->image_cache = eventd_nd_pixbuf_cache_new(EVENTD_LIBNOTIFY_IMAGE_CACHE_SIZE, _eventd_libnotify_image_cache_convert, g_object_ref, g_object_unref);
 
     return context;
 }
@@ -344,6 +360,8 @@ _eventd_libnotify_uninit(EventdPluginContext *context)
 {
     g_free(context->ignored_name_owner);
 
+    eventd_nd_pixbuf_cache_free(context->image_cache);
+
     g_dbus_node_info_unref(context->introspection_data);
 
     g_free(context);
@@ -609,6 +627,8 @@ _eventd_libnotify_config_reset(EventdPluginContext *context)
 {
     g_slist_free_full(context->actions, _eventd_libnotify_action_free);
     context->actions = NULL;
+
+    eventd_nd_pixbuf_cache_clear(context->image_cache);
 }
 
 
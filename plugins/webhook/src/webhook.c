@@ -32,8 +32,16 @@
 #include "eventd-plugin.h"
 #include "libeventd-helpers-config.h"
 
+#define EVENTD_WEBHOOK_RETRY_MAX_DELAY (5 * 60 * 1000)
+
 struct _EventdPluginContext {
     gboolean no_user_agent;
+    gint64 max_conns;
+    gint64 max_conns_per_host;
+    gint64 retry_queue_size;
+    SoupSession *session;
+    GHashTable *batches;
+    GQueue retry_queue;
     GSList *actions;
 };
 
@@ -49,8 +57,39 @@ struct _EventdPluginAction {
     FormatString *string;
     gchar *content_type;
     GHashTable *headers;
+    gint64 batch_window;
+    gint64 batch_size;
+    gint64 retries;
+    gint64 retry_delay;
 };
 
+/*
+ * A request does not reference its action,
+ * so that it can be retried across a configuration reload
+ */
+typedef struct {
+    EventdPluginContext *context;
+    const gchar *method;
+    gchar *url;
+    gchar *content_type;
+    GHashTable *headers;
+    GBytes *body;
+    gint64 retries;
+    gint64 retry_delay;
+    gint64 attempt;
+    guint timeout;
+} EventdWebhookRequest;
+
+typedef struct {
+    EventdPluginContext *context;
+    EventdPluginAction *action;
+    gchar *key;
+    gchar *url;
+    GString *body;
+    gint64 size;
+    guint timeout;
+} EventdWebhookBatch;
+
 static const gchar * const _eventd_webhook_method[] = {
     [EVENTD_WEBHOOK_METHOD_POST] = "POST",
     [EVENTD_WEBHOOK_METHOD_PUT]  = "PUT",
@@ -71,6 +110,71 @@ _eventd_webhook_action_free(gpointer data)
     g_slice_free(EventdPluginAction, action);
 }
 
+static void
+_eventd_webhook_request_free(EventdWebhookRequest *request)
+{
+    if ( request->timeout > 0 )
+        g_source_remove(request->timeout);
+    g_bytes_unref(request->body);
+    if ( request->headers != NULL )
+        g_hash_table_unref(request->headers);
+    g_free(request->content_type);
+    g_free(request->url);
+
+    g_slice_free(EventdWebhookRequest, request);
+}
+
+static void _eventd_webhook_batch_flush(EventdWebhookBatch *batch);
+
+static void
+_eventd_webhook_batches_flush(EventdPluginContext *context)
+{
+    GList *batches, *batch;
+
+    batches = g_hash_table_get_values(context->batches);
+    for ( batch = batches ; batch != NULL ; batch = g_list_next(batch) )
+        _eventd_webhook_batch_flush(batch->data);
+    g_list_free(batches);
+}
+
+static void
+_eventd_webhook_retry_queue_clear(EventdPluginContext *context)
+{
+    EventdWebhookRequest *request;
+
+    if ( ! g_queue_is_empty(&context->retry_queue) )
+        g_warning("Dropping %u webhook messages waiting for a retry", g_queue_get_length(&context->retry_queue));
+
+    while ( ( request = g_queue_pop_head(&context->retry_queue) ) != NULL )
+        _eventd_webhook_request_free(request);
+}
+
+static void
+_eventd_webhook_session_update(EventdPluginContext *context)
+{
+    if ( ( context->session == NULL ) || ( soup_session_get_max_conns(context->session) != context->max_conns ) || ( soup_session_get_max_conns_per_host(context->session) != context->max_conns_per_host ) )
+    {
+        /* Running messages keep the old session alive until they are done */
+        if ( context->session != NULL )
+            g_object_unref(context->session);
+        context->session = soup_session_new_with_options(
+            "max-conns", (gint) context->max_conns,
+            "max-conns-per-host", (gint) context->max_conns_per_host,
+            NULL);
+    }
+
+    soup_session_set_user_agent(context->session, context->no_user_agent ? NULL : ( PACKAGE_NAME " " NK_PACKAGE_VERSION ));
+}
+
+static void
+_eventd_webhook_global_reset(EventdPluginContext *context)
+{
+    context->no_user_agent = FALSE;
+    context->max_conns = 10;
+    context->max_conns_per_host = 2;
+    context->retry_queue_size = 100;
+}
+
 /*
  * Initialization interface
  */
@@ -81,6 +185,9 @@ _eventd_webhook_init(EventdPluginCoreContext *core)
     EventdPluginContext *context;
 
     context = g_new0(EventdPluginContext, 1);
+    _eventd_webhook_global_reset(context);
+    context->batches = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&context->retry_queue);
 
     return context;
 }
@@ -88,10 +195,32 @@ _eventd_webhook_init(EventdPluginCoreContext *core)
 static void
 _eventd_webhook_uninit(EventdPluginContext *context)
 {
+    g_hash_table_unref(context->batches);
+
     g_free(context);
 }
 
 
+/*
+ * Start/Stop interface
+ */
+
+static void
+_eventd_webhook_start(EventdPluginContext *context)
+{
+    _eventd_webhook_session_update(context);
+}
+
+static void
+_eventd_webhook_stop(EventdPluginContext *context)
+{
+    _eventd_webhook_batches_flush(context);
+    _eventd_webhook_retry_queue_clear(context);
+
+    g_clear_object(&context->session);
+}
+
+
 /*
  * Configuration interface
  */
@@ -103,8 +232,30 @@ _eventd_webhook_global_parse(EventdPluginContext *context, GKeyFile *config_file
         return;
 
     gboolean no_user_agent = FALSE;
+    Int integer;
+
     if ( evhelpers_config_key_file_get_boolean(config_file, "WebHook", "NoUserAgent", &no_user_agent) == 0 )
         context->no_user_agent = no_user_agent;
+
+    if ( evhelpers_config_key_file_get_int(config_file, "WebHook", "MaxConnections", &integer) == 0 )
+        context->max_conns = CLAMP(integer.value, 1, G_MAXINT);
+
+    if ( evhelpers_config_key_file_get_int(config_file, "WebHook", "MaxConnectionsPerHost", &integer) == 0 )
+        context->max_conns_per_host = CLAMP(integer.value, 1, G_MAXINT);
+
+    if ( evhelpers_config_key_file_get_int(config_file, "WebHook", "RetryQueueSize", &integer) == 0 )
+        context->retry_queue_size = MAX(integer.value, 0);
+}
+
+/* Batches are JSON arrays, so we only batch JSON payloads */
+static gboolean
+_eventd_webhook_content_type_is_json(const gchar *content_type)
+{
+    gsize length = strcspn(content_type, "; \t");
+
+    if ( ( length == strlen("application/json") ) && ( g_ascii_strncasecmp(content_type, "application/json", length) == 0 ) )
+        return TRUE;
+    return ( length > strlen("+json") ) && ( g_ascii_strncasecmp(content_type + length - strlen("+json"), "+json", strlen("+json")) == 0 );
 }
 
 static EventdPluginAction *
@@ -116,6 +267,7 @@ _eventd_webhook_action_parse(EventdPluginContext *context, GKeyFile *config_file
     FormatString *string = NULL;
     gchar *content_type = NULL;
     guint64 method;
+    gint64 batch_window, batch_size, retries, retry_delay;
     GHashTable *headers = NULL;
 
     if ( ! g_key_file_has_group(config_file, "WebHook") )
@@ -143,6 +295,24 @@ _eventd_webhook_action_parse(EventdPluginContext *context, GKeyFile *config_file
     if ( evhelpers_config_key_file_get_enum_with_default(config_file, "WebHook", "Method", _eventd_webhook_method, G_N_ELEMENTS(_eventd_webhook_method), EVENTD_WEBHOOK_METHOD_POST, &method) < 0 )
         goto fail;
 
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "WebHook", "BatchWindow", 0, &batch_window) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "WebHook", "BatchSize", 100, &batch_size) < 0 )
+        goto fail;
+
+    if ( ( batch_window > 0 ) && ( ! _eventd_webhook_content_type_is_json(content_type) ) )
+    {
+        g_warning("Batching is only supported for JSON payloads, not %s", content_type);
+        batch_window = 0;
+    }
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "WebHook", "Retries", 3, &retries) < 0 )
+        goto fail;
+
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "WebHook", "RetryDelay", 1000, &retry_delay) < 0 )
+        goto fail;
+
     if ( g_key_file_has_group(config_file, "WebHook Headers") )
     {
         gchar **keys, **key;
@@ -165,6 +335,10 @@ _eventd_webhook_action_parse(EventdPluginContext *context, GKeyFile *config_file
     action->string = string;
     action->content_type = content_type;
     action->headers = headers;
+    action->batch_window = MAX(batch_window, 0);
+    action->batch_size = MAX(batch_size, 1);
+    action->retries = MAX(retries, 0);
+    action->retry_delay = CLAMP(retry_delay, 1, EVENTD_WEBHOOK_RETRY_MAX_DELAY);
 
     context->actions = g_slist_prepend(context->actions, action);
 
@@ -180,8 +354,19 @@ fail:
 static void
 _eventd_webhook_config_reset(EventdPluginContext *context)
 {
+    /* Batches reference their action */
+    _eventd_webhook_batches_flush(context);
+
     g_slist_free_full(context->actions, _eventd_webhook_action_free);
     context->actions = NULL;
+
+    _eventd_webhook_global_reset(context);
+}
+
+static void
+_eventd_webhook_reload(EventdPluginContext *context)
+{
+    _eventd_webhook_session_update(context);
 }
 
 
@@ -189,26 +374,67 @@ _eventd_webhook_config_reset(EventdPluginContext *context)
  * Event action interface
  */
 
+static void _eventd_webhook_request_send(EventdWebhookRequest *request);
+
+static gboolean
+_eventd_webhook_request_retry_callback(gpointer user_data)
+{
+    EventdWebhookRequest *request = user_data;
+
+    request->timeout = 0;
+    g_queue_remove(&request->context->retry_queue, request);
+    _eventd_webhook_request_send(request);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_eventd_webhook_request_retry(EventdWebhookRequest *request)
+{
+    EventdPluginContext *context = request->context;
+    gint64 delay;
+
+    if ( request->attempt > request->retries )
+        return FALSE;
+
+    if ( g_queue_get_length(&context->retry_queue) >= (guint) context->retry_queue_size )
+    {
+        g_debug("Retry queue is full");
+        return FALSE;
+    }
+
+    /* Exponential backoff */
+    delay = request->retry_delay << MIN(request->attempt - 1, 16);
+    delay = MIN(delay, EVENTD_WEBHOOK_RETRY_MAX_DELAY);
+
+    g_debug("Retrying message to %s in %" G_GINT64_FORMAT "ms", request->url, delay);
+    request->timeout = g_timeout_add(delay, _eventd_webhook_request_retry_callback, request);
+    g_queue_push_tail(&context->retry_queue, request);
+
+    return TRUE;
+}
+
 static void
 _eventd_webhook_message_callback(GObject *obj, GAsyncResult *res, gpointer user_data)
 {
+    EventdWebhookRequest *request = user_data;
     GError *error = NULL;
     GBytes *bytes;
+    gchar *uri;
 
     SoupMessage *msg = soup_session_get_async_result_message(SOUP_SESSION(obj), res);
-    GUri *uri = soup_message_get_uri(msg);
+    uri = g_uri_to_string_partial(soup_message_get_uri(msg), G_URI_HIDE_USERINFO);
 
     bytes = soup_session_send_and_read_finish(SOUP_SESSION(obj), res, &error);
     if ( bytes == NULL )
     {
-        g_warning("Could not send message to %s://%s%s%s%s: %s",
-            g_uri_get_scheme(uri),
-            g_uri_get_host(uri),
-            g_uri_get_path(uri),
-            g_uri_get_query(uri),
-            g_uri_get_fragment(uri),
-            error->message);
+        if ( ! _eventd_webhook_request_retry(request) )
+        {
+            g_warning("Could not send message to %s: %s", uri, error->message);
+            _eventd_webhook_request_free(request);
+        }
         g_clear_error(&error);
+        g_free(uri);
         return;
     }
     g_bytes_unref(bytes);
@@ -221,56 +447,159 @@ _eventd_webhook_message_callback(GObject *obj, GAsyncResult *res, gpointer user_
         success = "successful";
         log_level = G_LOG_LEVEL_INFO;
     }
+    else if ( SOUP_STATUS_IS_SERVER_ERROR(status) && _eventd_webhook_request_retry(request) )
+    {
+        /* Transient error, we will retry */
+        success = "deferred";
+        log_level = G_LOG_LEVEL_DEBUG;
+        request = NULL;
+    }
 
-    g_log(G_LOG_DOMAIN, log_level, "Message to %s://%s%s%s%s is %s: (%d %s) %s",
-        g_uri_get_scheme(uri),
-        g_uri_get_host(uri),
-        g_uri_get_path(uri),
-        g_uri_get_query(uri),
-        g_uri_get_fragment(uri),
+    g_log(G_LOG_DOMAIN, log_level, "Message to %s is %s: (%d %s) %s",
+        uri,
         success,
-        soup_message_get_status(msg),
-        soup_status_get_phrase(soup_message_get_status(msg)),
+        status,
+        soup_status_get_phrase(status),
         soup_message_get_reason_phrase(msg)
     );
+
+    if ( request != NULL )
+        _eventd_webhook_request_free(request);
+    g_free(uri);
 }
 
 static void
-_eventd_webhook_event_action(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event)
+_eventd_webhook_request_send(EventdWebhookRequest *request)
 {
-    gchar *url = NULL;
-    gchar *string = NULL;
-    SoupSession *session;
     SoupMessage *msg;
 
-    url = evhelpers_format_string_get_string(action->url, event, NULL, NULL);
-    string = evhelpers_format_string_get_string(action->string, event, NULL, NULL);
+    if ( request->context->session == NULL )
+    {
+        g_debug("Not started, dropping message to %s", request->url);
+        _eventd_webhook_request_free(request);
+        return;
+    }
 
-    session = soup_session_new();
-    if ( ! context->no_user_agent )
-        soup_session_set_user_agent(session, PACKAGE_NAME " " NK_PACKAGE_VERSION);
-    msg = soup_message_new(_eventd_webhook_method[action->method], url);
-    if ( action->headers != NULL )
+    msg = soup_message_new(request->method, request->url);
+    if ( msg == NULL )
+    {
+        g_warning("Invalid URL: %s", request->url);
+        _eventd_webhook_request_free(request);
+        return;
+    }
+
+    if ( request->headers != NULL )
     {
         SoupMessageHeaders *headers;
         GHashTableIter iter;
         const gchar *header, *value;
         headers = soup_message_get_request_headers(msg);
         soup_message_headers_clear(headers);
-        g_hash_table_iter_init(&iter, action->headers);
+        g_hash_table_iter_init(&iter, request->headers);
         while ( g_hash_table_iter_next(&iter, (gpointer *) &header, (gpointer *) &value) )
             soup_message_headers_append(headers, header, value);
     }
-    gssize size = strlen(string);
-    GInputStream *stream;
-    stream = g_memory_input_stream_new_from_data(string, size, g_free);
-    soup_message_set_request_body(msg, action->content_type, stream, size);
-    g_object_unref(stream);
-    soup_session_send_and_read_async(session, msg, G_PRIORITY_DEFAULT, NULL, _eventd_webhook_message_callback, context);
+    soup_message_set_request_body_from_bytes(msg, request->content_type, request->body);
+
+    ++request->attempt;
+    soup_session_send_and_read_async(request->context->session, msg, G_PRIORITY_DEFAULT, NULL, _eventd_webhook_message_callback, request);
     g_object_unref(msg);
+}
+
+static void
+_eventd_webhook_send(EventdPluginContext *context, EventdPluginAction *action, gchar *url, GBytes *body)
+{
+    EventdWebhookRequest *request;
 
-    g_object_unref(session);
-    g_free(url);
+    request = g_slice_new0(EventdWebhookRequest);
+    request->context = context;
+    request->method = _eventd_webhook_method[action->method];
+    request->url = url;
+    request->content_type = g_strdup(action->content_type);
+    if ( action->headers != NULL )
+        request->headers = g_hash_table_ref(action->headers);
+    request->body = body;
+    request->retries = action->retries;
+    request->retry_delay = action->retry_delay;
+
+    _eventd_webhook_request_send(request);
+}
+
+static void
+_eventd_webhook_batch_flush(EventdWebhookBatch *batch)
+{
+    gsize size;
+
+    g_hash_table_remove(batch->context->batches, batch->key);
+    if ( batch->timeout > 0 )
+        g_source_remove(batch->timeout);
+
+    g_string_append_c(batch->body, ']');
+    size = batch->body->len;
+    _eventd_webhook_send(batch->context, batch->action, batch->url, g_bytes_new_take(g_string_free(batch->body, FALSE), size));
+
+    g_free(batch->key);
+    g_slice_free(EventdWebhookBatch, batch);
+}
+
+static gboolean
+_eventd_webhook_batch_timeout(gpointer user_data)
+{
+    EventdWebhookBatch *batch = user_data;
+
+    batch->timeout = 0;
+    _eventd_webhook_batch_flush(batch);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_webhook_batch_add(EventdPluginContext *context, EventdPluginAction *action, gchar *url, gchar *string)
+{
+    EventdWebhookBatch *batch;
+    gchar *key;
+
+    /* Different actions may send to the same URL with different headers */
+    key = g_strdup_printf("%p %s", (gpointer) action, url);
+    batch = g_hash_table_lookup(context->batches, key);
+    if ( batch == NULL )
+    {
+        batch = g_slice_new0(EventdWebhookBatch);
+        batch->context = context;
+        batch->action = action;
+        batch->key = key;
+        batch->url = url;
+        batch->body = g_string_new("[");
+        batch->timeout = g_timeout_add(action->batch_window, _eventd_webhook_batch_timeout, batch);
+        g_hash_table_insert(context->batches, batch->key, batch);
+    }
+    else
+    {
+        g_free(key);
+        g_free(url);
+        g_string_append_c(batch->body, ',');
+    }
+
+    g_string_append(batch->body, string);
+    g_free(string);
+
+    if ( ++batch->size >= action->batch_size )
+        _eventd_webhook_batch_flush(batch);
+}
+
+static void
+_eventd_webhook_event_action(EventdPluginContext *context, EventdPluginAction *action, EventdEvent *event)
+{
+    gchar *url;
+    gchar *string;
+
+    url = evhelpers_format_string_get_string(action->url, event, NULL, NULL);
+    string = evhelpers_format_string_get_string(action->string, event, NULL, NULL);
+
+    if ( action->batch_window > 0 )
+        _eventd_webhook_batch_add(context, action, url, string);
+    else
+        _eventd_webhook_send(context, action, url, g_bytes_new_take(string, strlen(string)));
 }
 
 
@@ -287,9 +616,13 @@ eventd_plugin_get_interface(EventdPluginInterface *interface)
     eventd_plugin_interface_add_init_callback(interface, _eventd_webhook_init);
     eventd_plugin_interface_add_uninit_callback(interface, _eventd_webhook_uninit);
 
+    eventd_plugin_interface_add_start_callback(interface, _eventd_webhook_start);
+    eventd_plugin_interface_add_stop_callback(interface, _eventd_webhook_stop);
+
     eventd_plugin_interface_add_global_parse_callback(interface, _eventd_webhook_global_parse);
     eventd_plugin_interface_add_action_parse_callback(interface, _eventd_webhook_action_parse);
     eventd_plugin_interface_add_config_reset_callback(interface, _eventd_webhook_config_reset);
+    eventd_plugin_interface_add_reload_callback(interface, _eventd_webhook_reload);
 
     eventd_plugin_interface_add_event_action_callback(interface, _eventd_webhook_event_action);
 }
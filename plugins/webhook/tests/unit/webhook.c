@@ -0,0 +1,235 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <libsoup/soup.h>
+
+#include "eventd-plugin.h"
+#include "eventd-plugin-private.h"
+
+void eventd_plugin_get_interface(EventdPluginInterface *interface);
+
+typedef struct {
+    SoupServer *server;
+    guint port;
+    guint failures;
+    GPtrArray *bodies;
+    GArray *ports;
+    EventdPluginInterface interface;
+    EventdPluginContext *context;
+    EventdPluginAction *action;
+} EventdWebhookTestFixture;
+
+static void
+_eventd_webhook_tests_handler(SoupServer *server, SoupServerMessage *msg, const char *path, GHashTable *query, gpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = user_data;
+    SoupMessageBody *body;
+    guint16 port;
+
+    body = soup_server_message_get_request_body(msg);
+    g_ptr_array_add(fixture->bodies, g_strndup(body->data, body->length));
+    port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(soup_server_message_get_remote_address(msg)));
+    g_array_append_val(fixture->ports, port);
+
+    if ( fixture->failures > 0 )
+    {
+        --fixture->failures;
+        soup_server_message_set_status(msg, SOUP_STATUS_SERVICE_UNAVAILABLE, NULL);
+        return;
+    }
+
+    soup_server_message_set_status(msg, SOUP_STATUS_OK, NULL);
+    soup_server_message_set_response(msg, "text/plain", SOUP_MEMORY_COPY, "OK", 2);
+}
+
+static void
+_init_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+    const gchar *extra = user_data;
+    GError *error = NULL;
+    GSList *uris;
+    GKeyFile *config_file;
+    gchar *config;
+
+    fixture->server = soup_server_new(NULL, NULL);
+    soup_server_add_handler(fixture->server, "/hook", _eventd_webhook_tests_handler, fixture, NULL);
+    g_assert_true(soup_server_listen_local(fixture->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error));
+    g_assert_no_error(error);
+
+    uris = soup_server_get_uris(fixture->server);
+    g_assert_nonnull(uris);
+    fixture->port = g_uri_get_port(uris->data);
+    g_slist_free_full(uris, (GDestroyNotify) g_uri_unref);
+
+    fixture->bodies = g_ptr_array_new_with_free_func(g_free);
+    fixture->ports = g_array_new(FALSE, FALSE, sizeof(guint16));
+
+    config = g_strdup_printf(
+        "[WebHook]\n"
+        "URL=http://127.0.0.1:%u/hook\n"
+        "String=\"${index}\"\n"
+        "RetryDelay=10\n"
+        "%s",
+        fixture->port, extra);
+    config_file = g_key_file_new();
+    g_assert_true(g_key_file_load_from_data(config_file, config, -1, G_KEY_FILE_NONE, NULL));
+    g_free(config);
+
+    eventd_plugin_get_interface(&fixture->interface);
+    fixture->context = fixture->interface.init(NULL);
+    fixture->interface.global_parse(fixture->context, config_file);
+    fixture->action = fixture->interface.action_parse(fixture->context, config_file);
+    g_assert_nonnull(fixture->action);
+    fixture->interface.start(fixture->context);
+
+    g_key_file_unref(config_file);
+}
+
+static void
+_clean_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+
+    fixture->interface.stop(fixture->context);
+    fixture->interface.config_reset(fixture->context);
+    fixture->interface.uninit(fixture->context);
+
+    g_array_unref(fixture->ports);
+    g_ptr_array_unref(fixture->bodies);
+    g_object_unref(fixture->server);
+}
+
+static void
+_eventd_webhook_tests_push(EventdWebhookTestFixture *fixture, guint64 index)
+{
+    EventdEvent *event;
+
+    event = eventd_event_new("test", "webhook");
+    eventd_event_add_data(event, g_strdup("index"), g_variant_new_uint64(index));
+    fixture->interface.event_action(fixture->context, fixture->action, event);
+    eventd_event_unref(event);
+}
+
+static gboolean
+_eventd_webhook_tests_timeout(gpointer user_data)
+{
+    gboolean *timed_out = user_data;
+
+    *timed_out = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/* Iterate until the server got enough requests, then a bit more to let the client side finish */
+static void
+_eventd_webhook_tests_wait(EventdWebhookTestFixture *fixture, guint count)
+{
+    gboolean timed_out = FALSE;
+    guint timeout;
+
+    timeout = g_timeout_add_seconds(2, _eventd_webhook_tests_timeout, &timed_out);
+    while ( ( fixture->bodies->len < count ) && ( ! timed_out ) )
+        g_main_context_iteration(NULL, TRUE);
+    if ( ! timed_out )
+        g_source_remove(timeout);
+    g_assert_cmpuint(fixture->bodies->len, ==, count);
+
+    timed_out = FALSE;
+    g_timeout_add(50, _eventd_webhook_tests_timeout, &timed_out);
+    while ( ! timed_out )
+        g_main_context_iteration(NULL, TRUE);
+}
+
+static void
+_eventd_webhook_tests_keep_alive(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+
+    _eventd_webhook_tests_push(fixture, 1);
+    _eventd_webhook_tests_wait(fixture, 1);
+    _eventd_webhook_tests_push(fixture, 2);
+    _eventd_webhook_tests_wait(fixture, 2);
+
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 0), ==, "\"1\"");
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 1), ==, "\"2\"");
+    /* Same connection */
+    g_assert_cmpuint(g_array_index(fixture->ports, guint16, 0), ==, g_array_index(fixture->ports, guint16, 1));
+}
+
+static void
+_eventd_webhook_tests_batch(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+
+    _eventd_webhook_tests_push(fixture, 1);
+    _eventd_webhook_tests_push(fixture, 2);
+    _eventd_webhook_tests_push(fixture, 3);
+    /* BatchSize reached */
+    _eventd_webhook_tests_wait(fixture, 1);
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 0), ==, "[\"1\",\"2\",\"3\"]");
+
+    _eventd_webhook_tests_push(fixture, 4);
+    _eventd_webhook_tests_wait(fixture, 2);
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 1), ==, "[\"4\"]");
+}
+
+static void
+_eventd_webhook_tests_retry(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+
+    fixture->failures = 2;
+    _eventd_webhook_tests_push(fixture, 1);
+    _eventd_webhook_tests_wait(fixture, 3);
+
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 0), ==, "\"1\"");
+    g_assert_cmpstr(g_ptr_array_index(fixture->bodies, 2), ==, "\"1\"");
+    g_assert_cmpuint(fixture->failures, ==, 0);
+}
+
+static void
+_eventd_webhook_tests_retry_give_up(gpointer fixture_, gconstpointer user_data)
+{
+    EventdWebhookTestFixture *fixture = fixture_;
+
+    fixture->failures = 5;
+    g_test_expect_message("eventd-webhook", G_LOG_LEVEL_WARNING, "Message to * is not successful: (503 *");
+    _eventd_webhook_tests_push(fixture, 1);
+    _eventd_webhook_tests_wait(fixture, 2);
+    g_test_assert_expected_messages();
+
+    g_assert_cmpuint(fixture->failures, ==, 3);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/webhook/keep-alive", EventdWebhookTestFixture, "", _init_data, _eventd_webhook_tests_keep_alive, _clean_data);
+    g_test_add("/webhook/batch", EventdWebhookTestFixture, "BatchWindow=100\nBatchSize=3\n", _init_data, _eventd_webhook_tests_batch, _clean_data);
+    g_test_add("/webhook/retry", EventdWebhookTestFixture, "", _init_data, _eventd_webhook_tests_retry, _clean_data);
+    g_test_add("/webhook/retry/give-up", EventdWebhookTestFixture, "Retries=1\n", _init_data, _eventd_webhook_tests_retry_give_up, _clean_data);
+
+    return g_test_run();
+}
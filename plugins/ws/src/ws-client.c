@@ -41,9 +41,13 @@ struct _EventdWsClient {
     GList *link;
     EventdProtocol *protocol;
     SoupWebsocketConnection *connection;
-    GList *subscribe_all;
-    GHashTable *subscriptions;
     EventdEvent *current;
+    guint64 id;
+    gchar *peer;
+    struct {
+        guint64 received;
+        guint64 sent;
+    } stats;
 };
 
 static void
@@ -53,6 +57,9 @@ _evend_ws_websocket_client_protocol_event(EventdProtocol *protocol, EventdEvent
 
     eventd_debug("Received an event (category: %s): %s", eventd_event_get_category(event), eventd_event_get_name(event));
 
+    ++self->stats.received;
+    ++self->context->stats.received;
+
     self->current = event;
     eventd_plugin_core_push_event(self->context->core, event);
     self->current = NULL;
@@ -63,31 +70,11 @@ _evend_ws_websocket_client_protocol_subscribe(EventdProtocol *protocol, GHashTab
 {
     EventdWsClient *self = user_data;
 
-    if ( categories == NULL )
-    {
-        self->context->subscribe_all = g_list_prepend(self->context->subscribe_all, self);
-        self->subscribe_all = self->context->subscribe_all;
+    if ( self->link == NULL )
+        /* Already removed from the context */
         return;
-    }
-
-    GHashTableIter iter;
-    gchar *category;
-    gpointer dummy;
-    gchar *key = NULL;
-    GList *list = NULL;
-    g_hash_table_iter_init(&iter, categories);
-    while ( g_hash_table_iter_next(&iter, (gpointer *) &category, &dummy) )
-    {
-        if ( g_hash_table_lookup_extended(self->context->subscribe_categories, category, (gpointer *) &key, (gpointer *) &list) )
-            g_hash_table_steal(self->context->subscribe_categories, category);
-        else
-            key = g_strdup(category);
-
-        list = g_list_prepend(list, self);
 
-        g_hash_table_insert(self->context->subscribe_categories, key, list);
-        g_hash_table_insert(self->subscriptions, key, list);
-    }
+    evhelpers_subscriptions_add(self->context->subscriptions, self, categories);
 }
 
 static void
@@ -136,34 +123,19 @@ _evend_ws_websocket_client_error(EventdWsClient *self, GError *error, SoupWebsoc
 static void
 _evend_ws_websocket_client_closed(EventdWsClient *self, SoupWebsocketConnection *connection)
 {
-    GHashTableIter iter;
-    gchar *category, *key;
-    GList *link, *list;
-    g_hash_table_iter_init(&iter, self->subscriptions);
-    while ( g_hash_table_iter_next(&iter, (gpointer *) &category, (gpointer *) &link) )
+    if ( self->link != NULL )
     {
-        g_hash_table_iter_steal(&iter);
-
-        g_hash_table_lookup_extended(self->context->subscribe_categories, category, (gpointer *) &key, (gpointer *) &list);
-        g_hash_table_steal(self->context->subscribe_categories, category);
-
-        list = g_list_delete_link(list, link);
-
-        g_hash_table_insert(self->context->subscribe_categories, key, list);
+        evhelpers_subscriptions_remove(self->context->subscriptions, self);
+        self->context->clients = g_list_delete_link(self->context->clients, self->link);
     }
-    g_hash_table_unref(self->subscriptions);
-
-    if ( self->subscribe_all != NULL )
-        self->context->subscribe_all = g_list_delete_link(self->context->subscribe_all, self->subscribe_all);
-
-    if ( self->link != NULL )
-        self->context->clients = g_list_remove_link(self->context->clients, self->link);
 
     if ( self->connection != NULL )
         g_object_unref(self->connection);
 
     eventd_protocol_unref(self->protocol);
 
+    g_free(self->peer);
+
     g_free(self);
 }
 
@@ -178,7 +150,8 @@ evend_ws_websocket_client_handler(SoupServer *server, SoupServerMessage *server_
     self->context = context;
 
     self->protocol = eventd_protocol_new(&_evend_ws_websocket_client_protocol_callbacks, self, NULL);
-    self->subscriptions = g_hash_table_new(g_str_hash, g_str_equal);
+    self->id = ++context->next_client_id;
+    self->peer = g_strdup(soup_server_message_get_remote_host(server_msg));
 
     self->connection = g_object_ref(connection);
     g_signal_connect_swapped(self->connection, "message", G_CALLBACK(_evend_ws_websocket_client_message), self);
@@ -193,8 +166,6 @@ evend_ws_websocket_client_disconnect(gpointer data)
 {
     EventdWsClient *self = data;
 
-    g_hash_table_steal_all(self->subscriptions);
-    self->subscribe_all = NULL;
     self->link = NULL;
 
     soup_websocket_connection_close(self->connection, SOUP_WEBSOCKET_CLOSE_NORMAL, NULL);
@@ -207,5 +178,18 @@ evend_ws_websocket_client_event_dispatch(EventdWsClient *self, EventdEvent *even
         /* Do not send back our own events */
         return;
 
-    soup_websocket_connection_send_text(self->connection, eventd_protocol_generate_event(self->protocol, event));
+    GBytes *message;
+
+    message = eventd_protocol_generate_event_bytes(self->protocol, event);
+    soup_websocket_connection_send_message(self->connection, SOUP_WEBSOCKET_DATA_TEXT, message);
+    g_bytes_unref(message);
+
+    ++self->stats.sent;
+    ++self->context->stats.sent;
+}
+
+void
+evend_ws_websocket_client_append_stats(EventdWsClient *self, GString *str)
+{
+    g_string_append_printf(str, "\n    #%" G_GUINT64_FORMAT " (%s): %" G_GUINT64_FORMAT " received, %" G_GUINT64_FORMAT " sent", self->id, ( self->peer != NULL ) ? self->peer : "unknown", self->stats.received, self->stats.sent);
 }
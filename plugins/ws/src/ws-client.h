@@ -28,5 +28,6 @@ typedef struct _EventdWsClient EventdWsClient;
 void evend_ws_websocket_client_handler(SoupServer *server, SoupServerMessage *server_msg, const char *path, SoupWebsocketConnection *connection, gpointer user_data);
 void evend_ws_websocket_client_disconnect(gpointer data);
 void evend_ws_websocket_client_event_dispatch(EventdWsClient *client, EventdEvent *event);
+void evend_ws_websocket_client_append_stats(EventdWsClient *client, GString *str);
 
 #endif /* __EVENTD_WS_CLIENT_H__ */
@@ -155,7 +155,10 @@ _evend_ws_start(EventdPluginContext *self)
 
     soup_server_add_websocket_handler(self->server, NULL, NULL, protocols, evend_ws_websocket_client_handler, self, NULL);
 
-    self->subscribe_categories = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_list_free);
+    self->server_binds = g_strdupv(self->binds);
+    self->server_auth = ( self->secret != NULL );
+
+    self->subscriptions = evhelpers_subscriptions_new();
 }
 
 static void
@@ -164,15 +167,41 @@ _evend_ws_stop(EventdPluginContext *self)
     if ( self->server == NULL )
         return;
 
-    g_hash_table_unref(self->subscribe_categories);
-    self->subscribe_categories = NULL;
-    g_list_free(self->subscribe_all);
-    self->subscribe_all = NULL;
+    evhelpers_subscriptions_free(self->subscriptions);
+    self->subscriptions = NULL;
 
     g_list_free_full(self->clients, evend_ws_websocket_client_disconnect);
     self->clients = NULL;
 
+    g_strfreev(self->server_binds);
+    self->server_binds = NULL;
+
     g_object_unref(self->server);
+    self->server = NULL;
+}
+
+static gboolean
+_evend_ws_binds_equal(const gchar * const *a, const gchar * const *b)
+{
+    if ( ( a == NULL ) || ( b == NULL ) )
+        return ( a == b );
+    return g_strv_equal(a, b);
+}
+
+static void
+_evend_ws_reload(EventdPluginContext *self)
+{
+    if ( self->server == NULL )
+        return;
+
+    /* Only restart the server, and drop our clients, if we have to */
+    if ( ( ! _evend_ws_binds_equal((const gchar * const *) self->binds, (const gchar * const *) self->server_binds) ) || ( self->server_auth != ( self->secret != NULL ) ) )
+    {
+        _evend_ws_stop(self);
+        _evend_ws_start(self);
+    }
+    else if ( self->certificate != NULL )
+        soup_server_set_tls_certificate(self->server, self->certificate);
 }
 
 
@@ -253,6 +282,38 @@ _evend_ws_config_reset(EventdPluginContext *self)
 }
 
 
+/*
+ * Control command interface
+ */
+
+static EventdPluginCommandStatus
+_evend_ws_control_command(EventdPluginContext *self, guint64 argc, const gchar * const *argv, gchar **status)
+{
+    EventdPluginCommandStatus r;
+
+    if ( g_strcmp0(argv[0], "stats") == 0 )
+    {
+        GString *str;
+        GList *client;
+
+        str = g_string_new(NULL);
+        g_string_append_printf(str, "%u clients connected, %" G_GUINT64_FORMAT " events received, %" G_GUINT64_FORMAT " events sent", g_list_length(self->clients), self->stats.received, self->stats.sent);
+        for ( client = self->clients ; client != NULL ; client = g_list_next(client) )
+            evend_ws_websocket_client_append_stats(client->data, str);
+
+        *status = g_string_free(str, FALSE);
+        r = EVENTD_PLUGIN_COMMAND_STATUS_OK;
+    }
+    else
+    {
+        *status = g_strdup_printf("Unknown command '%s'", argv[0]);
+        r = EVENTD_PLUGIN_COMMAND_STATUS_COMMAND_ERROR;
+    }
+
+    return r;
+}
+
+
 /*
  * Event dispatching interface
  */
@@ -264,8 +325,9 @@ _evend_ws_event_dispatch(EventdPluginContext *self, EventdEvent *event)
         return;
 
     const gchar *category;
-    GList *subscribers;
+    GPtrArray *subscribers;
     GList *client;
+    guint i;
 
     category = eventd_event_get_category(event);
     if ( category[0] == '.' )
@@ -275,13 +337,10 @@ _evend_ws_event_dispatch(EventdPluginContext *self, EventdEvent *event)
         return;
     }
 
-    subscribers = self->subscribe_all;
-    for ( client = subscribers ; client != NULL ; client = g_list_next(client) )
-        evend_ws_websocket_client_event_dispatch(client->data, event);
-
-    subscribers = g_hash_table_lookup(self->subscribe_categories, eventd_event_get_category(event));
-    for ( client = subscribers ; client != NULL ; client = g_list_next(client) )
-        evend_ws_websocket_client_event_dispatch(client->data, event);
+    subscribers = evhelpers_subscriptions_lookup(self->subscriptions, category);
+    for ( i = 0 ; i < subscribers->len ; ++i )
+        evend_ws_websocket_client_event_dispatch(g_ptr_array_index(subscribers, i), event);
+    g_ptr_array_unref(subscribers);
 }
 
 
@@ -300,6 +359,9 @@ eventd_plugin_get_interface(EventdPluginInterface *interface)
 
     eventd_plugin_interface_add_start_callback(interface, _evend_ws_start);
     eventd_plugin_interface_add_stop_callback(interface, _evend_ws_stop);
+    eventd_plugin_interface_add_reload_callback(interface, _evend_ws_reload);
+
+    eventd_plugin_interface_add_control_command_callback(interface, _evend_ws_control_command);
 
     eventd_plugin_interface_add_global_parse_callback(interface, _evend_ws_global_parse);
     eventd_plugin_interface_add_config_reset_callback(interface, _evend_ws_config_reset);
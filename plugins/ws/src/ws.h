@@ -23,15 +23,23 @@
 #ifndef __EVENTD_WS_H__
 #define __EVENTD_WS_H__
 
+#include "libeventd-helpers-subscriptions.h"
+
 struct _EventdPluginContext {
     EventdPluginCoreContext *core;
     gchar *secret;
     gchar **binds;
     SoupServer *server;
+    gchar **server_binds;
+    gboolean server_auth;
     GTlsCertificate *certificate;
     GList *clients;
-    GList *subscribe_all;
-    GHashTable *subscribe_categories;
+    LibeventdSubscriptions *subscriptions;
+    guint64 next_client_id;
+    struct {
+        guint64 received;
+        guint64 sent;
+    } stats;
 };
 
 #endif /* __EVENTD_WS_H__ */
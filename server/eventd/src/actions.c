@@ -33,6 +33,7 @@
 #include "eventd.h"
 #include "config_.h"
 #include "plugins.h"
+#include "flags.h"
 
 #include "actions.h"
 
@@ -41,8 +42,8 @@ struct _EventdActions {
 };
 
 typedef struct {
-    GQuark *add;
-    GQuark *remove;
+    EventdFlags add;
+    EventdFlags remove;
 } EventdActionsFlagsAction;
 
 typedef struct {
@@ -61,6 +62,9 @@ _eventd_actions_action_free(gpointer data)
     g_list_free(self->subactions);
     g_list_free_full(self->actions, eventd_plugins_action_free);
 
+    eventd_flags_clear(&self->flags.remove);
+    eventd_flags_clear(&self->flags.add);
+
     g_free(self->id);
 
     g_slice_free(EventdActionsAction, self);
@@ -99,9 +103,9 @@ eventd_actions_parse(EventdActions *self, GKeyFile *file, const gchar *default_i
         gchar **list;
         gsize length;
         if ( evhelpers_config_key_file_get_string_list(file, "Flags", "Add", &list, &length) == 0 )
-            action->flags.add = eventd_config_parse_flags_list(list, length);
+            eventd_flags_parse_list(&action->flags.add, list, length);
         if ( evhelpers_config_key_file_get_string_list(file, "Flags", "Remove", &list, &length) == 0 )
-            action->flags.remove = eventd_config_parse_flags_list(list, length);
+            eventd_flags_parse_list(&action->flags.remove, list, length);
     }
 
     action->actions = eventd_plugins_event_parse_all(file);
@@ -157,20 +161,15 @@ _eventd_actions_dump_action(GString *dump, EventdActionsAction *action)
 {
     g_string_append_printf(dump, "Name: %s", action->id);
 
-    GQuark *flag;
-    if ( action->flags.add != NULL )
+    if ( ! eventd_flags_is_empty(&action->flags.add) )
     {
-        g_string_append(dump, "\n    Adding flags:");
-        for ( flag = action->flags.add ; *flag != 0 ; ++flag )
-            g_string_append_printf(dump, " %s,", g_quark_to_string(*flag));
-        g_string_truncate(dump, dump->len - 1);
+        g_string_append(dump, "\n    Adding flags: ");
+        eventd_flags_dump(&action->flags.add, dump, ", ");
     }
-    if ( action->flags.remove != NULL )
+    if ( ! eventd_flags_is_empty(&action->flags.remove) )
     {
-        g_string_append(dump, "\n    Removing flags:");
-        for ( flag = action->flags.remove ; *flag != 0 ; ++flag )
-            g_string_append_printf(dump, " %s,", g_quark_to_string(*flag));
-        g_string_truncate(dump, dump->len - 1);
+        g_string_append(dump, "\n    Removing flags: ");
+        eventd_flags_dump(&action->flags.remove, dump, ", ");
     }
 
     if ( action->actions != NULL )
@@ -211,22 +210,6 @@ eventd_actions_dump_action(EventdActions *self, const gchar *action_id)
     return g_string_free(dump, FALSE);
 }
 
-static void
-_eventd_actions_trigger_flags(EventdCoreContext *core, EventdActionsFlagsAction *action)
-{
-    GQuark *flag;
-    if ( action->add != NULL )
-    {
-        for ( flag = action->add ; *flag != 0 ; ++flag )
-            eventd_core_flags_add(core, *flag);
-    }
-    if ( action->remove != NULL )
-    {
-        for ( flag = action->remove ; *flag != 0 ; ++flag )
-            eventd_core_flags_remove(core, *flag);
-    }
-}
-
 void
 eventd_actions_trigger(EventdCoreContext *core, const GList *action_, EventdEvent *event)
 {
@@ -234,7 +217,7 @@ eventd_actions_trigger(EventdCoreContext *core, const GList *action_, EventdEven
     {
         EventdActionsAction *action = action_->data;
         g_debug("Triggering action %s", action->id);
-        _eventd_actions_trigger_flags(core, &action->flags);
+        eventd_core_flags_update(core, &action->flags.add, &action->flags.remove);
         eventd_plugins_event_action_all(action->actions, event);
         eventd_actions_trigger(core, action->subactions, event);
     }
@@ -22,11 +22,15 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
 
 #include "libeventd-event.h"
+#include "libeventd-event-private.h"
 #include "libeventd-helpers-config.h"
 #include "libeventd-helpers-dirs.h"
 
@@ -47,21 +51,52 @@ struct _EventdConfig {
     EventdActions *actions;
 };
 
+typedef enum {
+    EVENTD_CONFIG_FILE_GLOBAL,
+    EVENTD_CONFIG_FILE_EVENT,
+    EVENTD_CONFIG_FILE_ACTION,
+} EventdConfigFileType;
+
+typedef struct {
+    EventdConfigFileType type;
+    gchar *path;
+    gchar *id;
+    gint64 mtime;
+    guint64 size;
+    GKeyFile *file;
+    gboolean broken;
+} EventdConfigFile;
+
+typedef struct {
+    GPtrArray *list;
+    GList *global_files;
+    GHashTable *action_files;
+    GHashTable *event_files;
+} EventdConfigFiles;
+
 gboolean
-eventd_config_process_event(EventdConfig *config, EventdEvent *event, GQuark *flags, const GList **actions)
+eventd_config_process_event(EventdConfig *config, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits)
 {
-    return eventd_events_process_event(config->events, event, flags, actions);
+    return eventd_events_process_event(config->events, event, flags, actions, limits);
 }
 
 
 static void
 _eventd_config_defaults(EventdConfig *config)
 {
+    eventd_event_slab_set_size(0);
 }
 
 static void
 _eventd_config_parse_global(EventdConfig *config, GKeyFile *config_file)
 {
+    if ( g_key_file_has_group(config_file, "Server") )
+    {
+        gint64 slab_size;
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, "Server", "EventSlabSize", 0, &slab_size) == 0 )
+            eventd_event_slab_set_size(CLAMP(slab_size, 0, G_MAXUINT));
+    }
+
     if ( g_tls_backend_supports_tls(g_tls_backend_get_default()) && g_key_file_has_group(config_file, "Server") )
     {
         gchar *priorities;
@@ -75,119 +110,209 @@ _eventd_config_parse_global(EventdConfig *config, GKeyFile *config_file)
 }
 
 static void
-_eventd_config_read_dir(EventdConfig *config, GHashTable *action_files, GHashTable *event_files, const gchar *config_dir_name, gsize base_dir_offset)
+_eventd_config_file_free(gpointer data)
+{
+    EventdConfigFile *file = data;
+
+    if ( file->file != NULL )
+        g_key_file_unref(file->file);
+    g_free(file->id);
+    g_free(file->path);
+
+    g_slice_free(EventdConfigFile, file);
+}
+
+static void
+_eventd_config_add_file(GPtrArray *list, EventdConfigFileType type, GFile *file, GFileInfo *info, gsize base_dir_offset)
+{
+    EventdConfigFile *config_file;
+
+    config_file = g_slice_new0(EventdConfigFile);
+    config_file->type = type;
+    config_file->path = g_file_get_path(file);
+    if ( type != EVENTD_CONFIG_FILE_GLOBAL )
+        config_file->id = g_strdup(config_file->path + base_dir_offset);
+    config_file->mtime = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC + g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    config_file->size = g_file_info_get_size(info);
+
+    g_ptr_array_add(list, config_file);
+}
+
+#define EVENTD_CONFIG_SCAN_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+static void
+_eventd_config_scan_dir(GPtrArray *list, GFile *config_dir, gsize base_dir_offset)
 {
     GError *error = NULL;
-    GDir *config_dir;
+    GFileEnumerator *enumerator;
 
-    config_dir = g_dir_open(config_dir_name, 0, &error);
-    if ( config_dir == NULL )
+    enumerator = g_file_enumerate_children(config_dir, EVENTD_CONFIG_SCAN_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL, &error);
+    if ( enumerator == NULL )
     {
+        gchar *config_dir_name = g_file_get_path(config_dir);
         g_warning("Can't read configuration directory '%s': %s", config_dir_name, error->message);
         g_clear_error(&error);
+        g_free(config_dir_name);
         return;
     }
 
-    gchar *config_file_name = NULL;
-    GKeyFile *config_file = NULL;
-    const gchar *file;
-    while ( ( file = g_dir_read_name(config_dir) ) != NULL )
+    GFileInfo *info;
+    GFile *file;
+    while ( g_file_enumerator_iterate(enumerator, &info, &file, NULL, &error) && ( info != NULL ) )
     {
-        if ( g_str_has_prefix(file, ".") )
+        const gchar *name = g_file_info_get_name(info);
+        GFileType type = g_file_info_get_file_type(info);
+
+        if ( g_str_has_prefix(name, ".") )
             continue;
 
-        config_file_name = g_build_filename(config_dir_name, file, NULL);
-        const gchar *config_file_id = config_file_name + base_dir_offset;
+        if ( g_str_has_suffix(name, ".event") && ( type == G_FILE_TYPE_REGULAR ) )
+            _eventd_config_add_file(list, EVENTD_CONFIG_FILE_EVENT, file, info, base_dir_offset);
+        else if ( g_str_has_suffix(name, ".action") && ( type == G_FILE_TYPE_REGULAR ) )
+            _eventd_config_add_file(list, EVENTD_CONFIG_FILE_ACTION, file, info, base_dir_offset);
+        else if ( type == G_FILE_TYPE_DIRECTORY )
+            _eventd_config_scan_dir(list, file, base_dir_offset);
+    }
+    if ( error != NULL )
+    {
+        g_warning("Can't read configuration directory: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_object_unref(enumerator);
+}
 
-        if ( g_str_has_suffix(file, ".event") && g_file_test(config_file_name, G_FILE_TEST_IS_REGULAR) )
-        {
-            config_file = g_key_file_new();
-            if ( ! g_key_file_load_from_file(config_file, config_file_name, G_KEY_FILE_NONE, &error) )
-            {
-                g_warning("Can't read the event file '%s': %s", config_file_name, error->message);
-                g_clear_error(&error);
-                g_key_file_free(config_file);
-            }
-            else
-                g_hash_table_insert(event_files, g_strdup(config_file_id), config_file);
-        }
-        else if ( g_str_has_suffix(file, ".action") && g_file_test(config_file_name, G_FILE_TEST_IS_REGULAR) )
+static void
+_eventd_config_scan(GPtrArray *list, const gchar *config_dir_name)
+{
+    GFile *config_dir, *file;
+    GFileInfo *info;
+
+    eventd_debug("Scanning configuration dir: %s", config_dir_name);
+
+    config_dir = g_file_new_for_path(config_dir_name);
+
+    file = g_file_get_child(config_dir, PACKAGE_NAME ".conf");
+    info = g_file_query_info(file, EVENTD_CONFIG_SCAN_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if ( ( info != NULL ) && ( g_file_info_get_file_type(info) == G_FILE_TYPE_REGULAR ) )
+        _eventd_config_add_file(list, EVENTD_CONFIG_FILE_GLOBAL, file, info, 0);
+    if ( info != NULL )
+        g_object_unref(info);
+    g_object_unref(file);
+
+    _eventd_config_scan_dir(list, config_dir, strlen(config_dir_name) + 1);
+
+    g_object_unref(config_dir);
+}
+
+static void
+_eventd_config_load_file(gpointer data, gpointer user_data)
+{
+    EventdConfigFile *config_file = data;
+    GError *error = NULL;
+    GKeyFile *file;
+
+    file = g_key_file_new();
+    if ( ! g_key_file_load_from_file(file, config_file->path, G_KEY_FILE_NONE, &error) )
+    {
+        switch ( config_file->type )
         {
-            config_file = g_key_file_new();
-            if ( ! g_key_file_load_from_file(config_file, config_file_name, G_KEY_FILE_NONE, &error) )
-            {
-                g_warning("Can't read the action file '%s': %s", config_file_name, error->message);
-                g_clear_error(&error);
-                g_key_file_free(config_file);
-            }
-            else if ( ! g_key_file_has_group(config_file, "Action") )
-                g_key_file_free(config_file);
-            else
-                g_hash_table_insert(action_files, g_strdup(config_file_id), config_file);
+        case EVENTD_CONFIG_FILE_GLOBAL:
+            g_warning("Can't read the configuration file '%s': %s", config_file->path, error->message);
+        break;
+        case EVENTD_CONFIG_FILE_EVENT:
+            g_warning("Can't read the event file '%s': %s", config_file->path, error->message);
+        break;
+        case EVENTD_CONFIG_FILE_ACTION:
+            g_warning("Can't read the action file '%s': %s", config_file->path, error->message);
+        break;
         }
-        else if ( g_file_test(config_file_name, G_FILE_TEST_IS_DIR) )
-            _eventd_config_read_dir(config, action_files, event_files, config_file_name, base_dir_offset);
-
-        g_free(config_file_name);
+        g_clear_error(&error);
+        g_key_file_unref(file);
+        config_file->broken = TRUE;
     }
-    g_dir_close(config_dir);
+    else if ( ( config_file->type == EVENTD_CONFIG_FILE_ACTION ) && ( ! g_key_file_has_group(file, "Action") ) )
+        g_key_file_unref(file);
+    else
+        config_file->file = file;
 }
 
 static void
-_eventd_config_load_dir(EventdConfig *config, GHashTable *action_files, GHashTable *event_files, const gchar *config_dir_name)
+_eventd_config_load_files(GPtrArray *list)
 {
-    GError *error = NULL;
-    gchar *config_file_name = NULL;
+    GThreadPool *pool;
+    guint i;
 
-    eventd_debug("Scanning configuration dir: %s", config_dir_name);
+    pool = g_thread_pool_new(_eventd_config_load_file, NULL, g_get_num_processors(), TRUE, NULL);
+    if ( pool == NULL )
+    {
+        g_ptr_array_foreach(list, _eventd_config_load_file, NULL);
+        return;
+    }
+
+    for ( i = 0 ; i < list->len ; ++i )
+        g_thread_pool_push(pool, g_ptr_array_index(list, i), NULL);
+
+    /* Waits for all the files to be loaded */
+    g_thread_pool_free(pool, FALSE, TRUE);
+}
 
-    config_file_name = g_build_filename(config_dir_name, PACKAGE_NAME ".conf", NULL);
-    if ( g_file_test(config_file_name, G_FILE_TEST_IS_REGULAR) )
+static void
+_eventd_config_key_file_copy(GKeyFile *dest, GKeyFile *src)
+{
+    gchar **groups, **group;
+
+    groups = g_key_file_get_groups(src, NULL);
+    for ( group = groups ; *group != NULL ; ++group )
     {
-        GKeyFile *config_file;
-        config_file = g_key_file_new();
-        if ( ! g_key_file_load_from_file(config_file, config_file_name, G_KEY_FILE_NONE, &error) )
-            g_warning("Can't read the configuration file '%s': %s", config_file_name, error->message);
-        else
+        gchar **keys, **key;
+        keys = g_key_file_get_keys(src, *group, NULL, NULL);
+        for ( key = keys ; *key != NULL ; ++key )
         {
-            _eventd_config_parse_global(config, config_file);
-            eventd_plugins_global_parse_all(config_file);
+            if ( ( g_strcmp0(*group, "File") == 0 ) && ( g_strcmp0(*key, "Extends") == 0 ) )
+                continue;
+
+            gchar *value = g_key_file_get_value(src, *group, *key, NULL);
+            g_key_file_set_value(dest, *group, *key, value);
+            g_free(value);
         }
-        g_clear_error(&error);
-        g_key_file_free(config_file);
+        g_strfreev(keys);
     }
-    g_free(config_file_name);
+    g_strfreev(groups);
+}
 
-    _eventd_config_read_dir(config, action_files, event_files, config_dir_name, g_utf8_strlen(config_dir_name, -1) + 1);
+static void
+_eventd_config_key_file_unref(GKeyFile *file)
+{
+    if ( file != NULL )
+        g_key_file_unref(file);
 }
 
 static GKeyFile *
-_eventd_config_process_config_file(GHashTable *files, const gchar *id, GKeyFile *file)
+_eventd_config_resolve_file(GHashTable *files, GHashTable *resolved, const gchar *id, GKeyFile *file)
 {
+    GKeyFile *new_file;
+    if ( g_hash_table_lookup_extended(resolved, id, NULL, (gpointer *) &new_file) )
+        /* NULL if it failed or if we are already resolving it */
+        return new_file;
+
     if ( ! g_key_file_has_group(file, "File") )
-        return file;
+        goto unchanged;
 
     gchar *parent_id;
 
     switch ( evhelpers_config_key_file_get_string(file, "File", "Extends", &parent_id) )
     {
     case 1:
-        return file;
+        goto unchanged;
     case -1:
+        g_hash_table_insert(resolved, g_strdup(id), NULL);
         return NULL;
     case 0:
     break;
     }
 
-    GKeyFile *new_file = NULL;
-
-    GError *error = NULL;
-    if ( ! g_key_file_remove_key(file, "File", "Extends", &error) )
-    {
-        g_warning("Couldn't clean event file '%s': %s", id, error->message);
-        g_clear_error(&error);
-        goto fail;
-    }
+    new_file = NULL;
+    g_hash_table_insert(resolved, g_strdup(id), NULL);
 
     GKeyFile *parent;
     parent = g_hash_table_lookup(files, parent_id);
@@ -197,37 +322,365 @@ _eventd_config_process_config_file(GHashTable *files, const gchar *id, GKeyFile
         goto fail;
     }
 
-    if ( ( parent = _eventd_config_process_config_file(files, parent_id, parent) ) == NULL )
+    if ( ( parent = _eventd_config_resolve_file(files, resolved, parent_id, parent) ) == NULL )
+    {
+        g_warning("Couldn't merge '%s' and '%s'", id, parent_id);
         goto fail;
+    }
 
-    GString *merged_data;
-    gchar *data;
+    new_file = g_key_file_new();
+    _eventd_config_key_file_copy(new_file, parent);
+    _eventd_config_key_file_copy(new_file, file);
+    g_hash_table_insert(resolved, g_strdup(id), new_file);
 
-    data = g_key_file_to_data(parent, NULL, NULL);
-    merged_data = g_string_new(data);
-    g_free(data);
+fail:
+    g_free(parent_id);
 
-    data = g_key_file_to_data(file, NULL, NULL);
-    g_string_append(merged_data, data);
-    g_free(data);
+    return new_file;
 
-    new_file = g_key_file_new();
-    if ( g_key_file_load_from_data(new_file, merged_data->str, -1, G_KEY_FILE_NONE, &error) )
-        g_hash_table_insert(files, g_strdup(id), new_file);
-    else
+unchanged:
+    g_hash_table_insert(resolved, g_strdup(id), g_key_file_ref(file));
+    return file;
+}
+
+static void
+_eventd_config_resolve_files(GHashTable *resolved_files, GHashTable *files)
+{
+    GHashTable *resolved;
+    GHashTableIter iter;
+    gchar *id;
+    GKeyFile *file;
+
+    resolved = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) _eventd_config_key_file_unref);
+
+    g_hash_table_iter_init(&iter, files);
+    while ( g_hash_table_iter_next(&iter, (gpointer *) &id, (gpointer *) &file) )
+    {
+        if ( ( file = _eventd_config_resolve_file(files, resolved, id, file) ) != NULL )
+            g_hash_table_insert(resolved_files, g_strdup(id), g_key_file_ref(file));
+    }
+
+    g_hash_table_unref(resolved);
+    g_hash_table_unref(files);
+}
+
+/*
+ * The cache is a little-endian serialized GVariant of this type:
+ * version, files manifest, global files, resolved event files, resolved action files
+ * Key files are stored as a list of groups with their list of key-value pairs
+ */
+#define EVENTD_CONFIG_CACHE_VERSION 1
+#define EVENTD_CONFIG_CACHE_KEY_FILE_TYPE "a(sa(ss))"
+#define EVENTD_CONFIG_CACHE_TYPE "(ua(ussxt)a" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE "a(s" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE ")a(s" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE "))"
+
+static gchar *
+_eventd_config_cache_get_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), PACKAGE_NAME, "config.cache", NULL);
+}
+
+static GVariant *
+_eventd_config_cache_key_file_to_variant(GKeyFile *file)
+{
+    GVariantBuilder builder;
+    gchar **groups, **group;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(EVENTD_CONFIG_CACHE_KEY_FILE_TYPE));
+    groups = g_key_file_get_groups(file, NULL);
+    for ( group = groups ; *group != NULL ; ++group )
+    {
+        gchar **keys, **key;
+
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("(sa(ss))"));
+        g_variant_builder_add(&builder, "s", *group);
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("a(ss)"));
+        keys = g_key_file_get_keys(file, *group, NULL, NULL);
+        for ( key = keys ; *key != NULL ; ++key )
+        {
+            gchar *value = g_key_file_get_value(file, *group, *key, NULL);
+            g_variant_builder_add(&builder, "(ss)", *key, value);
+            g_free(value);
+        }
+        g_strfreev(keys);
+        g_variant_builder_close(&builder);
+        g_variant_builder_close(&builder);
+    }
+    g_strfreev(groups);
+
+    return g_variant_builder_end(&builder);
+}
+
+static GKeyFile *
+_eventd_config_cache_key_file_from_variant(GVariant *variant)
+{
+    GKeyFile *file;
+    GVariantIter groups;
+    const gchar *group;
+    GVariantIter *keys;
+
+    file = g_key_file_new();
+    g_variant_iter_init(&groups, variant);
+    while ( g_variant_iter_next(&groups, "(&sa(ss))", &group, &keys) )
+    {
+        const gchar *key, *value;
+        while ( g_variant_iter_next(keys, "(&s&s)", &key, &value) )
+            g_key_file_set_value(file, group, key, value);
+        g_variant_iter_free(keys);
+    }
+
+    return file;
+}
+
+static GVariant *
+_eventd_config_cache_files_to_variant(GHashTable *files)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    const gchar *id;
+    GKeyFile *file;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(s" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE ")"));
+    g_hash_table_iter_init(&iter, files);
+    while ( g_hash_table_iter_next(&iter, (gpointer *) &id, (gpointer *) &file) )
+        g_variant_builder_add(&builder, "(s@" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE ")", id, _eventd_config_cache_key_file_to_variant(file));
+
+    return g_variant_builder_end(&builder);
+}
+
+static void
+_eventd_config_cache_files_from_variant(GHashTable *files, GVariant *variant)
+{
+    GVariantIter iter;
+    const gchar *id;
+    GVariant *file;
+
+    g_variant_iter_init(&iter, variant);
+    while ( g_variant_iter_next(&iter, "(&s@" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE ")", &id, &file) )
+    {
+        g_hash_table_insert(files, g_strdup(id), _eventd_config_cache_key_file_from_variant(file));
+        g_variant_unref(file);
+    }
+}
+
+static gboolean
+_eventd_config_cache_load(EventdConfigFiles *files)
+{
+    GError *error = NULL;
+    gchar *path;
+    GMappedFile *file;
+
+    path = _eventd_config_cache_get_path();
+    file = g_mapped_file_new(path, FALSE, &error);
+    g_free(path);
+    if ( file == NULL )
     {
-        g_warning("Couldn't merge '%s' and '%s': %s", id, parent_id, error->message);
+        if ( ! g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT) )
+            g_warning("Couldn't load configuration cache: %s", error->message);
         g_clear_error(&error);
-        g_key_file_free(new_file);
-        new_file = NULL;
+        return FALSE;
     }
 
-    g_string_free(merged_data, TRUE);
+    GBytes *bytes;
+    GVariant *cache;
 
-fail:
-    g_free(parent_id);
+    bytes = g_mapped_file_get_bytes(file);
+    g_mapped_file_unref(file);
+    cache = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(EVENTD_CONFIG_CACHE_TYPE), bytes, FALSE));
+    g_bytes_unref(bytes);
 
-    return new_file;
+    if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+    {
+        GVariant *swapped = g_variant_byteswap(cache);
+        g_variant_unref(cache);
+        cache = swapped;
+    }
+
+    gboolean ret = FALSE;
+    guint32 version;
+    GVariantIter *manifest;
+    GVariant *globals, *events, *actions;
+
+    g_variant_get(cache, "(ua(ussxt)@a" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE "@a(s" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE ")@a(s" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE "))", &version, &manifest, &globals, &events, &actions);
+    if ( version != EVENTD_CONFIG_CACHE_VERSION )
+        goto out;
+
+    if ( g_variant_iter_n_children(manifest) != files->list->len )
+        goto out;
+
+    guint32 type;
+    const gchar *file_path, *id;
+    gint64 mtime;
+    guint64 size;
+    guint i = 0;
+    while ( g_variant_iter_next(manifest, "(u&s&sxt)", &type, &file_path, &id, &mtime, &size) )
+    {
+        EventdConfigFile *config_file = g_ptr_array_index(files->list, i++);
+        if ( ( type != config_file->type ) || ( g_strcmp0(file_path, config_file->path) != 0 ) || ( g_strcmp0(id, ( config_file->id != NULL ) ? config_file->id : "") != 0 ) || ( mtime != config_file->mtime ) || ( size != config_file->size ) )
+            goto out;
+    }
+
+    GVariantIter iter;
+    GVariant *global;
+    g_variant_iter_init(&iter, globals);
+    while ( g_variant_iter_next(&iter, "@" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE, &global) )
+    {
+        files->global_files = g_list_append(files->global_files, _eventd_config_cache_key_file_from_variant(global));
+        g_variant_unref(global);
+    }
+    _eventd_config_cache_files_from_variant(files->event_files, events);
+    _eventd_config_cache_files_from_variant(files->action_files, actions);
+
+    ret = TRUE;
+
+out:
+    g_variant_iter_free(manifest);
+    g_variant_unref(actions);
+    g_variant_unref(events);
+    g_variant_unref(globals);
+    g_variant_unref(cache);
+
+    return ret;
+}
+
+static void
+_eventd_config_cache_save(EventdConfigFiles *files)
+{
+    GVariantBuilder builder;
+    guint i;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(EVENTD_CONFIG_CACHE_TYPE));
+    g_variant_builder_add(&builder, "u", EVENTD_CONFIG_CACHE_VERSION);
+
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("a(ussxt)"));
+    for ( i = 0 ; i < files->list->len ; ++i )
+    {
+        EventdConfigFile *config_file = g_ptr_array_index(files->list, i);
+        g_variant_builder_add(&builder, "(ussxt)", config_file->type, config_file->path, ( config_file->id != NULL ) ? config_file->id : "", config_file->mtime, config_file->size);
+    }
+    g_variant_builder_close(&builder);
+
+    GList *global_file;
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("a" EVENTD_CONFIG_CACHE_KEY_FILE_TYPE));
+    for ( global_file = files->global_files ; global_file != NULL ; global_file = g_list_next(global_file) )
+        g_variant_builder_add_value(&builder, _eventd_config_cache_key_file_to_variant(global_file->data));
+    g_variant_builder_close(&builder);
+
+    g_variant_builder_add_value(&builder, _eventd_config_cache_files_to_variant(files->event_files));
+    g_variant_builder_add_value(&builder, _eventd_config_cache_files_to_variant(files->action_files));
+
+    GVariant *cache;
+    cache = g_variant_ref_sink(g_variant_builder_end(&builder));
+    if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+    {
+        GVariant *swapped = g_variant_byteswap(cache);
+        g_variant_unref(cache);
+        cache = swapped;
+    }
+
+    GError *error = NULL;
+    gchar *path, *dir;
+
+    path = _eventd_config_cache_get_path();
+    dir = g_path_get_dirname(path);
+    if ( g_mkdir_with_parents(dir, 0700) < 0 )
+        g_warning("Couldn't create the cache dir '%s': %s", dir, g_strerror(errno));
+    else if ( ! g_file_set_contents(path, g_variant_get_data(cache), g_variant_get_size(cache), &error) )
+    {
+        g_warning("Couldn't save configuration cache: %s", error->message);
+        g_clear_error(&error);
+    }
+    g_free(dir);
+    g_free(path);
+
+    g_variant_unref(cache);
+}
+
+static void
+_eventd_config_files_clean(EventdConfigFiles *files)
+{
+    g_list_free_full(files->global_files, (GDestroyNotify) g_key_file_unref);
+    g_hash_table_unref(files->event_files);
+    g_hash_table_unref(files->action_files);
+}
+
+static gboolean
+_eventd_config_read(EventdConfig *config, EventdConfigFiles *files, gboolean system_mode, GError **error)
+{
+    gboolean ret = TRUE;
+
+    files->list = g_ptr_array_new_with_free_func(_eventd_config_file_free);
+    files->action_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_key_file_unref);
+    files->event_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_key_file_unref);
+
+    gchar **dirs, **dir;
+    dirs = evhelpers_dirs_get_config("CONFIG", system_mode, NULL);
+    for ( dir = dirs ; *dir != NULL ; ++dir )
+    {
+        _eventd_config_scan(files->list, *dir);
+        g_free(*dir);
+    }
+    g_free(dirs);
+    if ( ( config->arg_dir != NULL ) && g_file_test(config->arg_dir, G_FILE_TEST_IS_DIR) )
+        _eventd_config_scan(files->list, config->arg_dir);
+
+    if ( _eventd_config_cache_load(files) )
+    {
+        eventd_debug("Configuration loaded from cache");
+        goto out;
+    }
+
+    _eventd_config_load_files(files->list);
+
+    GHashTable *action_files, *event_files;
+    guint i;
+
+    for ( i = 0 ; i < files->list->len ; ++i )
+    {
+        EventdConfigFile *config_file = g_ptr_array_index(files->list, i);
+        if ( config_file->broken )
+        {
+            g_set_error(error, EVENTD_CONFIG_ERROR, EVENTD_CONFIG_ERROR_READ, "Couldn't read '%s'", config_file->path);
+            ret = FALSE;
+            break;
+        }
+    }
+
+    action_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_key_file_unref);
+    event_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_key_file_unref);
+
+    /* Later files override earlier ones with the same id */
+    for ( i = 0 ; i < files->list->len ; ++i )
+    {
+        EventdConfigFile *config_file = g_ptr_array_index(files->list, i);
+        if ( config_file->file == NULL )
+            continue;
+
+        switch ( config_file->type )
+        {
+        case EVENTD_CONFIG_FILE_GLOBAL:
+            files->global_files = g_list_append(files->global_files, g_key_file_ref(config_file->file));
+        break;
+        case EVENTD_CONFIG_FILE_EVENT:
+            g_hash_table_insert(event_files, g_strdup(config_file->id), g_key_file_ref(config_file->file));
+        break;
+        case EVENTD_CONFIG_FILE_ACTION:
+            g_hash_table_insert(action_files, g_strdup(config_file->id), g_key_file_ref(config_file->file));
+        break;
+        }
+    }
+
+    _eventd_config_resolve_files(files->event_files, event_files);
+    _eventd_config_resolve_files(files->action_files, action_files);
+
+    /* We want the warnings again until the file is fixed */
+    if ( ret )
+        _eventd_config_cache_save(files);
+
+out:
+    g_ptr_array_unref(files->list);
+    files->list = NULL;
+
+    return ret;
 }
 
 EventdConfig *
@@ -239,12 +692,10 @@ eventd_config_new(const gchar *arg_dir, gboolean system_mode)
 
     config->arg_dir = arg_dir;
 
-    config->actions = eventd_actions_new();
-    config->events = eventd_events_new();
-
     config->gnutls_priorities_env = g_getenv("G_TLS_GNUTLS_PRIORITY");
 
-    eventd_config_parse(config, system_mode);
+    /* At startup, we go with whatever we could read */
+    eventd_config_parse(config, system_mode, NULL);
 
     return config;
 }
@@ -256,36 +707,48 @@ _eventd_config_clean(EventdConfig *config)
         return;
 
     eventd_plugins_config_reset_all();
+}
 
-    eventd_events_reset(config->events);
-    eventd_actions_reset(config->actions);
+GQuark
+eventd_config_error_quark(void)
+{
+    return g_quark_from_static_string("eventd_config_error-quark");
 }
 
-void
-eventd_config_parse(EventdConfig *config, gboolean system_mode)
+gboolean
+eventd_config_parse(EventdConfig *config, gboolean system_mode, GError **error)
 {
+    EventdConfigFiles files = { .global_files = NULL };
+    gboolean reload = config->loaded;
+
+    /*
+     * First, we read every file without touching the running configuration
+     * so that a reload only holds the core for the actual parsing
+     * If a file is broken, the reload is aborted and we keep running
+     * with the current configuration
+     */
+    if ( ( ! _eventd_config_read(config, &files, system_mode, error) ) && reload )
+    {
+        _eventd_config_files_clean(&files);
+        return FALSE;
+    }
+
+    if ( reload )
+        eventd_plugins_reload_begin_all();
+
     _eventd_config_clean(config);
 
     config->loaded = TRUE;
 
     _eventd_config_defaults(config);
 
-    GHashTable *action_files;
-    GHashTable *event_files;
-
-    action_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_key_file_free);
-    event_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_key_file_free);
-
-    gchar **dirs, **dir;
-    dirs = evhelpers_dirs_get_config("CONFIG", system_mode, NULL);
-    for ( dir = dirs ; *dir != NULL ; ++dir )
+    GList *global_file;
+    for ( global_file = files.global_files ; global_file != NULL ; global_file = g_list_next(global_file) )
     {
-        _eventd_config_load_dir(config, action_files, event_files, *dir);
-        g_free(*dir);
+        _eventd_config_parse_global(config, global_file->data);
+        eventd_plugins_global_parse_all(global_file->data);
     }
-    g_free(dirs);
-    if ( ( config->arg_dir != NULL ) && g_file_test(config->arg_dir, G_FILE_TEST_IS_DIR) )
-        _eventd_config_load_dir(config, action_files, event_files, config->arg_dir);
+    g_list_free_full(files.global_files, (GDestroyNotify) g_key_file_unref);
 
     /*
      * We check the env early, and skip the configuration if found
@@ -294,28 +757,44 @@ eventd_config_parse(EventdConfig *config, gboolean system_mode)
     if ( config->gnutls_priorities != NULL )
         g_setenv("G_TLS_GNUTLS_PRIORITY", config->gnutls_priorities, TRUE);
 
+    /*
+     * We build the new events and actions aside and swap them in
+     * Events are processed synchronously in the core loop,
+     * so none of them can see a half-loaded configuration
+     */
+    EventdEvents *events;
+    EventdActions *actions;
     GHashTableIter iter;
     gchar *id;
     GKeyFile *config_file;
 
-    g_hash_table_iter_init(&iter, event_files);
+    events = eventd_events_new();
+    actions = eventd_actions_new();
+
+    g_hash_table_iter_init(&iter, files.event_files);
     while ( g_hash_table_iter_next(&iter, (gpointer *)&id, (gpointer *)&config_file) )
-    {
-        if ( ( config_file = _eventd_config_process_config_file(event_files, id, config_file) ) != NULL )
-            eventd_events_parse(config->events, config_file);
-    }
-    g_hash_table_unref(event_files);
+        eventd_events_parse(events, config_file);
+    g_hash_table_unref(files.event_files);
 
-    g_hash_table_iter_init(&iter, action_files);
+    g_hash_table_iter_init(&iter, files.action_files);
     while ( g_hash_table_iter_next(&iter, (gpointer *)&id, (gpointer *)&config_file) )
-    {
-        if ( ( config_file = _eventd_config_process_config_file(action_files, id, config_file) ) != NULL )
-            eventd_actions_parse(config->actions, config_file, id);
-    }
-    g_hash_table_unref(action_files);
+        eventd_actions_parse(actions, config_file, id);
+    g_hash_table_unref(files.action_files);
+
+    eventd_actions_link_actions(actions);
+    eventd_events_link_actions(events, actions);
 
-    eventd_actions_link_actions(config->actions);
-    eventd_events_link_actions(config->events, config->actions);
+    if ( config->events != NULL )
+        eventd_events_free(config->events);
+    if ( config->actions != NULL )
+        eventd_actions_free(config->actions);
+    config->events = events;
+    config->actions = actions;
+
+    if ( reload )
+        eventd_plugins_reload_end_all();
+
+    return TRUE;
 }
 
 void
@@ -323,33 +802,14 @@ eventd_config_free(EventdConfig *config)
 {
     _eventd_config_clean(config);
 
-    eventd_actions_free(config->actions);
-    eventd_events_free(config->events);
+    if ( config->actions != NULL )
+        eventd_actions_free(config->actions);
+    if ( config->events != NULL )
+        eventd_events_free(config->events);
 
     g_free(config);
 }
 
-GQuark *
-eventd_config_parse_flags_list(gchar **flags, gsize length)
-{
-    GQuark *quarks;
-
-    quarks = g_new0(GQuark, length + 1);
-    quarks[length] = 0;
-
-    gsize i;
-    for ( i = 0 ; i < length ; ++i )
-    {
-        gchar *flag = flags[i];
-        quarks[i] = g_quark_from_string(flag);
-        g_free(flag);
-    }
-
-    g_free(flags);
-
-    return quarks;
-}
-
 gchar *
 eventd_config_dump_event(EventdConfig *self, const gchar *event_id)
 {
@@ -23,13 +23,18 @@
 #ifndef __EVENTD_CONFIG_H__
 #define __EVENTD_CONFIG_H__
 
+typedef enum {
+    EVENTD_CONFIG_ERROR_READ,
+} EventdConfigError;
+
+GQuark eventd_config_error_quark(void);
+#define EVENTD_CONFIG_ERROR (eventd_config_error_quark())
+
 EventdConfig *eventd_config_new(const gchar *arg_dir, gboolean system_mode);
-void eventd_config_parse(EventdConfig *config, gboolean system_mode);
+gboolean eventd_config_parse(EventdConfig *config, gboolean system_mode, GError **error);
 void eventd_config_free(EventdConfig *config);
 
-gboolean eventd_config_process_event(EventdConfig *self, EventdEvent *event, GQuark *flags, const GList **actions);
-
-GQuark *eventd_config_parse_flags_list(gchar **flags, gsize length);
+gboolean eventd_config_process_event(EventdConfig *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits);
 
 gchar *eventd_config_dump_event(EventdConfig *self, const gchar *event_id);
 gchar *eventd_config_dump_action(EventdConfig *self, const gchar *action_id);
@@ -40,6 +40,7 @@
 
 #include "eventd.h"
 #include "plugins.h"
+#include "metrics.h"
 
 #include "control.h"
 
@@ -132,9 +133,24 @@ _eventd_service_private_connection_handler(GSocketService *socket_service, GSock
         return TRUE;
     }
     else if ( g_strcmp0(argv[0], "reload") == 0 )
-        eventd_core_config_reload(control->core);
+    {
+        if ( ! eventd_core_config_reload(control->core, &status) )
+            code = EVENTDCTL_RETURN_CODE_COMMAND_ERROR;
+    }
     else if ( g_strcmp0(argv[0], "version") == 0 )
         status = g_strdup(PACKAGE_NAME " " NK_PACKAGE_VERSION);
+    else if ( g_strcmp0(argv[0], "stats") == 0 )
+    {
+        if ( ( argc > 1 ) && ( g_strcmp0(argv[1], "openmetrics") == 0 ) )
+            status = eventd_metrics_dump_openmetrics();
+        else if ( argc > 1 )
+        {
+            status = g_strdup_printf("Unknown stats format '%s'", argv[1]);
+            code = EVENTDCTL_RETURN_CODE_COMMAND_ERROR;
+        }
+        else
+            status = eventd_metrics_dump();
+    }
     else if ( g_strcmp0(argv[0], "dump") == 0 )
     {
         if ( argc < 2 )
@@ -56,6 +56,9 @@
 #include "actions.h"
 #include "control.h"
 #include "sockets.h"
+#include "metrics.h"
+#include "flags.h"
+#include "limits.h"
 
 #include "eventd.h"
 
@@ -71,12 +74,13 @@ struct _EventdCoreContext {
     EventdCoreInterface iface;
     NkUuid uuid;
     EventdConfig *config;
+    EventdLimits *limits;
     EventdControl *control;
     EventdSockets *sockets;
+    EventdMetricsEndpoint *metrics;
     gboolean system_mode;
     GMainLoop *loop;
-    gsize flags_count;
-    GQuark *flags;
+    EventdFlags flags;
     EventdControlDelayedStop *delayed_stop;
 };
 
@@ -98,75 +102,83 @@ eventd_core_get_uuid(EventdCoreContext *context)
     return context->uuid.string;
 }
 
+static void
+_eventd_core_limits_trigger(const GList *actions, EventdEvent *event, gpointer user_data)
+{
+    EventdCoreContext *context = user_data;
+
+    eventd_actions_trigger(context, actions, event);
+}
+
 gboolean
 eventd_core_push_event(EventdCoreContext *context, EventdEvent *event)
 {
     const gchar *category;
+    gint64 start;
+
+    eventd_metrics_count(EVENTD_METRICS_COUNTER_EVENTS);
+
     category = eventd_event_get_category(event);
     if ( category[0] == '.' )
     {
+        eventd_metrics_count(EVENTD_METRICS_COUNTER_EVENTS_INTERNAL);
+        start = eventd_metrics_now();
         eventd_plugins_event_dispatch_all(event);
+        eventd_metrics_stage(EVENTD_METRICS_STAGE_DISPATCH, start);
         return TRUE;
     }
 
     const GList *actions;
-    if ( ! eventd_config_process_event(context->config, event, context->flags, &actions) )
+    EventdLimitsRule *limits = NULL;
+    gboolean matched;
+    start = eventd_metrics_now();
+    matched = eventd_config_process_event(context->config, event, &context->flags, &actions, &limits);
+    eventd_metrics_stage(EVENTD_METRICS_STAGE_PROCESS, start);
+    if ( ! matched )
+    {
+        eventd_metrics_count(EVENTD_METRICS_COUNTER_EVENTS_UNMATCHED);
         return FALSE;
+    }
 
+    start = eventd_metrics_now();
     eventd_plugins_event_dispatch_all(event);
-    eventd_actions_trigger(context, actions, event);
+    eventd_metrics_stage(EVENTD_METRICS_STAGE_DISPATCH, start);
 
-    return TRUE;
-}
+    start = eventd_metrics_now();
+    eventd_limits_process(context->limits, limits, actions, event);
+    eventd_metrics_stage(EVENTD_METRICS_STAGE_ACTIONS, start);
 
-gsize
-_eventd_core_flags_find(EventdCoreContext *context, GQuark flag)
-{
-    gsize i;
-    for ( i = 0 ; i < context->flags_count ; ++i )
-    {
-        if ( context->flags[i] == flag )
-            break;
-    }
-    return i;
+    return TRUE;
 }
 
 void
 eventd_core_flags_add(EventdCoreContext *context, GQuark flag)
 {
-    if ( eventd_core_flags_test(context, flag) )
-        return;
-
-    context->flags = g_renew(GQuark, context->flags, ++context->flags_count + 1);
-    context->flags[context->flags_count-1] = flag;
-    context->flags[context->flags_count] = 0;
+    eventd_flags_add(&context->flags, eventd_flags_get_index(flag));
 }
 
 void
 eventd_core_flags_remove(EventdCoreContext *context, GQuark flag)
 {
-    gsize i = _eventd_core_flags_find(context, flag);
-    if ( i == context->flags_count )
-        return;
-
-    for ( ; i < context->flags_count ; ++i )
-        context->flags[i] = context->flags[i+1];
+    eventd_flags_remove(&context->flags, eventd_flags_get_index(flag));
+}
 
-    context->flags = g_renew(GQuark, context->flags, --context->flags_count + 1);
+void
+eventd_core_flags_update(EventdCoreContext *context, const EventdFlags *add, const EventdFlags *remove)
+{
+    eventd_flags_update(&context->flags, add, remove);
 }
 
 gboolean
 eventd_core_flags_test(EventdCoreContext *context, GQuark flag)
 {
-    return _eventd_core_flags_find(context, flag) < context->flags_count;
+    return eventd_flags_test(&context->flags, eventd_flags_get_index(flag));
 }
 
 void
 eventd_core_flags_reset(EventdCoreContext *context)
 {
-    g_free(context->flags);
-    context->flags = NULL;
-    context->flags_count = 0;
+    eventd_flags_clear(&context->flags);
 }
 
 gchar *
@@ -175,25 +187,35 @@ eventd_core_flags_list(EventdCoreContext *context)
     GString *r;
 
     r = g_string_new("Flags list: ");
-    guint i;
-    if ( context->flags_count == 0 )
+    if ( eventd_flags_is_empty(&context->flags) )
         g_string_append(r, "(empty)");
     else
-    {
-        for ( i = 0 ; i < context->flags_count ; ++i )
-            g_string_append(g_string_append(r, g_quark_to_string(context->flags[i])), ", ");
-        g_string_truncate(r, r->len - 2);
-    }
+        eventd_flags_dump(&context->flags, r, ", ");
 
     return g_string_free(r, FALSE);
 }
 
-void
-eventd_core_config_reload(EventdCoreContext *context)
+gboolean
+eventd_core_config_reload(EventdCoreContext *context, gchar **status)
 {
-    eventd_plugins_stop_all();
-    eventd_config_parse(context->config, context->system_mode);
-    eventd_plugins_start_all();
+    GError *error = NULL;
+    gint64 start, duration;
+
+    start = g_get_monotonic_time();
+    eventd_limits_flush(context->limits);
+    if ( ! eventd_config_parse(context->config, context->system_mode, &error) )
+    {
+        *status = g_strdup_printf("Configuration not reloaded: %s", error->message);
+        g_warning("%s", *status);
+        g_error_free(error);
+        return FALSE;
+    }
+    duration = g_get_monotonic_time() - start;
+
+    *status = g_strdup_printf("Configuration reloaded in %" G_GINT64_FORMAT ".%03" G_GINT64_FORMAT "ms", duration / 1000, duration % 1000);
+    g_debug("%s", *status);
+
+    return TRUE;
 }
 
 static void
@@ -326,6 +348,7 @@ main(int argc, char *argv[])
     gchar *runtime_dir = NULL;
     gchar *control_socket = NULL;
     gchar **binds = NULL;
+    gchar **metrics_binds = NULL;
     gboolean take_over_socket = FALSE;
     gboolean enable_relay = TRUE;
     gboolean enable_sd_modules = TRUE;
@@ -398,6 +421,7 @@ main(int argc, char *argv[])
     {
         { "private-socket",       'i', 0,                     G_OPTION_ARG_FILENAME,     &control_socket,       "Socket to listen for internal control", "<socket>" },
         { "listen",               'l', 0,                     G_OPTION_ARG_STRING_ARRAY, &binds,                "Add a socket to listen to",             "<socket>" },
+        { "metrics-listen",       0,   0,                     G_OPTION_ARG_STRING_ARRAY, &metrics_binds,        "Add a socket to serve metrics on",      "<socket>" },
         { "take-over",            't', GIO_UNIX_OPTION_FLAG,  G_OPTION_ARG_NONE,         &take_over_socket,     "Take over socket",                      NULL },
         { "no-relay",             0,   G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE,         &enable_relay,         "Disable the relay feature",             NULL },
         { "no-service-discovery", 0,   G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE,         &enable_sd_modules,    "Disable the service discovery feature", NULL },
@@ -480,6 +504,9 @@ main(int argc, char *argv[])
     eventd_plugins_load(context, (const gchar * const *) binds, enable_relay, enable_sd_modules, context->system_mode);
 
     context->config = eventd_config_new(config_dir, context->system_mode);
+    context->limits = eventd_limits_new(_eventd_core_limits_trigger, context);
+
+    context->metrics = eventd_metrics_endpoint_new(context, (const gchar * const *) metrics_binds);
 
     eventd_plugins_start_all();
 
@@ -518,6 +545,9 @@ main(int argc, char *argv[])
     g_main_loop_run(context->loop);
     g_main_loop_unref(context->loop);
 
+    eventd_metrics_endpoint_free(context->metrics);
+
+    eventd_limits_free(context->limits);
     eventd_config_free(context->config);
 
     eventd_plugins_unload();
@@ -531,10 +561,12 @@ end:
     eventd_sockets_free(context->sockets);
 
     g_free(config_dir);
+    g_strfreev(metrics_binds);
     g_strfreev(binds);
     g_free(control_socket);
     g_free(runtime_dir);
 
+    eventd_flags_clear(&context->flags);
     g_free(context);
 
 #ifdef EVENTD_DEBUG_OUTPUT
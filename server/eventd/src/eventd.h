@@ -42,11 +42,12 @@ gboolean eventd_core_push_event(EventdCoreContext *context, EventdEvent *event);
 
 void eventd_core_flags_add(EventdCoreContext *context, GQuark flag);
 void eventd_core_flags_remove(EventdCoreContext *context, GQuark flag);
+void eventd_core_flags_update(EventdCoreContext *context, const EventdFlags *add, const EventdFlags *remove);
 gboolean eventd_core_flags_test(EventdCoreContext *context, GQuark flag);
 void eventd_core_flags_reset(EventdCoreContext *context);
 gchar *eventd_core_flags_list(EventdCoreContext *context);
 
-void eventd_core_config_reload(EventdCoreContext *context);
+gboolean eventd_core_config_reload(EventdCoreContext *context, gchar **status);
 
 void eventd_core_stop(EventdCoreContext *context, EventdControlDelayedStop *delayed_stop);
 
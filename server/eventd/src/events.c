@@ -34,12 +34,15 @@
 
 #include "config_.h"
 #include "actions.h"
+#include "flags.h"
+#include "limits.h"
 
 #include "events.h"
 
 struct _EventdEvents {
     GHashTable *events;
     GHashTable *events_by_id;
+    GHashTable *index;
 };
 
 typedef struct {
@@ -52,6 +55,8 @@ typedef struct {
 typedef struct {
     gchar *data;
     GRegex *regex;
+    /* A string every match contains, checked before running the regex */
+    gchar *literal;
 } EventdEventsEventDataRegex;
 
 typedef struct {
@@ -59,47 +64,63 @@ typedef struct {
 
     gint64 importance;
     GList *actions;
+    EventdLimitsRule *limits;
 
     /* Conditions */
     gchar **if_data;
     EventdEventsEventDataMatch *if_data_matches;
     EventdEventsEventDataRegex *if_data_regexes;
-    GQuark *flags_whitelist;
-    GQuark *flags_blacklist;
+    EventdFlags flags_whitelist;
+    EventdFlags flags_blacklist;
 } EventdEventsEvent;
 
 static void
-_eventd_events_event_free(gpointer data)
+_eventd_events_data_matches_free(EventdEventsEventDataMatch *matches)
 {
-    if ( data == NULL )
+    if ( matches == NULL )
         return;
 
-    EventdEventsEvent *self = data;
-
-    if ( self->if_data_regexes != NULL )
+    EventdEventsEventDataMatch *match;
+    for ( match = matches ; match->data != NULL ; ++match )
     {
-        EventdEventsEventDataRegex *match;
-        for ( match = self->if_data_regexes ; match->data != NULL ; ++match )
-        {
-            g_regex_unref(match->regex);
-            g_free(match->data);
-        }
+        g_variant_unref(match->value);
+        g_free(match->data);
     }
-    g_free(self->if_data_regexes);
+    g_free(matches);
+}
+
+static void
+_eventd_events_data_regexes_free(EventdEventsEventDataRegex *matches)
+{
+    if ( matches == NULL )
+        return;
 
-    if ( self->if_data_matches != NULL )
+    EventdEventsEventDataRegex *match;
+    for ( match = matches ; match->data != NULL ; ++match )
     {
-        EventdEventsEventDataMatch *match;
-        for ( match = self->if_data_matches ; match->data != NULL ; ++match )
-        {
-            g_variant_unref(match->value);
-            g_free(match->data);
-        }
+        g_free(match->literal);
+        g_regex_unref(match->regex);
+        g_free(match->data);
     }
-    g_free(self->if_data_matches);
+    g_free(matches);
+}
 
+static void
+_eventd_events_event_free(gpointer data)
+{
+    if ( data == NULL )
+        return;
+
+    EventdEventsEvent *self = data;
+
+    _eventd_events_data_regexes_free(self->if_data_regexes);
+    _eventd_events_data_matches_free(self->if_data_matches);
     g_strfreev(self->if_data);
 
+    eventd_flags_clear(&self->flags_blacklist);
+    eventd_flags_clear(&self->flags_whitelist);
+
+    eventd_limits_rule_free(self->limits);
     g_list_free(self->actions);
 
     g_free(self->id);
@@ -117,102 +138,109 @@ _eventd_events_event_list_free(gpointer data)
 }
 
 static gboolean
-_eventd_events_event_matches(EventdEventsEvent *self, EventdEvent *event, GQuark *current_flags)
+_eventd_events_event_data_match_check(const EventdEventsEventDataMatch *match, GVariant *data)
+{
+    if ( match->key != NULL )
+    {
+        if ( ! g_variant_is_of_type(data, G_VARIANT_TYPE_VARDICT) )
+            return FALSE;
+
+        data = g_variant_lookup_value(data, match->key, g_variant_get_type(match->value));
+        if ( data == NULL )
+            return FALSE;
+    }
+    else if ( ! g_variant_type_equal(g_variant_get_type(data), g_variant_get_type(match->value)) )
+        return FALSE;
+    else
+        g_variant_ref(data);
+
+    gint ret;
+    ret = g_variant_compare(data, match->value);
+    ret = CLAMP(ret, -1, 1);
+    g_variant_unref(data);
+
+    return ( ( ret == match->accepted[0] ) || ( ret == match->accepted[1] ) );
+}
+
+static gboolean
+_eventd_events_event_data_regex_match(const EventdEventsEventDataRegex *match, const gchar *string)
+{
+    if ( ( match->literal != NULL ) && ( strstr(string, match->literal) == NULL ) )
+        return FALSE;
+
+    return g_regex_match(match->regex, string, 0, NULL);
+}
+
+static gboolean
+_eventd_events_event_data_regex_check(const EventdEventsEventDataRegex *match, GVariant *data)
+{
+    if ( ! g_variant_is_of_type(data, G_VARIANT_TYPE_STRING) )
+        return FALSE;
+
+    return _eventd_events_event_data_regex_match(match, g_variant_get_string(data, NULL));
+}
+
+static gboolean
+_eventd_events_data_check(gchar **if_data, const EventdEventsEventDataMatch *if_data_matches, const EventdEventsEventDataRegex *if_data_regexes, EventdEvent *event)
 {
-    if ( self->if_data != NULL )
+    GVariant *value;
+
+    if ( if_data != NULL )
     {
         gchar **data;
-        for ( data = self->if_data ; *data != NULL ; ++data )
+        for ( data = if_data ; *data != NULL ; ++data )
         {
             if ( ! eventd_event_has_data(event, *data) )
                 return FALSE;
         }
     }
 
-    if ( self->if_data_matches != NULL )
+    if ( if_data_matches != NULL )
     {
-        EventdEventsEventDataMatch *match;
-        GVariant *data;
-        for ( match = self->if_data_matches ; match->data != NULL ; ++match )
+        const EventdEventsEventDataMatch *match;
+        for ( match = if_data_matches ; match->data != NULL ; ++match )
         {
-            if ( ! eventd_event_has_data(event, match->data) )
+            if ( ( value = eventd_event_get_data(event, match->data) ) == NULL )
                 continue;
-            if ( ( data = eventd_event_get_data(event, match->data) ) == NULL )
-                return FALSE;
-
-            if ( match->key != NULL )
-            {
-                if ( ! g_variant_is_of_type(data, G_VARIANT_TYPE_VARDICT) )
-                    return FALSE;
-
-                data = g_variant_lookup_value(data, match->key, g_variant_get_type(match->value));
-                if ( data == NULL )
-                    return FALSE;
-            }
-            else if ( ! g_variant_type_equal(g_variant_get_type(data), g_variant_get_type(match->value)) )
-                return FALSE;
-
-            gint ret;
-            ret = g_variant_compare(data, match->value);
-            ret = CLAMP(ret, -1, 1);
-            if ( ( ret != match->accepted[0] ) && ( ret != match->accepted[1] ) )
+            if ( ! _eventd_events_event_data_match_check(match, value) )
                 return FALSE;
         }
     }
 
-    if ( self->if_data_regexes != NULL )
+    if ( if_data_regexes != NULL )
     {
-        EventdEventsEventDataRegex *match;
-        const gchar *data;
-        for ( match = self->if_data_regexes ; match->data != NULL ; ++match )
+        const EventdEventsEventDataRegex *match;
+        for ( match = if_data_regexes ; match->data != NULL ; ++match )
         {
-            if ( ! eventd_event_has_data(event, match->data) )
+            if ( ( value = eventd_event_get_data(event, match->data) ) == NULL )
                 continue;
-            if ( ( data = eventd_event_get_data_string(event, match->data) ) == NULL )
-                return FALSE;
-            if ( ! g_regex_match(match->regex, data, 0, NULL) )
+            if ( ! _eventd_events_event_data_regex_check(match, value) )
                 return FALSE;
         }
     }
 
-    if ( current_flags != NULL )
-    {
-        GQuark *flag;
-        if ( self->flags_whitelist != NULL )
-        {
-            GQuark *wflag;
-            for ( wflag = self->flags_whitelist ; *wflag != 0 ; ++wflag )
-            {
-                gboolean has = FALSE;
-                for ( flag = current_flags ; ( *flag != 0 ) && ( ! has ) ; ++flag )
-                {
-                    if ( *flag == *wflag )
-                        has = TRUE;
-                }
-                if ( ! has )
-                    return FALSE;
-            }
-        }
+    return TRUE;
+}
 
-        if ( self->flags_blacklist != NULL )
-        {
-            GQuark *bflag;
-            for ( bflag = self->flags_blacklist ; *bflag != 0 ; ++bflag )
-            {
-                for ( flag = current_flags ; *flag != 0 ; ++flag )
-                {
-                    if ( *flag == *bflag )
-                        return FALSE;
-                }
-            }
-        }
-    }
+/*
+ * Reference matching, walking the events lists
+ * Only built for tests and benchmarks, to check the compiled matchers
+ */
+#ifdef EVENTD_EVENTS_LINEAR_MATCHER
+static gboolean
+_eventd_events_event_matches(EventdEventsEvent *self, EventdEvent *event, const EventdFlags *current_flags)
+{
+    if ( ! _eventd_events_data_check(self->if_data, self->if_data_matches, self->if_data_regexes, event) )
+        return FALSE;
+
+    if ( ( current_flags != NULL ) && ( ! eventd_flags_check(current_flags, &self->flags_whitelist, &self->flags_blacklist) ) )
+        return FALSE;
 
     return TRUE;
 }
 
 static EventdEventsEvent *
-_eventd_events_get_best_match(GList *list, EventdEvent *event, GQuark *current_flags)
+_eventd_events_get_best_match(GList *list, EventdEvent *event, const EventdFlags *current_flags)
 {
     GList *self_;
     for ( self_ = list ; self_ != NULL ; self_ = g_list_next(self_) )
@@ -225,7 +253,7 @@ _eventd_events_get_best_match(GList *list, EventdEvent *event, GQuark *current_f
 }
 
 static EventdEventsEvent *
-_eventd_events_get_event(EventdEvents *self, EventdEvent *event, GQuark *current_flags)
+_eventd_events_get_event_linear(EventdEvents *self, EventdEvent *event, const EventdFlags *current_flags)
 {
     const gchar *category, *name;
     gsize s;
@@ -240,41 +268,754 @@ _eventd_events_get_event(EventdEvents *self, EventdEvent *event, GQuark *current
 
     g_snprintf(full_name, s, "%s %s", category, name);
 
-    list = g_hash_table_lookup(self->events, full_name);
-    if ( list != NULL )
+    list = g_hash_table_lookup(self->events, full_name);
+    if ( list != NULL )
+    {
+        match = _eventd_events_get_best_match(list, event, current_flags);
+        if ( match != NULL )
+            return match;
+    }
+
+    list = g_hash_table_lookup(self->events, category);
+    if ( list != NULL )
+    {
+        match = _eventd_events_get_best_match(list, event, current_flags);
+        if ( match != NULL )
+            return match;
+    }
+
+    return NULL;
+}
+#endif /* EVENTD_EVENTS_LINEAR_MATCHER */
+
+/*
+ * Compiled matching
+ *
+ * Each event list is compiled into a matcher: the conditions of its events
+ * are deduplicated into predicates, grouped by the data they test.
+ * Matching an event looks each data up once, resolves all the equality
+ * conditions on it with a single hash lookup and records the satisfied
+ * predicates in a bitset.
+ * Every event is anchored on its most selective predicate, and only the
+ * events whose anchor holds are checked against the bitset.
+ * Regexes on the same data are also merged into a single alternation,
+ * so that a value matching none of them is rejected in one pass.
+ */
+
+#define EVENTD_EVENTS_NO_PREDICATE G_MAXUINT
+#define EVENTD_EVENTS_STACK_SIZE 32
+#define EVENTD_EVENTS_REGEX_COMBINE_MIN 4
+
+typedef enum {
+    EVENTD_EVENTS_PREDICATE_IF_DATA,
+    EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH,
+    EVENTD_EVENTS_PREDICATE_IF_DATA_REGEX,
+} EventdEventsPredicateType;
+
+typedef struct {
+    EventdEventsPredicateType type;
+    guint id;
+    guint key;
+    gboolean hashed;
+    union {
+        const EventdEventsEventDataMatch *match;
+        const EventdEventsEventDataRegex *regex;
+    };
+} EventdEventsPredicate;
+
+typedef struct {
+    const gchar *data;
+    /* IfData predicate */
+    guint if_data;
+    /* IfDataMatches and IfDataRegex predicates range */
+    guint first;
+    guint last;
+    /* Equality matches: value => predicate id + 1 */
+    GHashTable *values;
+    /* Other predicates, checked one by one */
+    GArray *others;
+    /* Regex predicates, and all of them merged when possible */
+    GArray *regexes;
+    GRegex *any;
+    /* Events that are candidates when the data is missing */
+    GArray *absent;
+} EventdEventsKey;
+
+typedef struct {
+    const EventdEventsEvent *event;
+    guint *predicates;
+    guint size;
+} EventdEventsRule;
+
+typedef struct {
+    guint size;
+    EventdEventsRule *rules;
+    guint predicates_size;
+    EventdEventsPredicate *predicates;
+    guint keys_size;
+    EventdEventsKey *keys;
+    GArray **anchored;
+    GArray *unanchored;
+} EventdEventsMatcher;
+
+typedef struct {
+    EventdEventsMatcher *matcher;
+    GHashTable *names;
+} EventdEventsCategory;
+
+typedef struct {
+    const gchar *data;
+    guint index;
+    EventdEventsPredicate *if_data;
+    GPtrArray *values;
+    GHashTable *seen;
+} EventdEventsKeyBuilder;
+
+static inline void
+_eventd_events_bitset_set(guint64 *bitset, guint bit)
+{
+    bitset[bit / 64] |= ( G_GUINT64_CONSTANT(1) << ( bit % 64 ) );
+}
+
+static inline gboolean
+_eventd_events_bitset_test(const guint64 *bitset, guint bit)
+{
+    return ( ( bitset[bit / 64] & ( G_GUINT64_CONSTANT(1) << ( bit % 64 ) ) ) != 0 );
+}
+
+static void
+_eventd_events_bitset_set_range(guint64 *bitset, guint first, guint last)
+{
+    for ( ; ( first < last ) && ( ( first % 64 ) != 0 ) ; ++first )
+        _eventd_events_bitset_set(bitset, first);
+    for ( ; ( first + 64 ) <= last ; first += 64 )
+        bitset[first / 64] = G_MAXUINT64;
+    for ( ; first < last ; ++first )
+        _eventd_events_bitset_set(bitset, first);
+}
+
+static gboolean
+_eventd_events_predicate_is_hashable(const EventdEventsPredicate *self)
+{
+    if ( self->type != EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH )
+        return FALSE;
+
+    const EventdEventsEventDataMatch *match = self->match;
+    if ( ( match->key != NULL ) || ( match->accepted[0] != 0 ) || ( match->accepted[1] != 0 ) )
+        return FALSE;
+
+    /* Doubles compare by value, not by representation */
+    const GVariantType *type = g_variant_get_type(match->value);
+    return ( g_variant_type_is_basic(type) && ( ! g_variant_type_equal(type, G_VARIANT_TYPE_DOUBLE) ) );
+}
+
+static gboolean
+_eventd_events_predicate_check(const EventdEventsPredicate *self, GVariant *data)
+{
+    switch ( self->type )
+    {
+    case EVENTD_EVENTS_PREDICATE_IF_DATA:
+        return TRUE;
+    case EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH:
+        return _eventd_events_event_data_match_check(self->match, data);
+    case EVENTD_EVENTS_PREDICATE_IF_DATA_REGEX:
+        return _eventd_events_event_data_regex_check(self->regex, data);
+    }
+    g_return_val_if_reached(FALSE);
+}
+
+static gboolean
+_eventd_events_rule_has_predicate(const EventdEventsRule *self, guint id)
+{
+    guint i;
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        if ( self->predicates[i] == id )
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+_eventd_events_rule_matches(const EventdEventsRule *self, const guint64 *results, const EventdFlags *current_flags)
+{
+    guint i;
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        if ( ! _eventd_events_bitset_test(results, self->predicates[i]) )
+            return FALSE;
+    }
+
+    if ( ( current_flags != NULL ) && ( ! eventd_flags_check(current_flags, &self->event->flags_whitelist, &self->event->flags_blacklist) ) )
+        return FALSE;
+
+    return TRUE;
+}
+
+static void
+_eventd_events_key_builder_free(gpointer data)
+{
+    EventdEventsKeyBuilder *self = data;
+
+    g_hash_table_unref(self->seen);
+    g_ptr_array_unref(self->values);
+    g_free(self->if_data);
+
+    g_free(self);
+}
+
+static EventdEventsKeyBuilder *
+_eventd_events_key_builder_get(GHashTable *keys, GPtrArray *keys_list, const gchar *data)
+{
+    EventdEventsKeyBuilder *self;
+
+    self = g_hash_table_lookup(keys, data);
+    if ( self != NULL )
+        return self;
+
+    self = g_new0(EventdEventsKeyBuilder, 1);
+    self->data = data;
+    self->index = keys_list->len;
+    self->values = g_ptr_array_new_with_free_func(g_free);
+    self->seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    g_ptr_array_add(keys_list, self);
+    g_hash_table_insert(keys, (gpointer) data, self);
+
+    return self;
+}
+
+static EventdEventsPredicate *
+_eventd_events_key_builder_add_predicate(EventdEventsKeyBuilder *self, EventdEventsPredicateType type, gconstpointer condition)
+{
+    EventdEventsPredicate *predicate;
+    gchar *description = NULL;
+
+    switch ( type )
+    {
+    case EVENTD_EVENTS_PREDICATE_IF_DATA:
+        if ( self->if_data == NULL )
+        {
+            self->if_data = g_new0(EventdEventsPredicate, 1);
+            self->if_data->type = type;
+            self->if_data->key = self->index;
+        }
+        return self->if_data;
+    case EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH:
+    {
+        const EventdEventsEventDataMatch *match = condition;
+        gchar *value = g_variant_print(match->value, TRUE);
+        if ( match->key == NULL )
+            description = g_strdup_printf("=%d,%d %s", match->accepted[0], match->accepted[1], value);
+        else
+            description = g_strdup_printf("=%d,%d[%s]%s", match->accepted[0], match->accepted[1], match->key, value);
+        g_free(value);
+    }
+    break;
+    case EVENTD_EVENTS_PREDICATE_IF_DATA_REGEX:
+        description = g_strconcat("~", g_regex_get_pattern(((const EventdEventsEventDataRegex *) condition)->regex), NULL);
+    break;
+    }
+
+    predicate = g_hash_table_lookup(self->seen, description);
+    if ( predicate != NULL )
+    {
+        g_free(description);
+        return predicate;
+    }
+
+    predicate = g_new0(EventdEventsPredicate, 1);
+    predicate->type = type;
+    predicate->key = self->index;
+    if ( type == EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH )
+        predicate->match = condition;
+    else
+        predicate->regex = condition;
+
+    g_hash_table_insert(self->seen, description, predicate);
+    g_ptr_array_add(self->values, predicate);
+
+    return predicate;
+}
+
+static gboolean
+_eventd_events_regex_is_combinable(const gchar *pattern)
+{
+    const gchar *c;
+
+    /* Numbered references would point to another pattern groups */
+    for ( c = pattern ; *c != '\0' ; ++c )
+    {
+        if ( *c == '\\' )
+        {
+            ++c;
+            if ( g_ascii_isdigit(*c) || ( *c == 'g' ) || ( *c == 'k' ) )
+                return FALSE;
+            if ( *c == '\0' )
+                return FALSE;
+        }
+        else if ( ( *c == '(' ) && ( ( c[1] == '*' ) || ( ( c[1] == '?' ) && ( strchr(":=!<", c[2]) == NULL ) ) ) )
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static GRegex *
+_eventd_events_regex_combine(const EventdEventsPredicate *predicates, const GArray *ids)
+{
+    GString *pattern;
+    GRegex *regex;
+    guint i;
+
+    pattern = g_string_new(NULL);
+    for ( i = 0 ; i < ids->len ; ++i )
+    {
+        const gchar *p = g_regex_get_pattern(predicates[g_array_index(ids, guint, i)].regex->regex);
+        if ( ! _eventd_events_regex_is_combinable(p) )
+        {
+            g_string_free(pattern, TRUE);
+            return NULL;
+        }
+        g_string_append_printf(pattern, "%s(?:%s)", ( i > 0 ) ? "|" : "", p);
+    }
+
+    /* Not being able to merge them is fine, we check them one by one */
+    regex = g_regex_new(pattern->str, G_REGEX_OPTIMIZE, 0, NULL);
+    g_string_free(pattern, TRUE);
+
+    return regex;
+}
+
+static void
+_eventd_events_matcher_free(gpointer data)
+{
+    EventdEventsMatcher *self = data;
+    guint i;
+
+    if ( self->unanchored != NULL )
+        g_array_unref(self->unanchored);
+    for ( i = 0 ; i < self->predicates_size ; ++i )
+    {
+        if ( self->anchored[i] != NULL )
+            g_array_unref(self->anchored[i]);
+    }
+    g_free(self->anchored);
+
+    for ( i = 0 ; i < self->keys_size ; ++i )
+    {
+        EventdEventsKey *key = &self->keys[i];
+        if ( key->absent != NULL )
+            g_array_unref(key->absent);
+        if ( key->any != NULL )
+            g_regex_unref(key->any);
+        if ( key->regexes != NULL )
+            g_array_unref(key->regexes);
+        if ( key->others != NULL )
+            g_array_unref(key->others);
+        if ( key->values != NULL )
+            g_hash_table_unref(key->values);
+    }
+    g_free(self->keys);
+
+    g_free(self->predicates);
+
+    for ( i = 0 ; i < self->size ; ++i )
+        g_free(self->rules[i].predicates);
+    g_free(self->rules);
+
+    g_free(self);
+}
+
+static EventdEventsMatcher *
+_eventd_events_matcher_new(GList *list)
+{
+    EventdEventsMatcher *self;
+    GHashTable *keys_table;
+    GPtrArray *keys_list, **rules_predicates;
+    EventdEventsKeyBuilder *builder;
+    GList *event_;
+    guint r, k, i, id;
+
+    self = g_new0(EventdEventsMatcher, 1);
+    self->size = g_list_length(list);
+    self->rules = g_new0(EventdEventsRule, self->size);
+
+    keys_table = g_hash_table_new(g_str_hash, g_str_equal);
+    keys_list = g_ptr_array_new_with_free_func(_eventd_events_key_builder_free);
+    rules_predicates = g_new0(GPtrArray *, self->size);
+
+    for ( event_ = list, r = 0 ; event_ != NULL ; event_ = g_list_next(event_), ++r )
+    {
+        const EventdEventsEvent *event = event_->data;
+        GPtrArray *predicates;
+
+        self->rules[r].event = event;
+        predicates = rules_predicates[r] = g_ptr_array_new();
+
+        if ( event->if_data != NULL )
+        {
+            gchar **data;
+            for ( data = event->if_data ; *data != NULL ; ++data )
+            {
+                builder = _eventd_events_key_builder_get(keys_table, keys_list, *data);
+                g_ptr_array_add(predicates, _eventd_events_key_builder_add_predicate(builder, EVENTD_EVENTS_PREDICATE_IF_DATA, NULL));
+            }
+        }
+
+        if ( event->if_data_matches != NULL )
+        {
+            EventdEventsEventDataMatch *match;
+            for ( match = event->if_data_matches ; match->data != NULL ; ++match )
+            {
+                builder = _eventd_events_key_builder_get(keys_table, keys_list, match->data);
+                g_ptr_array_add(predicates, _eventd_events_key_builder_add_predicate(builder, EVENTD_EVENTS_PREDICATE_IF_DATA_MATCH, match));
+            }
+        }
+
+        if ( event->if_data_regexes != NULL )
+        {
+            EventdEventsEventDataRegex *match;
+            for ( match = event->if_data_regexes ; match->data != NULL ; ++match )
+            {
+                builder = _eventd_events_key_builder_get(keys_table, keys_list, match->data);
+                g_ptr_array_add(predicates, _eventd_events_key_builder_add_predicate(builder, EVENTD_EVENTS_PREDICATE_IF_DATA_REGEX, match));
+            }
+        }
+    }
+
+    for ( k = 0 ; k < keys_list->len ; ++k )
+    {
+        builder = g_ptr_array_index(keys_list, k);
+        self->predicates_size += builder->values->len + ( ( builder->if_data != NULL ) ? 1 : 0 );
+    }
+    self->predicates = g_new0(EventdEventsPredicate, self->predicates_size);
+    self->anchored = g_new0(GArray *, self->predicates_size);
+    self->keys_size = keys_list->len;
+    self->keys = g_new0(EventdEventsKey, self->keys_size);
+
+    /* Predicates on the same data get contiguous ids */
+    id = 0;
+    for ( k = 0 ; k < keys_list->len ; ++k )
+    {
+        EventdEventsKey *key = &self->keys[k];
+        builder = g_ptr_array_index(keys_list, k);
+
+        key->data = builder->data;
+        key->if_data = EVENTD_EVENTS_NO_PREDICATE;
+        if ( builder->if_data != NULL )
+        {
+            builder->if_data->id = key->if_data = id;
+            self->predicates[id++] = *builder->if_data;
+        }
+
+        key->first = id;
+        for ( i = 0 ; i < builder->values->len ; ++i )
+        {
+            EventdEventsPredicate *predicate = g_ptr_array_index(builder->values, i);
+            predicate->id = id;
+
+            if ( _eventd_events_predicate_is_hashable(predicate) )
+            {
+                if ( key->values == NULL )
+                    key->values = g_hash_table_new(g_variant_hash, g_variant_equal);
+                if ( ! g_hash_table_contains(key->values, predicate->match->value) )
+                {
+                    g_hash_table_insert(key->values, predicate->match->value, GUINT_TO_POINTER(id + 1));
+                    predicate->hashed = TRUE;
+                }
+            }
+
+            if ( predicate->type == EVENTD_EVENTS_PREDICATE_IF_DATA_REGEX )
+            {
+                if ( key->regexes == NULL )
+                    key->regexes = g_array_new(FALSE, FALSE, sizeof(guint));
+                g_array_append_val(key->regexes, id);
+            }
+            else if ( ! predicate->hashed )
+            {
+                if ( key->others == NULL )
+                    key->others = g_array_new(FALSE, FALSE, sizeof(guint));
+                g_array_append_val(key->others, id);
+            }
+
+            self->predicates[id++] = *predicate;
+        }
+        key->last = id;
+
+        if ( ( key->regexes != NULL ) && ( key->regexes->len >= EVENTD_EVENTS_REGEX_COMBINE_MIN ) )
+            key->any = _eventd_events_regex_combine(self->predicates, key->regexes);
+    }
+
+    for ( r = 0 ; r < self->size ; ++r )
+    {
+        EventdEventsRule *rule = &self->rules[r];
+        GPtrArray *predicates = rules_predicates[r];
+        const EventdEventsPredicate *anchor = NULL;
+        GArray **candidates;
+
+        rule->size = predicates->len;
+        rule->predicates = g_new(guint, rule->size);
+        for ( i = 0 ; i < predicates->len ; ++i )
+        {
+            const EventdEventsPredicate *predicate = g_ptr_array_index(predicates, i);
+            rule->predicates[i] = predicate->id;
+
+            /* Prefer an equality match, then a presence check */
+            if ( predicate->hashed && ( ( anchor == NULL ) || ( ! anchor->hashed ) ) )
+                anchor = predicate;
+            else if ( ( anchor == NULL ) && ( predicate->type == EVENTD_EVENTS_PREDICATE_IF_DATA ) )
+                anchor = predicate;
+        }
+
+        if ( anchor == NULL )
+            candidates = &self->unanchored;
+        else
+            candidates = &self->anchored[anchor->id];
+        if ( *candidates == NULL )
+            *candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+        g_array_append_val(*candidates, r);
+
+        /* A missing data satisfies its value conditions, unless required by IfData */
+        if ( ( anchor != NULL ) && anchor->hashed )
+        {
+            EventdEventsKey *key = &self->keys[anchor->key];
+            if ( ( key->if_data == EVENTD_EVENTS_NO_PREDICATE ) || ( ! _eventd_events_rule_has_predicate(rule, key->if_data) ) )
+            {
+                if ( key->absent == NULL )
+                    key->absent = g_array_new(FALSE, FALSE, sizeof(guint));
+                g_array_append_val(key->absent, r);
+            }
+        }
+
+        g_ptr_array_unref(predicates);
+    }
+    g_free(rules_predicates);
+
+    g_ptr_array_unref(keys_list);
+    g_hash_table_unref(keys_table);
+
+    return self;
+}
+
+static const EventdEventsEvent *
+_eventd_events_matcher_match(const EventdEventsMatcher *self, EventdEvent *event, const EventdFlags *current_flags)
+{
+    guint64 results_[EVENTD_EVENTS_STACK_SIZE], *results = results_;
+    const GArray *candidates_[EVENTD_EVENTS_STACK_SIZE], **candidates = candidates_;
+    gsize words = ( self->predicates_size + 63 ) / 64;
+    gsize candidates_size = 0;
+    guint best = self->size;
+    guint k, i, c;
+
+    if ( words > G_N_ELEMENTS(results_) )
+        results = g_new0(guint64, words);
+    else
+        memset(results, 0, words * sizeof(guint64));
+    if ( ( 1 + 2 * self->keys_size ) > G_N_ELEMENTS(candidates_) )
+        candidates = g_new(const GArray *, 1 + 2 * self->keys_size);
+
+    if ( self->unanchored != NULL )
+        candidates[candidates_size++] = self->unanchored;
+
+    for ( k = 0 ; k < self->keys_size ; ++k )
+    {
+        const EventdEventsKey *key = &self->keys[k];
+        GVariant *data;
+
+        data = eventd_event_get_data(event, key->data);
+        if ( data == NULL )
+        {
+            _eventd_events_bitset_set_range(results, key->first, key->last);
+            if ( key->absent != NULL )
+                candidates[candidates_size++] = key->absent;
+            continue;
+        }
+
+        if ( key->if_data != EVENTD_EVENTS_NO_PREDICATE )
+        {
+            _eventd_events_bitset_set(results, key->if_data);
+            if ( self->anchored[key->if_data] != NULL )
+                candidates[candidates_size++] = self->anchored[key->if_data];
+        }
+
+        if ( ( key->values != NULL ) && g_variant_type_is_basic(g_variant_get_type(data)) )
+        {
+            guint id = GPOINTER_TO_UINT(g_hash_table_lookup(key->values, data));
+            if ( id > 0 )
+            {
+                _eventd_events_bitset_set(results, --id);
+                if ( self->anchored[id] != NULL )
+                    candidates[candidates_size++] = self->anchored[id];
+            }
+        }
+
+        if ( key->others != NULL )
+        {
+            for ( i = 0 ; i < key->others->len ; ++i )
+            {
+                guint id = g_array_index(key->others, guint, i);
+                if ( _eventd_events_predicate_check(&self->predicates[id], data) )
+                    _eventd_events_bitset_set(results, id);
+            }
+        }
+
+        if ( ( key->regexes != NULL ) && g_variant_is_of_type(data, G_VARIANT_TYPE_STRING) )
+        {
+            const gchar *string = g_variant_get_string(data, NULL);
+            if ( ( key->any == NULL ) || g_regex_match(key->any, string, 0, NULL) )
+            {
+                for ( i = 0 ; i < key->regexes->len ; ++i )
+                {
+                    guint id = g_array_index(key->regexes, guint, i);
+                    if ( _eventd_events_event_data_regex_match(self->predicates[id].regex, string) )
+                        _eventd_events_bitset_set(results, id);
+                }
+            }
+        }
+    }
+
+    /* Candidates lists are sorted, we want the first matching event overall */
+    for ( c = 0 ; c < candidates_size ; ++c )
+    {
+        const GArray *list = candidates[c];
+        for ( i = 0 ; i < list->len ; ++i )
+        {
+            guint r = g_array_index(list, guint, i);
+            if ( r >= best )
+                break;
+            if ( _eventd_events_rule_matches(&self->rules[r], results, current_flags) )
+            {
+                best = r;
+                break;
+            }
+        }
+    }
+
+    if ( candidates != candidates_ )
+        g_free(candidates);
+    if ( results != results_ )
+        g_free(results);
+
+    if ( best < self->size )
+        return self->rules[best].event;
+    return NULL;
+}
+
+static void
+_eventd_events_category_free(gpointer data)
+{
+    EventdEventsCategory *self = data;
+
+    if ( self->matcher != NULL )
+        _eventd_events_matcher_free(self->matcher);
+    g_hash_table_unref(self->names);
+
+    g_free(self);
+}
+
+static void
+_eventd_events_compile(EventdEvents *self)
+{
+    GHashTableIter iter;
+    const gchar *name;
+    GList *events;
+
+    self->index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _eventd_events_category_free);
+
+    g_hash_table_iter_init(&iter, self->events);
+    while ( g_hash_table_iter_next(&iter, (gpointer *) &name, (gpointer *) &events) )
+    {
+        EventdEventsCategory *category;
+        const gchar *s;
+        gchar *category_name;
+
+        s = strchr(name, ' ');
+        category_name = ( s == NULL ) ? g_strdup(name) : g_strndup(name, s - name);
+
+        category = g_hash_table_lookup(self->index, category_name);
+        if ( category == NULL )
+        {
+            category = g_new0(EventdEventsCategory, 1);
+            category->names = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _eventd_events_matcher_free);
+            g_hash_table_insert(self->index, category_name, category);
+        }
+        else
+            g_free(category_name);
+
+        if ( s == NULL )
+            category->matcher = _eventd_events_matcher_new(events);
+        else
+            g_hash_table_insert(category->names, (gpointer) ( s + 1 ), _eventd_events_matcher_new(events));
+    }
+}
+
+static void
+_eventd_events_uncompile(EventdEvents *self)
+{
+    if ( self->index == NULL )
+        return;
+
+    g_hash_table_unref(self->index);
+    self->index = NULL;
+}
+
+static const EventdEventsEvent *
+_eventd_events_get_event(EventdEvents *self, EventdEvent *event, const EventdFlags *current_flags)
+{
+    EventdEventsCategory *category;
+    EventdEventsMatcher *matcher;
+    const EventdEventsEvent *match;
+
+    if ( self->index == NULL )
+        _eventd_events_compile(self);
+
+    category = g_hash_table_lookup(self->index, eventd_event_get_category(event));
+    if ( category == NULL )
+        return NULL;
+
+    matcher = g_hash_table_lookup(category->names, eventd_event_get_name(event));
+    if ( matcher != NULL )
     {
-        match = _eventd_events_get_best_match(list, event, current_flags);
+        match = _eventd_events_matcher_match(matcher, event, current_flags);
         if ( match != NULL )
             return match;
     }
 
-    list = g_hash_table_lookup(self->events, category);
-    if ( list != NULL )
-    {
-        match = _eventd_events_get_best_match(list, event, current_flags);
-        if ( match != NULL )
-            return match;
-    }
+    if ( category->matcher != NULL )
+        return _eventd_events_matcher_match(category->matcher, event, current_flags);
 
     return NULL;
 }
 
-gboolean
-eventd_events_process_event(EventdEvents *self, EventdEvent *event, GQuark *flags, const GList **actions)
+static gboolean
+_eventd_events_process_event(const EventdEventsEvent *config_event, const GList **actions, EventdLimitsRule **limits)
 {
-    EventdEventsEvent *config_event;
-    config_event = _eventd_events_get_event(self, event, flags);
-
     if ( config_event == NULL )
         return FALSE;
 
     g_debug("Processing event '%s'", config_event->id);
 
     *actions = config_event->actions;
+    if ( limits != NULL )
+        *limits = config_event->limits;
 
     return TRUE;
 }
 
+gboolean
+eventd_events_process_event(EventdEvents *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits)
+{
+    return _eventd_events_process_event(_eventd_events_get_event(self, event, flags), actions, limits);
+}
+
+#ifdef EVENTD_EVENTS_LINEAR_MATCHER
+gboolean
+eventd_events_process_event_linear(EventdEvents *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits)
+{
+    return _eventd_events_process_event(_eventd_events_get_event_linear(self, event, flags), actions, limits);
+}
+#endif /* EVENTD_EVENTS_LINEAR_MATCHER */
+
 gchar *
 eventd_events_dump_event(EventdEvents *self, const gchar *event_id)
 {
@@ -314,23 +1055,20 @@ eventd_events_dump_event(EventdEvents *self, const gchar *event_id)
             g_string_append_printf(dump, "\n        - %s =~ %s", if_data_regexes->data, g_regex_get_pattern(if_data_regexes->regex));
     }
 
-    GQuark *flag;
-    if ( event->flags_whitelist != NULL )
+    if ( ! eventd_flags_is_empty(&event->flags_whitelist) )
     {
-        g_string_append(dump, "\n    If flags:");
-        for ( flag = event->flags_whitelist ; *flag != 0 ; ++flag )
-            g_string_append_printf(dump, " %s,", g_quark_to_string(*flag));
-        g_string_truncate(dump, dump->len - 1);
+        g_string_append(dump, "\n    If flags: ");
+        eventd_flags_dump(&event->flags_whitelist, dump, ", ");
     }
 
-    if ( event->flags_blacklist != NULL )
+    if ( ! eventd_flags_is_empty(&event->flags_blacklist) )
     {
-        g_string_append(dump, "\n    If not flags:");
-        for ( flag = event->flags_blacklist ; *flag != 0 ; ++flag )
-            g_string_append_printf(dump, " %s,", g_quark_to_string(*flag));
-        g_string_truncate(dump, dump->len - 1);
+        g_string_append(dump, "\n    If not flags: ");
+        eventd_flags_dump(&event->flags_blacklist, dump, ", ");
     }
 
+    eventd_limits_rule_dump(dump, event->limits);
+
     if ( event->actions != NULL )
     {
         g_string_append(dump, "\n\nActions:\n\n");
@@ -352,6 +1090,364 @@ _eventd_events_compare_event(gconstpointer a_, gconstpointer b_)
     return 0;
 }
 
+static gboolean
+_eventd_events_parse_data_match(gchar *data, EventdEventsEventDataMatch *match, GError **error)
+{
+    gchar *tmp, *key = NULL, *operator, *value_;
+    gint accepted[2];
+    GVariant *value;
+    GError *_inner_error_ = NULL;
+
+    tmp = g_utf8_strchr(data, -1, ',');
+    if ( tmp == NULL )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Data matches must be of the form 'data-name,operator,value'");
+        goto fail;
+    }
+    operator = g_utf8_next_char(tmp);
+    *tmp = '\0';
+
+    tmp = g_utf8_strchr(data, -1, '[');
+    if ( tmp != NULL )
+    {
+        key = g_utf8_next_char(tmp);
+        *tmp = '\0';
+        tmp = g_utf8_strchr(key, -1, ']');
+        if ( ( tmp == NULL ) || ( g_utf8_get_char(g_utf8_next_char(tmp)) != '\0' ) )
+        {
+            g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Data matches must be of the form 'data-name[key],operator,value'");
+            goto fail;
+        }
+        *tmp = '\0';
+    }
+
+    tmp = g_utf8_strchr(operator, -1, ',');
+    if ( tmp == NULL )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Data matches must be of the form 'data-name,operator,value'");
+        goto fail;
+    }
+    value_ = g_utf8_next_char(tmp);
+    *tmp = '\0';
+
+    gsize l = g_utf8_strlen(operator, -1);
+    if ( ( l > 2 ) || ( l < 1 ) )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Unsupported operator: %s", operator);
+        goto fail;
+    }
+    accepted[0] = -2;
+    switch ( g_utf8_get_char(g_utf8_next_char(operator)) )
+    {
+    case '=':
+        accepted[1] = 0;
+        switch ( g_utf8_get_char(operator) )
+        {
+        case '<':
+            accepted[0] = -1;
+        break;
+        case '>':
+            accepted[0] = 1;
+        break;
+        case '=':
+            accepted[0] = 0;
+        break;
+        case '!':
+            accepted[0] = -1;
+            accepted[1] = 1;
+        break;
+        }
+    break;
+    case '\0':
+        switch ( g_utf8_get_char(operator) )
+        {
+        case '<':
+            accepted[0] = accepted[1] = -1;
+        break;
+        case '>':
+            accepted[0] = accepted[1] = 1;
+        break;
+        }
+    }
+    if ( accepted[0] == -2 )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Unsupported operator: %s", operator);
+        goto fail;
+    }
+
+    value = g_variant_parse(NULL, value_, NULL, NULL, &_inner_error_);
+    if ( value == NULL )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Could not parse variant '%s': %s", value_, _inner_error_->message);
+        g_error_free(_inner_error_);
+        goto fail;
+    }
+
+    match->data = data;
+    match->key = key;
+    match->accepted[0] = accepted[0];
+    match->accepted[1] = accepted[1];
+    match->value = value;
+    return TRUE;
+
+fail:
+    g_free(data);
+    return FALSE;
+}
+
+/*
+ * Takes ownership of the list strings
+ * Invalid entries are skipped with a warning, unless error is set:
+ * then the first one fails the whole list
+ */
+static EventdEventsEventDataMatch *
+_eventd_events_parse_data_matches(gchar **if_data_matches, gsize length, GError **error)
+{
+    gchar **if_data_match;
+    EventdEventsEventDataMatch *matches, *match;
+    GError *_inner_error_ = NULL;
+
+    matches = g_new0(EventdEventsEventDataMatch, length + 1);
+    match = matches;
+
+    for ( if_data_match = if_data_matches ; *if_data_match != NULL ; ++if_data_match )
+    {
+        if ( _eventd_events_parse_data_match(*if_data_match, match, &_inner_error_) )
+            ++match;
+        else if ( error == NULL )
+        {
+            g_warning("%s", _inner_error_->message);
+            g_clear_error(&_inner_error_);
+        }
+        else
+        {
+            g_propagate_error(error, _inner_error_);
+            for ( ++if_data_match ; *if_data_match != NULL ; ++if_data_match )
+                g_free(*if_data_match);
+            match->data = NULL;
+            _eventd_events_data_matches_free(matches);
+            g_free(if_data_matches);
+            return NULL;
+        }
+    }
+    match->data = NULL;
+    g_free(if_data_matches);
+
+    return matches;
+}
+
+static void
+_eventd_events_regex_literal_end(GString *run, GString *best)
+{
+    if ( run->len > best->len )
+        g_string_assign(best, run->str);
+    g_string_truncate(run, 0);
+}
+
+/*
+ * Finds the longest string any match of the pattern must contain
+ * This is deliberately conservative: anything optional or not understood
+ * ends the current literal, and top-level alternatives, inline options
+ * and unusual escapes disable the prefilter entirely
+ */
+static gchar *
+_eventd_events_regex_get_literal(const gchar *pattern)
+{
+    GString *run, *best;
+    const gchar *c, *next;
+    gint depth = 0;
+    const gchar *literal;
+
+    run = g_string_new(NULL);
+    best = g_string_new(NULL);
+
+    for ( c = pattern ; *c != '\0' ; c = next )
+    {
+        next = c + 1;
+        literal = NULL;
+        switch ( *c )
+        {
+        case '\\':
+            if ( g_ascii_isdigit(c[1]) )
+            {
+                /* Back-reference */
+                for ( ; g_ascii_isdigit(*next) ; ++next );
+                _eventd_events_regex_literal_end(run, best);
+            }
+            else if ( ( c[1] != '\0' ) && ( strchr("dDwWsSbBAzZGhHvVRXKnrtfea", c[1]) != NULL ) )
+            {
+                next = c + 2;
+                _eventd_events_regex_literal_end(run, best);
+            }
+            else if ( ( c[1] != '\0' ) && ( ! g_ascii_isalnum(c[1]) ) )
+            {
+                literal = c + 1;
+                next = g_utf8_next_char(literal);
+            }
+            else
+                goto fail;
+        break;
+        case '[':
+            /* Skip the whole class */
+            if ( *next == '^' )
+                ++next;
+            if ( *next == ']' )
+                ++next;
+            for ( ; ( *next != '\0' ) && ( *next != ']' ) ; ++next )
+            {
+                if ( ( *next == '\\' ) && ( next[1] != '\0' ) )
+                    ++next;
+                else if ( ( *next == '[' ) && ( next[1] == ':' ) )
+                {
+                    const gchar *e = strstr(next, ":]");
+                    if ( e == NULL )
+                        goto fail;
+                    next = e + 1;
+                }
+            }
+            if ( *next == '\0' )
+                goto fail;
+            ++next;
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        case '(':
+            if ( ( *next == '*' ) || ( ( *next == '?' ) && ( strchr(":=!<", next[1]) == NULL ) ) )
+                /* Inline options, verbs, named or recursive groups */
+                goto fail;
+            ++depth;
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        case ')':
+            --depth;
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        case '|':
+            if ( depth == 0 )
+                goto fail;
+        break;
+        case '{':
+            for ( ; ( *next != '\0' ) && ( *next != '}' ) && ( g_ascii_isdigit(*next) || ( *next == ',' ) ) ; ++next );
+            if ( *next == '}' )
+                ++next;
+            /* fallthrough */
+        case '.':
+        case '^':
+        case '$':
+        case '?':
+        case '*':
+        case '+':
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        default:
+            /* The pattern is valid UTF-8, and quantifiers apply to whole characters */
+            literal = c;
+            next = g_utf8_next_char(c);
+        }
+
+        if ( ( literal == NULL ) || ( depth > 0 ) )
+            continue;
+
+        /* The quantifier applies to this character only */
+        switch ( *next )
+        {
+        case '?':
+        case '*':
+        case '{':
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        case '+':
+            g_string_append_len(run, literal, next - literal);
+            _eventd_events_regex_literal_end(run, best);
+        break;
+        default:
+            g_string_append_len(run, literal, next - literal);
+        }
+    }
+    _eventd_events_regex_literal_end(run, best);
+
+    g_string_free(run, TRUE);
+    if ( best->len < 2 )
+    {
+        g_string_free(best, TRUE);
+        return NULL;
+    }
+    return g_string_free(best, FALSE);
+
+fail:
+    g_string_free(run, TRUE);
+    g_string_free(best, TRUE);
+    return NULL;
+}
+
+static gboolean
+_eventd_events_parse_data_regex(gchar *data, EventdEventsEventDataRegex *match, GError **error)
+{
+    gchar *regex_;
+    GRegex *regex;
+    GError *_inner_error_ = NULL;
+
+    regex_ = g_utf8_strchr(data, -1, ',');
+    if ( regex_ == NULL )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Data matches must be of the form 'data-name,regex'");
+        g_free(data);
+        return FALSE;
+    }
+    *regex_ = '\0';
+    ++regex_;
+
+    regex = g_regex_new(regex_, G_REGEX_OPTIMIZE, 0, &_inner_error_);
+    if ( regex == NULL )
+    {
+        g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED, "Could not compile regex '%s': %s", regex_, _inner_error_->message);
+        g_error_free(_inner_error_);
+        g_free(data);
+        return FALSE;
+    }
+
+    match->data = data;
+    match->regex = regex;
+    match->literal = _eventd_events_regex_get_literal(regex_);
+    return TRUE;
+}
+
+/* Same as _eventd_events_parse_data_matches() */
+static EventdEventsEventDataRegex *
+_eventd_events_parse_data_regexes(gchar **if_data_regexes, gsize length, GError **error)
+{
+    gchar **if_data_regex;
+    EventdEventsEventDataRegex *matches, *match;
+    GError *_inner_error_ = NULL;
+
+    matches = g_new0(EventdEventsEventDataRegex, length + 1);
+    match = matches;
+
+    for ( if_data_regex = if_data_regexes ; *if_data_regex != NULL ; ++if_data_regex )
+    {
+        if ( _eventd_events_parse_data_regex(*if_data_regex, match, &_inner_error_) )
+            ++match;
+        else if ( error == NULL )
+        {
+            g_warning("%s", _inner_error_->message);
+            g_clear_error(&_inner_error_);
+        }
+        else
+        {
+            g_propagate_error(error, _inner_error_);
+            for ( ++if_data_regex ; *if_data_regex != NULL ; ++if_data_regex )
+                g_free(*if_data_regex);
+            match->data = NULL;
+            _eventd_events_data_regexes_free(matches);
+            g_free(if_data_regexes);
+            return NULL;
+        }
+    }
+    match->data = NULL;
+    g_free(if_data_regexes);
+
+    return matches;
+}
+
 static void
 _eventd_events_parse_group(EventdEvents *self, const gchar *group, GKeyFile *config_file)
 {
@@ -407,6 +1503,7 @@ _eventd_events_parse_group(EventdEvents *self, const gchar *group, GKeyFile *con
         g_free(actions);
     }
 
+    event->limits = eventd_limits_rule_parse(config_file, group);
 
     gchar **if_data;
     gchar **if_data_matches;
@@ -418,172 +1515,20 @@ _eventd_events_parse_group(EventdEvents *self, const gchar *group, GKeyFile *con
         event->if_data = if_data;
 
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "IfDataMatches", &if_data_matches, &length) == 0 )
-    {
-        gchar **if_data_match;
-        EventdEventsEventDataMatch *match;
-        gchar *tmp, *data, *key = NULL, *operator, *value_;
-        gint accepted[2];
-        GVariant *value;
-        GError *error = NULL;
-
-        event->if_data_matches = g_new0(EventdEventsEventDataMatch, length + 1);
-        match = event->if_data_matches;
-
-        for ( if_data_match = if_data_matches ; *if_data_match != NULL ; ++if_data_match )
-        {
-            data = *if_data_match;
-            tmp = g_utf8_strchr(data, -1, ',');
-            if ( tmp == NULL )
-            {
-                g_warning("Data matches must be of the form 'data-name,operator,value'");
-                g_free(data);
-                continue;
-            }
-            operator = g_utf8_next_char(tmp);
-            *tmp = '\0';
-
-            tmp = g_utf8_strchr(data, -1, '[');
-            if ( tmp != NULL )
-            {
-                key = g_utf8_next_char(tmp);
-                *tmp = '\0';
-                tmp = g_utf8_strchr(key, -1, ']');
-                if ( ( tmp == NULL ) || ( g_utf8_get_char(g_utf8_next_char(tmp)) != '\0' ) )
-                {
-                    g_warning("Data matches must be of the form 'data-name[key],operator,value'");
-                    g_free(data);
-                    continue;
-                }
-                *tmp = '\0';
-            }
-
-            tmp = g_utf8_strchr(operator, -1, ',');
-            if ( tmp == NULL )
-            {
-                g_warning("Data matches must be of the form 'data-name,operator,value'");
-                g_free(data);
-                continue;
-            }
-            value_ = g_utf8_next_char(tmp);
-            *tmp = '\0';
-
-            gsize l = g_utf8_strlen(operator, -1);
-            if ( ( l > 2 ) || ( l < 1 ) )
-            {
-                g_warning("Unsupported operator: %s", operator);
-                g_free(data);
-                continue;
-            }
-            accepted[0] = -2;
-            switch ( g_utf8_get_char(g_utf8_next_char(operator)) )
-            {
-            case '=':
-                accepted[1] = 0;
-                switch ( g_utf8_get_char(operator) )
-                {
-                case '<':
-                    accepted[0] = -1;
-                break;
-                case '>':
-                    accepted[0] = 1;
-                break;
-                case '=':
-                    accepted[0] = 0;
-                break;
-                case '!':
-                    accepted[0] = -1;
-                    accepted[1] = 1;
-                break;
-                }
-            break;
-            case '\0':
-                switch ( g_utf8_get_char(operator) )
-                {
-                case '<':
-                    accepted[0] = accepted[1] = -1;
-                break;
-                case '>':
-                    accepted[0] = accepted[1] = 1;
-                break;
-                }
-            }
-            if ( accepted[0] == -2 )
-            {
-                g_warning("Unsupported operator: %s", operator);
-                g_free(data);
-                continue;
-            }
-
-            value = g_variant_parse(NULL, value_, NULL, NULL, &error);
-            if ( value == NULL )
-            {
-                g_warning("Could not parse variant '%s': %s", value_, error->message);
-                g_clear_error(&error);
-                g_free(data);
-                continue;
-            }
-
-            match->data = data;
-            match->key = key;
-            match->accepted[0] = accepted[0];
-            match->accepted[1] = accepted[1];
-            match->value = value;
-            ++match;
-        }
-        match->data = NULL;
-        g_free(if_data_matches);
-    }
+        event->if_data_matches = _eventd_events_parse_data_matches(if_data_matches, length, NULL);
 
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "IfDataRegex", &if_data_regexes, &length) == 0 )
-    {
-        gchar **if_data_regex;
-        EventdEventsEventDataRegex *match;
-        gchar *data, *regex_;
-        GError *error = NULL;
-        GRegex *regex;
-
-        event->if_data_regexes = g_new0(EventdEventsEventDataRegex, length + 1);
-        match = event->if_data_regexes;
-
-        for ( if_data_regex = if_data_regexes ; *if_data_regex != NULL ; ++if_data_regex )
-        {
-            data = *if_data_regex;
-            regex_ = g_utf8_strchr(data, -1, ',');
-            if ( regex_ == NULL )
-            {
-                g_warning("Data matches must be of the form 'data-name,regex'");
-                g_free(data);
-                continue;
-            }
-            *regex_ = '\0';
-            ++regex_;
-
-            regex = g_regex_new(regex_, G_REGEX_OPTIMIZE, 0, &error);
-            if ( regex == NULL )
-            {
-                g_warning("Could not compile regex '%s': %s", regex_, error->message);
-                g_clear_error(&error);
-                g_free(data);
-                continue;
-            }
-
-            match->data = data;
-            match->regex = regex;
-            ++match;
-        }
-        match->data = NULL;
-        g_free(if_data_regexes);
-    }
+        event->if_data_regexes = _eventd_events_parse_data_regexes(if_data_regexes, length, NULL);
 
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "OnlyIfFlags", &flags, &length) == 0 )
-        event->flags_whitelist = eventd_config_parse_flags_list(flags, length);
+        eventd_flags_parse_list(&event->flags_whitelist, flags, length);
 
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "NotIfFlags", &flags, &length) == 0 )
-        event->flags_blacklist = eventd_config_parse_flags_list(flags, length);
+        eventd_flags_parse_list(&event->flags_blacklist, flags, length);
 
     gint64 default_importance, importance;
 
-    if ( ( event->if_data != NULL ) || ( event->if_data_matches != NULL ) || ( event->if_data_regexes != NULL ) || ( event->flags_whitelist != NULL ) || ( event->flags_blacklist != NULL ) )
+    if ( ( event->if_data != NULL ) || ( event->if_data_matches != NULL ) || ( event->if_data_regexes != NULL ) || ( ! eventd_flags_is_empty(&event->flags_whitelist) ) || ( ! eventd_flags_is_empty(&event->flags_blacklist) ) )
         default_importance = 0;
     else
         default_importance = G_MAXINT64;
@@ -610,6 +1555,8 @@ eventd_events_parse(EventdEvents *self, GKeyFile *config_file)
 {
     gchar **groups, **group;
 
+    _eventd_events_uncompile(self);
+
     groups = g_key_file_get_groups(config_file, NULL);
     if ( groups != NULL )
     {
@@ -639,11 +1586,15 @@ eventd_events_link_actions(EventdEvents *self, EventdActions *actions)
             eventd_actions_replace_actions(actions, &event->actions);
         }
     }
+
+    if ( self->index == NULL )
+        _eventd_events_compile(self);
 }
 
 void
 eventd_events_reset(EventdEvents *self)
 {
+    _eventd_events_uncompile(self);
     g_hash_table_remove_all(self->events);
     g_hash_table_remove_all(self->events_by_id);
 }
@@ -664,8 +1615,94 @@ eventd_events_new(void)
 void
 eventd_events_free(EventdEvents *self)
 {
+    _eventd_events_uncompile(self);
     g_hash_table_unref(self->events_by_id);
     g_hash_table_unref(self->events);
 
     g_free(self);
 }
+
+#define EVENTD_EVENTS_FILTER_MAX_REGEXES 8
+#define EVENTD_EVENTS_FILTER_MAX_REGEX_LENGTH 256
+
+struct _EventdEventsFilter {
+    gchar **if_data;
+    EventdEventsEventDataMatch *if_data_matches;
+    EventdEventsEventDataRegex *if_data_regexes;
+};
+
+GQuark
+eventd_events_error_quark(void)
+{
+    return g_quark_from_static_string("eventd_events_error-quark");
+}
+
+/*
+ * Filters come from clients: any invalid condition fails the whole filter,
+ * so it never matches more than asked, and regexes are limited since
+ * they run on the core thread for each dispatched event
+ */
+EventdEventsFilter *
+eventd_events_filter_new(gchar * const *if_data, gchar * const *if_data_matches, gchar * const *if_data_regexes, GError **error)
+{
+    EventdEventsFilter *self;
+
+    if ( ( if_data == NULL ) && ( if_data_matches == NULL ) && ( if_data_regexes == NULL ) )
+        return NULL;
+
+    if ( if_data_regexes != NULL )
+    {
+        gchar * const *if_data_regex;
+        gsize length = g_strv_length((gchar **) if_data_regexes);
+        if ( length > EVENTD_EVENTS_FILTER_MAX_REGEXES )
+        {
+            g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_LIMIT, "Too many regexes (%" G_GSIZE_FORMAT ", maximum is %d)", length, EVENTD_EVENTS_FILTER_MAX_REGEXES);
+            return NULL;
+        }
+        for ( if_data_regex = if_data_regexes ; *if_data_regex != NULL ; ++if_data_regex )
+        {
+            if ( strlen(*if_data_regex) > EVENTD_EVENTS_FILTER_MAX_REGEX_LENGTH )
+            {
+                g_set_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_LIMIT, "Regex too long (maximum is %d bytes)", EVENTD_EVENTS_FILTER_MAX_REGEX_LENGTH);
+                return NULL;
+            }
+        }
+    }
+
+    self = g_new0(EventdEventsFilter, 1);
+
+    if ( if_data != NULL )
+        self->if_data = g_strdupv((gchar **) if_data);
+    if ( ( if_data_matches != NULL ) && ( ( self->if_data_matches = _eventd_events_parse_data_matches(g_strdupv((gchar **) if_data_matches), g_strv_length((gchar **) if_data_matches), error) ) == NULL ) )
+        goto fail;
+    if ( ( if_data_regexes != NULL ) && ( ( self->if_data_regexes = _eventd_events_parse_data_regexes(g_strdupv((gchar **) if_data_regexes), g_strv_length((gchar **) if_data_regexes), error) ) == NULL ) )
+        goto fail;
+
+    return self;
+
+fail:
+    eventd_events_filter_free(self);
+    return NULL;
+}
+
+gboolean
+eventd_events_filter_matches(const EventdEventsFilter *self, EventdEvent *event)
+{
+    if ( self == NULL )
+        return TRUE;
+
+    return _eventd_events_data_check(self->if_data, self->if_data_matches, self->if_data_regexes, event);
+}
+
+void
+eventd_events_filter_free(EventdEventsFilter *self)
+{
+    if ( self == NULL )
+        return;
+
+    _eventd_events_data_regexes_free(self->if_data_regexes);
+    _eventd_events_data_matches_free(self->if_data_matches);
+    g_strfreev(self->if_data);
+
+    g_free(self);
+}
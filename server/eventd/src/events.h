@@ -30,8 +30,25 @@ void eventd_events_free(EventdEvents *self);
 void eventd_events_parse(EventdEvents *self, GKeyFile *config_file);
 void eventd_events_link_actions(EventdEvents *self, EventdActions *actions);
 
-gboolean eventd_events_process_event(EventdEvents *self, EventdEvent *event, GQuark *flags, const GList **actions);
+gboolean eventd_events_process_event(EventdEvents *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits);
+#ifdef EVENTD_EVENTS_LINEAR_MATCHER
+/* Reference implementation walking the events lists, for tests and benchmarks */
+gboolean eventd_events_process_event_linear(EventdEvents *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits);
+#endif /* EVENTD_EVENTS_LINEAR_MATCHER */
 
 gchar *eventd_events_dump_event(EventdEvents *self, const gchar *event_id);
 
+/* Standalone IfData/IfDataMatches/IfDataRegex conditions, as used for subscriptions */
+typedef enum {
+    EVENTD_EVENTS_ERROR_MALFORMED,
+    EVENTD_EVENTS_ERROR_LIMIT,
+} EventdEventsError;
+
+GQuark eventd_events_error_quark(void);
+#define EVENTD_EVENTS_ERROR (eventd_events_error_quark())
+
+EventdEventsFilter *eventd_events_filter_new(gchar * const *if_data, gchar * const *if_data_matches, gchar * const *if_data_regexes, GError **error);
+gboolean eventd_events_filter_matches(const EventdEventsFilter *self, EventdEvent *event);
+void eventd_events_filter_free(EventdEventsFilter *self);
+
 #endif /* __EVENTD_EVENTS_H__ */
@@ -22,52 +22,340 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
 
 #include "libeventd-event.h"
+#include "libeventd-event-private.h"
 #include "libeventd-protocol.h"
 #include "eventd-plugin.h"
 #include "libeventd-helpers-config.h"
 
 #include "../eventd.h"
+#include "../events.h"
+#include "../metrics.h"
 #include "evp-internal.h"
 
 #include "client.h"
+#include "worker.h"
+
+#define EVENTD_EVP_CLIENT_READ_BUFFER_SIZE 4096
+#define EVENTD_EVP_CLIENT_FLUSH_DELAY 2
+#define EVENTD_EVP_CLIENT_FLUSH_SIZE (64 * 1024)
+#define EVENTD_EVP_CLIENT_HIGH_WATER (4 * 1024 * 1024)
 
 struct _EventdEvpClient {
     EventdEvpContext *context;
+    EventdEvpWorkers *workers;
     GList *link;
     EventdProtocol *protocol;
+    GMutex protocol_lock;
+    GPtrArray *client_certificates;
     GCancellable *cancellable;
     GIOStream *connection;
-    GDataInputStream *in;
-    GDataOutputStream *out;
+    GInputStream *in;
+    gchar *buffer;
+    GOutputStream *out;
+    struct {
+        GCancellable *cancellable;
+        GQueue messages;
+        gsize size;
+        GBytes **messages_writing;
+        GOutputVector *vectors;
+        gsize n_writing;
+        gsize current;
+        GSource *source;
+        guint flush;
+        gboolean overflow;
+        gboolean closed;
+    } write;
     EventdEvent *current;
-    GList *subscribe_all;
-    GHashTable *subscriptions;
+    EventdEventsFilter *filter;
+    gchar **only_data;
+    gchar *projection;
+    gboolean subscribed;
+    EventdMetricsConnection *metrics;
+    gint64 parse_nested;
+    GError *rejected;
 };
 
 
 static void _eventd_evp_client_disconnect_internal(EventdEvpClient *self);
 
+/*
+ * With workers, the worker thread parses while the core thread generates
+ * our messages, and both touch the protocol state (e.g. binary frames)
+ * Without workers, the core thread generates from within the parser,
+ * so we must not lock there
+ */
+static void
+_eventd_evp_client_protocol_lock(EventdEvpClient *self)
+{
+    if ( self->workers != NULL )
+        g_mutex_lock(&self->protocol_lock);
+}
+
+static void
+_eventd_evp_client_protocol_unlock(EventdEvpClient *self)
+{
+    if ( self->workers != NULL )
+        g_mutex_unlock(&self->protocol_lock);
+}
+static void _eventd_evp_client_free(EventdEvpClient *self);
+
+static void
+_eventd_evp_client_write_release(EventdEvpClient *self)
+{
+    gsize i;
+
+    for ( i = 0 ; i < self->write.n_writing ; ++i )
+        g_bytes_unref(self->write.messages_writing[i]);
+    g_free(self->write.messages_writing);
+    g_free(self->write.vectors);
+    self->write.messages_writing = NULL;
+    self->write.vectors = NULL;
+    self->write.n_writing = 0;
+    self->write.current = 0;
+}
+
+static void _eventd_evp_client_flush(EventdEvpClient *self);
+
+static void
+_eventd_evp_client_write_done(EventdEvpClient *self, GError *error)
+{
+    if ( error != NULL )
+    {
+        if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+            g_warning("Couldn't send messages: %s", error->message);
+        g_error_free(error);
+        g_queue_clear_full(&self->write.messages, (GDestroyNotify) g_bytes_unref);
+        self->write.size = 0;
+        g_cancellable_cancel(self->cancellable);
+    }
+
+    _eventd_evp_client_write_release(self);
+
+    /* Frees us if we are closed and have nothing left */
+    _eventd_evp_client_flush(self);
+}
+
+static void _eventd_evp_client_write(EventdEvpClient *self);
+
+static gboolean
+_eventd_evp_client_write_ready(GObject *stream, gpointer user_data)
+{
+    EventdEvpClient *self = user_data;
+
+    g_source_unref(self->write.source);
+    self->write.source = NULL;
+    _eventd_evp_client_write(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * We do not use g_output_stream_writev_all_async(), so that we always know
+ * how far we got, and can move our write to another context on stop
+ * (see eventd_evp_client_move_write())
+ */
 static void
-_eventd_evp_client_send_message(EventdEvpClient *self, gchar *message)
+_eventd_evp_client_write(EventdEvpClient *self)
 {
+    GPollableOutputStream *out = G_POLLABLE_OUTPUT_STREAM(self->out);
     GError *error = NULL;
 
-    eventd_debug("Sending message:\n%s", message);
+    while ( self->write.current < self->write.n_writing )
+    {
+        GPollableReturn r;
+        gsize written;
 
-    if ( g_data_output_stream_put_string(self->out, message, NULL, &error) )
-        goto end;
+        r = g_pollable_output_stream_writev_nonblocking(out, self->write.vectors + self->write.current, self->write.n_writing - self->write.current, &written, self->write.cancellable, &error);
+        if ( r == G_POLLABLE_RETURN_FAILED )
+            break;
+        if ( r == G_POLLABLE_RETURN_WOULD_BLOCK )
+        {
+            self->write.source = g_pollable_output_stream_create_source(out, self->write.cancellable);
+            g_source_set_callback(self->write.source, (GSourceFunc) _eventd_evp_client_write_ready, self, NULL);
+            g_source_attach(self->write.source, g_main_context_get_thread_default());
+            return;
+        }
 
-    g_warning("Couldn't send message: %s", error->message);
-    g_clear_error(&error);
-    g_cancellable_cancel(self->cancellable);
+        while ( ( self->write.current < self->write.n_writing ) && ( written >= self->write.vectors[self->write.current].size ) )
+            written -= self->write.vectors[self->write.current++].size;
+        if ( written > 0 )
+        {
+            GOutputVector *vector = &self->write.vectors[self->write.current];
+            vector->buffer = (const guint8 *) vector->buffer + written;
+            vector->size -= written;
+        }
+    }
 
-end:
-    g_free(message);
+    _eventd_evp_client_write_done(self, error);
+}
+
+static void
+_eventd_evp_client_flush(EventdEvpClient *self)
+{
+    gsize i;
+
+    if ( self->write.flush > 0 )
+        g_source_remove(self->write.flush);
+    self->write.flush = 0;
+
+    if ( self->write.n_writing > 0 )
+        return;
+
+    if ( g_queue_is_empty(&self->write.messages) )
+    {
+        if ( self->write.closed )
+            _eventd_evp_client_free(self);
+        return;
+    }
+
+    self->write.n_writing = g_queue_get_length(&self->write.messages);
+    self->write.messages_writing = g_new(GBytes *, self->write.n_writing);
+    self->write.vectors = g_new(GOutputVector, self->write.n_writing);
+    for ( i = 0 ; i < self->write.n_writing ; ++i )
+    {
+        GBytes *message = g_queue_pop_head(&self->write.messages);
+        self->write.messages_writing[i] = message;
+        self->write.vectors[i].buffer = g_bytes_get_data(message, &self->write.vectors[i].size);
+    }
+
+    eventd_debug("Flushing %" G_GSIZE_FORMAT " messages (%" G_GSIZE_FORMAT " bytes)", self->write.n_writing, self->write.size);
+    self->write.size = 0;
+
+    _eventd_evp_client_write(self);
+}
+
+static gboolean
+_eventd_evp_client_flush_callback(gpointer user_data)
+{
+    EventdEvpClient *self = user_data;
+
+    self->write.flush = 0;
+    _eventd_evp_client_flush(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_evp_client_send_message(EventdEvpClient *self, GBytes *message)
+{
+    gsize size = g_bytes_get_size(message);
+
+    if ( ( self->out == NULL ) || self->write.overflow )
+    {
+        g_bytes_unref(message);
+        return;
+    }
+
+    eventd_debug("Queuing message (%" G_GSIZE_FORMAT " bytes)", size);
+
+    if ( ( self->write.size + size ) > EVENTD_EVP_CLIENT_HIGH_WATER )
+    {
+        /*
+         * The client is not reading fast enough
+         * We do not want to buffer forever, so we drop it
+         */
+        g_warning("Client output queue is over %d bytes, disconnecting", EVENTD_EVP_CLIENT_HIGH_WATER);
+        g_bytes_unref(message);
+        g_queue_clear_full(&self->write.messages, (GDestroyNotify) g_bytes_unref);
+        self->write.size = 0;
+        self->write.overflow = TRUE;
+        g_cancellable_cancel(self->write.cancellable);
+        g_cancellable_cancel(self->cancellable);
+        return;
+    }
+
+    g_queue_push_tail(&self->write.messages, message);
+    self->write.size += size;
+
+    if ( self->write.size >= EVENTD_EVP_CLIENT_FLUSH_SIZE )
+        _eventd_evp_client_flush(self);
+    else if ( ( self->write.flush == 0 ) && ( self->write.n_writing == 0 ) )
+        self->write.flush = g_timeout_add(EVENTD_EVP_CLIENT_FLUSH_DELAY, _eventd_evp_client_flush_callback, self);
+}
+
+static void
+_eventd_evp_client_send_text_message(EventdEvpClient *self, gchar *message)
+{
+    _eventd_evp_client_send_message(self, g_bytes_new_take(message, strlen(message)));
+}
+
+/*
+ * With worker threads, everything touching the core or our output
+ * is deferred to the core thread
+ */
+static void
+_eventd_evp_client_post(EventdEvpClient *self, EventdEvpWorkerMessageType type, gpointer data)
+{
+    if ( self->workers != NULL )
+        eventd_evp_workers_push(self->workers, self, type, data);
+    else
+        eventd_evp_client_worker_message(self, type, data, FALSE);
+}
+
+typedef struct {
+    GHashTable *categories;
+    EventdEventsFilter *filter;
+    gchar **only_data;
+} EventdEvpClientSubscription;
+
+static void
+_eventd_evp_client_subscription_free(EventdEvpClientSubscription *subscription)
+{
+    if ( subscription->categories != NULL )
+        g_hash_table_unref(subscription->categories);
+    eventd_events_filter_free(subscription->filter);
+    g_strfreev(subscription->only_data);
+
+    g_slice_free(EventdEvpClientSubscription, subscription);
+}
+
+static gint
+_eventd_evp_client_compare_data_name(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    return g_strcmp0(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+static void
+_eventd_evp_client_subscribe(EventdEvpClient *self, EventdEvpClientSubscription *subscription)
+{
+    if ( self->link == NULL )
+        /* Already removed from the context */
+        return;
+
+    /*
+     * The filter and projection apply to the whole connection, so we cannot
+     * honour them along with another subscription
+     */
+    if ( self->subscribed && ( ( self->filter != NULL ) || ( self->only_data != NULL ) || ( subscription->filter != NULL ) || ( subscription->only_data != NULL ) ) )
+    {
+        g_warning("Client subscribed again with a filter or projection, ignoring the new subscription");
+        return;
+    }
+    self->subscribed = TRUE;
+
+    self->filter = subscription->filter;
+    self->only_data = subscription->only_data;
+    subscription->filter = NULL;
+    subscription->only_data = NULL;
+
+    if ( self->only_data != NULL )
+    {
+        /*
+         * Clients asking for the same data share the projected event,
+         * so we need a canonical key for them
+         */
+        g_qsort_with_data(self->only_data, g_strv_length(self->only_data), sizeof(gchar *), _eventd_evp_client_compare_data_name, NULL);
+        self->projection = g_strjoinv("\n", self->only_data);
+    }
+
+    evhelpers_subscriptions_add(self->context->subscriptions, self, subscription->categories);
 }
 
 static void
@@ -75,43 +363,61 @@ _eventd_evp_client_protocol_event(EventdProtocol *protocol, EventdEvent *event,
 {
     EventdEvpClient *self = user_data;
 
-    eventd_debug("Received an event (category: %s): %s", eventd_event_get_category(event), eventd_event_get_name(event));
+    if ( self->rejected != NULL )
+        return;
 
-    self->current = event;
-    eventd_core_push_event(self->context->core, event);
-    self->current = NULL;
+    _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_EVENT, eventd_event_ref(event));
 }
 
 static void
-_eventd_evp_client_protocol_subscribe(EventdProtocol *protocol, GHashTable *categories, gpointer user_data)
+_eventd_evp_client_protocol_subscribe_filter(EventdProtocol *protocol, GHashTable *categories, const EventdProtocolSubscribeFilter *filter, gpointer user_data)
 {
     EventdEvpClient *self = user_data;
+    EventdEvpClientSubscription *subscription;
+    EventdEventsFilter *events_filter = NULL;
+
+    if ( self->rejected != NULL )
+        return;
+
+    if ( filter != NULL )
+    {
+        /* Regexes are compiled here, on the worker thread if any */
+        events_filter = eventd_events_filter_new(filter->if_data, filter->if_data_matches, filter->if_data_regexes, &self->rejected);
+        if ( self->rejected != NULL )
+            /* The read callback will say goodbye */
+            return;
+    }
+
+    subscription = g_slice_new0(EventdEvpClientSubscription);
 
     if ( categories == NULL )
+        subscription->categories = NULL;
+    else if ( self->workers != NULL )
     {
-        self->context->subscribe_all = g_list_prepend(self->context->subscribe_all, self);
-        self->subscribe_all = self->context->subscribe_all;
-        return;
+        /* The parser owns the categories strings */
+        GHashTableIter iter;
+        gchar *category;
+        subscription->categories = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_iter_init(&iter, categories);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &category, NULL) )
+            g_hash_table_add(subscription->categories, g_strdup(category));
     }
+    else
+        subscription->categories = g_hash_table_ref(categories);
 
-    GHashTableIter iter;
-    gchar *category;
-    gpointer dummy;
-    gchar *key = NULL;
-    GList *list = NULL;
-    g_hash_table_iter_init(&iter, categories);
-    while ( g_hash_table_iter_next(&iter, (gpointer *) &category, &dummy) )
+    if ( filter != NULL )
     {
-        if ( g_hash_table_lookup_extended(self->context->subscribe_categories, category, (gpointer *) &key, (gpointer *) &list) )
-            g_hash_table_steal(self->context->subscribe_categories, category);
-        else
-            key = g_strdup(category);
+        subscription->filter = events_filter;
+        subscription->only_data = g_strdupv(filter->only_data);
+    }
 
-        list = g_list_prepend(list, self);
+    _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_SUBSCRIBE, subscription);
+}
 
-        g_hash_table_insert(self->context->subscribe_categories, key, list);
-        g_hash_table_insert(self->subscriptions, key, list);
-    }
+static void
+_eventd_evp_client_protocol_subscribe(EventdProtocol *protocol, GHashTable *categories, gpointer user_data)
+{
+    _eventd_evp_client_protocol_subscribe_filter(protocol, categories, NULL, user_data);
 }
 
 static void
@@ -124,10 +430,20 @@ _eventd_evp_client_protocol_bye(EventdProtocol *protocol, const gchar *message,
     g_cancellable_cancel(self->cancellable);
 }
 
+static void
+_eventd_evp_client_protocol_binary(EventdProtocol *protocol, gpointer user_data)
+{
+    EventdEvpClient *self = user_data;
+
+    _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_BINARY, NULL);
+}
+
 static const EventdProtocolCallbacks _eventd_evp_client_protocol_callbacks = {
     .event = _eventd_evp_client_protocol_event,
     .subscribe = _eventd_evp_client_protocol_subscribe,
-    .bye = _eventd_evp_client_protocol_bye
+    .subscribe_filter = _eventd_evp_client_protocol_subscribe_filter,
+    .bye = _eventd_evp_client_protocol_bye,
+    .binary = _eventd_evp_client_protocol_binary,
 };
 
 static void
@@ -135,31 +451,43 @@ _eventd_evp_client_read_callback(GObject *obj, GAsyncResult *res, gpointer user_
 {
     EventdEvpClient *self = user_data;
     GError *error = NULL;
-    gchar *line;
-    gsize length;
+    gssize length;
 
-    line = g_data_input_stream_read_line_finish_utf8(G_DATA_INPUT_STREAM(obj), res, &length, &error);
-    if ( line == NULL )
+    length = g_input_stream_read_finish(G_INPUT_STREAM(obj), res, &error);
+    if ( length <= 0 )
     {
         if ( ( error != NULL ) && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
-            _eventd_evp_client_send_message(self, eventd_protocol_generate_bye(self->protocol, NULL));
+            _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_BYE, NULL);
         goto end;
     }
 
-    if ( ! eventd_protocol_parse(self->protocol, line, length, &error) )
+    gint64 start = eventd_metrics_now();
+    gboolean parsed;
+    self->parse_nested = 0;
+    _eventd_evp_client_protocol_lock(self);
+    parsed = eventd_protocol_parse_chunk(self->protocol, self->buffer, length, &error);
+    _eventd_evp_client_protocol_unlock(self);
+    eventd_metrics_stage(EVENTD_METRICS_STAGE_PARSE, start + self->parse_nested);
+    if ( self->rejected != NULL )
+    {
+        /* Clients can send whatever they want, do not fill our logs */
+        eventd_debug("Rejected client subscription: %s", self->rejected->message);
+        _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_BYE, g_strdup(self->rejected->message));
+        g_clear_error(&self->rejected);
+        goto end;
+    }
+    if ( ! parsed )
         goto error;
-    g_free(line);
 
-    g_data_input_stream_read_line_async(self->in, G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_read_callback, self);
+    g_input_stream_read_async(self->in, self->buffer, EVENTD_EVP_CLIENT_READ_BUFFER_SIZE, G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_read_callback, self);
     return;
 
 error:
     g_warning("Error reading client message: %s", error->message);
-    _eventd_evp_client_send_message(self, eventd_protocol_generate_bye(self->protocol, error->message));
+    _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_BYE, g_strdup(error->message));
 end:
-    g_free(line);
     g_clear_error(&error);
-    _eventd_evp_client_disconnect_internal(self);
+    _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_DISCONNECT, NULL);
 }
 
 
@@ -170,11 +498,11 @@ end:
 static void
 _eventd_evp_client_connect(EventdEvpClient *self)
 {
-    self->in = g_data_input_stream_new(g_io_stream_get_input_stream(self->connection));
-    self->out = g_data_output_stream_new(g_io_stream_get_output_stream(self->connection));
-    g_data_input_stream_set_newline_type(self->in, G_DATA_STREAM_NEWLINE_TYPE_LF);
+    self->in = g_object_ref(g_io_stream_get_input_stream(self->connection));
+    self->out = g_object_ref(g_io_stream_get_output_stream(self->connection));
+    self->buffer = g_new(gchar, EVENTD_EVP_CLIENT_READ_BUFFER_SIZE);
 
-    g_data_input_stream_read_line_async(self->in, G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_read_callback, self);
+    g_input_stream_read_async(self->in, self->buffer, EVENTD_EVP_CLIENT_READ_BUFFER_SIZE, G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_read_callback, self);
 }
 
 static void
@@ -186,7 +514,7 @@ _eventd_evp_client_tls_handshake_callback(GObject *obj, GAsyncResult *res, gpoin
     {
         g_warning("Could not finish TLS handshake: %s", error->message);
         g_clear_error(&error);
-        _eventd_evp_client_disconnect_internal(self);
+        _eventd_evp_client_post(self, EVENTD_EVP_WORKER_MESSAGE_DISCONNECT, NULL);
         return;
     }
 
@@ -197,15 +525,50 @@ static gboolean
 _eventd_evp_client_tls_certificate_callback(gpointer user_data, GTlsCertificate *peer_cert, GTlsCertificateFlags errors, GObject *obj)
 {
     EventdEvpClient *self = user_data;
-    GList *cert;
-    for ( cert = self->context->client_certificates ; cert != NULL ; cert = g_list_next(cert) )
+    guint i;
+    for ( i = 0 ; i < self->client_certificates->len ; ++i )
     {
-        if ( g_tls_certificate_is_same(peer_cert, cert->data) )
+        if ( g_tls_certificate_is_same(peer_cert, g_ptr_array_index(self->client_certificates, i)) )
             return TRUE;
     }
     return FALSE;
 }
 
+static gchar *
+_eventd_evp_client_get_peer(GSocketConnection *connection)
+{
+    GSocketAddress *address;
+    gchar *peer = NULL;
+
+    address = g_socket_connection_get_remote_address(connection, NULL);
+    if ( G_IS_INET_SOCKET_ADDRESS(address) )
+        peer = g_socket_connectable_to_string(G_SOCKET_CONNECTABLE(address));
+    if ( address != NULL )
+        g_object_unref(address);
+
+    return ( peer != NULL ) ? peer : g_strdup("local");
+}
+
+static gboolean
+_eventd_evp_client_start(gpointer user_data)
+{
+    EventdEvpClient *self = user_data;
+
+    if ( G_IS_TLS_CONNECTION(self->connection) )
+    {
+        if ( self->client_certificates != NULL )
+        {
+            g_object_set(self->connection, "authentication-mode", G_TLS_AUTHENTICATION_REQUIRED, NULL);
+            g_signal_connect_swapped(self->connection, "accept-certificate", G_CALLBACK(_eventd_evp_client_tls_certificate_callback), self);
+        }
+        g_tls_connection_handshake_async(G_TLS_CONNECTION(self->connection), G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_tls_handshake_callback, self);
+    }
+    else
+        _eventd_evp_client_connect(self);
+
+    return G_SOURCE_REMOVE;
+}
+
 gboolean
 eventd_evp_client_connection_handler(GSocketService *service, GSocketConnection *connection, GObject *obj, gpointer user_data)
 {
@@ -256,22 +619,26 @@ eventd_evp_client_connection_handler(GSocketService *service, GSocketConnection
     self->context = context;
 
     self->protocol = eventd_protocol_new(&_eventd_evp_client_protocol_callbacks, self, NULL);
-    self->subscriptions = g_hash_table_new(g_str_hash, g_str_equal);
-
+    g_mutex_init(&self->protocol_lock);
+    if ( context->client_certificates != NULL )
+        self->client_certificates = g_ptr_array_ref(context->client_certificates);
     self->cancellable = g_cancellable_new();
+    self->write.cancellable = g_cancellable_new();
+    g_queue_init(&self->write.messages);
     self->connection = stream;
 
-    if ( G_IS_TLS_CONNECTION(self->connection) )
+    gchar *peer = _eventd_evp_client_get_peer(connection);
+    self->metrics = eventd_metrics_connection_new(EVENTD_METRICS_CONNECTION_EVP, peer);
+    g_free(peer);
+
+    self->workers = context->workers;
+    if ( self->workers != NULL )
     {
-        if ( context->client_certificates != NULL )
-        {
-            g_object_set(self->connection, "authentication-mode", G_TLS_AUTHENTICATION_REQUIRED, NULL);
-            g_signal_connect_swapped(self->connection, "accept-certificate", G_CALLBACK(_eventd_evp_client_tls_certificate_callback), self);
-        }
-        g_tls_connection_handshake_async(G_TLS_CONNECTION(self->connection), G_PRIORITY_DEFAULT, self->cancellable, _eventd_evp_client_tls_handshake_callback, self);
+        eventd_evp_workers_add_client(self->workers, self);
+        g_main_context_invoke(eventd_evp_workers_get_context(self->workers), _eventd_evp_client_start, self);
     }
     else
-        _eventd_evp_client_connect(self);
+        _eventd_evp_client_start(self);
 
     self->link = context->clients = g_list_prepend(context->clients, self);
 
@@ -282,34 +649,35 @@ eventd_evp_client_connection_handler(GSocketService *service, GSocketConnection
 static void
 _eventd_evp_client_disconnect_internal(EventdEvpClient *self)
 {
-    GHashTableIter iter;
-    gchar *category, *key;
-    GList *link, *list;
-    g_hash_table_iter_init(&iter, self->subscriptions);
-    while ( g_hash_table_iter_next(&iter, (gpointer *) &category, (gpointer *) &link) )
+    if ( self->link != NULL )
     {
-        g_hash_table_iter_steal(&iter);
-
-        g_hash_table_lookup_extended(self->context->subscribe_categories, category, (gpointer *) &key, (gpointer *) &list);
-        g_hash_table_steal(self->context->subscribe_categories, category);
-
-        list = g_list_delete_link(list, link);
-
-        g_hash_table_insert(self->context->subscribe_categories, key, list);
+        evhelpers_subscriptions_remove(self->context->subscriptions, self);
+        self->context->clients = g_list_delete_link(self->context->clients, self->link);
     }
 
-    if ( self->subscribe_all != NULL )
-        self->context->subscribe_all = g_list_delete_link(self->context->subscribe_all, self->subscribe_all);
-
-    if ( self->link != NULL )
-        self->context->clients = g_list_remove_link(self->context->clients, self->link);
-
     eventd_evp_client_disconnect(self);
 
-    g_hash_table_unref(self->subscriptions);
+    /* We free ourselves once our last messages are written */
+    self->write.closed = TRUE;
+    _eventd_evp_client_flush(self);
+}
+
+static void
+_eventd_evp_client_free(EventdEvpClient *self)
+{
+    if ( self->write.source != NULL )
+    {
+        g_source_destroy(self->write.source);
+        g_source_unref(self->write.source);
+    }
+    if ( self->write.flush > 0 )
+        g_source_remove(self->write.flush);
+    g_queue_clear_full(&self->write.messages, (GDestroyNotify) g_bytes_unref);
+    g_object_unref(self->write.cancellable);
 
     if ( self->in != NULL )
         g_object_unref(self->in);
+    g_free(self->buffer);
     if ( self->out != NULL )
         g_object_unref(self->out);
 
@@ -321,6 +689,18 @@ _eventd_evp_client_disconnect_internal(EventdEvpClient *self)
 
     g_object_unref(self->cancellable);
     eventd_protocol_unref(self->protocol);
+    g_mutex_clear(&self->protocol_lock);
+    if ( self->client_certificates != NULL )
+        g_ptr_array_unref(self->client_certificates);
+
+    eventd_metrics_connection_free(self->metrics);
+
+    g_free(self->projection);
+    g_strfreev(self->only_data);
+    eventd_events_filter_free(self->filter);
+
+    if ( self->workers != NULL )
+        eventd_evp_workers_remove_client(self->workers, self);
 
     g_free(self);
 }
@@ -332,16 +712,133 @@ eventd_evp_client_disconnect(gpointer data)
 
     g_cancellable_cancel(self->cancellable);
     self->link = NULL;
-    self->subscribe_all = NULL;
-    g_hash_table_remove_all(self->subscriptions);
 }
 
 void
-eventd_evp_client_event_dispatch(EventdEvpClient *self, EventdEvent *event)
+eventd_evp_client_move_write(EventdEvpClient *self)
+{
+    if ( self->write.source == NULL )
+        return;
+
+    g_source_destroy(self->write.source);
+    g_source_unref(self->write.source);
+    self->write.source = NULL;
+
+    /* Waits on the new thread-default context if needed, or frees us */
+    _eventd_evp_client_write(self);
+}
+
+void
+eventd_evp_client_abort(EventdEvpClient *self)
+{
+    /* Drop whatever we still had to write, so we get freed */
+    g_cancellable_cancel(self->write.cancellable);
+    g_cancellable_cancel(self->cancellable);
+}
+
+static EventdEvent *
+_eventd_evp_client_project(EventdEvpClient *self, EventdEvent *event, GHashTable **projections)
+{
+    EventdEvent *projected;
+
+    if ( *projections == NULL )
+        *projections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) eventd_event_unref);
+    else if ( ( projected = g_hash_table_lookup(*projections, self->projection) ) != NULL )
+        return projected;
+
+    gchar **name;
+    GVariant *data;
+
+    /* Same UUID, so that the client can still link answers to the original event */
+    projected = eventd_event_new_for_uuid_string(eventd_event_get_uuid(event), eventd_event_get_category(event), eventd_event_get_name(event));
+    for ( name = self->only_data ; *name != NULL ; ++name )
+    {
+        if ( ( data = eventd_event_get_data(event, *name) ) != NULL )
+            eventd_event_add_data(projected, g_strdup(*name), data);
+    }
+
+    /* The protocol caches the serialized message in the event, shared by all the clients with this projection */
+    g_hash_table_insert(*projections, g_strdup(self->projection), projected);
+
+    return projected;
+}
+
+void
+eventd_evp_client_event_dispatch(EventdEvpClient *self, EventdEvent *event, GHashTable **projections)
 {
     if ( self->current == event )
         /* Do not send back our own events */
         return;
 
-    _eventd_evp_client_send_message(self, eventd_protocol_generate_event(self->protocol, event));
+    if ( projections != NULL )
+    {
+        if ( ! eventd_events_filter_matches(self->filter, event) )
+            return;
+        if ( self->projection != NULL )
+            event = _eventd_evp_client_project(self, event, projections);
+    }
+
+    GBytes *message;
+    _eventd_evp_client_protocol_lock(self);
+    message = eventd_protocol_generate_event_bytes(self->protocol, event);
+    _eventd_evp_client_protocol_unlock(self);
+
+    eventd_metrics_connection_event_sent(self->metrics);
+    _eventd_evp_client_send_message(self, message);
+}
+
+void
+eventd_evp_client_worker_message(EventdEvpClient *self, EventdEvpWorkerMessageType type, gpointer data, gboolean stopping)
+{
+    switch ( type )
+    {
+    case EVENTD_EVP_WORKER_MESSAGE_EVENT:
+    {
+        EventdEvent *event = data;
+        if ( ! stopping )
+        {
+            eventd_debug("Received an event (category: %s): %s", eventd_event_get_category(event), eventd_event_get_name(event));
+
+            gint64 start = eventd_metrics_now();
+            self->current = event;
+            eventd_core_push_event(self->context->core, event);
+            self->current = NULL;
+            eventd_metrics_connection_event_received(self->metrics, start);
+            if ( self->workers == NULL )
+                /* We are called from within the parser, do not account this as parsing time */
+                self->parse_nested += eventd_metrics_now() - start;
+        }
+        eventd_event_unref(event);
+    }
+    break;
+    case EVENTD_EVP_WORKER_MESSAGE_SUBSCRIBE:
+        if ( ! stopping )
+            _eventd_evp_client_subscribe(self, data);
+        _eventd_evp_client_subscription_free(data);
+    break;
+    case EVENTD_EVP_WORKER_MESSAGE_BINARY:
+        eventd_debug("Client switched to binary frames");
+        if ( ! stopping )
+        {
+            gchar *message;
+            _eventd_evp_client_protocol_lock(self);
+            message = eventd_protocol_generate_binary(self->protocol);
+            _eventd_evp_client_protocol_unlock(self);
+            _eventd_evp_client_send_text_message(self, message);
+        }
+    break;
+    case EVENTD_EVP_WORKER_MESSAGE_BYE:
+    {
+        GBytes *message;
+        _eventd_evp_client_protocol_lock(self);
+        message = eventd_protocol_generate_bye_bytes(self->protocol, data);
+        _eventd_evp_client_protocol_unlock(self);
+        _eventd_evp_client_send_message(self, message);
+        g_free(data);
+    }
+    break;
+    case EVENTD_EVP_WORKER_MESSAGE_DISCONNECT:
+        _eventd_evp_client_disconnect_internal(self);
+    break;
+    }
 }
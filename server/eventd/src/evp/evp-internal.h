@@ -23,14 +23,17 @@
 #ifndef __EVENTD_EVP_EVP_INTERAL_H__
 #define __EVENTD_EVP_EVP_INTERAL_H__
 
+#include "libeventd-helpers-subscriptions.h"
+
 #include "../types.h"
 #include "evp.h"
+#include "worker.h"
 #include "eventd-ws-module.h"
 
 struct _EventdEvpContext {
     EventdCoreContext *core;
     GTlsCertificate *certificate;
-    GList *client_certificates;
+    GPtrArray *client_certificates;
     gchar *cert_file;
     gchar *key_file;
     gchar *client_certs_file;
@@ -38,9 +41,10 @@ struct _EventdEvpContext {
     GFileMonitor *key_monitor;
     GFileMonitor *client_certs_monitor;
     GSocketService *service;
+    guint workers_count;
+    EventdEvpWorkers *workers;
     GList *clients;
-    GList *subscribe_all;
-    GHashTable *subscribe_categories;
+    LibeventdSubscriptions *subscriptions;
 };
 
 #endif /* __EVENTD_EVP_EVP_INTERAL_H__ */
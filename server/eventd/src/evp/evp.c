@@ -108,22 +108,26 @@ eventd_evp_uninit(EventdEvpContext *self)
 void
 eventd_evp_start(EventdEvpContext *self)
 {
-    self->subscribe_categories = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_list_free);
+    self->subscriptions = evhelpers_subscriptions_new();
+    if ( self->workers_count > 0 )
+        self->workers = eventd_evp_workers_new(self->workers_count);
     g_socket_service_start(self->service);
 }
 
 void
 eventd_evp_stop(EventdEvpContext *self)
 {
-    g_hash_table_unref(self->subscribe_categories);
-    self->subscribe_categories = NULL;
-    g_list_free(self->subscribe_all);
-    self->subscribe_all = NULL;
+    evhelpers_subscriptions_free(self->subscriptions);
+    self->subscriptions = NULL;
 
     g_list_free_full(self->clients, eventd_evp_client_disconnect);
     self->clients = NULL;
 
     g_socket_service_stop(self->service);
+
+    if ( self->workers != NULL )
+        eventd_evp_workers_free(self->workers);
+    self->workers = NULL;
 }
 
 
@@ -162,7 +166,7 @@ static gboolean
 _eventd_evp_load_client_certificates(EventdEvpContext *self, const gchar *client_certs_file)
 {
     GError *error = NULL;
-    GList *certs;
+    GList *certs, *cert;
 
     certs = g_tls_certificate_list_new_from_file(client_certs_file, &error);
 
@@ -172,8 +176,17 @@ _eventd_evp_load_client_certificates(EventdEvpContext *self, const gchar *client
         g_clear_error(&error);
         return FALSE;
     }
-    g_list_free_full(self->client_certificates, g_object_unref);
-    self->client_certificates = certs;
+
+    /*
+     * Clients hold a reference on the array they started with,
+     * since they check it on their worker thread
+     */
+    if ( self->client_certificates != NULL )
+        g_ptr_array_unref(self->client_certificates);
+    self->client_certificates = g_ptr_array_new_full(g_list_length(certs), g_object_unref);
+    for ( cert = certs ; cert != NULL ; cert = g_list_next(cert) )
+        g_ptr_array_add(self->client_certificates, cert->data);
+    g_list_free(certs);
     return TRUE;
 }
 
@@ -312,6 +325,7 @@ eventd_evp_global_parse(EventdEvpContext *self, GKeyFile *config_file)
     gchar *key_file = NULL;
     gchar *client_certs_file = NULL;
     gchar *publish_name = NULL;
+    gint64 workers;
 
     if ( ! g_key_file_has_group(config_file, "Server") )
         return;
@@ -324,6 +338,14 @@ eventd_evp_global_parse(EventdEvpContext *self, GKeyFile *config_file)
         goto cleanup;
     if ( evhelpers_config_key_file_get_string(config_file, "Server", "PublishName", &publish_name) < 0 )
         goto cleanup;
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, "Server", "Workers", 0, &workers) < 0 )
+        goto cleanup;
+
+    /* Workers are created on start, changing them needs a restart */
+    if ( self->subscriptions == NULL )
+        self->workers_count = MAX(workers, 0);
+    else if ( (guint) MAX(workers, 0) != self->workers_count )
+        g_warning("Server Workers= changed from %u to %" G_GINT64_FORMAT ", eventd needs a restart to apply it", self->workers_count, MAX(workers, 0));
 
     if ( cert_file != NULL )
     {
@@ -359,6 +381,8 @@ eventd_evp_config_reset(EventdEvpContext *self)
     if ( self->certificate != NULL )
         g_object_unref(self->certificate);
     self->certificate = NULL;
+    if ( self->subscriptions == NULL )
+        self->workers_count = 0;
     _eventd_evp_cleanup_monitors(self);
 }
 
@@ -371,22 +395,25 @@ void
 eventd_evp_event_dispatch(EventdEvpContext *self, EventdEvent *event)
 {
     const gchar *category;
-    GList *subscribers;
+    GPtrArray *subscribers;
+    GHashTable *projections = NULL;
     GList *client;
+    guint i;
 
     category = eventd_event_get_category(event);
     if ( category[0] == '.' )
     {
+        /* Internal events are never filtered nor projected */
         for ( client = self->clients ; client != NULL ; client = g_list_next(client) )
-            eventd_evp_client_event_dispatch(client->data, event);
+            eventd_evp_client_event_dispatch(client->data, event, NULL);
         return;
     }
 
-    subscribers = self->subscribe_all;
-    for ( client = subscribers ; client != NULL ; client = g_list_next(client) )
-        eventd_evp_client_event_dispatch(client->data, event);
+    subscribers = evhelpers_subscriptions_lookup(self->subscriptions, category);
+    for ( i = 0 ; i < subscribers->len ; ++i )
+        eventd_evp_client_event_dispatch(g_ptr_array_index(subscribers, i), event, &projections);
+    g_ptr_array_unref(subscribers);
 
-    subscribers = g_hash_table_lookup(self->subscribe_categories, category);
-    for ( client = subscribers ; client != NULL ; client = g_list_next(client) )
-        eventd_evp_client_event_dispatch(client->data, event);
+    if ( projections != NULL )
+        g_hash_table_unref(projections);
 }
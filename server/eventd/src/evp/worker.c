@@ -0,0 +1,281 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "libeventd-event.h"
+
+#include "client.h"
+
+#include "worker.h"
+
+/* How long we wait for clients to write their last messages on stop */
+#define EVENTD_EVP_WORKERS_STOP_TIMEOUT 1000
+
+typedef struct _EventdEvpWorkerMessage EventdEvpWorkerMessage;
+
+struct _EventdEvpWorkerMessage {
+    EventdEvpWorkerMessage *next;
+    EventdEvpClient *client;
+    EventdEvpWorkerMessageType type;
+    gpointer data;
+};
+
+typedef struct {
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+} EventdEvpWorker;
+
+struct _EventdEvpWorkers {
+    EventdEvpWorker *workers;
+    guint count;
+    guint next;
+    GSource *source;
+    GHashTable *clients;
+    gboolean stopping;
+    GMainContext *stop_context;
+    /*
+     * Lock-free multiple producers, single consumer queue
+     * Workers push messages on top of this stack and the core
+     * takes the whole stack at once, reversing it to get them in order
+     */
+    EventdEvpWorkerMessage *messages;
+};
+
+static void
+_eventd_evp_workers_process(EventdEvpWorkers *self, gboolean stopping)
+{
+    EventdEvpWorkerMessage *messages, *message, *next = NULL;
+
+    do
+        messages = g_atomic_pointer_get(&self->messages);
+    while ( ! g_atomic_pointer_compare_and_exchange(&self->messages, messages, NULL) );
+
+    for ( message = messages ; message != NULL ; message = messages )
+    {
+        messages = message->next;
+        message->next = next;
+        next = message;
+    }
+
+    for ( message = next ; message != NULL ; message = next )
+    {
+        next = message->next;
+        eventd_evp_client_worker_message(message->client, message->type, message->data, stopping);
+        g_slice_free(EventdEvpWorkerMessage, message);
+    }
+}
+
+static gboolean
+_eventd_evp_workers_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    EventdEvpWorkers *self = user_data;
+
+    /* Reset before processing, so a push racing with us wakes us up again */
+    g_source_set_ready_time(source, -1);
+    _eventd_evp_workers_process(self, self->stopping);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs _eventd_evp_workers_source_funcs = {
+    .dispatch = _eventd_evp_workers_source_dispatch,
+};
+
+static gpointer
+_eventd_evp_worker_thread(gpointer user_data)
+{
+    EventdEvpWorker *self = user_data;
+
+    g_main_context_push_thread_default(self->context);
+    g_main_loop_run(self->loop);
+
+    /* Let our cancelled clients finish */
+    while ( g_main_context_iteration(self->context, FALSE) );
+
+    g_main_context_pop_thread_default(self->context);
+
+    return NULL;
+}
+
+EventdEvpWorkers *
+eventd_evp_workers_new(guint count)
+{
+    EventdEvpWorkers *self;
+    guint i;
+
+    self = g_new0(EventdEvpWorkers, 1);
+    self->count = count;
+    self->workers = g_new0(EventdEvpWorker, count);
+    self->clients = g_hash_table_new(NULL, NULL);
+
+    self->source = g_source_new(&_eventd_evp_workers_source_funcs, sizeof(GSource));
+    g_source_set_callback(self->source, NULL, self, NULL);
+    g_source_attach(self->source, NULL);
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        EventdEvpWorker *worker = &self->workers[i];
+        gchar *name;
+
+        name = g_strdup_printf("evp-worker-%u", i);
+        worker->context = g_main_context_new();
+        worker->loop = g_main_loop_new(worker->context, FALSE);
+        worker->thread = g_thread_new(name, _eventd_evp_worker_thread, worker);
+        g_free(name);
+    }
+
+    return self;
+}
+
+static gboolean
+_eventd_evp_workers_abort_clients(gpointer user_data)
+{
+    EventdEvpWorkers *self = user_data;
+    GList *clients, *client;
+
+    g_warning("Some clients did not finish in time, aborting their writes");
+
+    clients = g_hash_table_get_keys(self->clients);
+    for ( client = clients ; client != NULL ; client = g_list_next(client) )
+        eventd_evp_client_abort(client->data);
+    g_list_free(clients);
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+eventd_evp_workers_free(EventdEvpWorkers *self)
+{
+    GMainContext *context;
+    GSource *abort_timeout;
+    GList *clients, *client;
+    guint i;
+
+    /*
+     * Our clients are cancelled already, but their worker has to post
+     * their last messages and we have to write their BYE
+     * We do that on our own context, so nothing else runs meanwhile,
+     * and the workers wake it up when they post
+     */
+    self->stopping = TRUE;
+    context = g_main_context_new();
+    g_main_context_push_thread_default(context);
+    g_atomic_pointer_set(&self->stop_context, context);
+
+    /* Running writes wait on the default context */
+    clients = g_hash_table_get_keys(self->clients);
+    for ( client = clients ; client != NULL ; client = g_list_next(client) )
+        eventd_evp_client_move_write(client->data);
+    g_list_free(clients);
+
+    abort_timeout = g_timeout_source_new(EVENTD_EVP_WORKERS_STOP_TIMEOUT);
+    g_source_set_callback(abort_timeout, _eventd_evp_workers_abort_clients, self, NULL);
+    g_source_attach(abort_timeout, context);
+
+    while ( g_hash_table_size(self->clients) > 0 )
+    {
+        _eventd_evp_workers_process(self, TRUE);
+        if ( g_hash_table_size(self->clients) > 0 )
+            g_main_context_iteration(context, TRUE);
+    }
+
+    g_source_destroy(abort_timeout);
+    g_source_unref(abort_timeout);
+
+    for ( i = 0 ; i < self->count ; ++i )
+        g_main_loop_quit(self->workers[i].loop);
+
+    for ( i = 0 ; i < self->count ; ++i )
+    {
+        EventdEvpWorker *worker = &self->workers[i];
+
+        g_thread_join(worker->thread);
+        g_main_loop_unref(worker->loop);
+        g_main_context_unref(worker->context);
+    }
+    g_free(self->workers);
+
+    g_source_destroy(self->source);
+    g_source_unref(self->source);
+
+    _eventd_evp_workers_process(self, TRUE);
+
+    g_main_context_pop_thread_default(context);
+    g_main_context_unref(context);
+
+    g_hash_table_unref(self->clients);
+
+    g_free(self);
+}
+
+void
+eventd_evp_workers_add_client(EventdEvpWorkers *self, EventdEvpClient *client)
+{
+    g_hash_table_add(self->clients, client);
+}
+
+void
+eventd_evp_workers_remove_client(EventdEvpWorkers *self, EventdEvpClient *client)
+{
+    g_hash_table_remove(self->clients, client);
+}
+
+GMainContext *
+eventd_evp_workers_get_context(EventdEvpWorkers *self)
+{
+    EventdEvpWorker *worker = &self->workers[self->next];
+
+    self->next = ( self->next + 1 ) % self->count;
+
+    return worker->context;
+}
+
+void
+eventd_evp_workers_push(EventdEvpWorkers *self, EventdEvpClient *client, EventdEvpWorkerMessageType type, gpointer data)
+{
+    EventdEvpWorkerMessage *message, *head;
+
+    message = g_slice_new(EventdEvpWorkerMessage);
+    message->client = client;
+    message->type = type;
+    message->data = data;
+
+    do
+    {
+        head = g_atomic_pointer_get(&self->messages);
+        message->next = head;
+    }
+    while ( ! g_atomic_pointer_compare_and_exchange(&self->messages, head, message) );
+
+    if ( head == NULL )
+        g_source_set_ready_time(self->source, 0);
+
+    GMainContext *context = g_atomic_pointer_get(&self->stop_context);
+    if ( context != NULL )
+        g_main_context_wakeup(context);
+}
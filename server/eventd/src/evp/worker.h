@@ -0,0 +1,53 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_EVP_WORKER_H__
+#define __EVENTD_EVP_WORKER_H__
+
+#include "client.h"
+
+typedef struct _EventdEvpWorkers EventdEvpWorkers;
+
+typedef enum {
+    EVENTD_EVP_WORKER_MESSAGE_EVENT,
+    EVENTD_EVP_WORKER_MESSAGE_SUBSCRIBE,
+    EVENTD_EVP_WORKER_MESSAGE_BINARY,
+    EVENTD_EVP_WORKER_MESSAGE_BYE,
+    EVENTD_EVP_WORKER_MESSAGE_DISCONNECT,
+} EventdEvpWorkerMessageType;
+
+EventdEvpWorkers *eventd_evp_workers_new(guint count);
+void eventd_evp_workers_free(EventdEvpWorkers *workers);
+
+/* Called on the core thread, to know which clients to wait for on stop */
+void eventd_evp_workers_add_client(EventdEvpWorkers *workers, EventdEvpClient *client);
+void eventd_evp_workers_remove_client(EventdEvpWorkers *workers, EventdEvpClient *client);
+
+GMainContext *eventd_evp_workers_get_context(EventdEvpWorkers *workers);
+void eventd_evp_workers_push(EventdEvpWorkers *workers, EventdEvpClient *client, EventdEvpWorkerMessageType type, gpointer data);
+
+/* In client.c, called on the core thread */
+void eventd_evp_client_worker_message(EventdEvpClient *client, EventdEvpWorkerMessageType type, gpointer data, gboolean stopping);
+void eventd_evp_client_move_write(EventdEvpClient *client);
+void eventd_evp_client_abort(EventdEvpClient *client);
+
+#endif /* __EVENTD_EVP_WORKER_H__ */
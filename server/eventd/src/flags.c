@@ -0,0 +1,191 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "types.h"
+
+#include "flags.h"
+
+#define EVENTD_FLAGS_WORD_BITS 64
+
+/*
+ * The registry is only ever used from the core thread
+ * Indices are never recycled, as they are baked in the parsed config
+ */
+static GHashTable *_eventd_flags_indices = NULL;
+static GArray *_eventd_flags_quarks = NULL;
+
+guint
+eventd_flags_get_index(GQuark flag)
+{
+    gpointer index;
+
+    if ( _eventd_flags_indices == NULL )
+    {
+        _eventd_flags_indices = g_hash_table_new(NULL, NULL);
+        _eventd_flags_quarks = g_array_new(FALSE, FALSE, sizeof(GQuark));
+    }
+    else if ( g_hash_table_lookup_extended(_eventd_flags_indices, GUINT_TO_POINTER(flag), NULL, &index) )
+        return GPOINTER_TO_UINT(index);
+
+    index = GUINT_TO_POINTER(_eventd_flags_quarks->len);
+    g_array_append_val(_eventd_flags_quarks, flag);
+    g_hash_table_insert(_eventd_flags_indices, GUINT_TO_POINTER(flag), index);
+
+    return GPOINTER_TO_UINT(index);
+}
+
+GQuark
+eventd_flags_get_quark(guint index)
+{
+    g_return_val_if_fail(( _eventd_flags_quarks != NULL ) && ( index < _eventd_flags_quarks->len ), 0);
+
+    return g_array_index(_eventd_flags_quarks, GQuark, index);
+}
+
+static void
+_eventd_flags_grow(EventdFlags *self, gsize size)
+{
+    if ( size <= self->size )
+        return;
+
+    self->bits = g_renew(guint64, self->bits, size);
+    memset(self->bits + self->size, 0, ( size - self->size ) * sizeof(guint64));
+    self->size = size;
+}
+
+void
+eventd_flags_parse_list(EventdFlags *self, gchar **flags, gsize length)
+{
+    gsize i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        eventd_flags_add(self, eventd_flags_get_index(g_quark_from_string(flags[i])));
+        g_free(flags[i]);
+    }
+
+    g_free(flags);
+}
+
+void
+eventd_flags_clear(EventdFlags *self)
+{
+    g_free(self->bits);
+    self->bits = NULL;
+    self->size = 0;
+}
+
+void
+eventd_flags_add(EventdFlags *self, guint index)
+{
+    _eventd_flags_grow(self, index / EVENTD_FLAGS_WORD_BITS + 1);
+    self->bits[index / EVENTD_FLAGS_WORD_BITS] |= ( G_GUINT64_CONSTANT(1) << ( index % EVENTD_FLAGS_WORD_BITS ) );
+}
+
+void
+eventd_flags_remove(EventdFlags *self, guint index)
+{
+    if ( ( index / EVENTD_FLAGS_WORD_BITS ) >= self->size )
+        return;
+
+    self->bits[index / EVENTD_FLAGS_WORD_BITS] &= ~( G_GUINT64_CONSTANT(1) << ( index % EVENTD_FLAGS_WORD_BITS ) );
+}
+
+gboolean
+eventd_flags_test(const EventdFlags *self, guint index)
+{
+    if ( ( index / EVENTD_FLAGS_WORD_BITS ) >= self->size )
+        return FALSE;
+
+    return ( ( self->bits[index / EVENTD_FLAGS_WORD_BITS] & ( G_GUINT64_CONSTANT(1) << ( index % EVENTD_FLAGS_WORD_BITS ) ) ) != 0 );
+}
+
+gboolean
+eventd_flags_is_empty(const EventdFlags *self)
+{
+    gsize i;
+    for ( i = 0 ; i < self->size ; ++i )
+    {
+        if ( self->bits[i] != 0 )
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void
+eventd_flags_update(EventdFlags *self, const EventdFlags *add, const EventdFlags *remove)
+{
+    gsize i;
+
+    _eventd_flags_grow(self, add->size);
+    for ( i = 0 ; i < add->size ; ++i )
+        self->bits[i] |= add->bits[i];
+
+    for ( i = 0 ; i < MIN(self->size, remove->size) ; ++i )
+        self->bits[i] &= ~remove->bits[i];
+}
+
+gboolean
+eventd_flags_check(const EventdFlags *self, const EventdFlags *whitelist, const EventdFlags *blacklist)
+{
+    gsize i;
+
+    /* All whitelisted flags must be set */
+    for ( i = 0 ; i < whitelist->size ; ++i )
+    {
+        guint64 bits = ( i < self->size ) ? self->bits[i] : 0;
+        if ( ( bits & whitelist->bits[i] ) != whitelist->bits[i] )
+            return FALSE;
+    }
+
+    /* No blacklisted flag may be set */
+    for ( i = 0 ; i < MIN(self->size, blacklist->size) ; ++i )
+    {
+        if ( ( self->bits[i] & blacklist->bits[i] ) != 0 )
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+eventd_flags_dump(const EventdFlags *self, GString *dump, const gchar *separator)
+{
+    gboolean first = TRUE;
+    guint index;
+
+    for ( index = 0 ; index < self->size * EVENTD_FLAGS_WORD_BITS ; ++index )
+    {
+        if ( ! eventd_flags_test(self, index) )
+            continue;
+
+        if ( ! first )
+            g_string_append(dump, separator);
+        g_string_append(dump, g_quark_to_string(eventd_flags_get_quark(index)));
+        first = FALSE;
+    }
+}
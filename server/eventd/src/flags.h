@@ -0,0 +1,51 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_FLAGS_H__
+#define __EVENTD_FLAGS_H__
+
+/*
+ * Flags are mapped to dense indices the first time we see them
+ * (mostly at config load), so that sets of flags are plain bitsets.
+ * An empty set has no storage at all.
+ */
+struct _EventdFlags {
+    gsize size; /* in 64-bit words */
+    guint64 *bits;
+};
+
+guint eventd_flags_get_index(GQuark flag);
+GQuark eventd_flags_get_quark(guint index);
+
+void eventd_flags_parse_list(EventdFlags *self, gchar **flags, gsize length);
+void eventd_flags_clear(EventdFlags *self);
+
+void eventd_flags_add(EventdFlags *self, guint index);
+void eventd_flags_remove(EventdFlags *self, guint index);
+gboolean eventd_flags_test(const EventdFlags *self, guint index);
+gboolean eventd_flags_is_empty(const EventdFlags *self);
+void eventd_flags_update(EventdFlags *self, const EventdFlags *add, const EventdFlags *remove);
+gboolean eventd_flags_check(const EventdFlags *self, const EventdFlags *whitelist, const EventdFlags *blacklist);
+
+void eventd_flags_dump(const EventdFlags *self, GString *dump, const gchar *separator);
+
+#endif /* __EVENTD_FLAGS_H__ */
@@ -0,0 +1,359 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "libeventd-event.h"
+#include "libeventd-event-private.h"
+#include "libeventd-helpers-config.h"
+
+#include "types.h"
+
+#include "metrics.h"
+
+#include "limits.h"
+
+typedef enum {
+    EVENTD_LIMITS_COALESCE_FIRST,
+    EVENTD_LIMITS_COALESCE_LAST,
+    EVENTD_LIMITS_COALESCE_COUNT,
+    _EVENTD_LIMITS_COALESCE_SIZE
+} EventdLimitsCoalesceMode;
+
+static const gchar * const _eventd_limits_coalesce_modes[_EVENTD_LIMITS_COALESCE_SIZE] = {
+    [EVENTD_LIMITS_COALESCE_FIRST] = "first",
+    [EVENTD_LIMITS_COALESCE_LAST]  = "last",
+    [EVENTD_LIMITS_COALESCE_COUNT] = "count",
+};
+
+struct _EventdLimitsRule {
+    struct {
+        FormatString *key;
+        gint64 window;
+        EventdLimitsCoalesceMode mode;
+        gchar *count_data;
+    } coalesce;
+    struct {
+        /* Tokens per µs */
+        gdouble rate;
+        gdouble burst;
+        gdouble tokens;
+        gint64 last;
+    } rate_limit;
+};
+
+struct _EventdLimits {
+    EventdLimitsTriggerFunc trigger;
+    gpointer user_data;
+    GHashTable *pending;
+};
+
+typedef struct {
+    EventdLimits *limits;
+    EventdLimitsRule *rule;
+    gchar *key;
+    const GList *actions;
+    EventdEvent *event;
+    guint64 count;
+    guint timeout;
+} EventdLimitsPending;
+
+EventdLimitsRule *
+eventd_limits_rule_parse(GKeyFile *config_file, const gchar *group)
+{
+    EventdLimitsRule *self;
+    FormatString *key = NULL;
+    gint64 rate;
+
+    if ( evhelpers_config_key_file_get_format_string(config_file, group, "Coalesce", &key) < 0 )
+        return NULL;
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "RateLimit", 0, &rate) < 0 )
+        goto fail;
+
+    if ( ( key == NULL ) && ( rate <= 0 ) )
+        return NULL;
+
+    self = g_new0(EventdLimitsRule, 1);
+
+    if ( key != NULL )
+    {
+        gint64 window;
+        guint64 mode;
+
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "CoalesceWindow", 1000, &window) < 0 )
+            goto fail_rule;
+        if ( evhelpers_config_key_file_get_enum_with_default(config_file, group, "CoalesceMode", _eventd_limits_coalesce_modes, _EVENTD_LIMITS_COALESCE_SIZE, EVENTD_LIMITS_COALESCE_FIRST, &mode) < 0 )
+            goto fail_rule;
+        if ( evhelpers_config_key_file_get_string_with_default(config_file, group, "CoalesceCountData", "count", &self->coalesce.count_data) < 0 )
+            goto fail_rule;
+
+        self->coalesce.key = key;
+        self->coalesce.window = MAX(window, 1);
+        self->coalesce.mode = mode;
+    }
+
+    if ( rate > 0 )
+    {
+        gint64 burst;
+
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "RateLimitBurst", rate, &burst) < 0 )
+            goto fail_rule;
+
+        self->rate_limit.rate = (gdouble) rate / G_USEC_PER_SEC;
+        self->rate_limit.burst = MAX(burst, 1);
+        self->rate_limit.tokens = self->rate_limit.burst;
+        self->rate_limit.last = g_get_monotonic_time();
+    }
+
+    return self;
+
+fail_rule:
+    g_free(self->coalesce.count_data);
+    g_free(self);
+fail:
+    evhelpers_format_string_unref(key);
+    return NULL;
+}
+
+void
+eventd_limits_rule_free(EventdLimitsRule *self)
+{
+    if ( self == NULL )
+        return;
+
+    g_free(self->coalesce.count_data);
+    evhelpers_format_string_unref(self->coalesce.key);
+
+    g_free(self);
+}
+
+void
+eventd_limits_rule_dump(GString *dump, const EventdLimitsRule *self)
+{
+    if ( self == NULL )
+        return;
+
+    if ( self->coalesce.key != NULL )
+    {
+        g_string_append_printf(dump, "\n    Coalescing: %s over %" G_GINT64_FORMAT "ms", _eventd_limits_coalesce_modes[self->coalesce.mode], self->coalesce.window);
+        if ( self->coalesce.mode == EVENTD_LIMITS_COALESCE_COUNT )
+            g_string_append_printf(dump, " into %s", self->coalesce.count_data);
+    }
+
+    if ( self->rate_limit.rate > 0 )
+        g_string_append_printf(dump, "\n    Rate limit: %.0f/s, burst %.0f", self->rate_limit.rate * G_USEC_PER_SEC, self->rate_limit.burst);
+}
+
+static gboolean
+_eventd_limits_rule_take_token(EventdLimitsRule *self)
+{
+    gint64 now = g_get_monotonic_time();
+
+    self->rate_limit.tokens = MIN(self->rate_limit.burst, self->rate_limit.tokens + ( now - self->rate_limit.last ) * self->rate_limit.rate);
+    self->rate_limit.last = now;
+
+    if ( self->rate_limit.tokens < 1 )
+        return FALSE;
+
+    self->rate_limit.tokens -= 1;
+    return TRUE;
+}
+
+static void
+_eventd_limits_trigger(EventdLimits *self, EventdLimitsRule *rule, const GList *actions, EventdEvent *event)
+{
+    if ( ( rule != NULL ) && ( rule->rate_limit.rate > 0 ) && ( ! _eventd_limits_rule_take_token(rule) ) )
+    {
+        eventd_debug("Rate limit reached for event %s %s, dropping it", eventd_event_get_category(event), eventd_event_get_name(event));
+        eventd_metrics_count(EVENTD_METRICS_COUNTER_EVENTS_RATE_LIMITED);
+        return;
+    }
+
+    self->trigger(actions, event, self->user_data);
+}
+
+static EventdEvent *
+_eventd_limits_event_with_count(EventdEvent *event, const gchar *name, guint64 count)
+{
+    EventdEvent *copy;
+    GHashTable *data;
+
+    /* The event may be in use elsewhere, we do not touch it */
+    copy = eventd_event_new_for_uuid_string(eventd_event_get_uuid(event), eventd_event_get_category(event), eventd_event_get_name(event));
+
+    data = eventd_event_get_all_data(event);
+    if ( data != NULL )
+    {
+        GHashTableIter iter;
+        const gchar *key;
+        GVariant *value;
+        g_hash_table_iter_init(&iter, data);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &key, (gpointer *) &value) )
+            eventd_event_add_data(copy, g_strdup(key), value);
+        g_hash_table_unref(data);
+    }
+
+    eventd_event_add_data(copy, g_strdup(name), g_variant_new_uint64(count));
+
+    return copy;
+}
+
+static void
+_eventd_limits_pending_free(EventdLimitsPending *pending)
+{
+    if ( pending->timeout > 0 )
+        g_source_remove(pending->timeout);
+    if ( pending->event != NULL )
+        eventd_event_unref(pending->event);
+    g_free(pending->key);
+
+    g_slice_free(EventdLimitsPending, pending);
+}
+
+static void
+_eventd_limits_pending_flush(EventdLimitsPending *pending)
+{
+    EventdLimitsRule *rule = pending->rule;
+    EventdEvent *event;
+
+    if ( pending->event == NULL )
+        /* First mode, already triggered */
+        return;
+
+    if ( rule->coalesce.mode == EVENTD_LIMITS_COALESCE_COUNT )
+        event = _eventd_limits_event_with_count(pending->event, rule->coalesce.count_data, pending->count);
+    else
+        event = eventd_event_ref(pending->event);
+
+    _eventd_limits_trigger(pending->limits, rule, pending->actions, event);
+    eventd_event_unref(event);
+}
+
+static gboolean
+_eventd_limits_pending_timeout(gpointer user_data)
+{
+    EventdLimitsPending *pending = user_data;
+
+    pending->timeout = 0;
+    g_hash_table_remove(pending->limits->pending, pending->key);
+    _eventd_limits_pending_flush(pending);
+    _eventd_limits_pending_free(pending);
+
+    return G_SOURCE_REMOVE;
+}
+
+EventdLimits *
+eventd_limits_new(EventdLimitsTriggerFunc trigger, gpointer user_data)
+{
+    EventdLimits *self;
+
+    self = g_new0(EventdLimits, 1);
+    self->trigger = trigger;
+    self->user_data = user_data;
+    self->pending = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return self;
+}
+
+void
+eventd_limits_free(EventdLimits *self)
+{
+    GHashTableIter iter;
+    EventdLimitsPending *pending;
+
+    /* We are stopping, pending events are dropped */
+    g_hash_table_iter_init(&iter, self->pending);
+    while ( g_hash_table_iter_next(&iter, NULL, (gpointer *) &pending) )
+        _eventd_limits_pending_free(pending);
+    g_hash_table_unref(self->pending);
+
+    g_free(self);
+}
+
+/*
+ * Events held by the coalescing stage reference their rule and actions,
+ * which are only valid until the next configuration reload
+ */
+void
+eventd_limits_flush(EventdLimits *self)
+{
+    GList *list, *pending;
+
+    list = g_hash_table_get_values(self->pending);
+    g_hash_table_remove_all(self->pending);
+
+    for ( pending = list ; pending != NULL ; pending = g_list_next(pending) )
+    {
+        _eventd_limits_pending_flush(pending->data);
+        _eventd_limits_pending_free(pending->data);
+    }
+    g_list_free(list);
+}
+
+void
+eventd_limits_process(EventdLimits *self, EventdLimitsRule *rule, const GList *actions, EventdEvent *event)
+{
+    EventdLimitsPending *pending;
+    gchar *value, *key;
+
+    if ( ( rule == NULL ) || ( rule->coalesce.key == NULL ) )
+    {
+        _eventd_limits_trigger(self, rule, actions, event);
+        return;
+    }
+
+    /* Two rules may build the same key */
+    value = evhelpers_format_string_get_string(rule->coalesce.key, event, NULL, NULL);
+    key = g_strdup_printf("%p %s", (gpointer) rule, value);
+    g_free(value);
+
+    pending = g_hash_table_lookup(self->pending, key);
+    if ( pending != NULL )
+    {
+        g_free(key);
+        ++pending->count;
+        if ( rule->coalesce.mode == EVENTD_LIMITS_COALESCE_LAST )
+        {
+            eventd_event_unref(pending->event);
+            pending->event = eventd_event_ref(event);
+        }
+        eventd_metrics_count(EVENTD_METRICS_COUNTER_EVENTS_COALESCED);
+        return;
+    }
+
+    pending = g_slice_new0(EventdLimitsPending);
+    pending->limits = self;
+    pending->rule = rule;
+    pending->key = key;
+    pending->actions = actions;
+    pending->count = 1;
+
+    if ( rule->coalesce.mode == EVENTD_LIMITS_COALESCE_FIRST )
+        _eventd_limits_trigger(self, rule, actions, event);
+    else
+        pending->event = eventd_event_ref(event);
+
+    pending->timeout = g_timeout_add(rule->coalesce.window, _eventd_limits_pending_timeout, pending);
+    g_hash_table_insert(self->pending, pending->key, pending);
+}
@@ -0,0 +1,38 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_LIMITS_H__
+#define __EVENTD_LIMITS_H__
+
+typedef void (*EventdLimitsTriggerFunc)(const GList *actions, EventdEvent *event, gpointer user_data);
+
+EventdLimitsRule *eventd_limits_rule_parse(GKeyFile *config_file, const gchar *group);
+void eventd_limits_rule_free(EventdLimitsRule *rule);
+void eventd_limits_rule_dump(GString *dump, const EventdLimitsRule *rule);
+
+EventdLimits *eventd_limits_new(EventdLimitsTriggerFunc trigger, gpointer user_data);
+void eventd_limits_free(EventdLimits *self);
+
+void eventd_limits_process(EventdLimits *self, EventdLimitsRule *rule, const GList *actions, EventdEvent *event);
+void eventd_limits_flush(EventdLimits *self);
+
+#endif /* __EVENTD_LIMITS_H__ */
@@ -0,0 +1,818 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "libeventd-event.h"
+#include "libeventd-event-private.h"
+
+#include "types.h"
+
+#include "eventd.h"
+
+#include "metrics.h"
+
+/*
+ * HDR-style histograms: values (in nanoseconds) below the sub-bucket
+ * count get their own bucket, then each power of two is split in
+ * sub-buckets, giving us a constant relative precision (12.5%)
+ * The last bucket also holds everything above the maximum exponent (~68s)
+ */
+#define EVENTD_METRICS_HISTOGRAM_SUB_BITS 3
+#define EVENTD_METRICS_HISTOGRAM_SUB_COUNT (1 << EVENTD_METRICS_HISTOGRAM_SUB_BITS)
+#define EVENTD_METRICS_HISTOGRAM_MAX_EXPONENT 35
+#define EVENTD_METRICS_HISTOGRAM_SIZE ( ( EVENTD_METRICS_HISTOGRAM_MAX_EXPONENT - EVENTD_METRICS_HISTOGRAM_SUB_BITS + 2 ) * EVENTD_METRICS_HISTOGRAM_SUB_COUNT )
+
+#define EVENTD_METRICS_ENDPOINT_THREADS 2
+#define EVENTD_METRICS_ENDPOINT_TIMEOUT 5
+#define EVENTD_METRICS_ENDPOINT_LINE_MAX_SIZE 1024
+#define EVENTD_METRICS_ENDPOINT_REQUEST_MAX_SIZE 8192
+
+/*
+ * Nanoseconds overflow 32 bits in about four seconds, so durations are
+ * always 64 bits, which GLib atomic operations do not cover everywhere
+ */
+/*
+ * Nanoseconds sums need 64 bits: we use the pointer-sized atomic helpers
+ * where they are wide enough, and a lock on 32-bit platforms
+ */
+#if GLIB_SIZEOF_VOID_P >= 8
+typedef gsize EventdMetricsValue;
+#else /* GLIB_SIZEOF_VOID_P < 8 */
+typedef guint64 EventdMetricsValue;
+static GMutex _eventd_metrics_values_lock;
+#endif /* GLIB_SIZEOF_VOID_P < 8 */
+
+typedef struct {
+    EventdMetricsValue sum;
+    EventdMetricsValue max;
+    gsize buckets[EVENTD_METRICS_HISTOGRAM_SIZE];
+} EventdMetricsHistogram;
+
+typedef struct {
+    gsize count;
+    guint64 sum;
+    guint64 max;
+    gsize buckets[EVENTD_METRICS_HISTOGRAM_SIZE];
+} EventdMetricsHistogramSnapshot;
+
+struct _EventdMetricsPlugin {
+    gchar *id;
+    gsize dropped;
+    EventdMetricsHistogram actions;
+};
+
+typedef struct {
+    gsize received;
+    gsize sent;
+} EventdMetricsConnectionCounters;
+
+struct _EventdMetricsConnection {
+    EventdMetricsConnectionType type;
+    guint64 id;
+    gchar *peer;
+    GList *link;
+    EventdMetricsConnectionCounters counters;
+    EventdMetricsHistogram push;
+};
+
+struct _EventdMetricsEndpoint {
+    GSocketService *socket_service;
+};
+
+static const gchar * const _eventd_metrics_stages[_EVENTD_METRICS_STAGE_SIZE] = {
+    [EVENTD_METRICS_STAGE_PARSE] = "parse",
+    [EVENTD_METRICS_STAGE_PROCESS] = "process",
+    [EVENTD_METRICS_STAGE_DISPATCH] = "dispatch",
+    [EVENTD_METRICS_STAGE_ACTIONS] = "actions",
+};
+
+static const gchar * const _eventd_metrics_connection_types[_EVENTD_METRICS_CONNECTION_TYPE_SIZE] = {
+    [EVENTD_METRICS_CONNECTION_EVP] = "evp",
+    [EVENTD_METRICS_CONNECTION_RELAY] = "relay",
+};
+
+/*
+ * Hot paths only ever use atomic operations,
+ * the lock only protects the plugins and connections lists
+ */
+static struct {
+    gsize counters[_EVENTD_METRICS_COUNTER_SIZE];
+    EventdMetricsHistogram stages[_EVENTD_METRICS_STAGE_SIZE];
+    EventdMetricsConnectionCounters connections_totals[_EVENTD_METRICS_CONNECTION_TYPE_SIZE];
+    EventdMetricsHistogram connections_push[_EVENTD_METRICS_CONNECTION_TYPE_SIZE];
+    GMutex lock;
+    GList *plugins;
+    GList *connections;
+    guint64 next_connection_id;
+} metrics;
+
+
+gint64
+eventd_metrics_now(void)
+{
+#ifdef G_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ( (gint64) ts.tv_sec * G_GINT64_CONSTANT(1000000000) ) + ts.tv_nsec;
+#else /* ! G_OS_UNIX */
+    return g_get_monotonic_time() * 1000;
+#endif /* ! G_OS_UNIX */
+}
+
+
+/*
+ * Values
+ */
+
+#if GLIB_SIZEOF_VOID_P >= 8
+static void
+_eventd_metrics_value_add(EventdMetricsValue *self, guint64 value)
+{
+    g_atomic_pointer_add(self, value);
+}
+
+static void
+_eventd_metrics_value_max(EventdMetricsValue *self, guint64 value)
+{
+    gsize max = (gsize) g_atomic_pointer_get(self);
+
+    while ( ( value > max ) && ( ! g_atomic_pointer_compare_and_exchange(self, max, value) ) )
+        max = (gsize) g_atomic_pointer_get(self);
+}
+
+static guint64
+_eventd_metrics_value_get(EventdMetricsValue *self)
+{
+    return (gsize) g_atomic_pointer_get(self);
+}
+#else /* GLIB_SIZEOF_VOID_P < 8 */
+static void
+_eventd_metrics_value_add(EventdMetricsValue *self, guint64 value)
+{
+    g_mutex_lock(&_eventd_metrics_values_lock);
+    *self += value;
+    g_mutex_unlock(&_eventd_metrics_values_lock);
+}
+
+static void
+_eventd_metrics_value_max(EventdMetricsValue *self, guint64 value)
+{
+    g_mutex_lock(&_eventd_metrics_values_lock);
+    if ( value > *self )
+        *self = value;
+    g_mutex_unlock(&_eventd_metrics_values_lock);
+}
+
+static guint64
+_eventd_metrics_value_get(EventdMetricsValue *self)
+{
+    guint64 value;
+
+    g_mutex_lock(&_eventd_metrics_values_lock);
+    value = *self;
+    g_mutex_unlock(&_eventd_metrics_values_lock);
+
+    return value;
+}
+#endif /* GLIB_SIZEOF_VOID_P < 8 */
+
+
+/*
+ * Histograms
+ */
+
+/* Index of the most significant bit, gulong may only hold 32 bits */
+static guint
+_eventd_metrics_histogram_exponent(guint64 value)
+{
+    if ( ( value >> 32 ) != 0 )
+        return 32 + g_bit_storage((gulong) ( value >> 32 )) - 1;
+    return g_bit_storage((gulong) value) - 1;
+}
+
+static guint
+_eventd_metrics_histogram_bucket(guint64 value)
+{
+    if ( value < EVENTD_METRICS_HISTOGRAM_SUB_COUNT )
+        return value;
+
+    guint exponent = _eventd_metrics_histogram_exponent(value);
+    if ( exponent > EVENTD_METRICS_HISTOGRAM_MAX_EXPONENT )
+        return EVENTD_METRICS_HISTOGRAM_SIZE - 1;
+
+    return ( exponent - EVENTD_METRICS_HISTOGRAM_SUB_BITS + 1 ) * EVENTD_METRICS_HISTOGRAM_SUB_COUNT + ( ( value >> ( exponent - EVENTD_METRICS_HISTOGRAM_SUB_BITS ) ) & ( EVENTD_METRICS_HISTOGRAM_SUB_COUNT - 1 ) );
+}
+
+/* Exclusive upper limit of a bucket */
+static guint64
+_eventd_metrics_histogram_bucket_limit(guint bucket)
+{
+    if ( bucket < EVENTD_METRICS_HISTOGRAM_SUB_COUNT )
+        return bucket + 1;
+
+    guint exponent = bucket / EVENTD_METRICS_HISTOGRAM_SUB_COUNT + EVENTD_METRICS_HISTOGRAM_SUB_BITS - 1;
+    guint64 sub = bucket % EVENTD_METRICS_HISTOGRAM_SUB_COUNT;
+
+    return ( EVENTD_METRICS_HISTOGRAM_SUB_COUNT + sub + 1 ) << ( exponent - EVENTD_METRICS_HISTOGRAM_SUB_BITS );
+}
+
+static void
+_eventd_metrics_histogram_record(EventdMetricsHistogram *self, gint64 start)
+{
+    gint64 now = eventd_metrics_now();
+    guint64 value = ( now > start ) ? ( now - start ) : 0;
+
+    g_atomic_pointer_add(&self->buckets[_eventd_metrics_histogram_bucket(value)], 1);
+    _eventd_metrics_value_add(&self->sum, value);
+    _eventd_metrics_value_max(&self->max, value);
+}
+
+static void
+_eventd_metrics_histogram_snapshot(EventdMetricsHistogram *self, EventdMetricsHistogramSnapshot *snapshot)
+{
+    guint i;
+
+    snapshot->count = 0;
+    for ( i = 0 ; i < EVENTD_METRICS_HISTOGRAM_SIZE ; ++i )
+    {
+        snapshot->buckets[i] = (gsize) g_atomic_pointer_get(&self->buckets[i]);
+        snapshot->count += snapshot->buckets[i];
+    }
+    snapshot->sum = _eventd_metrics_value_get(&self->sum);
+    snapshot->max = _eventd_metrics_value_get(&self->max);
+}
+
+/* Highest value equivalent to the quantile bucket, in nanoseconds */
+static guint64
+_eventd_metrics_histogram_snapshot_quantile(const EventdMetricsHistogramSnapshot *snapshot, guint per_mille)
+{
+    guint64 target = ( (guint64) snapshot->count * per_mille + 999 ) / 1000;
+    guint64 count = 0;
+    guint i;
+
+    for ( i = 0 ; i < EVENTD_METRICS_HISTOGRAM_SIZE ; ++i )
+    {
+        count += snapshot->buckets[i];
+        if ( count >= target )
+            return MIN(_eventd_metrics_histogram_bucket_limit(i) - 1, snapshot->max);
+    }
+    return snapshot->max;
+}
+
+
+/*
+ * Recording interface
+ */
+
+void
+eventd_metrics_count(EventdMetricsCounter counter)
+{
+    g_atomic_pointer_add(&metrics.counters[counter], 1);
+}
+
+void
+eventd_metrics_stage(EventdMetricsStage stage, gint64 start)
+{
+    _eventd_metrics_histogram_record(&metrics.stages[stage], start);
+}
+
+EventdMetricsPlugin *
+eventd_metrics_plugin_new(const gchar *id)
+{
+    EventdMetricsPlugin *plugin;
+
+    plugin = g_new0(EventdMetricsPlugin, 1);
+    plugin->id = g_strdup(id);
+
+    g_mutex_lock(&metrics.lock);
+    metrics.plugins = g_list_prepend(metrics.plugins, plugin);
+    g_mutex_unlock(&metrics.lock);
+
+    return plugin;
+}
+
+void
+eventd_metrics_plugin_free(EventdMetricsPlugin *plugin)
+{
+    g_mutex_lock(&metrics.lock);
+    metrics.plugins = g_list_remove(metrics.plugins, plugin);
+    g_mutex_unlock(&metrics.lock);
+
+    g_free(plugin->id);
+    g_free(plugin);
+}
+
+void
+eventd_metrics_plugin_action(EventdMetricsPlugin *plugin, gint64 start)
+{
+    _eventd_metrics_histogram_record(&plugin->actions, start);
+}
+
+void
+eventd_metrics_plugin_action_dropped(EventdMetricsPlugin *plugin)
+{
+    g_atomic_pointer_add(&plugin->dropped, 1);
+}
+
+EventdMetricsConnection *
+eventd_metrics_connection_new(EventdMetricsConnectionType type, const gchar *peer)
+{
+    EventdMetricsConnection *connection;
+
+    connection = g_new0(EventdMetricsConnection, 1);
+    connection->type = type;
+    connection->peer = g_strdup(peer);
+
+    g_mutex_lock(&metrics.lock);
+    connection->id = ++metrics.next_connection_id;
+    connection->link = metrics.connections = g_list_prepend(metrics.connections, connection);
+    g_mutex_unlock(&metrics.lock);
+
+    return connection;
+}
+
+void
+eventd_metrics_connection_free(EventdMetricsConnection *connection)
+{
+    if ( connection == NULL )
+        return;
+
+    g_mutex_lock(&metrics.lock);
+    metrics.connections = g_list_delete_link(metrics.connections, connection->link);
+    g_mutex_unlock(&metrics.lock);
+
+    g_free(connection->peer);
+    g_free(connection);
+}
+
+void
+eventd_metrics_connection_event_received(EventdMetricsConnection *connection, gint64 start)
+{
+    _eventd_metrics_histogram_record(&connection->push, start);
+    _eventd_metrics_histogram_record(&metrics.connections_push[connection->type], start);
+    g_atomic_pointer_add(&connection->counters.received, 1);
+    g_atomic_pointer_add(&metrics.connections_totals[connection->type].received, 1);
+}
+
+void
+eventd_metrics_connection_event_sent(EventdMetricsConnection *connection)
+{
+    g_atomic_pointer_add(&connection->counters.sent, 1);
+    g_atomic_pointer_add(&metrics.connections_totals[connection->type].sent, 1);
+}
+
+
+/*
+ * Human-readable dump
+ */
+
+static void
+_eventd_metrics_append_duration(GString *str, guint64 value)
+{
+    if ( value < 1000 )
+        g_string_append_printf(str, "%" G_GUINT64_FORMAT "ns", value);
+    else if ( value < 1000000 )
+        g_string_append_printf(str, "%.1fµs", value / 1e3);
+    else if ( value < 1000000000 )
+        g_string_append_printf(str, "%.1fms", value / 1e6);
+    else
+        g_string_append_printf(str, "%.2fs", value / 1e9);
+}
+
+static void
+_eventd_metrics_append_histogram(GString *str, EventdMetricsHistogram *histogram)
+{
+    EventdMetricsHistogramSnapshot snapshot;
+    _eventd_metrics_histogram_snapshot(histogram, &snapshot);
+
+    if ( snapshot.count == 0 )
+        return;
+
+    g_string_append(str, ", mean ");
+    _eventd_metrics_append_duration(str, snapshot.sum / snapshot.count);
+    g_string_append(str, ", p50 ");
+    _eventd_metrics_append_duration(str, _eventd_metrics_histogram_snapshot_quantile(&snapshot, 500));
+    g_string_append(str, ", p90 ");
+    _eventd_metrics_append_duration(str, _eventd_metrics_histogram_snapshot_quantile(&snapshot, 900));
+    g_string_append(str, ", p99 ");
+    _eventd_metrics_append_duration(str, _eventd_metrics_histogram_snapshot_quantile(&snapshot, 990));
+    g_string_append(str, ", max ");
+    _eventd_metrics_append_duration(str, snapshot.max);
+}
+
+static gsize
+_eventd_metrics_histogram_count(EventdMetricsHistogram *histogram)
+{
+    gsize count = 0;
+    guint i;
+
+    for ( i = 0 ; i < EVENTD_METRICS_HISTOGRAM_SIZE ; ++i )
+        count += (gsize) g_atomic_pointer_get(&histogram->buckets[i]);
+
+    return count;
+}
+
+gchar *
+eventd_metrics_dump(void)
+{
+    GString *str;
+    GList *link;
+    guint i;
+
+    str = g_string_new("Events:");
+    g_string_append_printf(str, " %" G_GSIZE_FORMAT " received, %" G_GSIZE_FORMAT " internal, %" G_GSIZE_FORMAT " unmatched, %" G_GSIZE_FORMAT " coalesced, %" G_GSIZE_FORMAT " rate-limited",
+        (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS]),
+        (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_INTERNAL]),
+        (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_UNMATCHED]),
+        (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_COALESCED]),
+        (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_RATE_LIMITED]));
+
+    g_string_append(str, "\nStages:");
+    for ( i = 0 ; i < _EVENTD_METRICS_STAGE_SIZE ; ++i )
+    {
+        g_string_append_printf(str, "\n    %s: %" G_GSIZE_FORMAT " samples", _eventd_metrics_stages[i], _eventd_metrics_histogram_count(&metrics.stages[i]));
+        _eventd_metrics_append_histogram(str, &metrics.stages[i]);
+    }
+
+    g_mutex_lock(&metrics.lock);
+
+    g_string_append(str, "\nPlugins:");
+    for ( link = metrics.plugins ; link != NULL ; link = g_list_next(link) )
+    {
+        EventdMetricsPlugin *plugin = link->data;
+        g_string_append_printf(str, "\n    %s: %" G_GSIZE_FORMAT " actions, %" G_GSIZE_FORMAT " dropped", plugin->id, _eventd_metrics_histogram_count(&plugin->actions), (gsize) g_atomic_pointer_get(&plugin->dropped));
+        _eventd_metrics_append_histogram(str, &plugin->actions);
+    }
+
+    g_string_append(str, "\nConnections:");
+    for ( i = 0 ; i < _EVENTD_METRICS_CONNECTION_TYPE_SIZE ; ++i )
+        g_string_append_printf(str, "\n    %s (total): %" G_GSIZE_FORMAT " received, %" G_GSIZE_FORMAT " sent", _eventd_metrics_connection_types[i], (gsize) g_atomic_pointer_get(&metrics.connections_totals[i].received), (gsize) g_atomic_pointer_get(&metrics.connections_totals[i].sent));
+    for ( link = metrics.connections ; link != NULL ; link = g_list_next(link) )
+    {
+        EventdMetricsConnection *connection = link->data;
+        g_string_append_printf(str, "\n    %s #%" G_GUINT64_FORMAT " (%s): %" G_GSIZE_FORMAT " received, %" G_GSIZE_FORMAT " sent", _eventd_metrics_connection_types[connection->type], connection->id, connection->peer, (gsize) g_atomic_pointer_get(&connection->counters.received), (gsize) g_atomic_pointer_get(&connection->counters.sent));
+        _eventd_metrics_append_histogram(str, &connection->push);
+    }
+
+    g_mutex_unlock(&metrics.lock);
+
+    EventdEventAllocationStats stats;
+    eventd_event_get_allocation_stats(&stats);
+    g_string_append_printf(str, "\nEvent allocations: %" G_GSIZE_FORMAT " allocated, %" G_GSIZE_FORMAT " recycled, %" G_GSIZE_FORMAT " released, %" G_GSIZE_FORMAT " data tables", stats.allocated, stats.recycled, stats.released, stats.data_allocated);
+
+    return g_string_free(str, FALSE);
+}
+
+
+/*
+ * OpenMetrics text exposition
+ */
+
+static void
+_eventd_metrics_openmetrics_append_seconds(GString *str, guint64 value)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append(str, g_ascii_formatd(buffer, sizeof(buffer), "%.9g", value / 1e9));
+}
+
+static void
+_eventd_metrics_openmetrics_append_label(GString *str, const gchar *name, const gchar *value)
+{
+    g_string_append_printf(str, "%s=\"", name);
+    for ( ; *value != '\0' ; ++value )
+    {
+        switch ( *value )
+        {
+        case '\\':
+            g_string_append(str, "\\\\");
+        break;
+        case '"':
+            g_string_append(str, "\\\"");
+        break;
+        case '\n':
+            g_string_append(str, "\\n");
+        break;
+        default:
+            g_string_append_c(str, *value);
+        }
+    }
+    g_string_append_c(str, '"');
+}
+
+static void
+_eventd_metrics_openmetrics_append_header(GString *str, const gchar *name, const gchar *type, const gchar *help)
+{
+    g_string_append_printf(str, "# TYPE %s %s\n", name, type);
+    if ( g_str_has_suffix(name, "_seconds") )
+        g_string_append_printf(str, "# UNIT %s seconds\n", name);
+    g_string_append_printf(str, "# HELP %s %s\n", name, help);
+}
+
+/*
+ * We only expose the power-of-two boundaries so that the bucket set
+ * is fixed, sub-buckets never straddle them so counts stay exact
+ */
+static void
+_eventd_metrics_openmetrics_append_histogram(GString *str, const gchar *name, const gchar *labels, EventdMetricsHistogram *histogram)
+{
+    EventdMetricsHistogramSnapshot snapshot;
+    guint64 count = 0;
+    guint i;
+
+    _eventd_metrics_histogram_snapshot(histogram, &snapshot);
+
+    for ( i = 0 ; i < EVENTD_METRICS_HISTOGRAM_SIZE - 1 ; ++i )
+    {
+        guint64 limit = _eventd_metrics_histogram_bucket_limit(i);
+
+        count += snapshot.buckets[i];
+        if ( ( limit < EVENTD_METRICS_HISTOGRAM_SUB_COUNT ) || ( ( limit & ( limit - 1 ) ) != 0 ) )
+            continue;
+
+        g_string_append_printf(str, "%s_bucket{%s,le=\"", name, labels);
+        _eventd_metrics_openmetrics_append_seconds(str, limit);
+        g_string_append_printf(str, "\"} %" G_GUINT64_FORMAT "\n", count);
+    }
+    g_string_append_printf(str, "%s_bucket{%s,le=\"+Inf\"} %" G_GSIZE_FORMAT "\n", name, labels, snapshot.count);
+    g_string_append_printf(str, "%s_count{%s} %" G_GSIZE_FORMAT "\n", name, labels, snapshot.count);
+    g_string_append_printf(str, "%s_sum{%s} ", name, labels);
+    _eventd_metrics_openmetrics_append_seconds(str, snapshot.sum);
+    g_string_append_c(str, '\n');
+}
+
+gchar *
+eventd_metrics_dump_openmetrics(void)
+{
+    GString *str, *labels;
+    GList *link;
+    guint i;
+
+    str = g_string_new(NULL);
+    labels = g_string_new(NULL);
+
+    _eventd_metrics_openmetrics_append_header(str, "eventd_events", "counter", "Events pushed to the core");
+    g_string_append_printf(str, "eventd_events_total %" G_GSIZE_FORMAT "\n", (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS]));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_events_internal", "counter", "Internal events dispatched without processing");
+    g_string_append_printf(str, "eventd_events_internal_total %" G_GSIZE_FORMAT "\n", (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_INTERNAL]));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_events_unmatched", "counter", "Events matching no configuration");
+    g_string_append_printf(str, "eventd_events_unmatched_total %" G_GSIZE_FORMAT "\n", (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_UNMATCHED]));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_events_coalesced", "counter", "Events merged into a previous one by coalescing");
+    g_string_append_printf(str, "eventd_events_coalesced_total %" G_GSIZE_FORMAT "\n", (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_COALESCED]));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_events_rate_limited", "counter", "Events whose actions were dropped by rate limiting");
+    g_string_append_printf(str, "eventd_events_rate_limited_total %" G_GSIZE_FORMAT "\n", (gsize) g_atomic_pointer_get(&metrics.counters[EVENTD_METRICS_COUNTER_EVENTS_RATE_LIMITED]));
+
+    _eventd_metrics_openmetrics_append_header(str, "eventd_stage_duration_seconds", "histogram", "Time spent in each core stage");
+    for ( i = 0 ; i < _EVENTD_METRICS_STAGE_SIZE ; ++i )
+    {
+        g_string_truncate(labels, 0);
+        _eventd_metrics_openmetrics_append_label(labels, "stage", _eventd_metrics_stages[i]);
+        _eventd_metrics_openmetrics_append_histogram(str, "eventd_stage_duration_seconds", labels->str, &metrics.stages[i]);
+    }
+
+    _eventd_metrics_openmetrics_append_header(str, "eventd_connection_events_received", "counter", "Events received, by connection type");
+    for ( i = 0 ; i < _EVENTD_METRICS_CONNECTION_TYPE_SIZE ; ++i )
+        g_string_append_printf(str, "eventd_connection_events_received_total{type=\"%s\"} %" G_GSIZE_FORMAT "\n", _eventd_metrics_connection_types[i], (gsize) g_atomic_pointer_get(&metrics.connections_totals[i].received));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_connection_events_sent", "counter", "Events sent, by connection type");
+    for ( i = 0 ; i < _EVENTD_METRICS_CONNECTION_TYPE_SIZE ; ++i )
+        g_string_append_printf(str, "eventd_connection_events_sent_total{type=\"%s\"} %" G_GSIZE_FORMAT "\n", _eventd_metrics_connection_types[i], (gsize) g_atomic_pointer_get(&metrics.connections_totals[i].sent));
+    _eventd_metrics_openmetrics_append_header(str, "eventd_connection_push_duration_seconds", "histogram", "Time spent handling received events, by connection type");
+    for ( i = 0 ; i < _EVENTD_METRICS_CONNECTION_TYPE_SIZE ; ++i )
+    {
+        g_string_truncate(labels, 0);
+        _eventd_metrics_openmetrics_append_label(labels, "type", _eventd_metrics_connection_types[i]);
+        _eventd_metrics_openmetrics_append_histogram(str, "eventd_connection_push_duration_seconds", labels->str, &metrics.connections_push[i]);
+    }
+
+    g_mutex_lock(&metrics.lock);
+
+    _eventd_metrics_openmetrics_append_header(str, "eventd_plugin_action_duration_seconds", "histogram", "Time spent in each plugin action");
+    for ( link = metrics.plugins ; link != NULL ; link = g_list_next(link) )
+    {
+        EventdMetricsPlugin *plugin = link->data;
+        g_string_truncate(labels, 0);
+        _eventd_metrics_openmetrics_append_label(labels, "plugin", plugin->id);
+        _eventd_metrics_openmetrics_append_histogram(str, "eventd_plugin_action_duration_seconds", labels->str, &plugin->actions);
+    }
+    _eventd_metrics_openmetrics_append_header(str, "eventd_plugin_actions_dropped", "counter", "Plugin actions dropped on a full queue");
+    for ( link = metrics.plugins ; link != NULL ; link = g_list_next(link) )
+    {
+        EventdMetricsPlugin *plugin = link->data;
+        g_string_truncate(labels, 0);
+        _eventd_metrics_openmetrics_append_label(labels, "plugin", plugin->id);
+        g_string_append_printf(str, "eventd_plugin_actions_dropped_total{%s} %" G_GSIZE_FORMAT "\n", labels->str, (gsize) g_atomic_pointer_get(&plugin->dropped));
+    }
+
+    g_mutex_unlock(&metrics.lock);
+
+    EventdEventAllocationStats stats;
+    eventd_event_get_allocation_stats(&stats);
+    _eventd_metrics_openmetrics_append_header(str, "eventd_event_allocations", "counter", "Event blocks allocated from the system");
+    g_string_append_printf(str, "eventd_event_allocations_total %" G_GSIZE_FORMAT "\n", stats.allocated);
+    _eventd_metrics_openmetrics_append_header(str, "eventd_event_recycles", "counter", "Event blocks reused from the slab");
+    g_string_append_printf(str, "eventd_event_recycles_total %" G_GSIZE_FORMAT "\n", stats.recycled);
+    _eventd_metrics_openmetrics_append_header(str, "eventd_event_releases", "counter", "Event blocks released to the system");
+    g_string_append_printf(str, "eventd_event_releases_total %" G_GSIZE_FORMAT "\n", stats.released);
+
+    g_string_append(str, "# EOF\n");
+
+    g_string_free(labels, TRUE);
+
+    return g_string_free(str, FALSE);
+}
+
+
+/*
+ * OpenMetrics endpoint
+ *
+ * A minimal HTTP/1.0 server, any GET request gets the metrics
+ * Connections are handled in their own threads so a slow scraper
+ * cannot stall the main loop
+ */
+
+static void
+_eventd_metrics_endpoint_send(GOutputStream *output, const gchar *status, const gchar *content_type, const gchar *body)
+{
+    GError *error = NULL;
+    gchar *headers;
+    gsize length = strlen(body);
+
+    headers = g_strdup_printf("HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %" G_GSIZE_FORMAT "\r\nConnection: close\r\n\r\n", status, content_type, length);
+
+    if ( ( ! g_output_stream_write_all(output, headers, strlen(headers), NULL, NULL, &error) ) || ( ! g_output_stream_write_all(output, body, length, NULL, NULL, &error) ) )
+        g_warning("Couldn't send metrics: %s", error->message);
+    g_clear_error(&error);
+
+    g_free(headers);
+}
+
+/*
+ * Reads the request line and skips the headers, within a size and time limit
+ * so a client cannot make us buffer or wait forever
+ * Returns the error status to answer, or NULL
+ */
+static const gchar *
+_eventd_metrics_endpoint_read_request(GInputStream *input, gchar **request, GError **error)
+{
+    gchar buffer[EVENTD_METRICS_ENDPOINT_REQUEST_MAX_SIZE];
+    gsize length = 0, line = 0, i;
+    gint64 deadline = g_get_monotonic_time() + EVENTD_METRICS_ENDPOINT_TIMEOUT * G_USEC_PER_SEC;
+
+    *request = NULL;
+    for (;;)
+    {
+        gssize r;
+
+        if ( length == sizeof(buffer) )
+            return "431 Request Header Fields Too Large";
+        if ( g_get_monotonic_time() > deadline )
+            return "408 Request Timeout";
+
+        r = g_input_stream_read(input, buffer + length, sizeof(buffer) - length, NULL, error);
+        if ( r <= 0 )
+            return NULL;
+
+        for ( i = length, length += r ; i < length ; ++i )
+        {
+            if ( buffer[i] != '\n' )
+                continue;
+
+            gsize end = ( ( i > line ) && ( buffer[i - 1] == '\r' ) ) ? ( i - 1 ) : i;
+            if ( *request == NULL )
+                *request = g_strndup(buffer + line, end - line);
+            else if ( end == line )
+                /* Empty line, end of the headers */
+                return NULL;
+            line = i + 1;
+        }
+
+        if ( ( length - line ) > EVENTD_METRICS_ENDPOINT_LINE_MAX_SIZE )
+            return ( *request == NULL ) ? "414 URI Too Long" : "431 Request Header Fields Too Large";
+    }
+}
+
+static gboolean
+_eventd_metrics_endpoint_run(GThreadedSocketService *service, GSocketConnection *connection, GObject *source_object, gpointer user_data)
+{
+    GIOStream *stream = G_IO_STREAM(connection);
+    GError *error = NULL;
+    const gchar *status;
+    gchar *request;
+
+    g_socket_set_timeout(g_socket_connection_get_socket(connection), EVENTD_METRICS_ENDPOINT_TIMEOUT);
+
+    status = _eventd_metrics_endpoint_read_request(g_io_stream_get_input_stream(stream), &request, &error);
+
+    if ( error != NULL )
+        g_warning("Couldn't read metrics request: %s", error->message);
+    else if ( status != NULL )
+        _eventd_metrics_endpoint_send(g_io_stream_get_output_stream(stream), status, "text/plain; charset=utf-8", "Invalid request\n");
+    else if ( request == NULL )
+        /* Nothing to answer */;
+    else if ( g_str_has_prefix(request, "GET ") )
+    {
+        gchar *body = eventd_metrics_dump_openmetrics();
+        _eventd_metrics_endpoint_send(g_io_stream_get_output_stream(stream), "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", body);
+        g_free(body);
+    }
+    else
+        _eventd_metrics_endpoint_send(g_io_stream_get_output_stream(stream), "405 Method Not Allowed", "text/plain; charset=utf-8", "Only GET is supported\n");
+
+    g_clear_error(&error);
+    g_free(request);
+
+    if ( ! g_io_stream_close(stream, NULL, &error) )
+        g_warning("Can't close the stream: %s", error->message);
+    g_clear_error(&error);
+
+    return TRUE;
+}
+
+EventdMetricsEndpoint *
+eventd_metrics_endpoint_new(EventdCoreContext *core, const gchar * const *binds)
+{
+    GSocketService *socket_service;
+    GError *error = NULL;
+    GList *sockets, *socket_;
+    gboolean ret = TRUE;
+
+    if ( binds == NULL )
+        return NULL;
+
+    sockets = eventd_core_get_binds(core, PACKAGE_NAME "-metrics", binds);
+    if ( sockets == NULL )
+    {
+        g_warning("No metrics socket available");
+        return NULL;
+    }
+
+    socket_service = g_threaded_socket_service_new(EVENTD_METRICS_ENDPOINT_THREADS);
+    g_socket_service_stop(socket_service);
+
+    for ( socket_ = sockets ; ( socket_ != NULL ) && ret ; socket_ = g_list_next(socket_) )
+    {
+        GSocket *socket = socket_->data;
+        if ( ! g_socket_listener_add_socket(G_SOCKET_LISTENER(socket_service), socket, NULL, &error) )
+        {
+            g_warning("Unable to add metrics socket: %s", error->message);
+            ret = FALSE;
+        }
+    }
+    g_clear_error(&error);
+
+    g_list_free_full(sockets, g_object_unref);
+
+    if ( ! ret )
+    {
+        g_object_unref(socket_service);
+        return NULL;
+    }
+
+    EventdMetricsEndpoint *endpoint;
+
+    endpoint = g_new0(EventdMetricsEndpoint, 1);
+    endpoint->socket_service = socket_service;
+
+    g_signal_connect(endpoint->socket_service, "run", G_CALLBACK(_eventd_metrics_endpoint_run), NULL);
+    g_socket_service_start(endpoint->socket_service);
+
+    return endpoint;
+}
+
+void
+eventd_metrics_endpoint_free(EventdMetricsEndpoint *endpoint)
+{
+    if ( endpoint == NULL )
+        return;
+
+    g_socket_service_stop(endpoint->socket_service);
+    g_socket_listener_close(G_SOCKET_LISTENER(endpoint->socket_service));
+    g_object_unref(endpoint->socket_service);
+    g_free(endpoint);
+}
@@ -0,0 +1,74 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_METRICS_H__
+#define __EVENTD_METRICS_H__
+
+typedef enum {
+    EVENTD_METRICS_STAGE_PARSE,
+    EVENTD_METRICS_STAGE_PROCESS,
+    EVENTD_METRICS_STAGE_DISPATCH,
+    EVENTD_METRICS_STAGE_ACTIONS,
+    _EVENTD_METRICS_STAGE_SIZE
+} EventdMetricsStage;
+
+typedef enum {
+    EVENTD_METRICS_COUNTER_EVENTS,
+    EVENTD_METRICS_COUNTER_EVENTS_INTERNAL,
+    EVENTD_METRICS_COUNTER_EVENTS_UNMATCHED,
+    EVENTD_METRICS_COUNTER_EVENTS_COALESCED,
+    EVENTD_METRICS_COUNTER_EVENTS_RATE_LIMITED,
+    _EVENTD_METRICS_COUNTER_SIZE
+} EventdMetricsCounter;
+
+typedef enum {
+    EVENTD_METRICS_CONNECTION_EVP,
+    EVENTD_METRICS_CONNECTION_RELAY,
+    _EVENTD_METRICS_CONNECTION_TYPE_SIZE
+} EventdMetricsConnectionType;
+
+typedef struct _EventdMetricsPlugin EventdMetricsPlugin;
+typedef struct _EventdMetricsConnection EventdMetricsConnection;
+typedef struct _EventdMetricsEndpoint EventdMetricsEndpoint;
+
+gint64 eventd_metrics_now(void);
+
+void eventd_metrics_count(EventdMetricsCounter counter);
+void eventd_metrics_stage(EventdMetricsStage stage, gint64 start);
+
+EventdMetricsPlugin *eventd_metrics_plugin_new(const gchar *id);
+void eventd_metrics_plugin_free(EventdMetricsPlugin *plugin);
+void eventd_metrics_plugin_action(EventdMetricsPlugin *plugin, gint64 start);
+void eventd_metrics_plugin_action_dropped(EventdMetricsPlugin *plugin);
+
+EventdMetricsConnection *eventd_metrics_connection_new(EventdMetricsConnectionType type, const gchar *peer);
+void eventd_metrics_connection_free(EventdMetricsConnection *connection);
+void eventd_metrics_connection_event_received(EventdMetricsConnection *connection, gint64 start);
+void eventd_metrics_connection_event_sent(EventdMetricsConnection *connection);
+
+gchar *eventd_metrics_dump(void);
+gchar *eventd_metrics_dump_openmetrics(void);
+
+EventdMetricsEndpoint *eventd_metrics_endpoint_new(EventdCoreContext *core, const gchar * const *binds);
+void eventd_metrics_endpoint_free(EventdMetricsEndpoint *endpoint);
+
+#endif /* __EVENTD_METRICS_H__ */
@@ -31,6 +31,7 @@
 #include "eventd-plugin.h"
 #include "eventd-plugin-private.h"
 
+#include "libeventd-helpers-config.h"
 #include "libeventd-helpers-dirs.h"
 
 #include "eventdctl.h"
@@ -40,11 +41,18 @@
 #include "relay/relay.h"
 #include "relay/server.h"
 #include "sd-modules.h"
+#include "metrics.h"
 
 typedef struct {
+    const gchar *id;
     GModule *module;
     EventdPluginContext *context;
     EventdPluginInterface interface;
+    EventdMetricsPlugin *metrics;
+    struct {
+        guint running;
+        GQueue queue;
+    } jobs;
 } EventdPlugin;
 
 typedef struct {
@@ -52,10 +60,33 @@ typedef struct {
     EventdPluginAction *action;
 } EventdPluginsAction;
 
+typedef struct {
+    EventdPlugin *plugin;
+    EventdPluginAction *action;
+    EventdEvent *event;
+} EventdPluginsJob;
+
 static EventdEvpContext *evp = NULL;
 static EventdRelayContext *relay = NULL;
 static GHashTable *plugins = NULL;
 
+/*
+ * Thread-safe actions run on a pool, each plugin having at most
+ * concurrency jobs running and queue_size jobs waiting
+ */
+static struct {
+    guint threads;
+    guint concurrency;
+    guint queue_size;
+    GThreadPool *pool;
+    GMutex lock;
+    GCond cond;
+    guint pending;
+} action_workers = {
+    .concurrency = 1,
+    .queue_size = 64,
+};
+
 
 static void
 _eventd_plugins_load_dir(EventdPluginCoreContext *core, gchar *plugins_dir_name, gboolean system_mode, gchar **whitelist, gchar **blacklist)
@@ -170,6 +201,7 @@ _eventd_plugins_load_dir(EventdPluginCoreContext *core, gchar *plugins_dir_name,
         eventd_debug("Loading plugin '%s': %s", file, *id);
 
         plugin = g_new0(EventdPlugin, 1);
+        plugin->id = *id;
         plugin->module = module;
         get_interface(&plugin->interface);
 
@@ -193,6 +225,9 @@ _eventd_plugins_load_dir(EventdPluginCoreContext *core, gchar *plugins_dir_name,
             }
         }
 
+        if ( plugin->interface.event_action != NULL )
+            plugin->metrics = eventd_metrics_plugin_new(*id);
+
         g_hash_table_insert(plugins, (gpointer) *id, plugin);
         continue;
 
@@ -211,10 +246,96 @@ _eventd_plugins_plugin_free(gpointer data)
 
     if ( plugin->interface.uninit != NULL )
         plugin->interface.uninit(plugin->context);
+    if ( plugin->metrics != NULL )
+        eventd_metrics_plugin_free(plugin->metrics);
     g_module_close(plugin->module);
     g_free(plugin);
 }
 
+static void
+_eventd_plugins_event_action(EventdPlugin *plugin, EventdPluginAction *action, EventdEvent *event)
+{
+    gint64 start = eventd_metrics_now();
+    plugin->interface.event_action(plugin->context, action, event);
+    eventd_metrics_plugin_action(plugin->metrics, start);
+}
+
+static void
+_eventd_plugins_actions_job_run(gpointer data, gpointer user_data)
+{
+    EventdPluginsJob *job = data;
+    EventdPlugin *plugin = job->plugin;
+
+    while ( job != NULL )
+    {
+        _eventd_plugins_event_action(plugin, job->action, job->event);
+        eventd_event_unref(job->event);
+        g_slice_free(EventdPluginsJob, job);
+
+        g_mutex_lock(&action_workers.lock);
+        job = g_queue_pop_head(&plugin->jobs.queue);
+        if ( job == NULL )
+            --plugin->jobs.running;
+        if ( --action_workers.pending == 0 )
+            g_cond_broadcast(&action_workers.cond);
+        g_mutex_unlock(&action_workers.lock);
+    }
+}
+
+static gboolean
+_eventd_plugins_actions_push(EventdPlugin *plugin, EventdPluginAction *action, EventdEvent *event)
+{
+    if ( ( action_workers.threads == 0 ) || ( ! plugin->interface.event_action_thread_safe ) )
+        return FALSE;
+
+    if ( action_workers.pool == NULL )
+        action_workers.pool = g_thread_pool_new(_eventd_plugins_actions_job_run, NULL, action_workers.threads, FALSE, NULL);
+    else if ( g_thread_pool_get_max_threads(action_workers.pool) != (gint) action_workers.threads )
+        g_thread_pool_set_max_threads(action_workers.pool, action_workers.threads, NULL);
+
+    EventdPluginsJob *job;
+    job = g_slice_new(EventdPluginsJob);
+    job->plugin = plugin;
+    job->action = action;
+    job->event = eventd_event_ref(event);
+
+    g_mutex_lock(&action_workers.lock);
+    if ( plugin->jobs.running < action_workers.concurrency )
+    {
+        ++plugin->jobs.running;
+        ++action_workers.pending;
+        g_thread_pool_push(action_workers.pool, job, NULL);
+        job = NULL;
+    }
+    else if ( g_queue_get_length(&plugin->jobs.queue) < action_workers.queue_size )
+    {
+        ++action_workers.pending;
+        g_queue_push_tail(&plugin->jobs.queue, job);
+        job = NULL;
+    }
+    g_mutex_unlock(&action_workers.lock);
+
+    if ( job != NULL )
+    {
+        g_warning("Plugin '%s' action queue is full, dropping action for event %s", plugin->id, eventd_event_get_uuid(event));
+        eventd_metrics_plugin_action_dropped(plugin->metrics);
+        eventd_event_unref(job->event);
+        g_slice_free(EventdPluginsJob, job);
+    }
+
+    return TRUE;
+}
+
+/* Waits for every running and queued action to finish */
+static void
+_eventd_plugins_actions_drain(void)
+{
+    g_mutex_lock(&action_workers.lock);
+    while ( action_workers.pending > 0 )
+        g_cond_wait(&action_workers.cond, &action_workers.lock);
+    g_mutex_unlock(&action_workers.lock);
+}
+
 void
 eventd_plugins_action_free(gpointer data)
 {
@@ -278,6 +399,10 @@ eventd_plugins_unload(void)
     if ( plugins == NULL )
         return;
 
+    if ( action_workers.pool != NULL )
+        g_thread_pool_free(action_workers.pool, FALSE, TRUE);
+    action_workers.pool = NULL;
+
     eventd_sd_modules_unload();
 
     eventd_relay_uninit(relay);
@@ -312,6 +437,8 @@ eventd_plugins_start_all(void)
 void
 eventd_plugins_stop_all(void)
 {
+    _eventd_plugins_actions_drain();
+
     GHashTableIter iter;
     const gchar *id;
     EventdPlugin *plugin;
@@ -327,6 +454,40 @@ eventd_plugins_stop_all(void)
     eventd_evp_stop(evp);
 }
 
+void
+eventd_plugins_reload_begin_all(void)
+{
+    _eventd_plugins_actions_drain();
+
+    GHashTableIter iter;
+    const gchar *id;
+    EventdPlugin *plugin;
+    g_hash_table_iter_init(&iter, plugins);
+    while ( g_hash_table_iter_next(&iter, (gpointer *)&id, (gpointer *)&plugin) )
+    {
+        if ( ( plugin->interface.reload == NULL ) && ( plugin->interface.stop != NULL ) )
+            plugin->interface.stop(plugin->context);
+    }
+}
+
+void
+eventd_plugins_reload_end_all(void)
+{
+    eventd_relay_config_reload(relay);
+
+    GHashTableIter iter;
+    const gchar *id;
+    EventdPlugin *plugin;
+    g_hash_table_iter_init(&iter, plugins);
+    while ( g_hash_table_iter_next(&iter, (gpointer *)&id, (gpointer *)&plugin) )
+    {
+        if ( plugin->interface.reload != NULL )
+            plugin->interface.reload(plugin->context);
+        else if ( plugin->interface.start != NULL )
+            plugin->interface.start(plugin->context);
+    }
+}
+
 EventdctlReturnCode
 eventd_plugins_control_command(const gchar *id, guint64 argc, const gchar * const *argv, gchar **status)
 {
@@ -362,6 +523,13 @@ eventd_plugins_relay_set_certificate(GTlsCertificate *certificate)
 void
 eventd_plugins_config_reset_all(void)
 {
+    /* Running actions use the plugin actions we are about to free */
+    _eventd_plugins_actions_drain();
+
+    action_workers.threads = 0;
+    action_workers.concurrency = 1;
+    action_workers.queue_size = 64;
+
     GHashTableIter iter;
     const gchar *id;
     EventdPlugin *plugin;
@@ -379,6 +547,18 @@ eventd_plugins_config_reset_all(void)
 void
 eventd_plugins_global_parse_all(GKeyFile *config_file)
 {
+    if ( g_key_file_has_group(config_file, "Server") )
+    {
+        gint64 workers, concurrency, queue_size;
+
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, "Server", "ActionWorkers", action_workers.threads, &workers) == 0 )
+            action_workers.threads = CLAMP(workers, 0, G_MAXINT);
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, "Server", "ActionConcurrency", action_workers.concurrency, &concurrency) == 0 )
+            action_workers.concurrency = CLAMP(concurrency, 1, G_MAXINT);
+        if ( evhelpers_config_key_file_get_int_with_default(config_file, "Server", "ActionQueueSize", action_workers.queue_size, &queue_size) == 0 )
+            action_workers.queue_size = CLAMP(queue_size, 0, G_MAXINT);
+    }
+
     GHashTableIter iter;
     const gchar *id;
     EventdPlugin *plugin;
@@ -445,6 +625,7 @@ eventd_plugins_event_action_all(const GList *actions, EventdEvent *event)
     for ( ; actions != NULL ; actions = g_list_next(actions) )
     {
         EventdPluginsAction *action = actions->data;
-        action->plugin->interface.event_action(action->plugin->context, action->action, event);
+        if ( ! _eventd_plugins_actions_push(action->plugin, action->action, event) )
+            _eventd_plugins_event_action(action->plugin, action->action, event);
     }
 }
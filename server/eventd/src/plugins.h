@@ -28,6 +28,8 @@ void eventd_plugins_unload(void);
 
 void eventd_plugins_start_all(void);
 void eventd_plugins_stop_all(void);
+void eventd_plugins_reload_begin_all(void);
+void eventd_plugins_reload_end_all(void);
 
 EventdctlReturnCode eventd_plugins_control_command(const gchar *id, guint64 argc, const gchar * const *argv, gchar **status);
 
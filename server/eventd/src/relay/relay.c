@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <string.h>
+#include <errno.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -41,9 +42,18 @@
 #include "relay.h"
 
 
+static const gchar * const _eventd_relay_spool_drop_policies[] = {
+    [EVENTD_RELAY_SPOOL_DROP_OLDEST] = "oldest",
+    [EVENTD_RELAY_SPOOL_DROP_NEWEST] = "newest",
+};
+
 struct _EventdRelayContext {
     EventdCoreContext *core;
+    gboolean started;
     GHashTable *servers;
+    GHashTable *signatures;
+    GHashTable *previous_servers;
+    GHashTable *previous_signatures;
 };
 
 
@@ -60,6 +70,9 @@ eventd_relay_init(EventdPluginCoreContext *core)
     context->core = core;
 
     context->servers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, eventd_relay_server_free);
+    context->signatures = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    context->previous_servers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, eventd_relay_server_free);
+    context->previous_signatures = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 
     return context;
 }
@@ -70,6 +83,9 @@ eventd_relay_uninit(EventdRelayContext *context)
     if ( context == NULL )
         return;
 
+    g_hash_table_unref(context->previous_signatures);
+    g_hash_table_unref(context->previous_servers);
+    g_hash_table_unref(context->signatures);
     g_hash_table_unref(context->servers);
 
     g_free(context);
@@ -96,6 +112,7 @@ eventd_relay_start(EventdRelayContext *context)
     if ( context == NULL )
         return;
 
+    context->started = TRUE;
     g_hash_table_foreach(context->servers, _eventd_relay_start_each, NULL);
 }
 
@@ -115,6 +132,7 @@ eventd_relay_stop(EventdRelayContext *context)
     if ( context == NULL )
         return;
 
+    context->started = FALSE;
     g_hash_table_foreach(context->servers, _eventd_relay_stop_each, NULL);
 }
 
@@ -123,6 +141,18 @@ eventd_relay_stop(EventdRelayContext *context)
  * Control command interface
  */
 
+static void
+_eventd_relay_server_append_spool_status(EventdRelayServer *self, GString *str)
+{
+    gsize length;
+    guint64 dropped;
+
+    if ( ! eventd_relay_server_get_spool_status(self, &length, &dropped) )
+        return;
+
+    g_string_append_printf(str, " (%" G_GSIZE_FORMAT " queued, %" G_GUINT64_FORMAT " dropped)", length, dropped);
+}
+
 static EventdPluginCommandStatus
 _eventd_relay_server_check_status(EventdRelayServer *self, const gchar **s)
 {
@@ -213,6 +243,7 @@ eventd_relay_control_command(EventdRelayContext *context, guint64 argc, const gc
                 {
                     _eventd_relay_server_check_status(server, &s);
                     g_string_append_printf(list, "\n    %s: %s", name, s);
+                    _eventd_relay_server_append_spool_status(server, list);
                 }
 
                 *status = g_string_free(list, FALSE);
@@ -225,8 +256,12 @@ eventd_relay_control_command(EventdRelayContext *context, guint64 argc, const gc
         }
         else
         {
+            GString *str;
             r = _eventd_relay_server_check_status(server, &s);
-            *status = g_strdup_printf("Server '%s' is %s", argv[1], s);
+            str = g_string_new(NULL);
+            g_string_append_printf(str, "Server '%s' is %s", argv[1], s);
+            _eventd_relay_server_append_spool_status(server, str);
+            *status = g_string_free(str, FALSE);
         }
         GHashTableIter iter;
         g_hash_table_iter_init(&iter, context->servers);
@@ -266,6 +301,28 @@ eventd_relay_control_command(EventdRelayContext *context, guint64 argc, const gc
  * Configuration interface
  */
 
+static gchar *
+_eventd_relay_server_signature(GKeyFile *config_file, const gchar *group)
+{
+    GString *signature;
+    gchar **keys, **key;
+
+    signature = g_string_new(NULL);
+    keys = g_key_file_get_keys(config_file, group, NULL, NULL);
+    if ( keys == NULL )
+        return g_string_free(signature, FALSE);
+
+    for ( key = keys ; *key != NULL ; ++key )
+    {
+        gchar *value = g_key_file_get_value(config_file, group, *key, NULL);
+        g_string_append_printf(signature, "%s=%s\n", *key, value);
+        g_free(value);
+    }
+    g_strfreev(keys);
+
+    return g_string_free(signature, FALSE);
+}
+
 static void
 _eventd_relay_server_parse(EventdRelayContext *context, GKeyFile *config_file, gchar *server_name)
 {
@@ -273,6 +330,7 @@ _eventd_relay_server_parse(EventdRelayContext *context, GKeyFile *config_file, g
         return;
 
     g_hash_table_remove(context->servers, server_name);
+    g_hash_table_remove(context->signatures, server_name);
 
     gsize size = strlen("Relay ") + strlen(server_name) + 1;
     gchar group[size];
@@ -295,12 +353,34 @@ _eventd_relay_server_parse(EventdRelayContext *context, GKeyFile *config_file, g
             return;
     }
 
+    gchar *signature;
+    const gchar *previous_signature;
+    signature = _eventd_relay_server_signature(config_file, group);
+    previous_signature = g_hash_table_lookup(context->previous_signatures, server_name);
+    if ( g_strcmp0(signature, previous_signature) == 0 )
+    {
+        /* Unchanged server, we keep its connection and spool across the reload */
+        EventdRelayServer *server = g_hash_table_lookup(context->previous_servers, server_name);
+        g_hash_table_steal(context->previous_servers, server_name);
+        g_hash_table_remove(context->previous_signatures, server_name);
+        g_hash_table_insert(context->servers, g_strdup(server_name), server);
+        g_hash_table_insert(context->signatures, server_name, signature);
+        g_free(discover_name);
+        g_free(server_uri);
+        return;
+    }
+
     gint64 ping_interval;
     gboolean accept_unknown_ca = FALSE;
+    gboolean binary = FALSE;
     gchar *server_identity = NULL;
     gchar **forwards = NULL;
     gchar **subscriptions = NULL;
     gboolean event_on_connection = FALSE;
+    gint64 spool_size, spool_max_age;
+    guint64 spool_drop_policy;
+    gboolean spool_persistent = FALSE;
+    EventdRelaySpool *spool = NULL;
 
     if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "PingInterval", 300, &ping_interval) < 0 )
         goto cleanup;
@@ -309,22 +389,51 @@ _eventd_relay_server_parse(EventdRelayContext *context, GKeyFile *config_file, g
         goto cleanup;
     if ( evhelpers_config_key_file_get_boolean(config_file, group, "AcceptUnknownCA", &accept_unknown_ca) < 0 )
         goto cleanup;
+    if ( evhelpers_config_key_file_get_boolean(config_file, group, "Binary", &binary) < 0 )
+        goto cleanup;
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "Forwards", &forwards, NULL) < 0 )
         goto cleanup;
     if ( evhelpers_config_key_file_get_string_list(config_file, group, "Subscriptions", &subscriptions, NULL) < 0 )
         goto cleanup;
     if ( evhelpers_config_key_file_get_boolean(config_file, group, "EventOnConnection", &event_on_connection) < 0 )
         goto cleanup;
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "SpoolSize", 1000, &spool_size) < 0 )
+        goto cleanup;
+    if ( evhelpers_config_key_file_get_int_with_default(config_file, group, "SpoolMaxAge", 0, &spool_max_age) < 0 )
+        goto cleanup;
+    if ( evhelpers_config_key_file_get_enum_with_default(config_file, group, "SpoolDropPolicy", _eventd_relay_spool_drop_policies, G_N_ELEMENTS(_eventd_relay_spool_drop_policies), EVENTD_RELAY_SPOOL_DROP_OLDEST, &spool_drop_policy) < 0 )
+        goto cleanup;
+    if ( evhelpers_config_key_file_get_boolean(config_file, group, "SpoolPersistent", &spool_persistent) < 0 )
+        goto cleanup;
+
+    if ( spool_size > 0 )
+    {
+        gchar *spool_path = NULL;
+        if ( spool_persistent )
+        {
+            gchar *spool_dir, *spool_file;
+            spool_dir = g_build_filename(g_get_user_cache_dir(), PACKAGE_NAME, NULL);
+            spool_file = g_strdup_printf("relay-%s.spool", server_name);
+            if ( g_mkdir_with_parents(spool_dir, 0700) == 0 )
+                spool_path = g_build_filename(spool_dir, spool_file, NULL);
+            else
+                g_warning("Couldn't create spool directory '%s': %s", spool_dir, g_strerror(errno));
+            g_free(spool_file);
+            g_free(spool_dir);
+        }
+        spool = eventd_relay_spool_new(spool_size, MAX(0, spool_max_age) * G_USEC_PER_SEC, spool_drop_policy, spool_path);
+        g_free(spool_path);
+    }
 
     EventdRelayServer *server;
     if ( discover_name != NULL )
     {
-        server = eventd_relay_server_new(context->core, ping_interval, server_identity, accept_unknown_ca, forwards, subscriptions, event_on_connection);
+        server = eventd_relay_server_new(context->core, server_name, ping_interval, server_identity, accept_unknown_ca, binary, forwards, subscriptions, event_on_connection, spool);
         eventd_sd_modules_monitor_server(discover_name, server);
     }
     else
     {
-        server = eventd_relay_server_new_for_uri(context->core, ping_interval, server_identity, accept_unknown_ca, forwards, subscriptions, event_on_connection, server_uri);
+        server = eventd_relay_server_new_for_uri(context->core, server_name, ping_interval, server_identity, accept_unknown_ca, binary, forwards, subscriptions, event_on_connection, spool, server_uri);
         if ( server == NULL )
         {
             g_warning("Couldn't create the connection to server '%s' using '%s'", server_name, server_uri);
@@ -332,11 +441,17 @@ _eventd_relay_server_parse(EventdRelayContext *context, GKeyFile *config_file, g
         }
     }
 
-    g_hash_table_insert(context->servers, server_name, server);
+    if ( context->started )
+        eventd_relay_server_start(server, TRUE);
+
+    g_hash_table_insert(context->servers, g_strdup(server_name), server);
+    g_hash_table_insert(context->signatures, server_name, signature);
     server_name = NULL;
+    signature = NULL;
     forwards = subscriptions = NULL;
 
 cleanup:
+    g_free(signature);
     g_strfreev(subscriptions);
     g_strfreev(forwards);
     g_free(server_identity);
@@ -355,6 +470,7 @@ eventd_relay_global_parse(EventdRelayContext *context, GKeyFile *config_file)
         return;
 
     g_hash_table_remove_all(context->servers);
+    g_hash_table_remove_all(context->signatures);
 
     gchar **servers = NULL;
     if ( evhelpers_config_key_file_get_string_list(config_file, "Relay", "Servers", &servers, NULL) < 0 )
@@ -375,7 +491,34 @@ eventd_relay_config_reset(EventdRelayContext *context)
     if ( context == NULL )
         return;
 
-    g_hash_table_remove_all(context->servers);
+    GHashTable *tmp;
+
+    /*
+     * We keep the current servers aside, to reuse the unchanged ones
+     * if this is a reload
+     */
+    g_hash_table_remove_all(context->previous_servers);
+    g_hash_table_remove_all(context->previous_signatures);
+
+    tmp = context->previous_servers;
+    context->previous_servers = context->servers;
+    context->servers = tmp;
+
+    tmp = context->previous_signatures;
+    context->previous_signatures = context->signatures;
+    context->signatures = tmp;
+}
+
+void
+eventd_relay_config_reload(EventdRelayContext *context)
+{
+    if ( context == NULL )
+        return;
+
+    if ( context->started )
+        g_hash_table_foreach(context->previous_servers, _eventd_relay_stop_each, NULL);
+    g_hash_table_remove_all(context->previous_servers);
+    g_hash_table_remove_all(context->previous_signatures);
 }
 
 void
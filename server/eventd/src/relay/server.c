@@ -34,7 +34,9 @@
 #include "libeventd-helpers-reconnect.h"
 
 #include "../eventd.h"
+#include "../metrics.h"
 
+#include "spool.h"
 #include "server.h"
 
 struct _EventdRelayServer {
@@ -42,6 +44,7 @@ struct _EventdRelayServer {
     guint ping_interval;
     GSocketConnectable *server_identity;
     gboolean accept_unknown_ca;
+    gboolean binary;
     GTlsCertificate *certificate;
     gboolean subscribe;
     gchar **subscriptions;
@@ -52,14 +55,18 @@ struct _EventdRelayServer {
     EventcConnection *connection;
     LibeventdReconnectHandler *reconnect;
     EventdEvent *current;
+    EventdRelaySpool *spool;
+    EventdMetricsConnection *metrics;
 };
 
 static void
 _eventd_relay_server_received_event(EventdRelayServer *self, EventdEvent *event, EventcConnection *connection)
 {
+    gint64 start = eventd_metrics_now();
     self->current = event;
     eventd_core_push_event(self->core, event);
     self->current = NULL;
+    eventd_metrics_connection_event_received(self->metrics, start);
 }
 
 static void
@@ -77,13 +84,48 @@ _eventd_relay_reconnect_callback(LibeventdReconnectHandler *handler, gpointer us
     eventd_relay_server_start(server, FALSE);
 }
 
+static gboolean
+_eventd_relay_server_send(EventdRelayServer *server, EventdEvent *event)
+{
+    GError *error = NULL;
+
+    if ( eventc_connection_send_event(server->connection, event, &error) )
+    {
+        eventd_metrics_connection_event_sent(server->metrics);
+        return TRUE;
+    }
+
+    g_warning("Couldn't send event: %s", error->message);
+    g_clear_error(&error);
+    evhelpers_reconnect_try(server->reconnect);
+
+    return FALSE;
+}
+
+static void
+_eventd_relay_server_replay(EventdRelayServer *server)
+{
+    if ( server->spool == NULL )
+        return;
+
+    EventdEvent *event;
+    while ( ( event = eventd_relay_spool_peek(server->spool) ) != NULL )
+    {
+        if ( ! _eventd_relay_server_send(server, event) )
+            return;
+        eventd_relay_spool_pop(server->spool);
+    }
+}
+
 static void
 _eventd_relay_connection_handler(GObject *obj, GAsyncResult *res, gpointer user_data)
 {
     GError *error = NULL;
     EventdRelayServer *server = user_data;
+    gboolean connected;
 
-    if ( eventc_connection_connect_finish(server->connection, res, &error) )
+    connected = eventc_connection_connect_finish(server->connection, res, &error);
+    if ( connected )
         evhelpers_reconnect_reset(server->reconnect);
     else if ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
     {
@@ -100,6 +142,9 @@ _eventd_relay_connection_handler(GObject *obj, GAsyncResult *res, gpointer user_
         eventc_connection_send_event(server->connection, event, NULL);
         eventd_event_unref(event);
     }
+
+    if ( connected )
+        _eventd_relay_server_replay(server);
 }
 
 static void
@@ -125,7 +170,7 @@ _eventd_relay_server_setup_connection(EventdRelayServer *server)
 }
 
 EventdRelayServer *
-eventd_relay_server_new(EventdCoreContext *core, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gchar **forwards, gchar **subscriptions, gboolean event_on_connection)
+eventd_relay_server_new(EventdCoreContext *core, const gchar *name, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gboolean binary, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, EventdRelaySpool *spool)
 {
     EventdRelayServer *server;
 
@@ -136,6 +181,7 @@ eventd_relay_server_new(EventdCoreContext *core, guint ping_interval, const gcha
     if ( server_identity != NULL )
         server->server_identity = g_network_address_new(server_identity, 0);
     server->accept_unknown_ca = accept_unknown_ca;
+    server->binary = binary;
 
     if ( forwards != NULL )
     {
@@ -157,6 +203,8 @@ eventd_relay_server_new(EventdCoreContext *core, guint ping_interval, const gcha
         g_strfreev(subscriptions);
 
     server->event_on_connection = event_on_connection;
+    server->spool = spool;
+    server->metrics = eventd_metrics_connection_new(EVENTD_METRICS_CONNECTION_RELAY, name);
 
     server->reconnect = evhelpers_reconnect_new(5, 10,_eventd_relay_reconnect_callback, server);
 
@@ -164,7 +212,7 @@ eventd_relay_server_new(EventdCoreContext *core, guint ping_interval, const gcha
 }
 
 EventdRelayServer *
-eventd_relay_server_new_for_uri(EventdCoreContext *core, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, const gchar *uri)
+eventd_relay_server_new_for_uri(EventdCoreContext *core, const gchar *name, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gboolean binary, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, EventdRelaySpool *spool, const gchar *uri)
 {
     EventcConnection *connection;
     GError *error = NULL;
@@ -174,12 +222,13 @@ eventd_relay_server_new_for_uri(EventdCoreContext *core, guint ping_interval, co
     {
         g_warning("Couldn't get address for relay server '%s': %s", uri, error->message);
         g_clear_error(&error);
+        eventd_relay_spool_free(spool);
         return NULL;
     }
 
     EventdRelayServer *server;
 
-    server = eventd_relay_server_new(core, ping_interval, server_identity, accept_unknown_ca, forwards, subscriptions, event_on_connection);
+    server = eventd_relay_server_new(core, name, ping_interval, server_identity, accept_unknown_ca, binary, forwards, subscriptions, event_on_connection, spool);
     server->connection = connection;
 
     _eventd_relay_server_setup_connection(server);
@@ -254,6 +303,7 @@ eventd_relay_server_start(EventdRelayServer *server, gboolean force)
         evhelpers_reconnect_reset(server->reconnect);
     }
     eventc_connection_set_accept_unknown_ca(server->connection, server->accept_unknown_ca);
+    eventc_connection_set_binary(server->connection, server->binary);
     eventc_connection_connect(server->connection, _eventd_relay_connection_handler, server);
 }
 
@@ -289,7 +339,7 @@ eventd_relay_server_event(EventdRelayServer *server, EventdEvent *event)
         return;
 
     if( ! eventd_relay_server_has_address(server) )
-        return;
+        goto spool;
 
     GError *error = NULL;
     if ( ! eventc_connection_is_connected(server->connection, &error) )
@@ -300,16 +350,31 @@ eventd_relay_server_event(EventdRelayServer *server, EventdEvent *event)
             g_clear_error(&error);
             evhelpers_reconnect_try(server->reconnect);
         }
-        return;
+        goto spool;
     }
 
-    if ( ! eventc_connection_send_event(server->connection, event, &error) )
-    {
-        g_warning("Couldn't send event: %s", error->message);
-        g_clear_error(&error);
-        evhelpers_reconnect_try(server->reconnect);
+    /* Keep the order, spooled events go first */
+    _eventd_relay_server_replay(server);
+    if ( ( server->spool != NULL ) && ( eventd_relay_spool_get_length(server->spool) > 0 ) )
+        goto spool;
+
+    if ( _eventd_relay_server_send(server, event) )
         return;
-    }
+
+spool:
+    if ( server->spool != NULL )
+        eventd_relay_spool_push(server->spool, event);
+}
+
+gboolean
+eventd_relay_server_get_spool_status(EventdRelayServer *server, gsize *length, guint64 *dropped)
+{
+    if ( server->spool == NULL )
+        return FALSE;
+
+    *length = eventd_relay_spool_get_length(server->spool);
+    *dropped = eventd_relay_spool_get_dropped(server->spool);
+    return TRUE;
 }
 
 void
@@ -328,6 +393,9 @@ eventd_relay_server_free(gpointer data)
 
     evhelpers_reconnect_free(server->reconnect);
 
+    eventd_relay_spool_free(server->spool);
+    eventd_metrics_connection_free(server->metrics);
+
     if ( server->forwards != NULL )
         g_hash_table_unref(server->forwards);
     g_strfreev(server->subscriptions);
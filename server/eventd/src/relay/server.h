@@ -25,9 +25,10 @@
 
 #include "../types.h"
 #include "eventd-sd-module.h"
+#include "spool.h"
 
-EventdRelayServer *eventd_relay_server_new(EventdCoreContext *core, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gchar **forwards, gchar **subscriptions, gboolean event_on_connection);
-EventdRelayServer *eventd_relay_server_new_for_uri(EventdCoreContext *core, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, const gchar *uri);
+EventdRelayServer *eventd_relay_server_new(EventdCoreContext *core, const gchar *name, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gboolean binary, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, EventdRelaySpool *spool);
+EventdRelayServer *eventd_relay_server_new_for_uri(EventdCoreContext *core, const gchar *name, guint ping_interval, const gchar *server_identity, gboolean accept_unknown_ca, gboolean binary, gchar **forwards, gchar **subscriptions, gboolean event_on_connection, EventdRelaySpool *spool, const gchar *uri);
 void eventd_relay_server_free(gpointer data);
 
 void eventd_relay_server_set_address(EventdRelayServer *server, GSocketConnectable *address);
@@ -41,5 +42,6 @@ void eventd_relay_server_stop(EventdRelayServer *server);
 void eventd_relay_server_set_certificate(EventdRelayServer *server, GTlsCertificate *certificate);
 
 void eventd_relay_server_event(EventdRelayServer *server, EventdEvent *event);
+gboolean eventd_relay_server_get_spool_status(EventdRelayServer *server, gsize *length, guint64 *dropped);
 
 #endif /* __EVENTD_PLUGINS_RELAY_SERVER_H__ */
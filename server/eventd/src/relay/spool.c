@@ -0,0 +1,539 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "libeventd-event.h"
+
+#include "spool.h"
+
+/*
+ * Segment records are a little-endian 32-bit size
+ * followed by a little-endian serialized GVariant of this type
+ */
+#define EVENTD_RELAY_SPOOL_RECORD_TYPE "(xsssa{sv})"
+#define EVENTD_RELAY_SPOOL_RECORD_HEADER_SIZE sizeof(guint32)
+
+/*
+ * Records are buffered and written by an I/O thread,
+ * at most after this delay or when this much is pending
+ */
+#define EVENTD_RELAY_SPOOL_FLUSH_INTERVAL 1000
+#define EVENTD_RELAY_SPOOL_FLUSH_SIZE (64 * 1024)
+
+typedef struct {
+    gint64 time;
+    EventdEvent *event;
+} EventdRelaySpoolEntry;
+
+struct _EventdRelaySpool {
+    gsize size;
+    gint64 max_age;
+    EventdRelaySpoolDropPolicy drop_policy;
+    EventdRelaySpoolEntry *ring;
+    gsize head;
+    gsize length;
+    guint64 dropped;
+    struct {
+        GFile *file;
+        gsize records;
+        gboolean rewrite;
+        guint flush_timeout;
+        GThreadPool *pool;
+        /* Owned by the I/O thread */
+        GOutputStream *stream;
+        /* The I/O thread takes these under the lock */
+        GMutex lock;
+        gboolean queued;
+        GByteArray *pending;
+        GBytes *contents;
+    } segment;
+};
+
+static EventdRelaySpoolEntry *
+_eventd_relay_spool_entry(EventdRelaySpool *self, gsize i)
+{
+    return &self->ring[( self->head + i ) % self->size];
+}
+
+static void
+_eventd_relay_spool_drop_head(EventdRelaySpool *self)
+{
+    EventdRelaySpoolEntry *entry = _eventd_relay_spool_entry(self, 0);
+
+    eventd_event_unref(entry->event);
+    entry->event = NULL;
+
+    self->head = ( self->head + 1 ) % self->size;
+    --self->length;
+}
+
+static void
+_eventd_relay_spool_prune(EventdRelaySpool *self)
+{
+    if ( self->max_age < 1 )
+        return;
+
+    gint64 limit = g_get_real_time() - self->max_age;
+    while ( ( self->length > 0 ) && ( _eventd_relay_spool_entry(self, 0)->time < limit ) )
+    {
+        _eventd_relay_spool_drop_head(self);
+        ++self->dropped;
+    }
+}
+
+static gboolean
+_eventd_relay_spool_ring_push(EventdRelaySpool *self, gint64 time, EventdEvent *event)
+{
+    if ( self->length == self->size )
+    {
+        ++self->dropped;
+        if ( self->drop_policy == EVENTD_RELAY_SPOOL_DROP_NEWEST )
+            return FALSE;
+        _eventd_relay_spool_drop_head(self);
+    }
+
+    EventdRelaySpoolEntry *entry = _eventd_relay_spool_entry(self, self->length++);
+    entry->time = time;
+    entry->event = eventd_event_ref(event);
+
+    return TRUE;
+}
+
+
+/*
+ * Segment file
+ */
+
+static void
+_eventd_relay_spool_record_serialize(GByteArray *buffer, EventdRelaySpoolEntry *entry)
+{
+    GVariantBuilder data_builder;
+    GHashTable *data;
+    GVariant *record;
+    guint32 size;
+    gsize offset;
+
+    g_variant_builder_init(&data_builder, G_VARIANT_TYPE_VARDICT);
+    data = eventd_event_get_all_data(entry->event);
+    if ( data != NULL )
+    {
+        GHashTableIter iter;
+        const gchar *name;
+        GVariant *value;
+        g_hash_table_iter_init(&iter, data);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &name, (gpointer *) &value) )
+            g_variant_builder_add(&data_builder, "{sv}", name, value);
+        g_hash_table_unref(data);
+    }
+
+    record = g_variant_ref_sink(g_variant_new(EVENTD_RELAY_SPOOL_RECORD_TYPE, entry->time, eventd_event_get_uuid(entry->event), eventd_event_get_category(entry->event), eventd_event_get_name(entry->event), &data_builder));
+    if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+    {
+        GVariant *swapped = g_variant_byteswap(record);
+        g_variant_unref(record);
+        record = swapped;
+    }
+
+    size = g_variant_get_size(record);
+    offset = buffer->len;
+    g_byte_array_set_size(buffer, offset + EVENTD_RELAY_SPOOL_RECORD_HEADER_SIZE + size);
+    size = GUINT32_TO_LE(size);
+    memcpy(buffer->data + offset, &size, sizeof(guint32));
+    g_variant_store(record, buffer->data + offset + EVENTD_RELAY_SPOOL_RECORD_HEADER_SIZE);
+    g_variant_unref(record);
+}
+
+static GBytes *
+_eventd_relay_spool_segment_serialize_ring(EventdRelaySpool *self)
+{
+    GByteArray *buffer;
+    gsize i;
+
+    buffer = g_byte_array_new();
+    for ( i = 0 ; i < self->length ; ++i )
+        _eventd_relay_spool_record_serialize(buffer, _eventd_relay_spool_entry(self, i));
+    self->segment.records = self->length;
+
+    return g_byte_array_free_to_bytes(buffer);
+}
+
+/*
+ * The I/O thread runs one job at a time, so the file sees our writes in order
+ */
+static void
+_eventd_relay_spool_segment_close(EventdRelaySpool *self)
+{
+    if ( self->segment.stream == NULL )
+        return;
+
+    g_output_stream_close(self->segment.stream, NULL, NULL);
+    g_object_unref(self->segment.stream);
+    self->segment.stream = NULL;
+}
+
+static void
+_eventd_relay_spool_segment_replace(EventdRelaySpool *self, GBytes *contents)
+{
+    GError *error = NULL;
+    gconstpointer data;
+    gsize size;
+
+    _eventd_relay_spool_segment_close(self);
+
+    data = g_bytes_get_data(contents, &size);
+    if ( size == 0 )
+    {
+        if ( ( ! g_file_delete(self->segment.file, NULL, &error) ) && ( ! g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ) )
+            g_warning("Couldn't truncate spool file: %s", error->message);
+    }
+    else if ( ! g_file_replace_contents(self->segment.file, data, size, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, NULL, &error) )
+        g_warning("Couldn't rewrite spool file: %s", error->message);
+    g_clear_error(&error);
+}
+
+static void
+_eventd_relay_spool_segment_write_records(EventdRelaySpool *self, GByteArray *records)
+{
+    GError *error = NULL;
+
+    /* If we cannot open it, we will retry with the next records */
+    if ( self->segment.stream == NULL )
+        self->segment.stream = G_OUTPUT_STREAM(g_file_append_to(self->segment.file, G_FILE_CREATE_PRIVATE, NULL, &error));
+    if ( ( self->segment.stream == NULL ) || ( ! g_output_stream_write_all(self->segment.stream, records->data, records->len, NULL, NULL, &error) ) )
+        g_warning("Couldn't write to spool file: %s", error->message);
+    g_clear_error(&error);
+}
+
+static void
+_eventd_relay_spool_segment_write(gpointer data, gpointer user_data)
+{
+    EventdRelaySpool *self = data;
+    GBytes *contents;
+    GByteArray *records;
+
+    for (;;)
+    {
+        g_mutex_lock(&self->segment.lock);
+        contents = self->segment.contents;
+        self->segment.contents = NULL;
+        records = NULL;
+        if ( self->segment.pending->len > 0 )
+        {
+            records = self->segment.pending;
+            self->segment.pending = g_byte_array_new();
+        }
+        self->segment.queued = ( contents != NULL ) || ( records != NULL );
+        g_mutex_unlock(&self->segment.lock);
+
+        if ( ! self->segment.queued )
+            return;
+
+        /* Records queued after a rewrite go after it */
+        if ( contents != NULL )
+        {
+            _eventd_relay_spool_segment_replace(self, contents);
+            g_bytes_unref(contents);
+        }
+        if ( records != NULL )
+        {
+            _eventd_relay_spool_segment_write_records(self, records);
+            g_byte_array_unref(records);
+        }
+    }
+}
+
+static void
+_eventd_relay_spool_segment_flush(EventdRelaySpool *self)
+{
+    if ( self->segment.flush_timeout > 0 )
+        g_source_remove(self->segment.flush_timeout);
+    self->segment.flush_timeout = 0;
+
+    g_mutex_lock(&self->segment.lock);
+    if ( self->segment.rewrite )
+    {
+        /* The rewrite supersedes whatever was not written yet */
+        self->segment.rewrite = FALSE;
+        g_byte_array_set_size(self->segment.pending, 0);
+        if ( self->segment.contents != NULL )
+            g_bytes_unref(self->segment.contents);
+        self->segment.contents = _eventd_relay_spool_segment_serialize_ring(self);
+    }
+
+    if ( ( ! self->segment.queued ) && ( ( self->segment.contents != NULL ) || ( self->segment.pending->len > 0 ) ) )
+    {
+        self->segment.queued = TRUE;
+        g_thread_pool_push(self->segment.pool, self, NULL);
+    }
+    g_mutex_unlock(&self->segment.lock);
+}
+
+static gboolean
+_eventd_relay_spool_segment_flush_timeout(gpointer user_data)
+{
+    EventdRelaySpool *self = user_data;
+
+    self->segment.flush_timeout = 0;
+    _eventd_relay_spool_segment_flush(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_relay_spool_segment_schedule(EventdRelaySpool *self, gsize pending)
+{
+    if ( pending >= EVENTD_RELAY_SPOOL_FLUSH_SIZE )
+        _eventd_relay_spool_segment_flush(self);
+    else if ( self->segment.flush_timeout == 0 )
+        self->segment.flush_timeout = g_timeout_add(EVENTD_RELAY_SPOOL_FLUSH_INTERVAL, _eventd_relay_spool_segment_flush_timeout, self);
+}
+
+static void
+_eventd_relay_spool_segment_append(EventdRelaySpool *self, EventdRelaySpoolEntry *entry)
+{
+    if ( self->segment.file == NULL )
+        return;
+
+    ++self->segment.records;
+    /* A pending rewrite will pick the entry from the ring */
+    if ( self->segment.rewrite )
+        return;
+
+    gsize pending;
+
+    g_mutex_lock(&self->segment.lock);
+    _eventd_relay_spool_record_serialize(self->segment.pending, entry);
+    pending = self->segment.pending->len;
+    g_mutex_unlock(&self->segment.lock);
+
+    _eventd_relay_spool_segment_schedule(self, pending);
+}
+
+static void
+_eventd_relay_spool_segment_rewrite(EventdRelaySpool *self)
+{
+    if ( self->segment.file == NULL )
+        return;
+
+    self->segment.rewrite = TRUE;
+    self->segment.records = self->length;
+    _eventd_relay_spool_segment_schedule(self, 0);
+}
+
+/*
+ * We queue what is left and wait for the I/O thread to write it all
+ */
+static void
+_eventd_relay_spool_segment_finish(EventdRelaySpool *self)
+{
+    _eventd_relay_spool_segment_flush(self);
+    g_thread_pool_free(self->segment.pool, FALSE, TRUE);
+
+    _eventd_relay_spool_segment_close(self);
+    if ( self->segment.contents != NULL )
+        g_bytes_unref(self->segment.contents);
+    g_byte_array_unref(self->segment.pending);
+    g_mutex_clear(&self->segment.lock);
+    g_object_unref(self->segment.file);
+}
+
+static void
+_eventd_relay_spool_segment_load(EventdRelaySpool *self, const gchar *path)
+{
+    GError *error = NULL;
+    GMappedFile *file;
+
+    file = g_mapped_file_new(path, FALSE, &error);
+    if ( file == NULL )
+    {
+        if ( ! g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT) )
+            g_warning("Couldn't load spool file: %s", error->message);
+        g_clear_error(&error);
+        return;
+    }
+
+    GBytes *bytes;
+    const gchar *data;
+    gsize length, offset = 0;
+
+    bytes = g_mapped_file_get_bytes(file);
+    data = g_bytes_get_data(bytes, &length);
+    while ( ( length - offset ) >= EVENTD_RELAY_SPOOL_RECORD_HEADER_SIZE )
+    {
+        guint32 size;
+        memcpy(&size, data + offset, sizeof(guint32));
+        size = GUINT32_FROM_LE(size);
+        offset += EVENTD_RELAY_SPOOL_RECORD_HEADER_SIZE;
+        if ( ( length - offset ) < size )
+            /* Truncated record, the last write did not complete */
+            break;
+
+        GBytes *record_bytes;
+        GVariant *record;
+
+        record_bytes = g_bytes_new_from_bytes(bytes, offset, size);
+        record = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(EVENTD_RELAY_SPOOL_RECORD_TYPE), record_bytes, FALSE));
+        g_bytes_unref(record_bytes);
+        offset += size;
+
+        if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+        {
+            GVariant *swapped = g_variant_byteswap(record);
+            g_variant_unref(record);
+            record = swapped;
+        }
+
+        gint64 time;
+        const gchar *uuid, *category, *name;
+        GVariantIter *event_data;
+        EventdEvent *event;
+
+        g_variant_get(record, "(x&s&s&sa{sv})", &time, &uuid, &category, &name, &event_data);
+        event = eventd_event_new_for_uuid_string(uuid, category, name);
+        if ( event != NULL )
+        {
+            gchar *data_name;
+            GVariant *value;
+            while ( g_variant_iter_next(event_data, "{sv}", &data_name, &value) )
+            {
+                eventd_event_add_data(event, data_name, value);
+                g_variant_unref(value);
+            }
+
+            _eventd_relay_spool_ring_push(self, time, event);
+            eventd_event_unref(event);
+        }
+        g_variant_iter_free(event_data);
+        g_variant_unref(record);
+    }
+
+    g_bytes_unref(bytes);
+    g_mapped_file_unref(file);
+
+    _eventd_relay_spool_prune(self);
+    eventd_debug("Loaded %" G_GSIZE_FORMAT " spooled events", self->length);
+}
+
+
+/*
+ * Public interface
+ */
+
+EventdRelaySpool *
+eventd_relay_spool_new(gsize size, gint64 max_age, EventdRelaySpoolDropPolicy drop_policy, const gchar *path)
+{
+    g_return_val_if_fail(size > 0, NULL);
+
+    EventdRelaySpool *self;
+
+    self = g_new0(EventdRelaySpool, 1);
+    self->size = size;
+    self->max_age = max_age;
+    self->drop_policy = drop_policy;
+    self->ring = g_new0(EventdRelaySpoolEntry, size);
+
+    if ( path != NULL )
+    {
+        self->segment.file = g_file_new_for_path(path);
+        self->segment.pool = g_thread_pool_new(_eventd_relay_spool_segment_write, NULL, 1, FALSE, NULL);
+        g_mutex_init(&self->segment.lock);
+        self->segment.pending = g_byte_array_new();
+        _eventd_relay_spool_segment_load(self, path);
+        /* Drops what we did not load and truncated records */
+        _eventd_relay_spool_segment_rewrite(self);
+    }
+
+    return self;
+}
+
+void
+eventd_relay_spool_free(EventdRelaySpool *self)
+{
+    if ( self == NULL )
+        return;
+
+    if ( self->segment.file != NULL )
+        _eventd_relay_spool_segment_finish(self);
+
+    while ( self->length > 0 )
+        _eventd_relay_spool_drop_head(self);
+
+    g_free(self->ring);
+
+    g_free(self);
+}
+
+void
+eventd_relay_spool_push(EventdRelaySpool *self, EventdEvent *event)
+{
+    _eventd_relay_spool_prune(self);
+
+    if ( ! _eventd_relay_spool_ring_push(self, g_get_real_time(), event) )
+        return;
+
+    /* Stale records are dropped when they are a full ring worth */
+    if ( self->segment.records >= ( self->length + self->size ) )
+        _eventd_relay_spool_segment_rewrite(self);
+    else
+        _eventd_relay_spool_segment_append(self, _eventd_relay_spool_entry(self, self->length - 1));
+}
+
+EventdEvent *
+eventd_relay_spool_peek(EventdRelaySpool *self)
+{
+    _eventd_relay_spool_prune(self);
+
+    if ( self->length == 0 )
+        return NULL;
+
+    return _eventd_relay_spool_entry(self, 0)->event;
+}
+
+void
+eventd_relay_spool_pop(EventdRelaySpool *self)
+{
+    g_return_if_fail(self->length > 0);
+
+    _eventd_relay_spool_drop_head(self);
+
+    if ( self->length == 0 )
+        _eventd_relay_spool_segment_rewrite(self);
+}
+
+gsize
+eventd_relay_spool_get_length(EventdRelaySpool *self)
+{
+    return self->length;
+}
+
+guint64
+eventd_relay_spool_get_dropped(EventdRelaySpool *self)
+{
+    return self->dropped;
+}
@@ -0,0 +1,43 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EVENTD_RELAY_SPOOL_H__
+#define __EVENTD_RELAY_SPOOL_H__
+
+typedef struct _EventdRelaySpool EventdRelaySpool;
+
+typedef enum {
+    EVENTD_RELAY_SPOOL_DROP_OLDEST,
+    EVENTD_RELAY_SPOOL_DROP_NEWEST,
+} EventdRelaySpoolDropPolicy;
+
+EventdRelaySpool *eventd_relay_spool_new(gsize size, gint64 max_age, EventdRelaySpoolDropPolicy drop_policy, const gchar *path);
+void eventd_relay_spool_free(EventdRelaySpool *spool);
+
+void eventd_relay_spool_push(EventdRelaySpool *spool, EventdEvent *event);
+EventdEvent *eventd_relay_spool_peek(EventdRelaySpool *spool);
+void eventd_relay_spool_pop(EventdRelaySpool *spool);
+
+gsize eventd_relay_spool_get_length(EventdRelaySpool *spool);
+guint64 eventd_relay_spool_get_dropped(EventdRelaySpool *spool);
+
+#endif /* __EVENTD_RELAY_SPOOL_H__ */
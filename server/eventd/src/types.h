@@ -33,6 +33,10 @@ typedef struct _EventdControl EventdControl;
 typedef struct _EventdControlDelayedStop EventdControlDelayedStop;
 typedef struct _EventdConfig EventdConfig;
 typedef struct _EventdEvents EventdEvents;
+typedef struct _EventdEventsFilter EventdEventsFilter;
+typedef struct _EventdFlags EventdFlags;
+typedef struct _EventdLimits EventdLimits;
+typedef struct _EventdLimitsRule EventdLimitsRule;
 typedef struct _EventdActions EventdActions;
 typedef struct _EventdSockets EventdSockets;
 
@@ -0,0 +1,180 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include <libeventd-event.h>
+
+#include "types.h"
+#include "events.h"
+
+#define QUERIES 200
+#define HOSTS 64
+
+typedef struct {
+    EventdEvents *events;
+    EventdEvent *queries[QUERIES];
+} EventdEventsBenchmarkFixture;
+
+static void
+_init_data(EventdEventsBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    guint size = GPOINTER_TO_UINT(user_data);
+    GString *config = g_string_new("[Event bench event]\nActions=fallback\n");
+    GKeyFile *key_file = g_key_file_new();
+    GRand *rand = g_rand_new_with_seed(size);
+    guint i;
+
+    for ( i = 0 ; i < size ; ++i )
+    {
+        g_string_append_printf(config, "[Event bench event rule-%u]\n", i);
+        if ( ( i % 4 ) == 0 )
+            g_string_append(config, "IfData=id\n");
+        g_string_append_printf(config, "IfDataMatches=id,==,uint64 %u\n", i);
+        if ( ( i % 16 ) == 0 )
+            g_string_append_printf(config, "IfDataRegex=host,^host-%u$\n", i % HOSTS);
+        g_string_append_printf(config, "Actions=rule-%u\n", i);
+    }
+
+    g_key_file_load_from_data(key_file, config->str, config->len, G_KEY_FILE_NONE, NULL);
+    g_string_free(config, TRUE);
+
+    fixture->events = eventd_events_new();
+    eventd_events_parse(fixture->events, key_file);
+    g_key_file_unref(key_file);
+
+    for ( i = 0 ; i < QUERIES ; ++i )
+    {
+        /* Half of the queries will not match any rule */
+        EventdEvent *event = eventd_event_new("bench", "event");
+        eventd_event_add_data(event, g_strdup("id"), g_variant_new_uint64(g_rand_int_range(rand, 0, 2 * size)));
+        eventd_event_add_data_string(event, g_strdup("host"), g_strdup_printf("host-%u", g_rand_int_range(rand, 0, HOSTS)));
+        fixture->queries[i] = event;
+    }
+
+    g_rand_free(rand);
+}
+
+static void
+_init_regex_data(EventdEventsBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    guint size = GPOINTER_TO_UINT(user_data);
+    GString *config = g_string_new("[Event bench event]\nActions=fallback\n");
+    GKeyFile *key_file = g_key_file_new();
+    GRand *rand = g_rand_new_with_seed(size);
+    guint i;
+
+    /* Many regexes on the same data, as with log-based rules */
+    for ( i = 0 ; i < size ; ++i )
+    {
+        g_string_append_printf(config, "[Event bench event rule-%u]\n", i);
+        g_string_append_printf(config, "IfDataRegex=message,^request %u failed: (timeout|refused)$\n", i);
+        g_string_append_printf(config, "Actions=rule-%u\n", i);
+    }
+
+    g_key_file_load_from_data(key_file, config->str, config->len, G_KEY_FILE_NONE, NULL);
+    g_string_free(config, TRUE);
+
+    fixture->events = eventd_events_new();
+    eventd_events_parse(fixture->events, key_file);
+    g_key_file_unref(key_file);
+
+    for ( i = 0 ; i < QUERIES ; ++i )
+    {
+        /* Half of the queries will not match any rule */
+        EventdEvent *event = eventd_event_new("bench", "event");
+        eventd_event_add_data_string(event, g_strdup("message"), g_strdup_printf("request %u failed: %s", g_rand_int_range(rand, 0, 2 * size), g_rand_boolean(rand) ? "timeout" : "unknown"));
+        fixture->queries[i] = event;
+    }
+
+    g_rand_free(rand);
+}
+
+static void
+_clean_data(EventdEventsBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    guint i;
+
+    for ( i = 0 ; i < QUERIES ; ++i )
+        eventd_event_unref(fixture->queries[i]);
+
+    eventd_events_free(fixture->events);
+}
+
+typedef gboolean (*EventdEventsBenchmarkFunc)(EventdEvents *self, EventdEvent *event, const EventdFlags *flags, const GList **actions, EventdLimitsRule **limits);
+
+static gdouble
+_eventd_events_benchmark_run(EventdEventsBenchmarkFixture *fixture, EventdEventsBenchmarkFunc func, guint rounds, const GList **results)
+{
+    guint r, i;
+
+    g_test_timer_start();
+    for ( r = 0 ; r < rounds ; ++r )
+    {
+        for ( i = 0 ; i < QUERIES ; ++i )
+        {
+            results[i] = NULL;
+            func(fixture->events, fixture->queries[i], NULL, &results[i], NULL);
+        }
+    }
+    return g_test_timer_elapsed();
+}
+
+static void
+_eventd_events_benchmark_func(EventdEventsBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    guint size = GPOINTER_TO_UINT(user_data);
+    guint rounds = MAX(1, 100000 / size);
+    const GList *results[QUERIES], *linear_results[QUERIES];
+    gdouble compiled, linear;
+    guint i;
+
+    /* Compile the index before timing */
+    _eventd_events_benchmark_run(fixture, eventd_events_process_event, 1, results);
+
+    compiled = _eventd_events_benchmark_run(fixture, eventd_events_process_event, rounds, results);
+    linear = _eventd_events_benchmark_run(fixture, eventd_events_process_event_linear, rounds, linear_results);
+
+    for ( i = 0 ; i < QUERIES ; ++i )
+        g_assert_true(results[i] == linear_results[i]);
+
+    g_test_message("%u rules: compiled %.3f µs/event, linear %.3f µs/event", size, compiled * 1e6 / ( rounds * QUERIES ), linear * 1e6 / ( rounds * QUERIES ));
+    g_test_minimized_result(compiled * 1e6 / ( rounds * QUERIES ), "%u rules, compiled: %.3f µs/event", size, compiled * 1e6 / ( rounds * QUERIES ));
+}
+
+int
+main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "C");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/eventd/events/benchmark/10", EventdEventsBenchmarkFixture, GUINT_TO_POINTER(10), _init_data, _eventd_events_benchmark_func, _clean_data);
+    g_test_add("/eventd/events/benchmark/1000", EventdEventsBenchmarkFixture, GUINT_TO_POINTER(1000), _init_data, _eventd_events_benchmark_func, _clean_data);
+    g_test_add("/eventd/events/benchmark/100000", EventdEventsBenchmarkFixture, GUINT_TO_POINTER(100000), _init_data, _eventd_events_benchmark_func, _clean_data);
+    g_test_add("/eventd/events/benchmark/regex/10", EventdEventsBenchmarkFixture, GUINT_TO_POINTER(10), _init_regex_data, _eventd_events_benchmark_func, _clean_data);
+    g_test_add("/eventd/events/benchmark/regex/500", EventdEventsBenchmarkFixture, GUINT_TO_POINTER(500), _init_regex_data, _eventd_events_benchmark_func, _clean_data);
+
+    return g_test_run();
+}
@@ -0,0 +1,234 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "libeventd-event.h"
+#include "libeventc.h"
+#include "libeventd-test.h"
+
+#define EVENTS 20000
+#define TIMEOUT 60
+
+typedef struct {
+    GMainLoop *loop;
+    EventcConnection *sender;
+    EventcConnection *receiver;
+    gboolean ready;
+    guint sent;
+    guint received;
+    GError *error;
+} EventdPipelineBenchmark;
+
+static gboolean
+_eventd_pipeline_benchmark_send_one(EventdPipelineBenchmark *self, const gchar *name, guint64 id)
+{
+    EventdEvent *event;
+    gboolean r;
+
+    event = eventd_event_new("test", name);
+    eventd_event_add_data(event, g_strdup("id"), g_variant_new_uint64(id));
+    eventd_event_add_data_string(event, g_strdup("message"), g_strdup("Some text to display\nover two lines"));
+    r = eventc_connection_send_event(self->sender, event, &self->error);
+    eventd_event_unref(event);
+
+    return r;
+}
+
+static void
+_eventd_pipeline_benchmark_received(EventcConnection *connection, EventdEvent *event, gpointer user_data)
+{
+    EventdPipelineBenchmark *self = user_data;
+    const gchar *name = eventd_event_get_name(event);
+
+    if ( g_strcmp0(name, "ready") == 0 )
+    {
+        if ( ! self->ready )
+            g_main_loop_quit(self->loop);
+        self->ready = TRUE;
+    }
+    else if ( ( g_strcmp0(name, "bench") == 0 ) && ( ++self->received == EVENTS ) )
+        g_main_loop_quit(self->loop);
+}
+
+static gboolean
+_eventd_pipeline_benchmark_ready(gpointer user_data)
+{
+    EventdPipelineBenchmark *self = user_data;
+
+    /*
+     * Subscriptions and relay connections are set up asynchronously,
+     * so we keep poking until the whole path is up
+     */
+    if ( self->ready )
+        return G_SOURCE_REMOVE;
+
+    if ( _eventd_pipeline_benchmark_send_one(self, "ready", 0) )
+        return G_SOURCE_CONTINUE;
+
+    g_main_loop_quit(self->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_eventd_pipeline_benchmark_send(gpointer user_data)
+{
+    EventdPipelineBenchmark *self = user_data;
+
+    while ( self->sent < EVENTS )
+    {
+        if ( _eventd_pipeline_benchmark_send_one(self, "bench", self->sent) )
+            ++self->sent;
+        else if ( g_error_matches(self->error, EVENTC_ERROR, EVENTC_ERROR_BUSY) )
+        {
+            /* Let the output queue drain */
+            g_clear_error(&self->error);
+            return G_SOURCE_CONTINUE;
+        }
+        else
+        {
+            g_main_loop_quit(self->loop);
+            break;
+        }
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_eventd_pipeline_benchmark_timeout(gpointer user_data)
+{
+    EventdPipelineBenchmark *self = user_data;
+
+    g_main_loop_quit(self->loop);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_pipeline_benchmark_run(const gchar *mode, const gchar *sender_uri, const gchar *receiver_uri)
+{
+    EventdPipelineBenchmark self = { .loop = NULL };
+    gdouble elapsed;
+    guint ready, timeout;
+
+    self.loop = g_main_loop_new(NULL, FALSE);
+
+    self.sender = eventc_connection_new(sender_uri, &self.error);
+    g_assert_no_error(self.error);
+    self.receiver = eventc_connection_new(receiver_uri, &self.error);
+    g_assert_no_error(self.error);
+
+    eventc_connection_set_subscribe(self.receiver, TRUE);
+    eventc_connection_add_subscription(self.receiver, g_strdup("test"));
+    g_signal_connect(self.receiver, "received-event", G_CALLBACK(_eventd_pipeline_benchmark_received), &self);
+
+    g_assert_true(eventc_connection_connect_sync(self.receiver, &self.error));
+    g_assert_true(eventc_connection_connect_sync(self.sender, &self.error));
+
+    timeout = g_timeout_add_seconds(TIMEOUT, _eventd_pipeline_benchmark_timeout, &self);
+
+    ready = g_timeout_add(50, _eventd_pipeline_benchmark_ready, &self);
+    g_main_loop_run(self.loop);
+    g_assert_no_error(self.error);
+    g_assert_true(self.ready);
+    g_source_remove(ready);
+
+    g_test_timer_start();
+    g_idle_add(_eventd_pipeline_benchmark_send, &self);
+    g_main_loop_run(self.loop);
+    elapsed = g_test_timer_elapsed();
+
+    g_source_remove(timeout);
+    g_assert_no_error(self.error);
+    g_assert_cmpuint(self.sent, ==, EVENTS);
+    g_assert_cmpuint(self.received, ==, EVENTS);
+
+    g_test_message("%s: %u events in %.3f s, %.0f events/s, %.3f µs/event", mode, EVENTS, elapsed, EVENTS / elapsed, elapsed * 1e6 / EVENTS);
+    g_test_maximized_result(EVENTS / elapsed, "%s: %.0f events/s", mode, EVENTS / elapsed);
+
+    eventc_connection_close(self.sender, NULL);
+    eventc_connection_close(self.receiver, NULL);
+    g_object_unref(self.sender);
+    g_object_unref(self.receiver);
+    g_main_loop_unref(self.loop);
+}
+
+static void
+_eventd_pipeline_benchmark_evp_func(void)
+{
+    EventdTestsEnv *env;
+    gchar *uri;
+
+    env = eventd_tests_env_new(NULL, NULL, FALSE);
+    g_assert_true(eventd_tests_env_start_eventd(env));
+
+    uri = g_strdup_printf("file://%s" G_DIR_SEPARATOR_S PACKAGE_NAME G_DIR_SEPARATOR_S EVP_UNIX_SOCKET, g_get_user_runtime_dir());
+    _eventd_pipeline_benchmark_run("evp", uri, uri);
+    g_free(uri);
+
+    g_assert_true(eventd_tests_env_stop_eventd(env));
+    eventd_tests_env_free(env, 0);
+}
+
+static void
+_eventd_pipeline_benchmark_relay_func(void)
+{
+    EventdTestsEnv *env, *relay;
+    gchar *sender_uri, *receiver_uri;
+
+    /* Events go through the relay instance to the one running the test plugin */
+    env = eventd_tests_env_new("tcp-file:relay", NULL, FALSE);
+    relay = eventd_tests_env_new(NULL, "", TRUE);
+    g_assert_true(eventd_tests_env_start_eventd(env));
+    g_assert_true(eventd_tests_env_start_eventd(relay));
+
+    sender_uri = g_strdup_printf("file://%s" G_DIR_SEPARATOR_S PACKAGE_NAME G_DIR_SEPARATOR_S EVP_UNIX_SOCKET, g_get_user_runtime_dir());
+    receiver_uri = g_strdup_printf("file://%s" G_DIR_SEPARATOR_S "relay", g_get_user_runtime_dir());
+    _eventd_pipeline_benchmark_run("relay", sender_uri, receiver_uri);
+    g_free(receiver_uri);
+    g_free(sender_uri);
+
+    g_assert_true(eventd_tests_env_stop_eventd(relay));
+    g_assert_true(eventd_tests_env_stop_eventd(env));
+    eventd_tests_env_free(relay, 0);
+    eventd_tests_env_free(env, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "C");
+
+    eventd_tests_env_setup(argv, "pipeline");
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/eventd/pipeline/benchmark/evp", _eventd_pipeline_benchmark_evp_func);
+    g_test_add_func("/eventd/pipeline/benchmark/relay", _eventd_pipeline_benchmark_relay_func);
+
+    return g_test_run();
+}
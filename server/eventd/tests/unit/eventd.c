@@ -25,6 +25,10 @@
 #include <glib.h>
 
 void eventd_tests_add_events_suite(void);
+void eventd_tests_add_relay_spool_suite(void);
+void eventd_tests_add_metrics_suite(void);
+void eventd_tests_add_flags_suite(void);
+void eventd_tests_add_limits_suite(void);
 
 int
 main(int argc, char *argv[])
@@ -39,6 +43,10 @@ main(int argc, char *argv[])
     g_test_set_nonfatal_assertions();
 
     eventd_tests_add_events_suite();
+    eventd_tests_add_relay_spool_suite();
+    eventd_tests_add_metrics_suite();
+    eventd_tests_add_flags_suite();
+    eventd_tests_add_limits_suite();
 
     return g_test_run();
 }
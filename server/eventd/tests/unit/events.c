@@ -20,14 +20,18 @@
  *
  */
 
+#include <string.h>
+
 #include <glib.h>
 
 #include <libeventd-event.h>
 
 #include "types.h"
 #include "events.h"
+#include "flags.h"
 
 #define MAX_DATA 10
+#define MAX_FLAGS 3
 
 typedef struct {
     EventdEvents *events;
@@ -47,6 +51,7 @@ typedef struct {
 typedef struct {
     const gchar *config;
     EventdEventsTestEvent event;
+    const gchar *flags[MAX_FLAGS + 1];
     const gchar *result;
 } EventdEventsTestData;
 
@@ -81,6 +86,44 @@ _eventd_events_tests_config = ""
 "\nIfData=some-other-data"
 "\nIfDataRegex=some-other-data,^2000$"
 "\nActions=if data regex int action"
+
+"\n[Event test regex colour]"
+"\nIfDataRegex=colour,^colou?r: (red|blue)$"
+"\nActions=colour action"
+
+"\n[Event test regex error]"
+"\nIfDataRegex=message,^error \\\\d+: timeout$"
+"\nActions=error action"
+
+"\n[Event test regex disk]"
+"\nIfDataRegex=message,disk (full|failure)"
+"\nActions=disk action"
+
+"\n[Event test regex battery]"
+"\nIfDataRegex=message,battery.*low"
+"\nActions=battery action"
+
+"\n[Event test regex quantifier]"
+"\nIfDataRegex=message,^x{2}y$"
+"\nActions=quantifier action"
+
+"\n[Event test regex multibyte]"
+"\nIfDataRegex=message,^ab\xc3\xa9?c$"
+"\nActions=multibyte action"
+
+"\n[Event test flagged]"
+"\nActions=flagged action"
+
+"\n[Event test flagged only-if]"
+"\nOnlyIfFlags=tests-flag;"
+"\nActions=only if flags action"
+
+"\n[Event test blocked]"
+"\nActions=blocked action"
+
+"\n[Event test blocked not-if]"
+"\nNotIfFlags=tests-blocking-flag;"
+"\nActions=not if flags action"
 "";
 
 static const struct {
@@ -194,6 +237,20 @@ static const struct {
             .result = "if data matches int action"
         }
     },
+    {
+        .testpath = "/eventd/events/if-data-matches/no-match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "something",
+                .data = {
+                    { .name = "some-other-data", .content = "\"some-unknown-value\"" },
+                    { .name = NULL }
+                }
+            },
+            .result = "some action"
+        }
+    },
     {
         .testpath = "/eventd/events/if-data-matches/fallback",
         .data = {
@@ -248,6 +305,173 @@ static const struct {
             .result = "some action"
         }
     },
+    {
+        .testpath = "/eventd/events/regex/literal/optional",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "colour", .content = "'color: blue'" },
+                    { .name = NULL }
+                }
+            },
+            .result = "colour action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/literal/no-match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "colour", .content = "'colour: green'" },
+                    { .name = NULL }
+                }
+            },
+            .result = NULL
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/merged/first",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "message", .content = "'error 42: timeout'" },
+                    { .name = NULL }
+                }
+            },
+            .result = "error action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/merged/alternative",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "message", .content = "'the disk failure'" },
+                    { .name = NULL }
+                }
+            },
+            .result = "disk action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/merged/quantifier",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "message", .content = "'xxy'" },
+                    { .name = NULL }
+                }
+            },
+            .result = "quantifier action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/literal/multibyte",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "message", .content = "'abc'" },
+                    { .name = NULL }
+                }
+            },
+            .result = "multibyte action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/regex/merged/no-match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "regex",
+                .data = {
+                    { .name = "message", .content = "'all good'" },
+                    { .name = NULL }
+                }
+            },
+            .result = NULL
+        }
+    },
+    {
+        .testpath = "/eventd/events/flags/only-if/match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "flagged",
+                .data = {
+                    { .name = NULL }
+                }
+            },
+            .flags = {
+                "tests-flag",
+                "tests-other-flag",
+                NULL
+            },
+            .result = "only if flags action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/flags/only-if/no-match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "flagged",
+                .data = {
+                    { .name = NULL }
+                }
+            },
+            .flags = {
+                "tests-other-flag",
+                NULL
+            },
+            .result = "flagged action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/flags/not-if/match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "blocked",
+                .data = {
+                    { .name = NULL }
+                }
+            },
+            .flags = {
+                "tests-other-flag",
+                NULL
+            },
+            .result = "not if flags action"
+        }
+    },
+    {
+        .testpath = "/eventd/events/flags/not-if/no-match",
+        .data = {
+            .event = {
+                .category = "test",
+                .name = "blocked",
+                .data = {
+                    { .name = NULL }
+                }
+            },
+            .flags = {
+                "tests-blocking-flag",
+                NULL
+            },
+            .result = "blocked action"
+        }
+    },
 };
 
 static void
@@ -282,10 +506,19 @@ _eventd_events_tests_func(EventdEventsTestFixture *fixture, gconstpointer user_d
     for ( event_data = data->event.data ; event_data->name != NULL ; ++event_data )
         eventd_event_add_data(event, g_strdup(event_data->name), g_variant_parse(NULL, event_data->content, NULL, NULL, NULL));
 
-    const GList *result = NULL;
+    EventdFlags flags = { 0 };
+    const gchar * const *flag;
+    for ( flag = data->flags ; *flag != NULL ; ++flag )
+        eventd_flags_add(&flags, eventd_flags_get_index(g_quark_from_string(*flag)));
+
+    const GList *result = NULL, *linear_result = NULL;
     GList fake_result = { .data = NULL };
-    eventd_events_process_event(fixture->events, event, NULL, &result);
+    eventd_events_process_event(fixture->events, event, &flags, &result, NULL);
+    eventd_events_process_event_linear(fixture->events, event, &flags, &linear_result, NULL);
     eventd_event_unref(event);
+    eventd_flags_clear(&flags);
+
+    g_assert_true(result == linear_result);
 
     if ( data->result == NULL )
         g_assert_null(result);
@@ -298,10 +531,83 @@ _eventd_events_tests_func(EventdEventsTestFixture *fixture, gconstpointer user_d
     }
 }
 
+static void
+_eventd_events_tests_filter_match(void)
+{
+    const gchar * const if_data_matches[] = { "some-data,>=,int64 1000", NULL };
+    EventdEventsFilter *filter;
+    EventdEvent *event;
+    GError *error = NULL;
+
+    filter = eventd_events_filter_new(NULL, (gchar **) if_data_matches, NULL, &error);
+    g_assert_no_error(error);
+    g_assert_nonnull(filter);
+
+    event = eventd_event_new("test", "filter");
+    eventd_event_add_data(event, g_strdup("some-data"), g_variant_new_int64(2000));
+    g_assert_true(eventd_events_filter_matches(filter, event));
+    eventd_event_add_data(event, g_strdup("some-data"), g_variant_new_int64(10));
+    g_assert_false(eventd_events_filter_matches(filter, event));
+    eventd_event_unref(event);
+
+    eventd_events_filter_free(filter);
+}
+
+static void
+_eventd_events_tests_filter_malformed_match(void)
+{
+    const gchar * const if_data_matches[] = { "some-data,>=,int64 1000", "some-data,~~,1", NULL };
+    GError *error = NULL;
+
+    g_assert_null(eventd_events_filter_new(NULL, (gchar **) if_data_matches, NULL, &error));
+    g_assert_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED);
+    g_clear_error(&error);
+}
+
+static void
+_eventd_events_tests_filter_malformed_regex(void)
+{
+    const gchar * const if_data_regexes[] = { "some-data,(", NULL };
+    GError *error = NULL;
+
+    g_assert_null(eventd_events_filter_new(NULL, NULL, (gchar **) if_data_regexes, &error));
+    g_assert_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_MALFORMED);
+    g_clear_error(&error);
+}
+
+static void
+_eventd_events_tests_filter_regex_limits(void)
+{
+    const gchar *if_data_regexes[10] = { NULL };
+    GError *error = NULL;
+    gchar *long_regex;
+    gsize i;
+
+    for ( i = 0 ; i < 9 ; ++i )
+        if_data_regexes[i] = "some-data,a";
+    g_assert_null(eventd_events_filter_new(NULL, NULL, (gchar **) if_data_regexes, &error));
+    g_assert_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_LIMIT);
+    g_clear_error(&error);
+
+    long_regex = g_strnfill(300, 'a');
+    memcpy(long_regex, "some-data,", strlen("some-data,"));
+    if_data_regexes[0] = long_regex;
+    if_data_regexes[1] = NULL;
+    g_assert_null(eventd_events_filter_new(NULL, NULL, (gchar **) if_data_regexes, &error));
+    g_assert_error(error, EVENTD_EVENTS_ERROR, EVENTD_EVENTS_ERROR_LIMIT);
+    g_clear_error(&error);
+    g_free(long_regex);
+}
+
 void
 eventd_tests_add_events_suite()
 {
     gsize i;
     for ( i = 0 ; i < G_N_ELEMENTS(_eventd_events_tests_list) ; ++i )
         g_test_add(_eventd_events_tests_list[i].testpath, EventdEventsTestFixture, &_eventd_events_tests_list[i].data, _init_data, _eventd_events_tests_func, _clean_data);
+
+    g_test_add_func("/eventd/events/filter/match", _eventd_events_tests_filter_match);
+    g_test_add_func("/eventd/events/filter/malformed-match", _eventd_events_tests_filter_malformed_match);
+    g_test_add_func("/eventd/events/filter/malformed-regex", _eventd_events_tests_filter_malformed_regex);
+    g_test_add_func("/eventd/events/filter/regex-limits", _eventd_events_tests_filter_regex_limits);
 }
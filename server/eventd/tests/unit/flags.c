@@ -0,0 +1,143 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+
+#include <libeventd-event.h>
+
+#include "types.h"
+#include "flags.h"
+
+static void
+_eventd_flags_tests_index(void)
+{
+    GQuark flag = g_quark_from_static_string("eventd-tests-flag");
+    guint index;
+
+    index = eventd_flags_get_index(flag);
+    g_assert_cmpuint(eventd_flags_get_index(flag), ==, index);
+    g_assert_cmpuint(eventd_flags_get_quark(index), ==, flag);
+    g_assert_cmpuint(eventd_flags_get_index(g_quark_from_static_string("eventd-tests-other-flag")), !=, index);
+}
+
+static void
+_eventd_flags_tests_set(void)
+{
+    EventdFlags flags = { 0 };
+
+    g_assert_true(eventd_flags_is_empty(&flags));
+    g_assert_false(eventd_flags_test(&flags, 3));
+
+    /* Far enough to need a second word */
+    eventd_flags_add(&flags, 3);
+    eventd_flags_add(&flags, 70);
+    g_assert_true(eventd_flags_test(&flags, 3));
+    g_assert_true(eventd_flags_test(&flags, 70));
+    g_assert_false(eventd_flags_test(&flags, 6));
+    g_assert_false(eventd_flags_test(&flags, 200));
+
+    eventd_flags_remove(&flags, 3);
+    eventd_flags_remove(&flags, 200);
+    g_assert_false(eventd_flags_test(&flags, 3));
+    g_assert_false(eventd_flags_is_empty(&flags));
+
+    eventd_flags_remove(&flags, 70);
+    g_assert_true(eventd_flags_is_empty(&flags));
+
+    eventd_flags_clear(&flags);
+}
+
+static void
+_eventd_flags_tests_update(void)
+{
+    EventdFlags flags = { 0 }, add = { 0 }, remove = { 0 };
+
+    eventd_flags_add(&flags, 1);
+    eventd_flags_add(&flags, 2);
+    eventd_flags_add(&add, 3);
+    eventd_flags_add(&add, 65);
+    eventd_flags_add(&remove, 1);
+
+    eventd_flags_update(&flags, &add, &remove);
+    g_assert_false(eventd_flags_test(&flags, 1));
+    g_assert_true(eventd_flags_test(&flags, 2));
+    g_assert_true(eventd_flags_test(&flags, 3));
+    g_assert_true(eventd_flags_test(&flags, 65));
+
+    eventd_flags_clear(&remove);
+    eventd_flags_clear(&add);
+    eventd_flags_clear(&flags);
+}
+
+static void
+_eventd_flags_tests_check(void)
+{
+    EventdFlags flags = { 0 }, whitelist = { 0 }, blacklist = { 0 };
+
+    /* No conditions */
+    g_assert_true(eventd_flags_check(&flags, &whitelist, &blacklist));
+
+    eventd_flags_add(&whitelist, 1);
+    eventd_flags_add(&whitelist, 66);
+    eventd_flags_add(&blacklist, 2);
+
+    g_assert_false(eventd_flags_check(&flags, &whitelist, &blacklist));
+    eventd_flags_add(&flags, 1);
+    g_assert_false(eventd_flags_check(&flags, &whitelist, &blacklist));
+    eventd_flags_add(&flags, 66);
+    g_assert_true(eventd_flags_check(&flags, &whitelist, &blacklist));
+    eventd_flags_add(&flags, 130);
+    g_assert_true(eventd_flags_check(&flags, &whitelist, &blacklist));
+    eventd_flags_add(&flags, 2);
+    g_assert_false(eventd_flags_check(&flags, &whitelist, &blacklist));
+
+    eventd_flags_clear(&blacklist);
+    eventd_flags_clear(&whitelist);
+    eventd_flags_clear(&flags);
+}
+
+static void
+_eventd_flags_tests_dump(void)
+{
+    EventdFlags flags = { 0 };
+    GString *dump;
+
+    eventd_flags_add(&flags, eventd_flags_get_index(g_quark_from_static_string("eventd-tests-dump-a")));
+    eventd_flags_add(&flags, eventd_flags_get_index(g_quark_from_static_string("eventd-tests-dump-b")));
+
+    dump = g_string_new(NULL);
+    eventd_flags_dump(&flags, dump, ", ");
+    g_assert_cmpstr(dump->str, ==, "eventd-tests-dump-a, eventd-tests-dump-b");
+    g_string_free(dump, TRUE);
+
+    eventd_flags_clear(&flags);
+}
+
+void
+eventd_tests_add_flags_suite(void)
+{
+    g_test_add_func("/eventd/flags/index", _eventd_flags_tests_index);
+    g_test_add_func("/eventd/flags/set", _eventd_flags_tests_set);
+    g_test_add_func("/eventd/flags/update", _eventd_flags_tests_update);
+    g_test_add_func("/eventd/flags/check", _eventd_flags_tests_check);
+    g_test_add_func("/eventd/flags/dump", _eventd_flags_tests_dump);
+}
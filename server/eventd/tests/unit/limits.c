@@ -0,0 +1,257 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+
+#include <libeventd-event.h>
+
+#include "types.h"
+#include "limits.h"
+
+#define WINDOW 20
+
+typedef struct {
+    GKeyFile *config_file;
+    EventdLimits *limits;
+    GPtrArray *triggered;
+} EventdLimitsTestFixture;
+
+static const gchar *_eventd_limits_tests_config =
+    "[First]\n"
+    "Coalesce=${key}\n"
+    "CoalesceWindow=20\n"
+    "[Last]\n"
+    "Coalesce=${key}\n"
+    "CoalesceWindow=20\n"
+    "CoalesceMode=last\n"
+    "[Count]\n"
+    "Coalesce=${key}\n"
+    "CoalesceWindow=20\n"
+    "CoalesceMode=count\n"
+    "CoalesceCountData=repeated\n"
+    "[RateLimit]\n"
+    "RateLimit=1\n"
+    "RateLimitBurst=2\n"
+    "[None]\n"
+    "Importance=1\n"
+    "";
+
+static void
+_eventd_limits_tests_trigger(const GList *actions, EventdEvent *event, gpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = user_data;
+
+    g_ptr_array_add(fixture->triggered, eventd_event_ref(event));
+}
+
+static void
+_init_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+
+    fixture->config_file = g_key_file_new();
+    g_key_file_load_from_data(fixture->config_file, _eventd_limits_tests_config, -1, G_KEY_FILE_NONE, NULL);
+    fixture->limits = eventd_limits_new(_eventd_limits_tests_trigger, fixture);
+    fixture->triggered = g_ptr_array_new_with_free_func((GDestroyNotify) eventd_event_unref);
+}
+
+static void
+_clean_data(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+
+    g_ptr_array_unref(fixture->triggered);
+    eventd_limits_free(fixture->limits);
+    g_key_file_free(fixture->config_file);
+}
+
+static void
+_eventd_limits_tests_push(EventdLimitsTestFixture *fixture, EventdLimitsRule *rule, const gchar *key, guint64 index)
+{
+    EventdEvent *event;
+
+    event = eventd_event_new("test", "limits");
+    eventd_event_add_data_string(event, g_strdup("key"), g_strdup(key));
+    eventd_event_add_data(event, g_strdup("index"), g_variant_new_uint64(index));
+    eventd_limits_process(fixture->limits, rule, NULL, event);
+    eventd_event_unref(event);
+}
+
+static gboolean
+_eventd_limits_tests_quit(gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+_eventd_limits_tests_wait(void)
+{
+    GMainLoop *loop;
+
+    loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add(WINDOW * 3, _eventd_limits_tests_quit, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+}
+
+static guint64
+_eventd_limits_tests_get_uint64(EventdLimitsTestFixture *fixture, guint i, const gchar *name)
+{
+    GVariant *data;
+
+    data = eventd_event_get_data(g_ptr_array_index(fixture->triggered, i), name);
+    g_assert_nonnull(data);
+    return g_variant_get_uint64(data);
+}
+
+static void
+_eventd_limits_tests_parse(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+    EventdLimitsRule *rule;
+    GString *dump;
+
+    g_assert_null(eventd_limits_rule_parse(fixture->config_file, "None"));
+
+    rule = eventd_limits_rule_parse(fixture->config_file, "Count");
+    g_assert_nonnull(rule);
+    dump = g_string_new(NULL);
+    eventd_limits_rule_dump(dump, rule);
+    g_assert_cmpstr(dump->str, ==, "\n    Coalescing: count over 20ms into repeated");
+    g_string_free(dump, TRUE);
+    eventd_limits_rule_free(rule);
+
+    /* No rule, no limits */
+    _eventd_limits_tests_push(fixture, NULL, "a", 0);
+    _eventd_limits_tests_push(fixture, NULL, "a", 1);
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+}
+
+static void
+_eventd_limits_tests_first(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+    EventdLimitsRule *rule;
+
+    rule = eventd_limits_rule_parse(fixture->config_file, "First");
+
+    _eventd_limits_tests_push(fixture, rule, "a", 0);
+    _eventd_limits_tests_push(fixture, rule, "a", 1);
+    _eventd_limits_tests_push(fixture, rule, "b", 2);
+    _eventd_limits_tests_push(fixture, rule, "a", 3);
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 0, "index"), ==, 0);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 1, "index"), ==, 2);
+
+    _eventd_limits_tests_wait();
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+
+    /* The window is over */
+    _eventd_limits_tests_push(fixture, rule, "a", 4);
+    g_assert_cmpuint(fixture->triggered->len, ==, 3);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 2, "index"), ==, 4);
+
+    eventd_limits_flush(fixture->limits);
+    g_assert_cmpuint(fixture->triggered->len, ==, 3);
+
+    eventd_limits_rule_free(rule);
+}
+
+static void
+_eventd_limits_tests_last(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+    EventdLimitsRule *rule;
+
+    rule = eventd_limits_rule_parse(fixture->config_file, "Last");
+
+    _eventd_limits_tests_push(fixture, rule, "a", 0);
+    _eventd_limits_tests_push(fixture, rule, "a", 1);
+    _eventd_limits_tests_push(fixture, rule, "a", 2);
+    g_assert_cmpuint(fixture->triggered->len, ==, 0);
+
+    _eventd_limits_tests_wait();
+    g_assert_cmpuint(fixture->triggered->len, ==, 1);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 0, "index"), ==, 2);
+
+    /* Flushing triggers pending events right away */
+    _eventd_limits_tests_push(fixture, rule, "a", 3);
+    eventd_limits_flush(fixture->limits);
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 1, "index"), ==, 3);
+
+    eventd_limits_rule_free(rule);
+}
+
+static void
+_eventd_limits_tests_count(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+    EventdLimitsRule *rule;
+
+    rule = eventd_limits_rule_parse(fixture->config_file, "Count");
+
+    _eventd_limits_tests_push(fixture, rule, "a", 0);
+    _eventd_limits_tests_push(fixture, rule, "b", 1);
+    _eventd_limits_tests_push(fixture, rule, "a", 2);
+    _eventd_limits_tests_push(fixture, rule, "a", 3);
+    g_assert_cmpuint(fixture->triggered->len, ==, 0);
+
+    _eventd_limits_tests_wait();
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+
+    guint a = ( _eventd_limits_tests_get_uint64(fixture, 0, "index") == 3 ) ? 0 : 1;
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, a, "index"), ==, 3);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, a, "repeated"), ==, 3);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 1 - a, "index"), ==, 1);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 1 - a, "repeated"), ==, 1);
+
+    eventd_limits_rule_free(rule);
+}
+
+static void
+_eventd_limits_tests_rate_limit(gpointer fixture_, gconstpointer user_data)
+{
+    EventdLimitsTestFixture *fixture = fixture_;
+    EventdLimitsRule *rule;
+    guint64 i;
+
+    rule = eventd_limits_rule_parse(fixture->config_file, "RateLimit");
+
+    for ( i = 0 ; i < 5 ; ++i )
+        _eventd_limits_tests_push(fixture, rule, "a", i);
+    g_assert_cmpuint(fixture->triggered->len, ==, 2);
+    g_assert_cmpuint(_eventd_limits_tests_get_uint64(fixture, 1, "index"), ==, 1);
+
+    eventd_limits_rule_free(rule);
+}
+
+void
+eventd_tests_add_limits_suite(void)
+{
+    g_test_add("/eventd/limits/parse", EventdLimitsTestFixture, NULL, _init_data, _eventd_limits_tests_parse, _clean_data);
+    g_test_add("/eventd/limits/coalesce/first", EventdLimitsTestFixture, NULL, _init_data, _eventd_limits_tests_first, _clean_data);
+    g_test_add("/eventd/limits/coalesce/last", EventdLimitsTestFixture, NULL, _init_data, _eventd_limits_tests_last, _clean_data);
+    g_test_add("/eventd/limits/coalesce/count", EventdLimitsTestFixture, NULL, _init_data, _eventd_limits_tests_count, _clean_data);
+    g_test_add("/eventd/limits/rate-limit", EventdLimitsTestFixture, NULL, _init_data, _eventd_limits_tests_rate_limit, _clean_data);
+}
@@ -0,0 +1,107 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <libeventd-event.h>
+
+#include "types.h"
+#include "metrics.h"
+
+static void
+_eventd_metrics_tests_stage(void)
+{
+    gchar *dump;
+
+    /* We cannot have spent less than 3µs since then */
+    eventd_metrics_stage(EVENTD_METRICS_STAGE_PROCESS, eventd_metrics_now() - 3000);
+
+    dump = eventd_metrics_dump_openmetrics();
+    g_assert_nonnull(strstr(dump, "eventd_stage_duration_seconds_bucket{stage=\"process\",le=\"1.024e-06\"} 0\n"));
+    g_assert_nonnull(strstr(dump, "eventd_stage_duration_seconds_bucket{stage=\"process\",le=\"+Inf\"} 1\n"));
+    g_assert_nonnull(strstr(dump, "eventd_stage_duration_seconds_count{stage=\"process\"} 1\n"));
+    g_assert_true(g_str_has_suffix(dump, "# EOF\n"));
+    g_free(dump);
+}
+
+static void
+_eventd_metrics_tests_plugin(void)
+{
+    EventdMetricsPlugin *plugin;
+    gchar *dump;
+
+    plugin = eventd_metrics_plugin_new("test");
+    eventd_metrics_plugin_action(plugin, eventd_metrics_now());
+    eventd_metrics_plugin_action(plugin, eventd_metrics_now());
+    eventd_metrics_plugin_action_dropped(plugin);
+
+    dump = eventd_metrics_dump_openmetrics();
+    g_assert_nonnull(strstr(dump, "eventd_plugin_action_duration_seconds_count{plugin=\"test\"} 2\n"));
+    g_assert_nonnull(strstr(dump, "eventd_plugin_actions_dropped_total{plugin=\"test\"} 1\n"));
+    g_free(dump);
+
+    eventd_metrics_plugin_free(plugin);
+
+    dump = eventd_metrics_dump_openmetrics();
+    g_assert_null(strstr(dump, "plugin=\"test\""));
+    g_free(dump);
+}
+
+static void
+_eventd_metrics_tests_connection(void)
+{
+    EventdMetricsConnection *connection;
+    gchar *dump;
+
+    connection = eventd_metrics_connection_new(EVENTD_METRICS_CONNECTION_RELAY, "test \"server\"");
+    eventd_metrics_connection_event_received(connection, eventd_metrics_now());
+    eventd_metrics_connection_event_sent(connection);
+    eventd_metrics_connection_event_sent(connection);
+
+    dump = eventd_metrics_dump_openmetrics();
+    g_assert_null(strstr(dump, "peer="));
+    g_assert_nonnull(strstr(dump, "eventd_connection_events_sent_total{type=\"relay\"} 2\n"));
+    g_assert_nonnull(strstr(dump, "eventd_connection_events_received_total{type=\"relay\"} 1\n"));
+    g_assert_nonnull(strstr(dump, "eventd_connection_push_duration_seconds_count{type=\"relay\"} 1\n"));
+    g_free(dump);
+
+    dump = eventd_metrics_dump();
+    g_assert_nonnull(strstr(dump, "(test \"server\"): 1 received, 2 sent"));
+    g_free(dump);
+
+    eventd_metrics_connection_free(connection);
+
+    dump = eventd_metrics_dump();
+    g_assert_null(strstr(dump, "(test \"server\")"));
+    g_assert_nonnull(strstr(dump, "relay (total): 1 received, 2 sent"));
+    g_free(dump);
+}
+
+void
+eventd_tests_add_metrics_suite(void)
+{
+    g_test_add_func("/eventd/metrics/stage", _eventd_metrics_tests_stage);
+    g_test_add_func("/eventd/metrics/plugin", _eventd_metrics_tests_plugin);
+    g_test_add_func("/eventd/metrics/connection", _eventd_metrics_tests_connection);
+}
@@ -0,0 +1,144 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libeventd-event.h>
+
+#include "relay/spool.h"
+
+#define SPOOL_SIZE 4
+
+typedef struct {
+    gchar *dir;
+    gchar *path;
+    EventdEvent *events[SPOOL_SIZE * 2];
+} EventdRelaySpoolTestFixture;
+
+static void
+_init_data(EventdRelaySpoolTestFixture *fixture, gconstpointer user_data)
+{
+    gsize i;
+
+    fixture->dir = g_dir_make_tmp("eventd-spool-XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+    fixture->path = g_build_filename(fixture->dir, "test.spool", NULL);
+
+    for ( i = 0 ; i < G_N_ELEMENTS(fixture->events) ; ++i )
+    {
+        fixture->events[i] = eventd_event_new("test", "spool");
+        eventd_event_add_data(fixture->events[i], g_strdup("index"), g_variant_new_uint64(i));
+    }
+}
+
+static void
+_clean_data(EventdRelaySpoolTestFixture *fixture, gconstpointer user_data)
+{
+    gsize i;
+
+    for ( i = 0 ; i < G_N_ELEMENTS(fixture->events) ; ++i )
+        eventd_event_unref(fixture->events[i]);
+
+    g_unlink(fixture->path);
+    g_rmdir(fixture->dir);
+    g_free(fixture->path);
+    g_free(fixture->dir);
+}
+
+static void
+_eventd_relay_spool_tests_check(EventdRelaySpool *spool, gsize first, gsize last)
+{
+    EventdEvent *event;
+    gsize i;
+
+    g_assert_cmpuint(eventd_relay_spool_get_length(spool), ==, last - first);
+    for ( i = first ; i < last ; ++i )
+    {
+        event = eventd_relay_spool_peek(spool);
+        g_assert_nonnull(event);
+        g_assert_cmpuint(g_variant_get_uint64(eventd_event_get_data(event, "index")), ==, i);
+        eventd_relay_spool_pop(spool);
+    }
+    g_assert_null(eventd_relay_spool_peek(spool));
+}
+
+static void
+_eventd_relay_spool_tests_drop_oldest(EventdRelaySpoolTestFixture *fixture, gconstpointer user_data)
+{
+    EventdRelaySpool *spool;
+    gsize i;
+
+    spool = eventd_relay_spool_new(SPOOL_SIZE, 0, EVENTD_RELAY_SPOOL_DROP_OLDEST, NULL);
+    for ( i = 0 ; i < G_N_ELEMENTS(fixture->events) ; ++i )
+        eventd_relay_spool_push(spool, fixture->events[i]);
+
+    g_assert_cmpuint(eventd_relay_spool_get_dropped(spool), ==, SPOOL_SIZE);
+    _eventd_relay_spool_tests_check(spool, SPOOL_SIZE, SPOOL_SIZE * 2);
+    eventd_relay_spool_free(spool);
+}
+
+static void
+_eventd_relay_spool_tests_drop_newest(EventdRelaySpoolTestFixture *fixture, gconstpointer user_data)
+{
+    EventdRelaySpool *spool;
+    gsize i;
+
+    spool = eventd_relay_spool_new(SPOOL_SIZE, 0, EVENTD_RELAY_SPOOL_DROP_NEWEST, NULL);
+    for ( i = 0 ; i < G_N_ELEMENTS(fixture->events) ; ++i )
+        eventd_relay_spool_push(spool, fixture->events[i]);
+
+    g_assert_cmpuint(eventd_relay_spool_get_dropped(spool), ==, SPOOL_SIZE);
+    _eventd_relay_spool_tests_check(spool, 0, SPOOL_SIZE);
+    eventd_relay_spool_free(spool);
+}
+
+static void
+_eventd_relay_spool_tests_persistent(EventdRelaySpoolTestFixture *fixture, gconstpointer user_data)
+{
+    EventdRelaySpool *spool;
+    gsize i;
+
+    spool = eventd_relay_spool_new(SPOOL_SIZE, 0, EVENTD_RELAY_SPOOL_DROP_OLDEST, fixture->path);
+    for ( i = 0 ; i < G_N_ELEMENTS(fixture->events) ; ++i )
+        eventd_relay_spool_push(spool, fixture->events[i]);
+    eventd_relay_spool_free(spool);
+
+    /* Events must survive a restart, in order */
+    spool = eventd_relay_spool_new(SPOOL_SIZE, 0, EVENTD_RELAY_SPOOL_DROP_OLDEST, fixture->path);
+    g_assert_cmpstr(eventd_event_get_uuid(eventd_relay_spool_peek(spool)), ==, eventd_event_get_uuid(fixture->events[SPOOL_SIZE]));
+    _eventd_relay_spool_tests_check(spool, SPOOL_SIZE, SPOOL_SIZE * 2);
+    eventd_relay_spool_free(spool);
+
+    /* The drained spool is empty on disk too */
+    spool = eventd_relay_spool_new(SPOOL_SIZE, 0, EVENTD_RELAY_SPOOL_DROP_OLDEST, fixture->path);
+    g_assert_null(eventd_relay_spool_peek(spool));
+    eventd_relay_spool_free(spool);
+}
+
+void
+eventd_tests_add_relay_spool_suite(void)
+{
+    g_test_add("/eventd/relay/spool/drop-oldest", EventdRelaySpoolTestFixture, NULL, _init_data, _eventd_relay_spool_tests_drop_oldest, _clean_data);
+    g_test_add("/eventd/relay/spool/drop-newest", EventdRelaySpoolTestFixture, NULL, _init_data, _eventd_relay_spool_tests_drop_newest, _clean_data);
+    g_test_add("/eventd/relay/spool/persistent", EventdRelaySpoolTestFixture, NULL, _init_data, _eventd_relay_spool_tests_persistent, _clean_data);
+}
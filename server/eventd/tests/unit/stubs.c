@@ -25,11 +25,14 @@
 #include <libeventd-event.h>
 
 #include "types.h"
+#include "eventd.h"
 #include "actions.h"
 #include "plugins.h"
 
 void eventd_plugins_config_reset_all(void) {}
 void eventd_plugins_global_parse_all(GKeyFile *config_file) {}
+void eventd_plugins_reload_begin_all(void) {}
+void eventd_plugins_reload_end_all(void) {}
 
 void eventd_actions_reset(void) {}
 void eventd_actions_parse(EventdActions *actions, GKeyFile *file, const gchar *default_id) {}
@@ -39,3 +42,5 @@ void eventd_actions_dump_actions(GString *dump, GList *actions) {}
 gchar *eventd_actions_dump_action(EventdActions *self, const gchar *action_id) { return NULL; }
 EventdActions *eventd_actions_new(void) { return NULL; }
 void eventd_actions_free(EventdActions *action) {}
+
+GList *eventd_core_get_binds(EventdCoreContext *context, const gchar *namespace, const gchar * const *binds) { return NULL; }
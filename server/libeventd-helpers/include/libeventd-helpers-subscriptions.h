@@ -0,0 +1,38 @@
+/*
+ * libeventd - Internal helper
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LIBEVENTD_SUBSCRIPTIONS_H__
+#define __LIBEVENTD_SUBSCRIPTIONS_H__
+
+#include <glib.h>
+
+typedef struct _LibeventdSubscriptions LibeventdSubscriptions;
+
+LibeventdSubscriptions *evhelpers_subscriptions_new(void);
+void evhelpers_subscriptions_free(LibeventdSubscriptions *subscriptions);
+
+void evhelpers_subscriptions_add(LibeventdSubscriptions *subscriptions, gpointer subscriber, GHashTable *categories);
+void evhelpers_subscriptions_remove(LibeventdSubscriptions *subscriptions, gpointer subscriber);
+
+GPtrArray *evhelpers_subscriptions_lookup(LibeventdSubscriptions *subscriptions, const gchar *category);
+
+#endif /* __LIBEVENTD_SUBSCRIPTIONS_H__ */
@@ -29,6 +29,7 @@
 #include <gio/gio.h>
 
 #include "libeventd-event.h"
+#include "libeventd-event-private.h"
 
 #include <nkutils-enum.h>
 #include <nkutils-format-string.h>
@@ -37,24 +38,137 @@
 #include "libeventd-helpers-config.h"
 
 struct _Filename {
-    guint64 ref_count;
+    gatomicrefcount ref_count;
     gchar *data_name;
     FormatString *file_uri;
 };
 
+typedef enum {
+    FORMAT_STRING_OP_LITERAL,
+    FORMAT_STRING_OP_DATA,
+} FormatStringOpType;
+
+typedef struct {
+    FormatStringOpType type;
+    const gchar *string;
+    gsize length;
+} FormatStringOp;
+
+/* Actions may render on pool threads, so references are atomic */
+struct _FormatString {
+    gatomicrefcount ref_count;
+    guint serial;
+    NkFormatString *format;
+    gsize length;
+    gsize n_ops;
+    FormatStringOp *ops;
+};
+
+static gint _evhelpers_format_string_serial = 0;
+
+static void
+_evhelpers_format_string_ops_free(FormatStringOp *ops, gsize n_ops)
+{
+    gsize i;
+    for ( i = 0 ; i < n_ops ; ++i )
+    {
+        if ( ops[i].type == FORMAT_STRING_OP_LITERAL )
+            g_free((gchar *) ops[i].string);
+    }
+    g_free(ops);
+}
+
+/*
+ * We compile the simple cases, only literals and ${name} references,
+ * to a flat list of ops. Anything fancier is left to nkutils
+ */
+static gboolean
+_evhelpers_format_string_compile(FormatString *self, const gchar *string)
+{
+    if ( strchr(string, '\\') != NULL )
+        return FALSE;
+
+    GArray *ops;
+    const gchar *s = string, *c;
+    FormatStringOp op;
+    guint i;
+
+    ops = g_array_new(FALSE, FALSE, sizeof(FormatStringOp));
+    while ( ( c = strchr(s, '$') ) != NULL )
+    {
+        const gchar *e;
+
+        if ( c[1] != '{' )
+            goto fail;
+
+        for ( e = c + 2 ; g_ascii_isalnum(*e) || ( *e == '_' ) ; ++e );
+        if ( ( *e != '}' ) || ( e == ( c + 2 ) ) )
+            goto fail;
+
+        if ( c > s )
+        {
+            op.type = FORMAT_STRING_OP_LITERAL;
+            op.string = g_strndup(s, c - s);
+            op.length = c - s;
+            self->length += op.length;
+            g_array_append_val(ops, op);
+        }
+
+        gchar *name = g_strndup(c + 2, e - c - 2);
+        op.type = FORMAT_STRING_OP_DATA;
+        op.string = g_intern_string(name);
+        op.length = 0;
+        g_free(name);
+        g_array_append_val(ops, op);
+
+        s = e + 1;
+    }
+    if ( *s != '\0' )
+    {
+        op.type = FORMAT_STRING_OP_LITERAL;
+        op.string = g_strdup(s);
+        op.length = strlen(s);
+        self->length += op.length;
+        g_array_append_val(ops, op);
+    }
+
+    self->n_ops = ops->len;
+    self->ops = (FormatStringOp *) g_array_free(ops, FALSE);
+    return TRUE;
+
+fail:
+    self->length = 0;
+    for ( i = 0 ; i < ops->len ; ++i )
+    {
+        if ( g_array_index(ops, FormatStringOp, i).type == FORMAT_STRING_OP_LITERAL )
+            g_free((gchar *) g_array_index(ops, FormatStringOp, i).string);
+    }
+    g_array_free(ops, TRUE);
+    return FALSE;
+}
+
 EVENTD_EXPORT
 FormatString *
 evhelpers_format_string_new(gchar *string)
 {
     GError *error = NULL;
-    FormatString *format_string;
+    FormatString *self;
 
-    format_string = nk_format_string_parse(string, '$', &error);
-    if ( format_string != NULL )
-        return format_string;
+    self = g_new0(FormatString, 1);
+    g_atomic_ref_count_init(&self->ref_count);
+    self->serial = (guint) g_atomic_int_add(&_evhelpers_format_string_serial, 1) + 1;
+
+    /* nkutils takes ownership of the string so we compile it first */
+    _evhelpers_format_string_compile(self, string);
+
+    self->format = nk_format_string_parse(string, '$', &error);
+    if ( self->format != NULL )
+        return self;
 
     g_warning("Malformed format string: %s", error->message);
     g_clear_error(&error);
+    _evhelpers_format_string_ops_free(self->ops, self->n_ops);
+    g_free(self);
     return NULL;
 }
 
@@ -62,9 +176,9 @@ EVENTD_EXPORT
 FormatString *
 evhelpers_format_string_ref(FormatString *format_string)
 {
-    if ( format_string == NULL )
-        return NULL;
-    return nk_format_string_ref(format_string);
+    if ( format_string != NULL )
+        g_atomic_ref_count_inc(&format_string->ref_count);
+    return format_string;
 }
 
 EVENTD_EXPORT
@@ -73,7 +187,14 @@ evhelpers_format_string_unref(FormatString *format_string)
 {
     if ( format_string == NULL )
         return;
-    nk_format_string_unref(format_string);
+
+    if ( ! g_atomic_ref_count_dec(&format_string->ref_count) )
+        return;
+
+    nk_format_string_unref(format_string->format);
+    _evhelpers_format_string_ops_free(format_string->ops, format_string->n_ops);
+
+    g_free(format_string);
 }
 
 static gboolean
@@ -128,7 +249,7 @@ evhelpers_filename_new(gchar *string)
     Filename *filename;
 
     filename = g_new0(Filename, 1);
-    filename->ref_count = 1;
+    g_atomic_ref_count_init(&filename->ref_count);
 
     filename->data_name = data_name;
     filename->file_uri = file_uri;
@@ -141,7 +262,7 @@ Filename *
 evhelpers_filename_ref(Filename *filename)
 {
     if ( filename != NULL )
-        ++filename->ref_count;
+        g_atomic_ref_count_inc(&filename->ref_count);
     return filename;
 }
 
@@ -152,7 +273,7 @@ evhelpers_filename_unref(Filename *filename)
     if ( filename == NULL )
         return;
 
-    if ( --filename->ref_count > 0 )
+    if ( ! g_atomic_ref_count_dec(&filename->ref_count) )
         return;
 
     evhelpers_format_string_unref(filename->file_uri);
@@ -615,6 +736,49 @@ _evhelpers_token_list_callback(const gchar *token, guint64 value, gpointer user_
     return g_variant_ref(content);
 }
 
+static gchar *
+_evhelpers_format_string_render(const FormatString *format_string, EventdEvent *event)
+{
+    const gchar **values;
+    gsize *lengths;
+    gsize length = format_string->length;
+    gsize i;
+
+    values = g_newa(const gchar *, format_string->n_ops);
+    lengths = g_newa(gsize, format_string->n_ops);
+    for ( i = 0 ; i < format_string->n_ops ; ++i )
+    {
+        const FormatStringOp *op = &format_string->ops[i];
+        if ( op->type == FORMAT_STRING_OP_LITERAL )
+        {
+            values[i] = op->string;
+            lengths[i] = op->length;
+            continue;
+        }
+
+        GVariant *content;
+        content = eventd_event_get_data(event, op->string);
+
+        /* Let nkutils handle missing data and conversions */
+        if ( ( content == NULL ) || ( ! g_variant_is_of_type(content, G_VARIANT_TYPE_STRING) ) )
+            return NULL;
+
+        values[i] = g_variant_get_string(content, &lengths[i]);
+        length += lengths[i];
+    }
+
+    gchar *ret, *c;
+    c = ret = g_new(gchar, length + 1);
+    for ( i = 0 ; i < format_string->n_ops ; ++i )
+    {
+        memcpy(c, values[i], lengths[i]);
+        c += lengths[i];
+    }
+    *c = '\0';
+
+    return ret;
+}
+
 EVENTD_EXPORT
 gchar *
 evhelpers_format_string_get_string(const FormatString *format_string, EventdEvent *event, FormatStringReplaceCallback callback, gpointer user_data)
@@ -629,8 +793,28 @@ evhelpers_format_string_get_string(const FormatString *format_string, EventdEven
     };
 
     gchar *ret;
-    ret = nk_format_string_replace(format_string, _evhelpers_token_list_callback, &data);
-    g_free(data.to_free);
+
+    if ( callback != NULL )
+    {
+        ret = nk_format_string_replace(format_string->format, _evhelpers_token_list_callback, &data);
+        g_free(data.to_free);
+        return ret;
+    }
+
+    ret = eventd_event_get_cached_string(event, format_string->serial);
+    if ( ret != NULL )
+        return ret;
+
+    if ( format_string->ops != NULL )
+        ret = _evhelpers_format_string_render(format_string, event);
+    if ( ret == NULL )
+    {
+        ret = nk_format_string_replace(format_string->format, _evhelpers_token_list_callback, &data);
+        g_free(data.to_free);
+    }
+
+    if ( ret != NULL )
+        eventd_event_set_cached_string(event, format_string->serial, ret);
 
     return ret;
 }
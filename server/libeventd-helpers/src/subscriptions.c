@@ -0,0 +1,317 @@
+/*
+ * libeventd - Internal helper
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "libeventd-helpers-subscriptions.h"
+
+/*
+ * Subscriptions are stored in routes: the catch-all one, one per exact
+ * category and one per prefix ("app.*"). Each route keeps its subscribers
+ * in a flat array, along with the matching membership records so that
+ * removing a subscriber is a swap-remove per subscription.
+ *
+ * Dispatching resolves a category to the deduplicated set of its
+ * subscribers once, and caches it until the subscriptions change.
+ */
+
+#define EVHELPERS_SUBSCRIPTIONS_CACHE_SIZE 512
+
+typedef struct {
+    gchar *category;
+    gboolean prefix;
+    GPtrArray *subscribers;
+    GPtrArray *members;
+} LibeventdSubscriptionsRoute;
+
+typedef struct {
+    LibeventdSubscriptionsRoute *route;
+    guint index;
+} LibeventdSubscriptionsMember;
+
+struct _LibeventdSubscriptions {
+    LibeventdSubscriptionsRoute all;
+    GHashTable *exact;
+    GHashTable *prefixes;
+    GHashTable *subscribers;
+    GHashTable *cache;
+};
+
+static void
+_evhelpers_subscriptions_route_init(LibeventdSubscriptionsRoute *route)
+{
+    route->subscribers = g_ptr_array_new();
+    route->members = g_ptr_array_new();
+}
+
+static void
+_evhelpers_subscriptions_route_clear(LibeventdSubscriptionsRoute *route)
+{
+    g_ptr_array_unref(route->members);
+    g_ptr_array_unref(route->subscribers);
+    g_free(route->category);
+}
+
+static void
+_evhelpers_subscriptions_route_free(gpointer data)
+{
+    LibeventdSubscriptionsRoute *route = data;
+
+    _evhelpers_subscriptions_route_clear(route);
+    g_free(route);
+}
+
+EVENTD_EXPORT
+LibeventdSubscriptions *
+evhelpers_subscriptions_new(void)
+{
+    LibeventdSubscriptions *self;
+
+    self = g_new0(LibeventdSubscriptions, 1);
+
+    _evhelpers_subscriptions_route_init(&self->all);
+    /* Routes own their category, used as key */
+    self->exact = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _evhelpers_subscriptions_route_free);
+    self->prefixes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _evhelpers_subscriptions_route_free);
+    self->subscribers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_ptr_array_unref);
+    self->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+    return self;
+}
+
+EVENTD_EXPORT
+void
+evhelpers_subscriptions_free(LibeventdSubscriptions *self)
+{
+    if ( self == NULL )
+        return;
+
+    g_hash_table_unref(self->cache);
+    g_hash_table_unref(self->subscribers);
+    g_hash_table_unref(self->prefixes);
+    g_hash_table_unref(self->exact);
+    _evhelpers_subscriptions_route_clear(&self->all);
+
+    g_free(self);
+}
+
+static LibeventdSubscriptionsRoute *
+_evhelpers_subscriptions_get_route(LibeventdSubscriptions *self, const gchar *category)
+{
+    LibeventdSubscriptionsRoute *route;
+    GHashTable *table = self->exact;
+    gsize length = strlen(category);
+    gboolean prefix = FALSE;
+
+    if ( ( length > 0 ) && ( category[length - 1] == '*' ) )
+    {
+        if ( length == 1 )
+            return &self->all;
+        table = self->prefixes;
+        prefix = TRUE;
+        --length;
+    }
+
+    gchar *key = g_strndup(category, length);
+    route = g_hash_table_lookup(table, key);
+    if ( route != NULL )
+    {
+        g_free(key);
+        return route;
+    }
+
+    route = g_new0(LibeventdSubscriptionsRoute, 1);
+    route->category = key;
+    route->prefix = prefix;
+    _evhelpers_subscriptions_route_init(route);
+    g_hash_table_insert(table, route->category, route);
+
+    return route;
+}
+
+static void
+_evhelpers_subscriptions_route_add(LibeventdSubscriptions *self, LibeventdSubscriptionsRoute *route, gpointer subscriber, GPtrArray *members)
+{
+    LibeventdSubscriptionsMember *member;
+
+    member = g_new(LibeventdSubscriptionsMember, 1);
+    member->route = route;
+    member->index = route->subscribers->len;
+
+    g_ptr_array_add(route->subscribers, subscriber);
+    g_ptr_array_add(route->members, member);
+    g_ptr_array_add(members, member);
+}
+
+static void
+_evhelpers_subscriptions_route_remove(LibeventdSubscriptions *self, LibeventdSubscriptionsMember *member)
+{
+    LibeventdSubscriptionsRoute *route = member->route;
+    guint index = member->index;
+
+    g_ptr_array_remove_index_fast(route->subscribers, index);
+    g_ptr_array_remove_index_fast(route->members, index);
+    if ( index < route->members->len )
+    {
+        LibeventdSubscriptionsMember *moved = g_ptr_array_index(route->members, index);
+        moved->index = index;
+    }
+
+    if ( ( route->subscribers->len > 0 ) || ( route == &self->all ) )
+        return;
+
+    g_hash_table_remove(route->prefix ? self->prefixes : self->exact, route->category);
+}
+
+/**
+ * evhelpers_subscriptions_add:
+ * @subscriptions: a #LibeventdSubscriptions
+ * @subscriber: the subscriber to add
+ * @categories: (nullable): a set of categories, or %NULL to subscribe to all
+ *
+ * Subscribes @subscriber to the categories.
+ * A category ending with a '*' is a prefix: "app.*" matches "app.mail"
+ * and "app.chat", and "*" alone matches everything.
+ */
+EVENTD_EXPORT
+void
+evhelpers_subscriptions_add(LibeventdSubscriptions *self, gpointer subscriber, GHashTable *categories)
+{
+    GPtrArray *members;
+
+    members = g_hash_table_lookup(self->subscribers, subscriber);
+    if ( members == NULL )
+    {
+        members = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(self->subscribers, subscriber, members);
+    }
+
+    if ( categories == NULL )
+        _evhelpers_subscriptions_route_add(self, &self->all, subscriber, members);
+    else
+    {
+        GHashTableIter iter;
+        const gchar *category;
+        g_hash_table_iter_init(&iter, categories);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &category, NULL) )
+            _evhelpers_subscriptions_route_add(self, _evhelpers_subscriptions_get_route(self, category), subscriber, members);
+    }
+
+    g_hash_table_remove_all(self->cache);
+}
+
+/**
+ * evhelpers_subscriptions_remove:
+ * @subscriptions: a #LibeventdSubscriptions
+ * @subscriber: the subscriber to remove
+ *
+ * Drops all the subscriptions of @subscriber.
+ */
+EVENTD_EXPORT
+void
+evhelpers_subscriptions_remove(LibeventdSubscriptions *self, gpointer subscriber)
+{
+    GPtrArray *members;
+    guint i;
+
+    if ( ! g_hash_table_steal_extended(self->subscribers, subscriber, NULL, (gpointer *) &members) )
+        return;
+
+    for ( i = 0 ; i < members->len ; ++i )
+        _evhelpers_subscriptions_route_remove(self, g_ptr_array_index(members, i));
+    g_ptr_array_unref(members);
+
+    g_hash_table_remove_all(self->cache);
+}
+
+static void
+_evhelpers_subscriptions_resolve_route(GPtrArray *subscribers, GHashTable *seen, LibeventdSubscriptionsRoute *route)
+{
+    guint i;
+
+    for ( i = 0 ; i < route->subscribers->len ; ++i )
+    {
+        gpointer subscriber = g_ptr_array_index(route->subscribers, i);
+        if ( g_hash_table_add(seen, subscriber) )
+            g_ptr_array_add(subscribers, subscriber);
+    }
+}
+
+static GPtrArray *
+_evhelpers_subscriptions_resolve(LibeventdSubscriptions *self, const gchar *category)
+{
+    GPtrArray *subscribers;
+    GHashTable *seen;
+    LibeventdSubscriptionsRoute *route;
+    GHashTableIter iter;
+
+    subscribers = g_ptr_array_new();
+    seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    _evhelpers_subscriptions_resolve_route(subscribers, seen, &self->all);
+
+    route = g_hash_table_lookup(self->exact, category);
+    if ( route != NULL )
+        _evhelpers_subscriptions_resolve_route(subscribers, seen, route);
+
+    g_hash_table_iter_init(&iter, self->prefixes);
+    while ( g_hash_table_iter_next(&iter, NULL, (gpointer *) &route) )
+    {
+        if ( g_str_has_prefix(category, route->category) )
+            _evhelpers_subscriptions_resolve_route(subscribers, seen, route);
+    }
+
+    g_hash_table_unref(seen);
+
+    return subscribers;
+}
+
+/**
+ * evhelpers_subscriptions_lookup:
+ * @subscriptions: a #LibeventdSubscriptions
+ * @category: an event category
+ *
+ * Retrieves the subscribers for @category, each of them only once.
+ *
+ * Returns: (transfer full): the subscribers array, to unref after use
+ */
+EVENTD_EXPORT
+GPtrArray *
+evhelpers_subscriptions_lookup(LibeventdSubscriptions *self, const gchar *category)
+{
+    GPtrArray *subscribers;
+
+    subscribers = g_hash_table_lookup(self->cache, category);
+    if ( subscribers == NULL )
+    {
+        if ( g_hash_table_size(self->cache) >= EVHELPERS_SUBSCRIPTIONS_CACHE_SIZE )
+            g_hash_table_remove_all(self->cache);
+        subscribers = _evhelpers_subscriptions_resolve(self, category);
+        g_hash_table_insert(self->cache, g_strdup(category), subscribers);
+    }
+
+    return g_ptr_array_ref(subscribers);
+}
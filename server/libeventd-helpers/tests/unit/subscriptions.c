@@ -0,0 +1,178 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "libeventd-helpers-subscriptions.h"
+
+static gint subscribers[3];
+#define SUBSCRIBER(n) ((gpointer) &subscribers[n])
+
+static GHashTable *
+_evhelpers_subscriptions_tests_categories(const gchar *first, ...)
+{
+    GHashTable *categories;
+    const gchar *category;
+    va_list args;
+
+    categories = g_hash_table_new(g_str_hash, g_str_equal);
+
+    va_start(args, first);
+    for ( category = first ; category != NULL ; category = va_arg(args, const gchar *) )
+        g_hash_table_add(categories, (gpointer) category);
+    va_end(args);
+
+    return categories;
+}
+
+static void
+_evhelpers_subscriptions_tests_assert(LibeventdSubscriptions *subscriptions, const gchar *category, gint n, ...)
+{
+    GPtrArray *found;
+    va_list args;
+    gint i;
+
+    found = evhelpers_subscriptions_lookup(subscriptions, category);
+    g_assert_cmpuint(found->len, ==, n);
+
+    va_start(args, n);
+    for ( i = 0 ; i < n ; ++i )
+        g_assert_true(g_ptr_array_find(found, va_arg(args, gpointer), NULL));
+    va_end(args);
+
+    g_ptr_array_unref(found);
+}
+
+static void
+_evhelpers_subscriptions_tests_exact(void)
+{
+    LibeventdSubscriptions *subscriptions;
+    GHashTable *categories;
+
+    subscriptions = evhelpers_subscriptions_new();
+
+    categories = _evhelpers_subscriptions_tests_categories("mail", "chat", NULL);
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(0), categories);
+    g_hash_table_unref(categories);
+
+    categories = _evhelpers_subscriptions_tests_categories("chat", NULL);
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(1), categories);
+    g_hash_table_unref(categories);
+
+    _evhelpers_subscriptions_tests_assert(subscriptions, "mail", 1, SUBSCRIBER(0));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "chat", 2, SUBSCRIBER(0), SUBSCRIBER(1));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "music", 0);
+
+    evhelpers_subscriptions_remove(subscriptions, SUBSCRIBER(0));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "mail", 0);
+    _evhelpers_subscriptions_tests_assert(subscriptions, "chat", 1, SUBSCRIBER(1));
+
+    evhelpers_subscriptions_free(subscriptions);
+}
+
+static void
+_evhelpers_subscriptions_tests_wildcard(void)
+{
+    LibeventdSubscriptions *subscriptions;
+    GHashTable *categories;
+
+    subscriptions = evhelpers_subscriptions_new();
+
+    categories = _evhelpers_subscriptions_tests_categories("app.*", "app.mail", NULL);
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(0), categories);
+    g_hash_table_unref(categories);
+
+    categories = _evhelpers_subscriptions_tests_categories("*", NULL);
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(1), categories);
+    g_hash_table_unref(categories);
+
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(2), NULL);
+
+    /* Overlapping subscriptions only give the subscriber once */
+    _evhelpers_subscriptions_tests_assert(subscriptions, "app.mail", 3, SUBSCRIBER(0), SUBSCRIBER(1), SUBSCRIBER(2));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "app.chat", 3, SUBSCRIBER(0), SUBSCRIBER(1), SUBSCRIBER(2));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "app", 2, SUBSCRIBER(1), SUBSCRIBER(2));
+
+    evhelpers_subscriptions_remove(subscriptions, SUBSCRIBER(1));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "app.chat", 2, SUBSCRIBER(0), SUBSCRIBER(2));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "other", 1, SUBSCRIBER(2));
+
+    evhelpers_subscriptions_remove(subscriptions, SUBSCRIBER(0));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "app.chat", 1, SUBSCRIBER(2));
+
+    evhelpers_subscriptions_free(subscriptions);
+}
+
+static void
+_evhelpers_subscriptions_tests_many(void)
+{
+    LibeventdSubscriptions *subscriptions;
+    GHashTable *categories;
+    gchar *category;
+    guint i;
+
+    subscriptions = evhelpers_subscriptions_new();
+
+    categories = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for ( i = 0 ; i < 1000 ; ++i )
+        g_hash_table_add(categories, g_strdup_printf("category-%u", i));
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(0), categories);
+    evhelpers_subscriptions_add(subscriptions, SUBSCRIBER(1), categories);
+    g_hash_table_unref(categories);
+
+    for ( i = 0 ; i < 1000 ; i += 100 )
+    {
+        category = g_strdup_printf("category-%u", i);
+        _evhelpers_subscriptions_tests_assert(subscriptions, category, 2, SUBSCRIBER(0), SUBSCRIBER(1));
+        g_free(category);
+    }
+
+    /* Removing swaps subscribers around, check the other one is intact */
+    evhelpers_subscriptions_remove(subscriptions, SUBSCRIBER(0));
+    for ( i = 0 ; i < 1000 ; i += 100 )
+    {
+        category = g_strdup_printf("category-%u", i);
+        _evhelpers_subscriptions_tests_assert(subscriptions, category, 1, SUBSCRIBER(1));
+        g_free(category);
+    }
+
+    evhelpers_subscriptions_remove(subscriptions, SUBSCRIBER(1));
+    _evhelpers_subscriptions_tests_assert(subscriptions, "category-0", 0);
+
+    evhelpers_subscriptions_free(subscriptions);
+}
+
+int
+main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "C");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/libeventd-helpers/subscriptions/exact", _evhelpers_subscriptions_tests_exact);
+    g_test_add_func("/libeventd-helpers/subscriptions/wildcard", _evhelpers_subscriptions_tests_wildcard);
+    g_test_add_func("/libeventd-helpers/subscriptions/many", _evhelpers_subscriptions_tests_many);
+
+    return g_test_run();
+}
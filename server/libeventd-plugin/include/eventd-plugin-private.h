@@ -47,9 +47,11 @@ struct EventdPluginInterface {
     EventdPluginGlobalParseFunc global_parse;
     EventdPluginActionParseFunc action_parse;
     EventdPluginSimpleFunc config_reset;
+    EventdPluginSimpleFunc reload;
 
     EventdPluginEventDispatchFunc event_dispatch;
     EventdPluginEventActionFunc event_action;
+    gboolean event_action_thread_safe;
 };
 
 #endif /* __EVENTD_EVENTD_PLUGIN_PRIVATE_H__ */
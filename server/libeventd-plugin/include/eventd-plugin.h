@@ -81,9 +81,11 @@ void eventd_plugin_interface_add_control_command_callback(EventdPluginInterface
 void eventd_plugin_interface_add_global_parse_callback(EventdPluginInterface *iface, EventdPluginGlobalParseFunc callback);
 void eventd_plugin_interface_add_action_parse_callback(EventdPluginInterface *iface, EventdPluginActionParseFunc callback);
 void eventd_plugin_interface_add_config_reset_callback(EventdPluginInterface *iface, EventdPluginSimpleFunc callback);
+void eventd_plugin_interface_add_reload_callback(EventdPluginInterface *iface, EventdPluginSimpleFunc callback);
 
 void eventd_plugin_interface_add_event_dispatch_callback(EventdPluginInterface *iface, EventdPluginEventDispatchFunc callback);
 void eventd_plugin_interface_add_event_action_callback(EventdPluginInterface *iface, EventdPluginEventActionFunc callback);
+void eventd_plugin_interface_set_event_action_thread_safe(EventdPluginInterface *iface, gboolean thread_safe);
 
 
 /*
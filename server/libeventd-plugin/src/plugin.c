@@ -145,7 +145,7 @@ EVENTD_EXPORT void eventd_plugin_interface_add_uninit_callback(EventdPluginInter
  *
  * This callback should set up any plugin-wide requirements (e.g., sockets,
  * files, databases, etc.) specified by the configuration. This is also called
- * after the configuration is reloaded.
+ * after the configuration is reloaded, unless the plugin has a reload callback.
  */
 EVENTD_EXPORT void eventd_plugin_interface_add_start_callback(EventdPluginInterface *interface, EventdPluginSimpleFunc callback) { interface->start = callback; }
 /**
@@ -154,7 +154,7 @@ EVENTD_EXPORT void eventd_plugin_interface_add_start_callback(EventdPluginInterf
  * @callback: (scope async): a function to call before shutdown
  *
  * This callback should tear down any plugin-wide resources. It is also called
- * before the configuration is reloaded.
+ * before the configuration is reloaded, unless the plugin has a reload callback.
  */
 EVENTD_EXPORT void eventd_plugin_interface_add_stop_callback(EventdPluginInterface *interface, EventdPluginSimpleFunc callback) { interface->stop = callback; }
 
@@ -224,6 +224,16 @@ EVENTD_EXPORT void eventd_plugin_interface_add_action_parse_callback(EventdPlugi
  * This callback is called before reloading the configuration and shutdown.
  */
 EVENTD_EXPORT void eventd_plugin_interface_add_config_reset_callback(EventdPluginInterface *interface, EventdPluginSimpleFunc callback) { interface->config_reset = callback; }
+/**
+ * eventd_plugin_interface_add_reload_callback:
+ * @iface: an #EventdPluginInterface
+ * @callback: (scope async): a function to call after the configuration is reloaded
+ *
+ * A plugin with this callback is not stopped and started around configuration
+ * reloads, so it can keep its connections up. This callback is called once the
+ * new configuration is parsed and should apply the global settings that changed.
+ */
+EVENTD_EXPORT void eventd_plugin_interface_add_reload_callback(EventdPluginInterface *interface, EventdPluginSimpleFunc callback) { interface->reload = callback; }
 
 /**
  * EventdPluginEventDispatchFunc:
@@ -263,3 +273,18 @@ EVENTD_EXPORT void eventd_plugin_interface_add_event_dispatch_callback(EventdPlu
  * plugin.
  */
 EVENTD_EXPORT void eventd_plugin_interface_add_event_action_callback(EventdPluginInterface *interface, EventdPluginEventActionFunc callback) { interface->event_action = callback; }
+
+/**
+ * eventd_plugin_interface_set_event_action_thread_safe:
+ * @iface: an #EventdPluginInterface
+ * @thread_safe: whether the event action callback is thread-safe
+ *
+ * A plugin whose event action callback can safely run in another thread,
+ * concurrently with itself and with the rest of the plugin, can let eventd run
+ * its actions on a worker pool, so that they do not block the main loop.
+ *
+ * The plugin actions and the event are guaranteed to stay valid until the
+ * callback returns: eventd waits for running actions before resetting the
+ * configuration or stopping plugins.
+ */
+EVENTD_EXPORT void eventd_plugin_interface_set_event_action_thread_safe(EventdPluginInterface *interface, gboolean thread_safe) { interface->event_action_thread_safe = thread_safe; }
@@ -26,6 +26,17 @@
 EventdEvent *eventd_event_new_for_uuid(NkUuid uuid, const gchar *category, const gchar *name);
 EventdEvent *eventd_event_new_for_uuid_string(const gchar *uuid_string, const gchar *category, const gchar *name);
 
-void eventd_event_set_all_data(EventdEvent *event, GHashTable *data);
+typedef struct {
+    gsize allocated;
+    gsize recycled;
+    gsize released;
+    gsize data_allocated;
+} EventdEventAllocationStats;
+
+void eventd_event_slab_set_size(guint size);
+void eventd_event_get_allocation_stats(EventdEventAllocationStats *stats);
+
+gchar *eventd_event_get_cached_string(EventdEvent *event, guint key);
+void eventd_event_set_cached_string(EventdEvent *event, guint key, const gchar *string);
 
 #endif /* __EVENTD_EVENT_PRIVATE_H__ */
@@ -31,6 +31,7 @@ G_BEGIN_DECLS
 
 typedef struct _EventdProtocol               EventdProtocol;
 typedef struct _EventdProtocolCallbacks      EventdProtocolCallbacks;
+typedef struct _EventdProtocolSubscribeFilter EventdProtocolSubscribeFilter;
 
 GType eventd_protocol_get_type(void);
 
@@ -42,6 +43,21 @@ struct _EventdProtocolCallbacks
     void (*subscribe)(EventdProtocol *protocol, GHashTable *categories, gpointer user_data);
     void (*ping)(EventdProtocol *protocol, gpointer user_data);
     void (*bye)(EventdProtocol *protocol, const gchar *message, gpointer user_data);
+    void (*binary)(EventdProtocol *protocol, gpointer user_data);
+    void (*subscribe_filter)(EventdProtocol *protocol, GHashTable *categories, const EventdProtocolSubscribeFilter *filter, gpointer user_data);
+};
+
+/*
+ * Subscription filter: conditions on the event data, like the IfData,
+ * IfDataMatches and IfDataRegex event keys, and the list of data to send.
+ * All members are optional %NULL-terminated arrays.
+ */
+struct _EventdProtocolSubscribeFilter
+{
+    gchar **if_data;
+    gchar **if_data_matches;
+    gchar **if_data_regexes;
+    gchar **only_data;
 };
 
 /*
@@ -67,14 +83,26 @@ GQuark eventd_protocol_parse_error_quark(void);
 EventdProtocol *eventd_protocol_new(const EventdProtocolCallbacks *callbacks, gpointer user_data, GDestroyNotify notify);
 EventdProtocol *eventd_protocol_ref(EventdProtocol *protocol);
 void eventd_protocol_unref(EventdProtocol *protocol);
+void eventd_protocol_reset(EventdProtocol *protocol);
 
 gboolean eventd_protocol_parse(EventdProtocol *protocol, gchar *buffer, gsize length, GError **error);
+gboolean eventd_protocol_parse_chunk(EventdProtocol *protocol, gchar *buffer, gsize length, GError **error);
 
 gchar *eventd_protocol_generate_event(EventdProtocol *protocol, EventdEvent *event);
 gchar *eventd_protocol_generate_subscribe(EventdProtocol *protocol, GHashTable *categories);
+gchar *eventd_protocol_generate_subscribe_filter(EventdProtocol *protocol, GHashTable *categories, const EventdProtocolSubscribeFilter *filter);
 gchar *eventd_protocol_generate_ping(EventdProtocol *protocol);
 gchar *eventd_protocol_generate_bye(EventdProtocol *protocol, const gchar *message);
 
+gchar *eventd_protocol_generate_binary(EventdProtocol *protocol);
+gboolean eventd_protocol_is_binary(EventdProtocol *protocol);
+
+GBytes *eventd_protocol_generate_event_bytes(EventdProtocol *protocol, EventdEvent *event);
+GBytes *eventd_protocol_generate_subscribe_bytes(EventdProtocol *protocol, GHashTable *categories);
+GBytes *eventd_protocol_generate_subscribe_filter_bytes(EventdProtocol *protocol, GHashTable *categories, const EventdProtocolSubscribeFilter *filter);
+GBytes *eventd_protocol_generate_ping_bytes(EventdProtocol *protocol);
+GBytes *eventd_protocol_generate_bye_bytes(EventdProtocol *protocol, const gchar *message);
+
 
 G_END_DECLS
 
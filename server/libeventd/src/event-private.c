@@ -36,12 +36,13 @@ eventd_event_new_for_uuid(NkUuid uuid, const gchar *category, const gchar *name)
 {
     EventdEvent *self;
 
-    self = g_new0(EventdEvent, 1);
-    self->refcount = 1;
+    self = eventd_event_alloc(category, name);
+    g_atomic_ref_count_init(&self->refcount);
+    g_mutex_init(&self->cache.lock);
+    self->data.entries = self->data.inline_entries;
+    self->data.size = EVENTD_EVENT_DATA_INLINE_SIZE;
 
     self->uuid = uuid;
-    self->category = g_strdup(category);
-    self->name = g_strdup(name);
 
     return self;
 }
@@ -61,11 +62,40 @@ eventd_event_new_for_uuid_string(const gchar *uuid_string, const gchar *category
 }
 
 void
-eventd_event_set_all_data(EventdEvent *self, GHashTable *data)
+eventd_event_clear_data(EventdEvent *self)
 {
-    g_return_if_fail(self != NULL);
+    gsize i;
+    for ( i = 0 ; i < self->data.length ; ++i )
+    {
+        if ( ! self->data.entries[i].interned )
+            g_free(self->data.entries[i].name);
+        g_variant_unref(self->data.entries[i].value);
+    }
 
-    if ( self->data != NULL )
-        g_hash_table_unref(self->data);
-    self->data = data;
+    if ( self->data.index != NULL )
+        g_hash_table_unref(self->data.index);
+    if ( self->data.entries != self->data.inline_entries )
+        g_free(self->data.entries);
+
+    self->data.length = 0;
+    self->data.size = EVENTD_EVENT_DATA_INLINE_SIZE;
+    self->data.entries = self->data.inline_entries;
+    self->data.index = NULL;
+}
+
+void
+eventd_event_clear_caches(EventdEvent *self)
+{
+    if ( self->message.text != NULL )
+        g_bytes_unref(self->message.text);
+    if ( self->message.binary != NULL )
+        g_bytes_unref(self->message.binary);
+    self->message.text = NULL;
+    self->message.binary = NULL;
+
+    g_mutex_lock(&self->cache.lock);
+    if ( self->cache.strings != NULL )
+        g_hash_table_unref(self->cache.strings);
+    self->cache.strings = NULL;
+    g_mutex_unlock(&self->cache.lock);
 }
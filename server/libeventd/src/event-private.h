@@ -21,13 +21,57 @@
 #ifndef __EVENTD_EVENT_EVENT_PRIVATE_H__
 #define __EVENTD_EVENT_EVENT_PRIVATE_H__
 
+/*
+ * Most events carry a handful of data, so we keep them inline
+ * and only index them when they grow past the threshold
+ * Names already interned (those known from the configuration) are shared,
+ * so lookups usually only compare pointers
+ * Other names come from peers, we must not intern them
+ */
+#define EVENTD_EVENT_DATA_INLINE_SIZE 8
+#define EVENTD_EVENT_DATA_INDEX_THRESHOLD 16
+
+typedef struct {
+    gchar *name;
+    gboolean interned;
+    GVariant *value;
+} EventdEventData;
+
+/*
+ * Events are allocated in one block along with their category and name
+ * Blocks of the standard size can be kept in a shared slab for reuse
+ */
+#define EVENTD_EVENT_SLAB_STRINGS_SIZE 128
+#define EVENTD_EVENT_SLAB_BLOCK_SIZE ( sizeof(EventdEvent) + EVENTD_EVENT_SLAB_STRINGS_SIZE )
+
 struct _EventdEvent {
-    guint64 refcount;
+    gatomicrefcount refcount;
     NkUuid uuid;
     gchar *category;
     gchar *name;
     gint64 timeout;
-    GHashTable *data;
+    struct {
+        gsize length;
+        gsize size;
+        EventdEventData *entries;
+        GHashTable *index;
+        EventdEventData inline_entries[EVENTD_EVENT_DATA_INLINE_SIZE];
+    } data;
+    struct {
+        GBytes *text;
+        GBytes *binary;
+    } message;
+    struct {
+        GMutex lock;
+        GHashTable *strings;
+    } cache;
+    gsize block_size;
+    gchar strings[];
 };
 
+EventdEvent *eventd_event_alloc(const gchar *category, const gchar *name);
+
+void eventd_event_clear_data(EventdEvent *event);
+void eventd_event_clear_caches(EventdEvent *event);
+
 #endif /* __EVENTD_EVENT_EVENT_PRIVATE_H__ */
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 
@@ -33,6 +35,126 @@
 EVENTD_EXPORT GType eventd_event_get_type(void);
 G_DEFINE_BOXED_TYPE(EventdEvent, eventd_event, eventd_event_ref, eventd_event_unref)
 
+/*
+ * Events are often created in one thread and freed in another,
+ * so the slab is shared, free blocks being chained through their first bytes
+ */
+static struct {
+    GMutex lock;
+    guint size;
+    gpointer blocks;
+    gsize length;
+} _eventd_event_slab;
+static EventdEventAllocationStats _eventd_event_stats;
+
+EVENTD_EXPORT
+EventdEvent *
+eventd_event_alloc(const gchar *category, const gchar *name)
+{
+    gsize category_size = ( category != NULL ) ? ( strlen(category) + 1 ) : 0;
+    gsize name_size = ( name != NULL ) ? ( strlen(name) + 1 ) : 0;
+    gsize size = sizeof(EventdEvent) + category_size + name_size;
+    EventdEvent *self = NULL;
+
+    if ( size <= EVENTD_EVENT_SLAB_BLOCK_SIZE )
+    {
+        size = EVENTD_EVENT_SLAB_BLOCK_SIZE;
+        g_mutex_lock(&_eventd_event_slab.lock);
+        if ( _eventd_event_slab.blocks != NULL )
+        {
+            self = _eventd_event_slab.blocks;
+            _eventd_event_slab.blocks = *(gpointer *) self;
+            --_eventd_event_slab.length;
+        }
+        g_mutex_unlock(&_eventd_event_slab.lock);
+    }
+
+    if ( self != NULL )
+        g_atomic_pointer_add(&_eventd_event_stats.recycled, 1);
+    else
+    {
+        self = g_malloc(size);
+        g_atomic_pointer_add(&_eventd_event_stats.allocated, 1);
+    }
+
+    memset(self, 0, sizeof(EventdEvent));
+    self->block_size = size;
+    if ( category != NULL )
+        self->category = memcpy(self->strings, category, category_size);
+    if ( name != NULL )
+        self->name = memcpy(self->strings + category_size, name, name_size);
+
+    return self;
+}
+
+static void
+_eventd_event_release(EventdEvent *self)
+{
+    if ( self->block_size == EVENTD_EVENT_SLAB_BLOCK_SIZE )
+    {
+        gboolean kept = FALSE;
+
+        g_mutex_lock(&_eventd_event_slab.lock);
+        if ( _eventd_event_slab.length < _eventd_event_slab.size )
+        {
+            *(gpointer *) self = _eventd_event_slab.blocks;
+            _eventd_event_slab.blocks = self;
+            ++_eventd_event_slab.length;
+            kept = TRUE;
+        }
+        g_mutex_unlock(&_eventd_event_slab.lock);
+
+        if ( kept )
+            return;
+    }
+
+    g_free(self);
+    g_atomic_pointer_add(&_eventd_event_stats.released, 1);
+}
+
+/*
+ * Enables the event slab, keeping up to size freed events
+ * to reuse their memory; 0, the default, disables it
+ */
+EVENTD_EXPORT
+void
+eventd_event_slab_set_size(guint size)
+{
+    gpointer blocks = NULL;
+
+    g_mutex_lock(&_eventd_event_slab.lock);
+    _eventd_event_slab.size = size;
+    while ( _eventd_event_slab.length > size )
+    {
+        gpointer block = _eventd_event_slab.blocks;
+        _eventd_event_slab.blocks = *(gpointer *) block;
+        --_eventd_event_slab.length;
+        *(gpointer *) block = blocks;
+        blocks = block;
+    }
+    g_mutex_unlock(&_eventd_event_slab.lock);
+
+    while ( blocks != NULL )
+    {
+        gpointer block = blocks;
+        blocks = *(gpointer *) block;
+        g_free(block);
+        g_atomic_pointer_add(&_eventd_event_stats.released, 1);
+    }
+}
+
+EVENTD_EXPORT
+void
+eventd_event_get_allocation_stats(EventdEventAllocationStats *stats)
+{
+    g_return_if_fail(stats != NULL);
+
+    stats->allocated = (gsize) g_atomic_pointer_get(&_eventd_event_stats.allocated);
+    stats->recycled = (gsize) g_atomic_pointer_get(&_eventd_event_stats.recycled);
+    stats->released = (gsize) g_atomic_pointer_get(&_eventd_event_stats.released);
+    stats->data_allocated = (gsize) g_atomic_pointer_get(&_eventd_event_stats.data_allocated);
+}
+
 
 /**
  * eventd_event_new:
@@ -59,9 +181,45 @@ eventd_event_new(const gchar *category, const gchar *name)
 static void
 _eventd_event_free(EventdEvent *self)
 {
-    if ( self->data != NULL )
-        g_hash_table_unref(self->data);
-    g_free(self->name);
+    eventd_event_clear_data(self);
+    eventd_event_clear_caches(self);
+    g_mutex_clear(&self->cache.lock);
+    _eventd_event_release(self);
+}
+
+static EventdEventData *
+_eventd_event_find_data(const EventdEvent *self, const gchar *name)
+{
+    gsize i;
+
+    if ( self->data.index != NULL )
+    {
+        i = GPOINTER_TO_SIZE(g_hash_table_lookup(self->data.index, name));
+        return ( i > 0 ) ? &self->data.entries[i - 1] : NULL;
+    }
+
+    for ( i = 0 ; i < self->data.length ; ++i )
+    {
+        if ( self->data.entries[i].name == name )
+            return &self->data.entries[i];
+    }
+    for ( i = 0 ; i < self->data.length ; ++i )
+    {
+        if ( g_str_equal(self->data.entries[i].name, name) )
+            return &self->data.entries[i];
+    }
+
+    return NULL;
+}
+
+static void
+_eventd_event_index_data(EventdEvent *self)
+{
+    gsize i;
+
+    self->data.index = g_hash_table_new(g_str_hash, g_str_equal);
+    for ( i = 0 ; i < self->data.length ; ++i )
+        g_hash_table_insert(self->data.index, (gpointer) self->data.entries[i].name, GSIZE_TO_POINTER(i + 1));
 }
 
 /**
@@ -78,7 +236,7 @@ eventd_event_ref(EventdEvent *self)
 {
     g_return_val_if_fail(self != NULL, NULL);
 
-    ++self->refcount;
+    g_atomic_ref_count_inc(&self->refcount);
 
     return self;
 }
@@ -99,7 +257,7 @@ eventd_event_unref(EventdEvent *self)
     if ( self == NULL )
         return;
 
-    if ( --self->refcount < 1 )
+    if ( g_atomic_ref_count_dec(&self->refcount) )
         _eventd_event_free(self);
 }
 
@@ -122,9 +280,52 @@ eventd_event_add_data(EventdEvent *self, gchar *name, GVariant *content)
     g_return_if_fail(name != NULL);
     g_return_if_fail(content != NULL);
 
-    if ( self->data == NULL )
-        self->data = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
-    g_hash_table_insert(self->data, name, g_variant_ref_sink(content));
+    gboolean interned;
+    EventdEventData *data;
+
+    interned = ( g_quark_try_string(name) != 0 );
+    if ( interned )
+    {
+        const gchar *key = g_intern_string(name);
+        g_free(name);
+        name = (gchar *) key;
+    }
+    content = g_variant_ref_sink(content);
+
+    data = _eventd_event_find_data(self, name);
+    if ( data != NULL )
+    {
+        if ( ! interned )
+            g_free(name);
+        g_variant_unref(data->value);
+        data->value = content;
+    }
+    else
+    {
+        if ( self->data.length == self->data.size )
+        {
+            self->data.size *= 2;
+            if ( self->data.entries == self->data.inline_entries )
+            {
+                self->data.entries = g_new(EventdEventData, self->data.size);
+                memcpy(self->data.entries, self->data.inline_entries, sizeof(self->data.inline_entries));
+                g_atomic_pointer_add(&_eventd_event_stats.data_allocated, 1);
+            }
+            else
+                self->data.entries = g_renew(EventdEventData, self->data.entries, self->data.size);
+        }
+
+        data = &self->data.entries[self->data.length++];
+        data->name = name;
+        data->interned = interned;
+        data->value = content;
+
+        if ( self->data.index != NULL )
+            g_hash_table_insert(self->data.index, name, GSIZE_TO_POINTER(self->data.length));
+        else if ( self->data.length > EVENTD_EVENT_DATA_INDEX_THRESHOLD )
+            _eventd_event_index_data(self);
+    }
+    eventd_event_clear_caches(self);
 }
 
 /**
@@ -214,10 +415,7 @@ eventd_event_has_data(const EventdEvent *self, const gchar *name)
     g_return_val_if_fail(self != NULL, FALSE);
     g_return_val_if_fail(name != NULL, FALSE);
 
-    if ( self->data == NULL )
-        return FALSE;
-
-    return g_hash_table_contains(self->data, name);
+    return ( _eventd_event_find_data(self, name) != NULL );
 }
 
 /**
@@ -236,10 +434,12 @@ eventd_event_get_data(const EventdEvent *self, const gchar *name)
     g_return_val_if_fail(self != NULL, NULL);
     g_return_val_if_fail(name != NULL, NULL);
 
-    if ( self->data == NULL )
+    EventdEventData *data;
+    data = _eventd_event_find_data(self, name);
+    if ( data == NULL )
         return NULL;
 
-    return g_hash_table_lookup(self->data, name);
+    return data->value;
 }
 
 /**
@@ -270,7 +470,7 @@ eventd_event_get_data_string(const EventdEvent *self, const gchar *name)
  * eventd_event_get_all_data:
  * @event: an #EventdEvent
  *
- * Retrieves the data table from the event.
+ * Retrieves a copy of the data table from the event.
  *
  * Returns: (nullable) (transfer container) (element-type utf8 GVariant): the data table
  */
@@ -280,8 +480,54 @@ eventd_event_get_all_data(const EventdEvent *self)
 {
     g_return_val_if_fail(self != NULL, NULL);
 
-    if ( self->data == NULL )
+    if ( self->data.length == 0 )
         return NULL;
 
-    return g_hash_table_ref(self->data);
+    GHashTable *data;
+    gsize i;
+
+    data = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+    for ( i = 0 ; i < self->data.length ; ++i )
+        g_hash_table_insert(data, g_strdup(self->data.entries[i].name), g_variant_ref(self->data.entries[i].value));
+
+    return data;
+}
+
+/*
+ * Rendered strings cache
+ *
+ * Used by libeventd-helpers so that every action
+ * rendering the same template for an event only does it once.
+ * The cache is dropped whenever the event data changes.
+ */
+EVENTD_EXPORT
+gchar *
+eventd_event_get_cached_string(EventdEvent *self, guint key)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+    g_return_val_if_fail(key != 0, NULL);
+
+    gchar *string = NULL;
+
+    g_mutex_lock(&self->cache.lock);
+    if ( self->cache.strings != NULL )
+        string = g_strdup(g_hash_table_lookup(self->cache.strings, GUINT_TO_POINTER(key)));
+    g_mutex_unlock(&self->cache.lock);
+
+    return string;
+}
+
+EVENTD_EXPORT
+void
+eventd_event_set_cached_string(EventdEvent *self, guint key, const gchar *string)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(key != 0);
+    g_return_if_fail(string != NULL);
+
+    g_mutex_lock(&self->cache.lock);
+    if ( self->cache.strings == NULL )
+        self->cache.strings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    g_hash_table_insert(self->cache.strings, GUINT_TO_POINTER(key), g_strdup(string));
+    g_mutex_unlock(&self->cache.lock);
 }
@@ -29,28 +29,22 @@
 #include "libeventd-event-private.h"
 #include "libeventd-protocol.h"
 
+#include "event-private.h"
 #include "protocol-evp-private.h"
 
 #define DATA_SAMPLE ".DATA test-data\nSome data to put inside\nAnd here is a new line\nThat should be enough\n.\n"
 
 static void
-_eventd_protocol_generate_data(GString *str, GHashTable *data)
+_eventd_protocol_generate_data(GString *str, EventdEvent *event)
 {
-    if ( data == NULL )
-        return;
-
-    GHashTableIter iter;
-    gchar *name;
-    GVariant *value;
-    g_hash_table_iter_init(&iter, data);
-    while ( g_hash_table_iter_next(&iter, (gpointer *) &name, (gpointer *) &value) )
+    gsize i;
+    for ( i = 0 ; i < event->data.length ; ++i )
     {
-        g_string_append_printf(str, "DATA %s ", name);
+        GVariant *value = event->data.entries[i].value;
+        g_string_append_printf(str, "DATA %s ", event->data.entries[i].name);
         g_variant_print_string(value, str, ! g_variant_is_of_type(value, G_VARIANT_TYPE_STRING));
         g_string_append_c(str, '\n');
     }
-
-    g_hash_table_unref(data);
 }
 
 /**
@@ -66,21 +60,18 @@ EVENTD_EXPORT
 gchar *
 eventd_protocol_generate_event(EventdProtocol *protocol, EventdEvent *event)
 {
-    GHashTable *data;
-    data = eventd_event_get_all_data(event);
-
-    if ( data == NULL )
+    if ( event->data.length == 0 )
         return g_strdup_printf("EVENT %s %s %s\n", eventd_event_get_uuid(event), eventd_event_get_category(event), eventd_event_get_name(event));
 
     gsize size;
-    size = strlen(".EVENT 1b4e28ba-2fa1-11d2-883f-0016d3cca427 test-category test-name\n.\n") + ( g_hash_table_size(data) * strlen(DATA_SAMPLE) );
+    size = strlen(".EVENT 1b4e28ba-2fa1-11d2-883f-0016d3cca427 test-category test-name\n.\n") + ( event->data.length * strlen(DATA_SAMPLE) );
 
     GString *str;
     str = g_string_sized_new(size);
 
     g_string_append_printf(str, ".EVENT %s %s %s\n", eventd_event_get_uuid(event), eventd_event_get_category(event), eventd_event_get_name(event));
 
-    _eventd_protocol_generate_data(str, data);
+    _eventd_protocol_generate_data(str, event);
 
     g_string_append(str, ".\n");
 
@@ -128,6 +119,56 @@ eventd_protocol_generate_subscribe(EventdProtocol *protocol, GHashTable *categor
     return g_string_free(str, FALSE);
 }
 
+static void
+_eventd_protocol_generate_filter_list(GString *str, const gchar *keyword, gchar **list)
+{
+    if ( list == NULL )
+        return;
+
+    for ( ; *list != NULL ; ++list )
+        g_string_append_printf(str, "%s %s\n", keyword, *list);
+}
+
+/**
+ * eventd_protocol_generate_subscribe_filter:
+ * @protocol: an #EventdProtocol
+ * @categories: (element-type utf8 utf8) (nullable): the categories of events you want to subscribe to as a set (key == value)
+ * @filter: (nullable): the conditions on the events data and the data to receive
+ *
+ * Generates a SUBSCRIBE message with a filter.
+ * Without any category, it subscribes to all events matching the filter.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+gchar *
+eventd_protocol_generate_subscribe_filter(EventdProtocol *protocol, GHashTable *categories, const EventdProtocolSubscribeFilter *filter)
+{
+    if ( filter == NULL )
+        return eventd_protocol_generate_subscribe(protocol, categories);
+
+    GString *str;
+    str = g_string_new(".SUBSCRIBE\n");
+
+    if ( categories != NULL )
+    {
+        GHashTableIter iter;
+        gchar *category;
+        g_hash_table_iter_init(&iter, categories);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &category, NULL) )
+            g_string_append_c(g_string_append(str, category), '\n');
+    }
+
+    _eventd_protocol_generate_filter_list(str, "IFDATA", filter->if_data);
+    _eventd_protocol_generate_filter_list(str, "IFDATAMATCHES", filter->if_data_matches);
+    _eventd_protocol_generate_filter_list(str, "IFDATAREGEX", filter->if_data_regexes);
+    _eventd_protocol_generate_filter_list(str, "ONLYDATA", filter->only_data);
+
+    g_string_append(str, ".\n");
+
+    return g_string_free(str, FALSE);
+}
+
 /**
  * eventd_protocol_generate_ping:
  * @protocol: an #EventdProtocol
@@ -161,3 +202,218 @@ eventd_protocol_generate_bye(EventdProtocol *protocol, const gchar *message)
 
     return g_strdup_printf("BYE %s\n", message);
 }
+
+/**
+ * eventd_protocol_generate_binary:
+ * @protocol: an #EventdProtocol
+ *
+ * Generates a BINARY message.
+ *
+ * If the peer already sent its own BINARY message, this acknowledges it
+ * and messages generated by the *_bytes() functions are binary frames from now on.
+ * Otherwise, this offers to switch and they will be once the peer acknowledges it.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+gchar *
+eventd_protocol_generate_binary(EventdProtocol *self)
+{
+    if ( self->binary.peer && ( ! self->binary.offered ) )
+        self->binary.output = TRUE;
+    else
+    {
+        self->binary.offered = TRUE;
+        self->binary.peer = FALSE;
+        self->binary.output = FALSE;
+    }
+
+    return g_strdup("BINARY\n");
+}
+
+/**
+ * eventd_protocol_is_binary:
+ * @protocol: an #EventdProtocol
+ *
+ * Returns: %TRUE if the *_bytes() functions generate binary frames
+ */
+EVENTD_EXPORT
+gboolean
+eventd_protocol_is_binary(EventdProtocol *self)
+{
+    return self->binary.output;
+}
+
+static GBytes *
+_eventd_protocol_evp_generate_frame(guchar type, GVariant *payload)
+{
+    gsize size = 0;
+    guint32 be_size;
+    gchar *frame;
+
+    if ( payload != NULL )
+    {
+        g_variant_ref_sink(payload);
+        if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+        {
+            /* Frames are little-endian on the wire */
+            GVariant *swapped = g_variant_byteswap(payload);
+            g_variant_unref(payload);
+            payload = swapped;
+        }
+        size = g_variant_get_size(payload);
+    }
+
+    frame = g_malloc(EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE + size);
+    frame[0] = (gchar) EVENTD_PROTOCOL_EVP_FRAME_MAGIC;
+    frame[1] = type;
+    be_size = GUINT32_TO_BE(size);
+    memcpy(frame + 2, &be_size, sizeof(guint32));
+
+    if ( payload != NULL )
+    {
+        g_variant_store(payload, frame + EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE);
+        g_variant_unref(payload);
+    }
+
+    return g_bytes_new_take(frame, EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE + size);
+}
+
+static GBytes *
+_eventd_protocol_evp_generate_text(gchar *message)
+{
+    return g_bytes_new_take(message, strlen(message));
+}
+
+static GBytes *
+_eventd_protocol_evp_generate_event_frame(EventdEvent *event)
+{
+    GVariantBuilder builder;
+    gsize i;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    for ( i = 0 ; i < event->data.length ; ++i )
+        g_variant_builder_add(&builder, "{sv}", event->data.entries[i].name, event->data.entries[i].value);
+
+    return _eventd_protocol_evp_generate_frame(EVENTD_PROTOCOL_EVP_FRAME_EVENT, g_variant_new("(sssa{sv})", eventd_event_get_uuid(event), eventd_event_get_category(event), eventd_event_get_name(event), &builder));
+}
+
+/**
+ * eventd_protocol_generate_event_bytes:
+ * @protocol: an #EventdProtocol
+ * @event: the #EventdEVent to generate a message for
+ *
+ * Generates an EVENT message, as a binary frame if negotiated.
+ *
+ * The message is cached on @event, so dispatching it to several peers
+ * only serializes it once per format.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+GBytes *
+eventd_protocol_generate_event_bytes(EventdProtocol *self, EventdEvent *event)
+{
+    if ( ! self->binary.output )
+    {
+        if ( event->message.text == NULL )
+            event->message.text = _eventd_protocol_evp_generate_text(eventd_protocol_generate_event(self, event));
+        return g_bytes_ref(event->message.text);
+    }
+
+    if ( event->message.binary == NULL )
+        event->message.binary = _eventd_protocol_evp_generate_event_frame(event);
+    return g_bytes_ref(event->message.binary);
+}
+
+/**
+ * eventd_protocol_generate_subscribe_bytes:
+ * @protocol: an #EventdProtocol
+ * @categories: (element-type utf8 utf8) (nullable): the categories of events you want to subscribe to as a set (key == value)
+ *
+ * Generates a SUBSCRIBE message, as a binary frame if negotiated.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+GBytes *
+eventd_protocol_generate_subscribe_bytes(EventdProtocol *self, GHashTable *categories)
+{
+    if ( ! self->binary.output )
+        return _eventd_protocol_evp_generate_text(eventd_protocol_generate_subscribe(self, categories));
+
+    GVariant *payload = NULL;
+    if ( ( categories != NULL ) && ( g_hash_table_size(categories) > 0 ) )
+    {
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        gchar *category;
+
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_STRING_ARRAY);
+        g_hash_table_iter_init(&iter, categories);
+        while ( g_hash_table_iter_next(&iter, (gpointer *) &category, NULL) )
+            g_variant_builder_add(&builder, "s", category);
+        payload = g_variant_builder_end(&builder);
+    }
+
+    return _eventd_protocol_evp_generate_frame(EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE, g_variant_new_maybe(G_VARIANT_TYPE_STRING_ARRAY, payload));
+}
+
+/**
+ * eventd_protocol_generate_subscribe_filter_bytes:
+ * @protocol: an #EventdProtocol
+ * @categories: (element-type utf8 utf8) (nullable): the categories of events you want to subscribe to as a set (key == value)
+ * @filter: (nullable): the conditions on the events data and the data to receive
+ *
+ * Generates a SUBSCRIBE message with a filter.
+ * There is no frame for filters, so this is always a text message,
+ * which peers accept even after switching to binary frames.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+GBytes *
+eventd_protocol_generate_subscribe_filter_bytes(EventdProtocol *self, GHashTable *categories, const EventdProtocolSubscribeFilter *filter)
+{
+    if ( filter == NULL )
+        return eventd_protocol_generate_subscribe_bytes(self, categories);
+
+    return _eventd_protocol_evp_generate_text(eventd_protocol_generate_subscribe_filter(self, categories, filter));
+}
+
+/**
+ * eventd_protocol_generate_ping_bytes:
+ * @protocol: an #EventdProtocol
+ *
+ * Generates a PING message, as a binary frame if negotiated.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+GBytes *
+eventd_protocol_generate_ping_bytes(EventdProtocol *self)
+{
+    if ( ! self->binary.output )
+        return _eventd_protocol_evp_generate_text(eventd_protocol_generate_ping(self));
+
+    return _eventd_protocol_evp_generate_frame(EVENTD_PROTOCOL_EVP_FRAME_PING, NULL);
+}
+
+/**
+ * eventd_protocol_generate_bye_bytes:
+ * @protocol: an #EventdProtocol
+ * @message: (nullable): an optional message to send
+ *
+ * Generates a BYE message, as a binary frame if negotiated.
+ *
+ * Returns: (transfer full): the message
+ */
+EVENTD_EXPORT
+GBytes *
+eventd_protocol_generate_bye_bytes(EventdProtocol *self, const gchar *message)
+{
+    if ( ! self->binary.output )
+        return _eventd_protocol_evp_generate_text(eventd_protocol_generate_bye(self, message));
+
+    return _eventd_protocol_evp_generate_frame(EVENTD_PROTOCOL_EVP_FRAME_BYE, g_variant_new_maybe(G_VARIANT_TYPE_STRING, ( message == NULL ) ? NULL : g_variant_new_string(message)));
+}
@@ -69,6 +69,16 @@ eventd_protocol_call_subscribe(EventdProtocol *self, GHashTable *subscriptions)
         self->callbacks->subscribe(self, subscriptions, self->user_data);
 }
 
+static inline void
+eventd_protocol_call_subscribe_filter(EventdProtocol *self, GHashTable *subscriptions, const EventdProtocolSubscribeFilter *filter)
+{
+    if ( self->callbacks->subscribe_filter != NULL )
+        self->callbacks->subscribe_filter(self, subscriptions, filter, self->user_data);
+    else
+        /* Not supported, the peer just gets more than it asked */
+        eventd_protocol_call_subscribe(self, subscriptions);
+}
+
 static inline void
 eventd_protocol_call_ping(EventdProtocol *self)
 {
@@ -83,6 +93,13 @@ eventd_protocol_call_bye(EventdProtocol *self, const gchar *message)
         self->callbacks->bye(self, message, self->user_data);
 }
 
+static inline void
+eventd_protocol_call_binary(EventdProtocol *self)
+{
+    if ( self->callbacks->binary != NULL )
+        self->callbacks->binary(self, self->user_data);
+}
+
 static gboolean
 _eventd_protocol_evp_parse_dot__continue_noeat(EventdProtocol *self, const gchar *line, GError **error)
 {
@@ -139,12 +156,6 @@ _eventd_protocol_evp_parse_dot_event_start(EventdProtocol *self, const gchar * c
 static void
 _eventd_protocol_evp_parse_dot_event_end(EventdProtocol *self, GError **error)
 {
-    if ( self->data.hash != NULL )
-    {
-        eventd_event_set_all_data(self->event, self->data.hash);
-        self->data.hash = NULL;
-    }
-
     eventd_protocol_call_event(self, self->event);
 
     eventd_event_unref(self->event);
@@ -154,6 +165,36 @@ _eventd_protocol_evp_parse_dot_event_end(EventdProtocol *self, GError **error)
 }
 
 /* .SUBSCRIBE */
+static const gchar * const _eventd_protocol_evp_filter_keywords[_EVENTD_PROTOCOL_EVP_FILTER_SIZE] = {
+    [EVENTD_PROTOCOL_EVP_FILTER_IF_DATA]         = "IFDATA ",
+    [EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_MATCHES] = "IFDATAMATCHES ",
+    [EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_REGEX]   = "IFDATAREGEX ",
+    [EVENTD_PROTOCOL_EVP_FILTER_ONLY_DATA]       = "ONLYDATA ",
+};
+
+static void
+_eventd_protocol_evp_parse_filter_clear(EventdProtocol *self)
+{
+    EventdProtocolFilterType type;
+
+    for ( type = 0 ; type < _EVENTD_PROTOCOL_EVP_FILTER_SIZE ; ++type )
+    {
+        if ( self->filter[type] != NULL )
+            g_ptr_array_unref(self->filter[type]);
+        self->filter[type] = NULL;
+    }
+}
+
+static gchar **
+_eventd_protocol_evp_parse_filter_list(EventdProtocol *self, EventdProtocolFilterType type)
+{
+    if ( self->filter[type] == NULL )
+        return NULL;
+
+    g_ptr_array_add(self->filter[type], NULL);
+    return (gchar **) self->filter[type]->pdata;
+}
+
 static void
 _eventd_protocol_evp_parse_dot_subscribe_start(EventdProtocol *self, const gchar * const *argv, GError **error)
 {
@@ -166,6 +207,21 @@ _eventd_protocol_evp_parse_dot_subscribe_start(EventdProtocol *self, const gchar
 static gboolean
 _eventd_protocol_evp_parse_dot_subscribe_continue(EventdProtocol *self, const gchar *line, GError **error)
 {
+    EventdProtocolFilterType type;
+
+    /* Categories cannot contain spaces, so these cannot be mistaken for one */
+    for ( type = 0 ; type < _EVENTD_PROTOCOL_EVP_FILTER_SIZE ; ++type )
+    {
+        const gchar *keyword = _eventd_protocol_evp_filter_keywords[type];
+        if ( ! g_str_has_prefix(line, keyword) )
+            continue;
+
+        if ( self->filter[type] == NULL )
+            self->filter[type] = g_ptr_array_new_with_free_func(g_free);
+        g_ptr_array_add(self->filter[type], g_strdup(line + strlen(keyword)));
+        return TRUE;
+    }
+
     g_hash_table_add(self->subscriptions, g_strdup(line));
     return TRUE;
 }
@@ -173,13 +229,32 @@ _eventd_protocol_evp_parse_dot_subscribe_continue(EventdProtocol *self, const gc
 static void
 _eventd_protocol_evp_parse_dot_subscribe_end(EventdProtocol *self, GError **error)
 {
-    if ( g_hash_table_size(self->subscriptions) < 2 )
+    EventdProtocolFilterType type;
+    gboolean filtered = FALSE;
+
+    for ( type = 0 ; type < _EVENTD_PROTOCOL_EVP_FILTER_SIZE ; ++type )
+        filtered = filtered || ( self->filter[type] != NULL );
+
+    if ( filtered )
+    {
+        EventdProtocolSubscribeFilter filter = {
+            .if_data = _eventd_protocol_evp_parse_filter_list(self, EVENTD_PROTOCOL_EVP_FILTER_IF_DATA),
+            .if_data_matches = _eventd_protocol_evp_parse_filter_list(self, EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_MATCHES),
+            .if_data_regexes = _eventd_protocol_evp_parse_filter_list(self, EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_REGEX),
+            .only_data = _eventd_protocol_evp_parse_filter_list(self, EVENTD_PROTOCOL_EVP_FILTER_ONLY_DATA),
+        };
+
+        /* No category means all events */
+        eventd_protocol_call_subscribe_filter(self, ( g_hash_table_size(self->subscriptions) > 0 ) ? self->subscriptions : NULL, &filter);
+        _eventd_protocol_evp_parse_filter_clear(self);
+    }
+    else if ( g_hash_table_size(self->subscriptions) < 2 )
     {
         g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "SUBSCRIBE dot message requires at least two categories");
         return;
     }
-
-    eventd_protocol_call_subscribe(self, self->subscriptions);
+    else
+        eventd_protocol_call_subscribe(self, self->subscriptions);
 
     g_hash_table_unref(self->subscriptions);
     self->subscriptions = NULL;
@@ -202,9 +277,7 @@ _eventd_protocol_evp_parse_data(EventdProtocol *self, const gchar * const *argv,
         return;
     }
 
-    if ( self->data.hash == NULL )
-        self->data.hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
-    g_hash_table_insert(self->data.hash, g_strdup(argv[0]), g_variant_ref_sink(value));
+    eventd_event_add_data(self->event, g_strdup(argv[0]), value);
 }
 
 /* EVENT */
@@ -256,6 +329,19 @@ _eventd_protocol_evp_parse_bye(EventdProtocol *self, const gchar * const *argv,
     self->state = self->base_state;
 }
 
+/* BINARY */
+static void
+_eventd_protocol_evp_parse_binary(EventdProtocol *self, const gchar * const *argv, GError **error)
+{
+    /* The peer sends binary frames from now on */
+    self->binary.peer = TRUE;
+
+    if ( self->binary.offered )
+        self->binary.output = TRUE;
+    else
+        eventd_protocol_call_binary(self);
+}
+
 static const EventdProtocolTokens _eventd_protocol_evp_dot_messages[] = {
     {"EVENT", 3, 3,
             { EVENTD_PROTOCOL_EVP_STATE_BASE, EVENTD_PROTOCOL_EVP_STATE_SUBSCRIBE, _EVENTD_PROTOCOL_EVP_STATE_SIZE },
@@ -308,20 +394,101 @@ static const EventdProtocolTokens _eventd_protocol_evp_messages[] = {
             _eventd_protocol_evp_parse_bye,
             _EVENTD_PROTOCOL_EVP_STATE_SIZE, NULL, NULL
     },
+    {"BINARY", 0, 0,
+            { EVENTD_PROTOCOL_EVP_STATE_BASE, EVENTD_PROTOCOL_EVP_STATE_SUBSCRIBE, _EVENTD_PROTOCOL_EVP_STATE_SIZE },
+            _eventd_protocol_evp_parse_binary,
+            _EVENTD_PROTOCOL_EVP_STATE_SIZE, NULL, NULL
+    },
     { .message = NULL }
 };
 
+/*
+ * Keywords are dispatched through a perfect hash of their first two
+ * characters and their length, then checked in full
+ */
+#define EVENTD_PROTOCOL_EVP_KEYWORD_HASH(c0, c1, l) ( ( (guchar) (c0) + (guchar) (c1) + (l) ) % 9 )
+#define EVENTD_PROTOCOL_EVP_KEYWORD_HASH_SIZE 9
+#define EVENTD_PROTOCOL_EVP_MAX_ARGS 3
+
+static const EventdProtocolTokens *_eventd_protocol_evp_dot_messages_hash[EVENTD_PROTOCOL_EVP_KEYWORD_HASH_SIZE] = {
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('E', 'V', 5)] = &_eventd_protocol_evp_dot_messages[0],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('S', 'U', 9)] = &_eventd_protocol_evp_dot_messages[1],
+};
+
+static const EventdProtocolTokens *_eventd_protocol_evp_messages_hash[EVENTD_PROTOCOL_EVP_KEYWORD_HASH_SIZE] = {
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('D', 'A', 4)] = &_eventd_protocol_evp_messages[0],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('E', 'V', 5)] = &_eventd_protocol_evp_messages[1],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('S', 'U', 9)] = &_eventd_protocol_evp_messages[2],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('P', 'I', 4)] = &_eventd_protocol_evp_messages[3],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('B', 'Y', 3)] = &_eventd_protocol_evp_messages[4],
+    [EVENTD_PROTOCOL_EVP_KEYWORD_HASH('B', 'I', 6)] = &_eventd_protocol_evp_messages[5],
+};
+
+static const EventdProtocolTokens *
+_eventd_protocol_evp_lookup_message(const EventdProtocolTokens * const *hash, const gchar *keyword, gsize length)
+{
+    const EventdProtocolTokens *message;
+
+    if ( length == 0 )
+        return NULL;
+
+    message = hash[EVENTD_PROTOCOL_EVP_KEYWORD_HASH(keyword[0], keyword[1], length)];
+    if ( ( message == NULL ) || ( strncmp(message->message, keyword, length) != 0 ) || ( message->message[length] != '\0' ) )
+        return NULL;
+
+    return message;
+}
+
+static gboolean
+_eventd_protocol_evp_check_state(EventdProtocol *self, const EventdProtocolTokens *message, GError **error)
+{
+    const EventdProtocolState *state;
+    for ( state = message->start_states ; *state != _EVENTD_PROTOCOL_EVP_STATE_SIZE ; ++state )
+    {
+        if ( self->state == *state )
+            return TRUE;
+    }
+
+    g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_UNEXPECTED_TOKEN, "Message '%s' in an invalid state '%s'", message->message, _eventd_protocol_evp_states[self->state]);
+    return FALSE;
+}
+
+static gsize
+_eventd_protocol_evp_split_args(gchar *args, const gchar **argv, gsize max_args)
+{
+    gsize argc = 0;
+
+    if ( *args != '\0' )
+    {
+        argv[argc++] = args;
+        while ( ( argc < max_args ) && ( ( args = strchr(args, ' ') ) != NULL ) )
+        {
+            *args++ = '\0';
+            argv[argc++] = args;
+        }
+    }
+    argv[argc] = NULL;
+
+    return argc;
+}
+
 static void
-_eventd_protocol_evp_parse_line(EventdProtocol *self, const gchar *line, GError **error)
+_eventd_protocol_evp_parse_line(EventdProtocol *self, gchar *line, gsize length, GError **error)
 {
-    eventd_debug("[%s] Parse line: %.255s%s", _eventd_protocol_evp_states[self->state], line, ( strlen(line) > 255 ) ? " […]" : "");
+    eventd_debug("[%s] Parse line: %.255s%s", _eventd_protocol_evp_states[self->state], line, ( length > 255 ) ? " […]" : "");
 
     const EventdProtocolTokens *message;
 
+    if ( ! g_utf8_validate(line, length, NULL) )
+    {
+        g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_GARBAGE, "Got invalid UTF-8 line");
+        return;
+    }
+
     /*
      * Handle the end of a dot message
      */
-    if ( g_strcmp0(line, ".") == 0 )
+    if ( ( line[0] == '.' ) && ( line[1] == '\0' ) )
     {
         for ( message = _eventd_protocol_evp_dot_messages ; message->message != NULL ; ++message )
         {
@@ -352,58 +519,222 @@ _eventd_protocol_evp_parse_line(EventdProtocol *self, const gchar *line, GError
      * or the dot message did not eat the line
      */
 
-    const EventdProtocolState *state;
-    if ( g_str_has_prefix(line, ".") )
+    gchar *args;
+    gsize keyword_length;
+
+    args = strchr(line, ' ');
+    if ( line[0] == '.' )
     {
-        message = _eventd_protocol_evp_dot_messages;
         ++line;
+        keyword_length = ( args != NULL ) ? (gsize) ( args - line ) : ( length - 1 );
+        message = _eventd_protocol_evp_lookup_message(_eventd_protocol_evp_dot_messages_hash, line, keyword_length);
+        if ( message == NULL )
+            /* Catch-all message to ignore future dot messages */
+            message = &_eventd_protocol_evp_dot_messages[G_N_ELEMENTS(_eventd_protocol_evp_dot_messages) - 2];
     }
     else
-        message = _eventd_protocol_evp_messages;
+    {
+        keyword_length = ( args != NULL ) ? (gsize) ( args - line ) : length;
+        message = _eventd_protocol_evp_lookup_message(_eventd_protocol_evp_messages_hash, line, keyword_length);
+        if ( message == NULL )
+            return;
+    }
 
-    for ( ; message->message != NULL ; ++message )
+    const gchar *argv_[EVENTD_PROTOCOL_EVP_MAX_ARGS + 1];
+    const gchar **argv = NULL;
+    if ( args != NULL )
     {
-        if ( ! g_str_has_prefix(line, message->message) )
-            continue;
-        const gchar *args = line + strlen(message->message);
-        gchar **argv = NULL;
-        if ( g_str_has_prefix(args, " ") )
+        ++args;
+        if ( message->max_args < 1 )
         {
-            ++args;
-            if ( message->max_args < 1 )
-            {
-                g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does not take arguments, but got '%s'", message->message, args);
-                return;
-            }
-
-            gsize argc;
-            argv = g_strsplit(args, " ", message->max_args);
-            argc = g_strv_length(argv);
-            if ( argc < message->min_args )
-            {
-                g_strfreev(argv);
-                g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does take at least %" G_GSIZE_FORMAT " arguments, but got %" G_GSIZE_FORMAT, message->message, message->min_args, argc);
-                return;
-            }
+            g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does not take arguments, but got '%s'", message->message, args);
+            return;
         }
-        else if ( message->min_args > 0 )
+
+        gsize argc;
+        argv = argv_;
+        argc = _eventd_protocol_evp_split_args(args, argv, MIN(message->max_args, EVENTD_PROTOCOL_EVP_MAX_ARGS));
+        if ( argc < message->min_args )
         {
-            g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does take at least %" G_GSIZE_FORMAT " arguments, but got none", message->message, message->min_args);
+            g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does take at least %" G_GSIZE_FORMAT " arguments, but got %" G_GSIZE_FORMAT, message->message, message->min_args, argc);
             return;
         }
+    }
+    else if ( message->min_args > 0 )
+    {
+        g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Message '%s' does take at least %" G_GSIZE_FORMAT " arguments, but got none", message->message, message->min_args);
+        return;
+    }
+
+    if ( _eventd_protocol_evp_check_state(self, message, error) )
+        message->start_func(self, argv, error);
+}
+
+static void
+_eventd_protocol_evp_parse_frame(EventdProtocol *self, guchar type, const gchar *payload, gsize length, GError **error)
+{
+    const EventdProtocolTokens *message;
+    const GVariantType *payload_type;
+
+    switch ( type )
+    {
+    case EVENTD_PROTOCOL_EVP_FRAME_EVENT:
+        message = &_eventd_protocol_evp_messages[1];
+        payload_type = G_VARIANT_TYPE(EVENTD_PROTOCOL_EVP_FRAME_EVENT_TYPE);
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE:
+        message = &_eventd_protocol_evp_messages[2];
+        payload_type = G_VARIANT_TYPE(EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE_TYPE);
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_PING:
+        message = &_eventd_protocol_evp_messages[3];
+        payload_type = NULL;
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_BYE:
+        message = &_eventd_protocol_evp_messages[4];
+        payload_type = G_VARIANT_TYPE(EVENTD_PROTOCOL_EVP_FRAME_BYE_TYPE);
+    break;
+    default:
+        g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Unknown frame type %#x", type);
+        return;
+    }
+
+    eventd_debug("[%s] Parse %s frame: %" G_GSIZE_FORMAT " bytes", _eventd_protocol_evp_states[self->state], message->message, length);
+
+    if ( ! _eventd_protocol_evp_check_state(self, message, error) )
+        return;
+
+    GVariant *value = NULL;
+    if ( payload_type != NULL )
+    {
+        /* Untrusted data, GVariant will check it when accessed */
+        GBytes *bytes = g_bytes_new(payload, length);
+        value = g_variant_ref_sink(g_variant_new_from_bytes(payload_type, bytes, FALSE));
+        g_bytes_unref(bytes);
+        if ( G_BYTE_ORDER == G_BIG_ENDIAN )
+        {
+            /* Frames are little-endian on the wire */
+            GVariant *swapped = g_variant_byteswap(value);
+            g_variant_unref(value);
+            value = swapped;
+        }
+    }
+
+    switch ( type )
+    {
+    case EVENTD_PROTOCOL_EVP_FRAME_EVENT:
+    {
+        const gchar *argv[4] = { NULL };
+        GVariantIter *data;
+        EventdEvent *event;
 
-        gboolean valid = FALSE;
-        for ( state = message->start_states ; *state != _EVENTD_PROTOCOL_EVP_STATE_SIZE ; ++state )
+        g_variant_get(value, "(&s&s&sa{sv})", &argv[0], &argv[1], &argv[2], &data);
+        event = _eventd_protocol_evp_parser_get_event(self, argv, error);
+        if ( event != NULL )
         {
-            if ( self->state == *state )
-                valid = TRUE;
+            gchar *name;
+            GVariant *content;
+            while ( g_variant_iter_next(data, "{sv}", &name, &content) )
+            {
+                eventd_event_add_data(event, name, content);
+                g_variant_unref(content);
+            }
+
+            eventd_protocol_call_event(self, event);
+            eventd_event_unref(event);
         }
-        if ( valid )
-            message->start_func(self, (const gchar * const *) argv, error);
+        g_variant_iter_free(data);
+    }
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE:
+    {
+        GVariant *categories = NULL;
+        g_variant_get(value, "m@as", &categories);
+        if ( categories == NULL )
+            eventd_protocol_call_subscribe(self, NULL);
         else
-            g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_UNEXPECTED_TOKEN, "Message '%s' in an invalid state '%s'", message->message, _eventd_protocol_evp_states[self->state]);
-        return;
+        {
+            GHashTable *subscriptions;
+            const gchar **strv, **category;
+
+            strv = g_variant_get_strv(categories, NULL);
+            subscriptions = g_hash_table_new(g_str_hash, g_str_equal);
+            for ( category = strv ; *category != NULL ; ++category )
+                g_hash_table_add(subscriptions, (gpointer) *category);
+            eventd_protocol_call_subscribe(self, subscriptions);
+            g_hash_table_unref(subscriptions);
+            g_free(strv);
+            g_variant_unref(categories);
+        }
+
+        self->base_state = EVENTD_PROTOCOL_EVP_STATE_SUBSCRIBE;
+        self->state = self->base_state;
     }
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_PING:
+        eventd_protocol_call_ping(self);
+    break;
+    case EVENTD_PROTOCOL_EVP_FRAME_BYE:
+    {
+        const gchar *bye_message = NULL;
+        g_variant_get(value, "m&s", &bye_message);
+        _eventd_protocol_evp_parse_bye(self, ( bye_message == NULL ) ? NULL : &bye_message, error);
+    }
+    break;
+    }
+
+    if ( value != NULL )
+        g_variant_unref(value);
+}
+
+static gsize
+_eventd_protocol_evp_frame_size(const gchar *header, GError **error)
+{
+    guint32 size;
+
+    memcpy(&size, header + 2, sizeof(guint32));
+    size = GUINT32_FROM_BE(size);
+    if ( size > EVENTD_PROTOCOL_EVP_FRAME_MAX_SIZE )
+    {
+        g_set_error(error, EVENTD_PROTOCOL_PARSE_ERROR, EVENTD_PROTOCOL_PARSE_ERROR_MALFORMED, "Frame too big: %" G_GUINT32_FORMAT " bytes", size);
+        return 0;
+    }
+
+    return EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE + size;
+}
+
+static gboolean
+_eventd_protocol_evp_parse_error(EventdProtocol *self, GError *_inner_error_, GError **error)
+{
+    if ( _inner_error_ == NULL )
+        return TRUE;
+
+    eventd_protocol_evp_parse_free(self);
+
+    g_propagate_error(error, _inner_error_);
+    return FALSE;
+}
+
+static void
+_eventd_protocol_evp_line_append(EventdProtocol *self, const gchar *data, gsize length)
+{
+    if ( ( self->line.length + length + 1 ) > self->line.size )
+    {
+        self->line.size = MAX(self->line.size * 2, self->line.length + length + 1);
+        self->line.buffer = g_realloc(self->line.buffer, self->line.size);
+    }
+    memcpy(self->line.buffer + self->line.length, data, length);
+    self->line.length += length;
+    self->line.buffer[self->line.length] = '\0';
+}
+
+static void
+_eventd_protocol_evp_line_parse(EventdProtocol *self, GError **error)
+{
+    gsize length = self->line.length;
+
+    self->line.length = 0;
+    _eventd_protocol_evp_parse_line(self, self->line.buffer, length, error);
 }
 
 /**
@@ -414,6 +745,7 @@ _eventd_protocol_evp_parse_line(EventdProtocol *self, const gchar *line, GError
  * @error: (out) (optional): return location for error or %NULL to ignore
  *
  * Parses @buffer for messages.
+ * @buffer must contain complete lines, the last one may miss its newline.
  *
  * Returns: %FALSE if there was an error, %TRUE otherwise
  */
@@ -425,23 +757,128 @@ eventd_protocol_parse(EventdProtocol *self, gchar *buffer, gsize length, GError
 
     GError *_inner_error_ = NULL;
 
-    gchar *sl, *el;
-    for ( sl = buffer, el = g_utf8_strchr(sl, length, '\n'); ( el != NULL ) && ( _inner_error_ == NULL ) ; sl = el + 1, el = g_utf8_strchr(sl, length - ( sl - buffer ), '\n') )
+    const gchar *sl, *el, *end = buffer + length;
+    for ( sl = buffer ; ( _inner_error_ == NULL ) && ( sl < end ) ; sl = el + 1 )
     {
-        *el = '\0';
-        _eventd_protocol_evp_parse_line(self, sl, &_inner_error_);
+        el = memchr(sl, '\n', end - sl);
+        if ( el == NULL )
+            el = end;
+
+        _eventd_protocol_evp_line_append(self, sl, el - sl);
+        _eventd_protocol_evp_line_parse(self, &_inner_error_);
     }
 
-    if ( ( _inner_error_ == NULL ) && ( sl < ( buffer + length ) ) )
-        _eventd_protocol_evp_parse_line(self, sl, &_inner_error_);
+    return _eventd_protocol_evp_parse_error(self, _inner_error_, error);
+}
 
-    if ( _inner_error_ == NULL )
-        return TRUE;
+static gsize
+_eventd_protocol_evp_frame_append(EventdProtocol *self, const gchar *data, gsize length, GError **error)
+{
+    gsize needed, eaten = 0;
 
-    eventd_protocol_evp_parse_free(self);
+    needed = MIN(length, self->line.frame - self->line.length);
+    _eventd_protocol_evp_line_append(self, data, needed);
+    eaten += needed;
 
-    g_propagate_error(error, _inner_error_);
-    return FALSE;
+    if ( ( self->line.frame == EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE ) && ( self->line.length == EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE ) )
+    {
+        self->line.frame = _eventd_protocol_evp_frame_size(self->line.buffer, error);
+        if ( self->line.frame == 0 )
+            return eaten;
+
+        needed = MIN(length - eaten, self->line.frame - self->line.length);
+        _eventd_protocol_evp_line_append(self, data + eaten, needed);
+        eaten += needed;
+    }
+
+    if ( self->line.length == self->line.frame )
+    {
+        gsize size = self->line.frame;
+
+        self->line.frame = 0;
+        self->line.length = 0;
+        _eventd_protocol_evp_parse_frame(self, self->line.buffer[1], self->line.buffer + EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE, size - EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE, error);
+    }
+
+    return eaten;
+}
+
+/**
+ * eventd_protocol_parse_chunk:
+ * @protocol: an #EventdProtocol
+ * @buffer: (array length=length): the bytes to parse
+ * @length: length of @buffer
+ * @error: (out) (optional): return location for error or %NULL to ignore
+ *
+ * Parses raw bytes as read from a stream, in chunks of any size.
+ * Complete lines are tokenized in place, so @buffer is modified.
+ * An incomplete trailing line or frame is kept until a following call completes it.
+ *
+ * Once the peer switched to binary frames (see eventd_protocol_generate_binary()),
+ * both frames and text lines are accepted.
+ *
+ * Do not mix calls to this function and eventd_protocol_parse()
+ * on the same @protocol.
+ *
+ * Returns: %FALSE if there was an error, %TRUE otherwise
+ */
+EVENTD_EXPORT
+gboolean
+eventd_protocol_parse_chunk(EventdProtocol *self, gchar *buffer, gsize length, GError **error)
+{
+    g_return_val_if_fail(self->state != _EVENTD_PROTOCOL_EVP_STATE_SIZE, FALSE);
+
+    GError *_inner_error_ = NULL;
+
+    gchar *sl = buffer, *el, *end = buffer + length;
+
+    while ( ( _inner_error_ == NULL ) && ( sl < end ) )
+    {
+        if ( ( self->line.length == 0 ) && self->binary.peer && ( (guchar) *sl == EVENTD_PROTOCOL_EVP_FRAME_MAGIC ) )
+        {
+            gsize size;
+            if ( ( (gsize) ( end - sl ) >= EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE ) && ( ( size = _eventd_protocol_evp_frame_size(sl, &_inner_error_) ) <= (gsize) ( end - sl ) ) )
+            {
+                /* Complete frame in the chunk, no copy needed */
+                if ( _inner_error_ == NULL )
+                    _eventd_protocol_evp_parse_frame(self, sl[1], sl + EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE, size - EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE, &_inner_error_);
+                sl += size;
+                continue;
+            }
+            if ( _inner_error_ != NULL )
+                break;
+            self->line.frame = EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE;
+        }
+
+        if ( self->line.frame > 0 )
+        {
+            /* Complete the frame started in a previous chunk */
+            sl += _eventd_protocol_evp_frame_append(self, sl, end - sl, &_inner_error_);
+            continue;
+        }
+
+        el = memchr(sl, '\n', end - sl);
+        if ( el == NULL )
+        {
+            _eventd_protocol_evp_line_append(self, sl, end - sl);
+            break;
+        }
+
+        if ( self->line.length > 0 )
+        {
+            /* Complete the line started in a previous chunk */
+            _eventd_protocol_evp_line_append(self, sl, el - sl);
+            _eventd_protocol_evp_line_parse(self, &_inner_error_);
+        }
+        else
+        {
+            *el = '\0';
+            _eventd_protocol_evp_parse_line(self, sl, el - sl, &_inner_error_);
+        }
+        sl = el + 1;
+    }
+
+    return _eventd_protocol_evp_parse_error(self, _inner_error_, error);
 }
 
 void
@@ -450,20 +887,20 @@ eventd_protocol_evp_parse_free(EventdProtocol *self)
     switch ( self->state )
     {
     case EVENTD_PROTOCOL_EVP_STATE_DOT_EVENT:
-        if ( self->data.hash != NULL )
-            g_hash_table_unref(self->data.hash);
-        self->data.hash = NULL;
-
         eventd_event_unref(self->event);
         self->event = NULL;
     break;
     case EVENTD_PROTOCOL_EVP_STATE_DOT_SUBSCRIBE:
         g_hash_table_unref(self->subscriptions);
         self->subscriptions = NULL;
+        _eventd_protocol_evp_parse_filter_clear(self);
     break;
     default:
     break;
     }
 
+    self->line.length = 0;
+    self->line.frame = 0;
+
     self->state = _EVENTD_PROTOCOL_EVP_STATE_SIZE;
 }
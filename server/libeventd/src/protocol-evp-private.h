@@ -32,6 +32,31 @@ typedef enum {
     _EVENTD_PROTOCOL_EVP_STATE_SIZE
 } EventdProtocolState;
 
+typedef enum {
+    EVENTD_PROTOCOL_EVP_FILTER_IF_DATA,
+    EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_MATCHES,
+    EVENTD_PROTOCOL_EVP_FILTER_IF_DATA_REGEX,
+    EVENTD_PROTOCOL_EVP_FILTER_ONLY_DATA,
+    _EVENTD_PROTOCOL_EVP_FILTER_SIZE
+} EventdProtocolFilterType;
+
+/*
+ * Binary frames: magic byte (never valid UTF-8), type byte,
+ * big-endian 32-bit payload size, serialized GVariant payload
+ */
+#define EVENTD_PROTOCOL_EVP_FRAME_MAGIC 0xff
+#define EVENTD_PROTOCOL_EVP_FRAME_HEADER_SIZE 6
+#define EVENTD_PROTOCOL_EVP_FRAME_MAX_SIZE ( 16 * 1024 * 1024 )
+
+#define EVENTD_PROTOCOL_EVP_FRAME_EVENT     'E'
+#define EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE 'S'
+#define EVENTD_PROTOCOL_EVP_FRAME_PING      'P'
+#define EVENTD_PROTOCOL_EVP_FRAME_BYE       'B'
+
+#define EVENTD_PROTOCOL_EVP_FRAME_EVENT_TYPE     "(sssa{sv})"
+#define EVENTD_PROTOCOL_EVP_FRAME_SUBSCRIBE_TYPE "mas"
+#define EVENTD_PROTOCOL_EVP_FRAME_BYE_TYPE       "ms"
+
 struct _EventdProtocol {
     guint64 refcount;
 
@@ -48,12 +73,23 @@ struct _EventdProtocol {
         EventdEvent *event;
         GHashTable *subscriptions;
     };
+    GPtrArray *filter[_EVENTD_PROTOCOL_EVP_FILTER_SIZE];
     struct {
-        GHashTable *hash;
         EventdProtocolState return_state;
         gchar *name;
         GString *value;
     } data;
+    struct {
+        gchar *buffer;
+        gsize length;
+        gsize size;
+        gsize frame;
+    } line;
+    struct {
+        gboolean offered;
+        gboolean peer;
+        gboolean output;
+    } binary;
 };
 
 gboolean eventd_protocol_evp_parse(EventdProtocol *protocol, const gchar *buffer, GError **error);
@@ -41,6 +41,8 @@ _eventd_protocol_evp_free(EventdProtocol *protocol)
 
     eventd_protocol_evp_parse_free(self);
 
+    g_free(self->line.buffer);
+
     g_free(self);
 }
 
@@ -106,6 +108,30 @@ eventd_protocol_new(const EventdProtocolCallbacks *callbacks, gpointer user_data
     return self;
 }
 
+/**
+ * eventd_protocol_reset:
+ * @protocol: an #EventdProtocol
+ *
+ * Resets @protocol to its initial state, dropping any partially parsed
+ * message and the binary frames negotiation.
+ * Use it before reusing @protocol for a new connection.
+ */
+EVENTD_EXPORT
+void
+eventd_protocol_reset(EventdProtocol *self)
+{
+    g_return_if_fail(self != NULL);
+
+    eventd_protocol_evp_parse_free(self);
+
+    self->state = EVENTD_PROTOCOL_EVP_STATE_BASE;
+    self->base_state = EVENTD_PROTOCOL_EVP_STATE_BASE;
+    self->catchall.level = 0;
+    self->binary.offered = FALSE;
+    self->binary.peer = FALSE;
+    self->binary.output = FALSE;
+}
+
 
 /*
  * EventdProtocolParseError
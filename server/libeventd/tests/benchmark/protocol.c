@@ -0,0 +1,177 @@
+/*
+ * eventd - Small daemon to act on remote or local events
+ *
+ * Copyright © 2011-2024 Morgane "Sardem FF7" Glidic
+ *
+ * This file is part of eventd.
+ *
+ * eventd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eventd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with eventd. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "libeventd-event.h"
+#include "libeventd-protocol.h"
+
+#define EVENTS 10000
+
+typedef struct {
+    EventdProtocol *sender;
+    EventdProtocol *receiver;
+    EventdEvent *events[EVENTS];
+    GBytes *stream;
+    guint received;
+} EventdProtocolBenchmarkFixture;
+
+static void
+_eventd_protocol_benchmark_event(EventdProtocol *protocol, EventdEvent *event, gpointer user_data)
+{
+    EventdProtocolBenchmarkFixture *fixture = user_data;
+
+    ++fixture->received;
+}
+
+static const EventdProtocolCallbacks _callbacks = {
+    .event = _eventd_protocol_benchmark_event,
+};
+
+static void
+_eventd_protocol_benchmark_negotiate(EventdProtocolBenchmarkFixture *fixture)
+{
+    gchar *message;
+
+    message = eventd_protocol_generate_binary(fixture->sender);
+    g_assert_true(eventd_protocol_parse_chunk(fixture->receiver, message, strlen(message), NULL));
+    g_free(message);
+
+    message = eventd_protocol_generate_binary(fixture->receiver);
+    g_assert_true(eventd_protocol_parse_chunk(fixture->sender, message, strlen(message), NULL));
+    g_free(message);
+
+    g_assert_true(eventd_protocol_is_binary(fixture->sender));
+}
+
+static void
+_init_data(EventdProtocolBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    gboolean binary = GPOINTER_TO_UINT(user_data);
+    GByteArray *stream;
+    guint i;
+
+    fixture->sender = eventd_protocol_new(&_callbacks, fixture, NULL);
+    fixture->receiver = eventd_protocol_new(&_callbacks, fixture, NULL);
+    if ( binary )
+        _eventd_protocol_benchmark_negotiate(fixture);
+
+    stream = g_byte_array_new();
+    for ( i = 0 ; i < EVENTS ; ++i )
+    {
+        EventdEvent *event;
+        GBytes *message;
+        gconstpointer data;
+        gsize size;
+
+        event = fixture->events[i] = eventd_event_new("bench", "event");
+        eventd_event_add_data_string(event, g_strdup("title"), g_strdup_printf("Event number %u", i));
+        eventd_event_add_data_string(event, g_strdup("message"), g_strdup("Some text to display\nover two lines"));
+        eventd_event_add_data(event, g_strdup("id"), g_variant_new_uint64(i));
+        eventd_event_add_data(event, g_strdup("urgent"), g_variant_new_boolean(( i % 2 ) == 0));
+
+        message = eventd_protocol_generate_event_bytes(fixture->sender, event);
+        data = g_bytes_get_data(message, &size);
+        g_byte_array_append(stream, data, size);
+        g_bytes_unref(message);
+    }
+    fixture->stream = g_byte_array_free_to_bytes(stream);
+}
+
+static void
+_clean_data(EventdProtocolBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    guint i;
+
+    for ( i = 0 ; i < EVENTS ; ++i )
+        eventd_event_unref(fixture->events[i]);
+    g_bytes_unref(fixture->stream);
+    eventd_protocol_unref(fixture->receiver);
+    eventd_protocol_unref(fixture->sender);
+}
+
+static void
+_eventd_protocol_benchmark_generator_func(EventdProtocolBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    const gchar *mode = GPOINTER_TO_UINT(user_data) ? "binary" : "text";
+    gsize length = 0;
+    gdouble elapsed;
+    guint i;
+
+    g_test_timer_start();
+    for ( i = 0 ; i < EVENTS ; ++i )
+    {
+        GBytes *message;
+
+        message = eventd_protocol_generate_event_bytes(fixture->sender, fixture->events[i]);
+        length += g_bytes_get_size(message);
+        g_bytes_unref(message);
+    }
+    elapsed = g_test_timer_elapsed();
+
+    g_assert_cmpuint(length, ==, g_bytes_get_size(fixture->stream));
+
+    g_test_message("%s: %.1f bytes/event, %.3f µs/event, %.1f MiB/s", mode, (gdouble) length / EVENTS, elapsed * 1e6 / EVENTS, length / elapsed / ( 1024 * 1024 ));
+    g_test_minimized_result(elapsed * 1e6 / EVENTS, "%s generation: %.3f µs/event", mode, elapsed * 1e6 / EVENTS);
+}
+
+static void
+_eventd_protocol_benchmark_parser_func(EventdProtocolBenchmarkFixture *fixture, gconstpointer user_data)
+{
+    const gchar *mode = GPOINTER_TO_UINT(user_data) ? "binary" : "text";
+    gsize length, o;
+    gchar *buffer;
+    gdouble elapsed;
+
+    /* The parser tokenizes text lines in place, work on a copy */
+    buffer = g_bytes_unref_to_data(g_bytes_ref(fixture->stream), &length);
+
+    g_test_timer_start();
+    for ( o = 0 ; o < length ; o += 4096 )
+        g_assert_true(eventd_protocol_parse_chunk(fixture->receiver, buffer + o, MIN(4096, length - o), NULL));
+    elapsed = g_test_timer_elapsed();
+
+    g_assert_cmpuint(fixture->received, ==, EVENTS);
+
+    g_test_message("%s: %.1f bytes/event, %.3f µs/event", mode, (gdouble) length / EVENTS, elapsed * 1e6 / EVENTS);
+    g_test_minimized_result(elapsed * 1e6 / EVENTS, "%s parsing: %.3f µs/event", mode, elapsed * 1e6 / EVENTS);
+
+    g_free(buffer);
+}
+
+int
+main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "C");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/libeventd/protocol/benchmark/parser/text", EventdProtocolBenchmarkFixture, GUINT_TO_POINTER(FALSE), _init_data, _eventd_protocol_benchmark_parser_func, _clean_data);
+    g_test_add("/libeventd/protocol/benchmark/parser/binary", EventdProtocolBenchmarkFixture, GUINT_TO_POINTER(TRUE), _init_data, _eventd_protocol_benchmark_parser_func, _clean_data);
+    g_test_add("/libeventd/protocol/benchmark/generator/text", EventdProtocolBenchmarkFixture, GUINT_TO_POINTER(FALSE), _init_data, _eventd_protocol_benchmark_generator_func, _clean_data);
+    g_test_add("/libeventd/protocol/benchmark/generator/binary", EventdProtocolBenchmarkFixture, GUINT_TO_POINTER(TRUE), _init_data, _eventd_protocol_benchmark_generator_func, _clean_data);
+
+    return g_test_run();
+}
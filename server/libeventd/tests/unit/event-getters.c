@@ -44,6 +44,18 @@ _init_data_with_data(gpointer fixture, gconstpointer user_data)
     eventd_event_add_data_string(data->event, g_strdup(EVENTD_EVENT_TEST_DATA_NAME), g_strdup(EVENTD_EVENT_TEST_DATA_CONTENT));
 }
 
+static void
+_init_data_with_lots_of_data(gpointer fixture, gconstpointer user_data)
+{
+    GettersData *data = fixture;
+    _init_data(fixture, user_data);
+
+    gsize i;
+    for ( i = 0 ; i < 32 ; ++i )
+        eventd_event_add_data_string(data->event, g_strdup_printf(EVENTD_EVENT_TEST_DATA_NAME "-%" G_GSIZE_FORMAT, i), g_strdup_printf(EVENTD_EVENT_TEST_DATA_CONTENT "-%" G_GSIZE_FORMAT, i));
+    eventd_event_add_data_string(data->event, g_strdup(EVENTD_EVENT_TEST_DATA_NAME "-0"), g_strdup(EVENTD_EVENT_TEST_DATA_CONTENT));
+}
+
 static void
 _clean_data(gpointer fixture, gconstpointer user_data)
 {
@@ -142,6 +154,29 @@ _test_get_data_notnull_good__notnull(gpointer fixture, gconstpointer user_data)
     g_assert_cmpstr(eventd_event_get_data_string(data->event, EVENTD_EVENT_TEST_DATA_NAME), ==, EVENTD_EVENT_TEST_DATA_CONTENT);
 }
 
+static void
+_test_get_data_lots(gpointer fixture, gconstpointer user_data)
+{
+    GettersData *data = fixture;
+
+    gsize i;
+    for ( i = 1 ; i < 32 ; ++i )
+    {
+        gchar *name = g_strdup_printf(EVENTD_EVENT_TEST_DATA_NAME "-%" G_GSIZE_FORMAT, i);
+        gchar *content = g_strdup_printf(EVENTD_EVENT_TEST_DATA_CONTENT "-%" G_GSIZE_FORMAT, i);
+        g_assert_cmpstr(eventd_event_get_data_string(data->event, name), ==, content);
+        g_free(content);
+        g_free(name);
+    }
+    g_assert_cmpstr(eventd_event_get_data_string(data->event, EVENTD_EVENT_TEST_DATA_NAME "-0"), ==, EVENTD_EVENT_TEST_DATA_CONTENT);
+    g_assert_null(eventd_event_get_data(data->event, EVENTD_EVENT_TEST_DATA_NAME "-32"));
+
+    GHashTable *all_data;
+    all_data = eventd_event_get_all_data(data->event);
+    g_assert_cmpuint(g_hash_table_size(all_data), ==, 32);
+    g_hash_table_unref(all_data);
+}
+
 static void
 _test_get_data_null_good__null(gpointer fixture, gconstpointer user_data)
 {
@@ -191,6 +226,7 @@ eventd_tests_unit_eventd_event_suite_getters(void)
     g_test_suite_add(suite, g_test_create_case("get_data(event, name) = NULL",           sizeof(GettersData), NULL, _init_data,           _test_get_data_notnull_good__null,           _clean_data));
     g_test_suite_add(suite, g_test_create_case("get_data(event, name2) = NULL",          sizeof(GettersData), NULL, _init_data_with_data, _test_get_data_notnull_good2__null,          _clean_data));
     g_test_suite_add(suite, g_test_create_case("get_data(event, name) = content",        sizeof(GettersData), NULL, _init_data_with_data, _test_get_data_notnull_good__notnull,        _clean_data));
+    g_test_suite_add(suite, g_test_create_case("get_data(event, name) = content (lots)", sizeof(GettersData), NULL, _init_data_with_lots_of_data, _test_get_data_lots,                _clean_data));
     g_test_suite_add(suite, g_test_create_case("get_data(NULL)",                         sizeof(GettersData), NULL, NULL,                 _test_get_data_null_good__null,              NULL));
     g_test_suite_add(suite, g_test_create_case("get_data(event, NULL)",                  sizeof(GettersData), NULL, NULL,                 _test_get_data_notnull_bad__null,            NULL));
 
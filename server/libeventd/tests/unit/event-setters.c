@@ -145,6 +145,51 @@ _test_add_data_notnull_good_bad(gpointer fixture, gconstpointer user_data)
     g_test_trap_assert_failed();
 }
 
+static void
+_test_cached_string(gpointer fixture, gconstpointer user_data)
+{
+    SettersData *data = fixture;
+    gchar *string;
+
+    g_assert_null(eventd_event_get_cached_string(data->event, 1));
+
+    eventd_event_set_cached_string(data->event, 1, EVENTD_EVENT_TEST_DATA_CONTENT);
+    string = eventd_event_get_cached_string(data->event, 1);
+    g_assert_cmpstr(string, ==, EVENTD_EVENT_TEST_DATA_CONTENT);
+    g_free(string);
+    g_assert_null(eventd_event_get_cached_string(data->event, 2));
+
+    eventd_event_add_data_string(data->event, g_strdup(EVENTD_EVENT_TEST_DATA_NAME), g_strdup(EVENTD_EVENT_TEST_DATA_CONTENT));
+    g_assert_null(eventd_event_get_cached_string(data->event, 1));
+}
+
+static void
+_test_slab(gpointer fixture, gconstpointer user_data)
+{
+    EventdEventAllocationStats before, after;
+    EventdEvent *event;
+
+    eventd_event_slab_set_size(1);
+
+    event = eventd_event_new_for_uuid_string(EVENTD_EVENT_TEST_UUID, EVENTD_EVENT_TEST_CATEGORY, EVENTD_EVENT_TEST_NAME);
+    eventd_event_unref(event);
+
+    eventd_event_get_allocation_stats(&before);
+    event = eventd_event_new_for_uuid_string(EVENTD_EVENT_TEST_UUID, EVENTD_EVENT_TEST_CATEGORY, EVENTD_EVENT_TEST_NAME);
+    g_assert_cmpstr(eventd_event_get_category(event), ==, EVENTD_EVENT_TEST_CATEGORY);
+    g_assert_cmpstr(eventd_event_get_name(event), ==, EVENTD_EVENT_TEST_NAME);
+    g_assert_null(eventd_event_get_data(event, EVENTD_EVENT_TEST_DATA_NAME));
+    eventd_event_unref(event);
+    eventd_event_get_allocation_stats(&after);
+
+    g_assert_cmpuint(after.allocated, ==, before.allocated);
+    g_assert_cmpuint(after.recycled, ==, before.recycled + 1);
+
+    eventd_event_slab_set_size(0);
+    eventd_event_get_allocation_stats(&after);
+    g_assert_cmpuint(after.released, ==, before.released + 1);
+}
+
 void
 eventd_tests_unit_eventd_event_suite_setters(void)
 {
@@ -161,5 +206,8 @@ eventd_tests_unit_eventd_event_suite_setters(void)
     g_test_suite_add(suite, g_test_create_case("add_data(event, NULL,)",             sizeof(SettersData), NULL, _init_data, _test_add_data_notnull_bad_good,         _clean_data));
     g_test_suite_add(suite, g_test_create_case("add_data(event, NULL, NULL)",        sizeof(SettersData), NULL, _init_data, _test_add_data_notnull_good_bad,         _clean_data));
 
+    g_test_suite_add(suite, g_test_create_case("cached_string(event)",               sizeof(SettersData), NULL, _init_data, _test_cached_string,                      _clean_data));
+    g_test_suite_add(suite, g_test_create_case("slab",                               sizeof(SettersData), NULL, NULL,       _test_slab,                              NULL));
+
     g_test_suite_add_suite(g_test_get_root(), suite);
 }
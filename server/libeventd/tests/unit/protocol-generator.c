@@ -20,6 +20,8 @@
  *
  */
 
+#include <string.h>
+
 #include "common.h"
 #include "protocol-generator.h"
 
@@ -84,6 +86,30 @@ _test_evp_generate_event(gpointer fixture, gconstpointer user_data)
     g_free(message);
 }
 
+static void
+_test_evp_generate_event_bytes(gpointer fixture, gconstpointer user_data)
+{
+    GeneratorData *data = fixture;
+    GBytes *message, *cached;
+    gchar *expected;
+
+    message = eventd_protocol_generate_event_bytes(data->protocol, data->event);
+    cached = eventd_protocol_generate_event_bytes(data->protocol, data->event);
+    g_assert_true(message == cached);
+    g_bytes_unref(cached);
+
+    expected = eventd_protocol_generate_event(data->protocol, data->event);
+    g_assert_cmpmem(g_bytes_get_data(message, NULL), g_bytes_get_size(message), expected, strlen(expected));
+    g_free(expected);
+
+    eventd_event_add_data_string(data->event, g_strdup("new-data"), g_strdup("content"));
+    cached = eventd_protocol_generate_event_bytes(data->protocol, data->event);
+    g_assert_true(message != cached);
+    g_bytes_unref(cached);
+
+    g_bytes_unref(message);
+}
+
 static void
 _test_evp_generate_bye(gpointer fixture, gconstpointer user_data)
 {
@@ -116,6 +142,7 @@ eventd_tests_unit_eventd_protocol_suite_generator(void)
 
     g_test_suite_add(suite, g_test_create_case("evp_generate_event()",             sizeof(GeneratorData), NULL,                  _init_data,           _test_evp_generate_event,    _clean_data));
     g_test_suite_add(suite, g_test_create_case("evp_generate_event(data)",         sizeof(GeneratorData), NULL,                  _init_data_with_data, _test_evp_generate_event,    _clean_data));
+    g_test_suite_add(suite, g_test_create_case("evp_generate_event_bytes(cache)", sizeof(GeneratorData), NULL,                  _init_data_with_data, _test_evp_generate_event_bytes, _clean_data));
     g_test_suite_add(suite, g_test_create_case("evp_generate_bye()",               sizeof(GeneratorData), NULL,                  _init_data,           _test_evp_generate_bye,      _clean_data));
     g_test_suite_add(suite, g_test_create_case("evp_generate_bye(message)",        sizeof(GeneratorData), GINT_TO_POINTER(TRUE), _init_data,           _test_evp_generate_bye,      _clean_data));
 
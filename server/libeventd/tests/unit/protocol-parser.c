@@ -32,6 +32,8 @@ static gchar *BUILDER_EVENT_LINES[] = {
 typedef struct {
     EventdProtocol *protocol;
     EventdEvent *event;
+    GHashTable *categories;
+    EventdProtocolSubscribeFilter filter;
 } EvpData;
 
 static void
@@ -42,8 +44,22 @@ _test_evp_event_callback(EventdProtocol *parser, EventdEvent *event, gpointer us
     data->event = eventd_event_ref(event);
 }
 
+static void
+_test_evp_subscribe_filter_callback(EventdProtocol *parser, GHashTable *categories, const EventdProtocolSubscribeFilter *filter, gpointer user_data)
+{
+    EvpData *data = user_data;
+
+    if ( categories != NULL )
+        data->categories = g_hash_table_ref(categories);
+    data->filter.if_data = g_strdupv(filter->if_data);
+    data->filter.if_data_matches = g_strdupv(filter->if_data_matches);
+    data->filter.if_data_regexes = g_strdupv(filter->if_data_regexes);
+    data->filter.only_data = g_strdupv(filter->only_data);
+}
+
 static const EventdProtocolCallbacks _callbacks = {
-    .event = _test_evp_event_callback
+    .event = _test_evp_event_callback,
+    .subscribe_filter = _test_evp_subscribe_filter_callback,
 };
 
 static void
@@ -61,6 +77,13 @@ _clean_data_evp(gpointer fixture, gconstpointer user_data)
 
     eventd_event_unref(data->event);
 
+    if ( data->categories != NULL )
+        g_hash_table_unref(data->categories);
+    g_strfreev(data->filter.if_data);
+    g_strfreev(data->filter.if_data_matches);
+    g_strfreev(data->filter.if_data_regexes);
+    g_strfreev(data->filter.only_data);
+
     eventd_protocol_unref(data->protocol);
 }
 
@@ -108,6 +131,140 @@ _test_evp_parse_parts_bad(gpointer fixture, gconstpointer user_data)
     g_assert_null(data->event);
 }
 
+static void
+_test_evp_parse_chunks(gpointer fixture, gconstpointer user_data)
+{
+    EvpData *data = fixture;
+    gboolean r;
+    GError *error = NULL;
+    gsize sizes[] = { 1, 2, 3, 7, 64, 4096 };
+    gsize i, o, length;
+    gchar *message, *buffer;
+
+    message = g_strjoinv("\n", BUILDER_EVENT_LINES);
+    length = strlen(message) + 1;
+    message[length - 1] = '\n';
+    buffer = g_new(gchar, length);
+
+    for ( i = 0 ; i < G_N_ELEMENTS(sizes) ; ++i )
+    {
+        /* The parser tokenizes in place, work on a copy */
+        memcpy(buffer, message, length);
+        for ( o = 0 ; o < length ; o += sizes[i] )
+        {
+            g_assert_null(data->event);
+            r = eventd_protocol_parse_chunk(data->protocol, buffer + o, MIN(sizes[i], length - o), &error);
+            g_assert_true(r);
+            g_assert_no_error(error);
+        }
+        g_assert_nonnull(data->event);
+        g_assert_cmpstr(eventd_event_get_data_string(data->event, EVENTD_EVENT_TEST_DATA_ESCAPING_NAME), ==, "." EVENTD_EVENT_TEST_DATA_ESCAPING_CONTENT);
+
+        eventd_event_unref(data->event);
+        data->event = NULL;
+    }
+
+    g_free(buffer);
+    g_free(message);
+}
+
+static void
+_test_evp_parse_chunk_binary(gpointer fixture, gconstpointer user_data)
+{
+    EvpData *data = fixture;
+    gboolean r;
+    GError *error = NULL;
+    gsize sizes[] = { 1, 2, 3, 7, 64, 4096 };
+    gsize i, o, length;
+    EventdProtocol *sender;
+    EventdEvent *event;
+    gchar *message;
+    GBytes *frame;
+
+    sender = eventd_protocol_new(&_callbacks, NULL, NULL);
+
+    /* Negotiate frames from sender to our parser */
+    message = eventd_protocol_generate_binary(sender);
+    r = eventd_protocol_parse_chunk(data->protocol, message, strlen(message), &error);
+    g_assert_true(r);
+    g_assert_no_error(error);
+    g_free(message);
+    g_assert_false(eventd_protocol_is_binary(sender));
+
+    message = eventd_protocol_generate_binary(data->protocol);
+    r = eventd_protocol_parse_chunk(sender, message, strlen(message), &error);
+    g_assert_true(r);
+    g_assert_no_error(error);
+    g_free(message);
+    g_assert_true(eventd_protocol_is_binary(sender));
+    g_assert_true(eventd_protocol_is_binary(data->protocol));
+
+    event = eventd_event_new_for_uuid_string(EVENTD_EVENT_TEST_UUID, EVENTD_EVENT_TEST_CATEGORY, EVENTD_EVENT_TEST_NAME);
+    eventd_event_add_data_string(event, g_strdup(EVENTD_EVENT_TEST_DATA_ESCAPING_NAME), g_strdup(EVENTD_EVENT_TEST_DATA_ESCAPING_CONTENT));
+    frame = eventd_protocol_generate_event_bytes(sender, event);
+    eventd_event_unref(event);
+
+    message = g_bytes_unref_to_data(frame, &length);
+    g_assert_cmpuint((guchar) message[0], ==, 0xff);
+
+    for ( i = 0 ; i < G_N_ELEMENTS(sizes) ; ++i )
+    {
+        for ( o = 0 ; o < length ; o += sizes[i] )
+        {
+            g_assert_null(data->event);
+            r = eventd_protocol_parse_chunk(data->protocol, message + o, MIN(sizes[i], length - o), &error);
+            g_assert_true(r);
+            g_assert_no_error(error);
+        }
+        g_assert_nonnull(data->event);
+        g_assert_cmpstr(eventd_event_get_uuid(data->event), ==, EVENTD_EVENT_TEST_UUID);
+        g_assert_cmpstr(eventd_event_get_category(data->event), ==, EVENTD_EVENT_TEST_CATEGORY);
+        g_assert_cmpstr(eventd_event_get_name(data->event), ==, EVENTD_EVENT_TEST_NAME);
+        g_assert_cmpstr(eventd_event_get_data_string(data->event, EVENTD_EVENT_TEST_DATA_ESCAPING_NAME), ==, EVENTD_EVENT_TEST_DATA_ESCAPING_CONTENT);
+
+        eventd_event_unref(data->event);
+        data->event = NULL;
+    }
+
+    g_free(message);
+    eventd_protocol_unref(sender);
+}
+
+static void
+_test_evp_parse_subscribe_filter(gpointer fixture, gconstpointer user_data)
+{
+    EvpData *data = fixture;
+    gboolean r;
+    GError *error = NULL;
+    GHashTable *categories;
+    gchar *if_data_matches[] = { "count,>=,uint64 3", NULL };
+    gchar *only_data[] = { "title", "message", NULL };
+    EventdProtocolSubscribeFilter filter = {
+        .if_data_matches = if_data_matches,
+        .only_data = only_data,
+    };
+    gchar *message;
+
+    categories = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_add(categories, EVENTD_EVENT_TEST_CATEGORY);
+
+    message = eventd_protocol_generate_subscribe_filter(data->protocol, categories, &filter);
+    g_hash_table_unref(categories);
+
+    r = eventd_protocol_parse_chunk(data->protocol, message, strlen(message), &error);
+    g_assert_true(r);
+    g_assert_no_error(error);
+    g_free(message);
+
+    g_assert_nonnull(data->categories);
+    g_assert_cmpuint(g_hash_table_size(data->categories), ==, 1);
+    g_assert_true(g_hash_table_contains(data->categories, EVENTD_EVENT_TEST_CATEGORY));
+    g_assert_null(data->filter.if_data);
+    g_assert_null(data->filter.if_data_regexes);
+    g_assert_true(g_strv_equal((const gchar * const *) data->filter.if_data_matches, (const gchar * const *) if_data_matches));
+    g_assert_true(g_strv_equal((const gchar * const *) data->filter.only_data, (const gchar * const *) only_data));
+}
+
 void
 eventd_tests_unit_eventd_protocol_suite_parser(void)
 {
@@ -117,6 +274,9 @@ eventd_tests_unit_eventd_protocol_suite_parser(void)
 
     g_test_suite_add(suite, g_test_create_case("evp_parse(parts_good)",   sizeof(EvpData), NULL, _init_data_evp, _test_evp_parse_parts_good,   _clean_data_evp));
     g_test_suite_add(suite, g_test_create_case("evp_parse(parts_bad)",    sizeof(EvpData), NULL, _init_data_evp, _test_evp_parse_parts_bad,    _clean_data_evp));
+    g_test_suite_add(suite, g_test_create_case("evp_parse_chunk(chunks)", sizeof(EvpData), NULL, _init_data_evp, _test_evp_parse_chunks,      _clean_data_evp));
+    g_test_suite_add(suite, g_test_create_case("evp_parse_chunk(binary)", sizeof(EvpData), NULL, _init_data_evp, _test_evp_parse_chunk_binary, _clean_data_evp));
+    g_test_suite_add(suite, g_test_create_case("evp_parse(subscribe_filter)", sizeof(EvpData), NULL, _init_data_evp, _test_evp_parse_subscribe_filter, _clean_data_evp));
 
     g_test_suite_add_suite(g_test_get_root(), suite);
 }